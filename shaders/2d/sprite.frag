@@ -1,9 +1,12 @@
 #version 300 es
 precision highp float;
+precision highp sampler2DArray;
 
 in vec2 vsTex;
 
-uniform sampler2D tex0;
+uniform sampler2DArray uSprites;
+uniform int uLayer;
+uniform vec4 uUvRect; /* x0, y0, x1, y1 inside the layer */
 uniform vec3 uColor;
 
 out vec4 fragColor;
@@ -11,7 +14,11 @@ out vec4 fragColor;
 void
 main()
 {
-    vec4 col = texture(tex0, vsTex);
+    /* keep nearest sampling from stepping outside of the image */
+    vec2 halfTexel = 0.5 / vec2(textureSize(uSprites, 0).xy);
+    vec2 uv = clamp(mix(uUvRect.xy, uUvRect.zw, vsTex), uUvRect.xy + halfTexel, uUvRect.zw - halfTexel);
+
+    vec4 col = texture(uSprites, vec3(uv, float(uLayer)));
     fragColor = vec4(uColor, 1.0) * col;
 
     if (col.a < 0.1)
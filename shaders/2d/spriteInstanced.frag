@@ -0,0 +1,26 @@
+#version 300 es
+precision highp float;
+precision highp sampler2DArray;
+
+in vec2 vsTex;
+flat in int vsLayer;
+flat in vec4 vsUvRect; /* x0, y0, x1, y1 inside the layer */
+flat in vec3 vsColor;
+
+uniform sampler2DArray uSprites;
+
+out vec4 fragColor;
+
+void
+main()
+{
+    /* keep nearest sampling from stepping outside of the image */
+    vec2 halfTexel = 0.5 / vec2(textureSize(uSprites, 0).xy);
+    vec2 uv = clamp(mix(vsUvRect.xy, vsUvRect.zw, vsTex), vsUvRect.xy + halfTexel, vsUvRect.zw - halfTexel);
+
+    vec4 col = texture(uSprites, vec3(uv, float(vsLayer)));
+    fragColor = vec4(vsColor, 1.0) * col;
+
+    if (col.a < 0.1)
+        discard;
+}
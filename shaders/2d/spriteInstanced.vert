@@ -0,0 +1,33 @@
+#version 300 es
+precision highp float;
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTex;
+/* per instance, render::SpriteInstance */
+layout (location = 2) in vec4 aPosLayer;
+layout (location = 3) in vec2 aScale;
+layout (location = 4) in vec4 aUvRect;
+layout (location = 5) in vec3 aColor;
+
+layout (std140) uniform ubProjView
+{
+    mat4 uProj;
+    mat4 uView;
+};
+
+out vec2 vsTex;
+flat out int vsLayer;
+flat out vec4 vsUvRect;
+flat out vec3 vsColor;
+
+void
+main()
+{
+    vsTex = aTex;
+    vsLayer = int(aPosLayer.w);
+    vsUvRect = aUvRect;
+    vsColor = aColor;
+
+    /* same as sprite.vert's translate * scale, hidden ones collapse to a point */
+    gl_Position = uProj * vec4(aPosLayer.xy + aPos.xy*aScale, aPosLayer.z, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 300 es
+precision mediump float;
+
+in vec2 vsTex;
+
+out vec4 fragColor;
+
+uniform sampler2D uTex0;
+uniform vec4 uColor;
+
+void
+main()
+{
+    /* 0.5 is the outline, fwidth keeps the edge about one pixel wide at any scale */
+    float dist = texture(uTex0, vsTex).r;
+    float w = max(fwidth(dist), 0.0001);
+    float alpha = smoothstep(0.5 - w, 0.5 + w, dist);
+
+    if (alpha < 0.01)
+        discard;
+
+    fragColor = uColor * vec4(vec3(alpha), 1.0f);
+}
@@ -0,0 +1,22 @@
+#version 310 es
+precision highp float;
+
+in vec2 vsTex;
+in vec3 vsNorm;
+
+uniform sampler2D uTex0;
+
+out vec4 fragColor;
+
+void
+main()
+{
+    vec4 col = texture(uTex0, vsTex);
+
+    if (col.a < 0.1)
+        discard;
+
+    /* light from the camera, enough to tell the faces apart */
+    float diff = max(dot(normalize(vsNorm), vec3(0.0, 0.0, 1.0)), 0.0);
+    fragColor = vec4(col.rgb * (0.25 + 0.75 * diff), col.a);
+}
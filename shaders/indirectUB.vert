@@ -0,0 +1,43 @@
+#version 310 es
+precision highp float;
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTex;
+layout (location = 2) in vec3 aNorm;
+layout (location = 4) in uint aDrawID; /* per instance, the command's baseInstance picks it */
+
+layout (std140) uniform ubProjView
+{
+    mat4 uProj;
+    mat4 uView;
+};
+
+/* positions are quantized over the bounds of their primitive */
+struct Draw
+{
+    mat4 tm;
+    vec4 posOffset;
+    vec4 posScale;
+};
+
+layout (std430, binding = 1) readonly buffer sbDraws
+{
+    Draw aDraws[];
+};
+
+uniform mat4 uModel;
+
+out vec2 vsTex;
+out vec3 vsNorm;
+
+void
+main()
+{
+    Draw d = aDraws[aDrawID];
+    mat4 m = uModel * d.tm;
+    vec3 pos = aPos * d.posScale.xyz + d.posOffset.xyz;
+
+    vsTex = aTex;
+    vsNorm = mat3(transpose(inverse(m))) * aNorm;
+    gl_Position = uProj * uView * m * vec4(pos, 1.0);
+}
@@ -1,3 +1,4 @@
+#include "adt/AllocStats.hh"
 #include "adt/Pool.hh"
 
 template<typename ALLOC_T, adt::u32 CAP>
@@ -20,6 +21,16 @@ struct AllocatorPool
         return &pool[idx];
     }
 
+    /* same as get(), counted under ntsName with ADT_ALLOC_STATS */
+    template<typename ...ARGS>
+    [[nodiscard]] ALLOC_T*
+    getNamed(const char* ntsName, ARGS&&... args)
+    {
+        ALLOC_T* p = get(std::forward<ARGS>(args)...);
+        p->setStats(adt::allocStatsGet(ntsName));
+        return p;
+    }
+
     void
     giveBack(ALLOC_T* pAlloc)
     {
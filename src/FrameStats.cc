@@ -0,0 +1,144 @@
+#include "FrameStats.hh"
+
+#include "adt/OsAllocator.hh"
+#include "adt/defer.hh"
+#include "adt/sort.hh"
+
+#include <cmath>
+#include <cstring>
+
+namespace frame
+{
+
+Percentiles
+computePercentiles(f32* pScratch, u32 n)
+{
+    if (n == 0) return {};
+
+    f64 sum = 0.0;
+    for (u32 i = 0; i < n; ++i) sum += pScratch[i];
+
+    sort::quick(pScratch, 0, n - 1);
+
+    auto rank = [&](f32 p) {
+        const u32 i = u32(std::ceil(p * f32(n)));
+        return pScratch[i > 0 ? i - 1 : 0];
+    };
+
+    return {
+        .p50 = rank(0.50f),
+        .p95 = rank(0.95f),
+        .p99 = rank(0.99f),
+        .max = pScratch[n - 1],
+        .mean = f32(sum / n),
+    };
+}
+
+Percentiles
+SampleRing::percentiles() const
+{
+    f32 aScratch[RING_SIZE];
+    const u32 n = getSize();
+    memcpy(aScratch, m_aRing, n * sizeof(f32));
+
+    return computePercentiles(aScratch, n);
+}
+
+void
+FrameStats::push(const FrameRecord& r)
+{
+    m_aRing[m_nFrames & (RING_SIZE - 1)] = r;
+    ++m_nFrames;
+
+    if (m_bKeepHistory) m_aHistory.push(m_pAlloc, r);
+}
+
+Percentiles
+FrameStats::percentiles(f32 FrameRecord::* pField) const
+{
+    f32 aScratch[RING_SIZE];
+    const u32 n = getSize();
+    for (u32 i = 0; i < n; ++i) aScratch[i] = at(i).*pField;
+
+    return computePercentiles(aScratch, n);
+}
+
+Percentiles
+FrameStats::percentilesAll(f32 FrameRecord::* pField) const
+{
+    if (!m_bKeepHistory) return percentiles(pField);
+
+    const u32 n = m_aHistory.getSize();
+    f32* pScratch = (f32*)OsAllocatorGet()->malloc(utils::max(n, 1u), sizeof(f32));
+    defer( OsAllocatorGet()->free(pScratch) );
+
+    for (u32 i = 0; i < n; ++i) pScratch[i] = m_aHistory[i].*pField;
+
+    return computePercentiles(pScratch, n);
+}
+
+void
+FrameStats::keepHistory(IAllocator* pAlloc)
+{
+    m_pAlloc = pAlloc;
+    m_bKeepHistory = true;
+}
+
+void
+FrameStats::writeSummaryCSV(FILE* pf) const
+{
+    const Percentiles aP[] {
+        percentilesAll(&FrameRecord::wallMS),
+        percentilesAll(&FrameRecord::simMS),
+        percentilesAll(&FrameRecord::drawMS),
+        percentilesAll(&FrameRecord::swapMS),
+        m_tickMS.percentiles(),
+        m_inputMS.percentiles(),
+    };
+
+    fprintf(pf, "stat,wall_ms,sim_ms,draw_ms,swap_ms,tick_ms,input_ms\n");
+
+    const char* aNames[] {"p50", "p95", "p99", "max", "mean"};
+    f32 Percentiles::* aFields[] {&Percentiles::p50, &Percentiles::p95, &Percentiles::p99, &Percentiles::max, &Percentiles::mean};
+    for (u32 i = 0; i < utils::size(aNames); ++i)
+    {
+        fprintf(pf, "%s,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+            aNames[i], aP[0].*aFields[i], aP[1].*aFields[i], aP[2].*aFields[i], aP[3].*aFields[i],
+            aP[4].*aFields[i], aP[5].*aFields[i]
+        );
+    }
+}
+
+bool
+FrameStats::writeFramesCSV(const char* ntsPath) const
+{
+    FILE* pf = fopen(ntsPath, "wb");
+    if (!pf) return false;
+
+    fprintf(pf, "frame,wall_ms,sim_ticks,sim_ms,draw_ms,swap_ms\n");
+
+    auto row = [&](u64 i, const FrameRecord& r) {
+        fprintf(pf, "%llu,%.3f,%u,%.3f,%.3f,%.3f\n",
+            (unsigned long long)i, r.wallMS, r.nTicks, r.simMS, r.drawMS, r.swapMS
+        );
+    };
+
+    if (m_bKeepHistory)
+    {
+        for (u32 i = 0; i < m_aHistory.getSize(); ++i) row(i, m_aHistory[i]);
+    }
+    else
+    {
+        for (u32 i = 0; i < getSize(); ++i) row(m_nFrames - getSize() + i, at(i));
+    }
+
+    return fclose(pf) == 0;
+}
+
+void
+FrameStats::destroy()
+{
+    if (m_pAlloc) m_aHistory.destroy(m_pAlloc);
+}
+
+} /* namespace frame */
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "adt/Vec.hh"
+
+#include <cstdio>
+
+using namespace adt;
+
+namespace frame
+{
+
+/* one iteration of the main loop */
+struct FrameRecord
+{
+    f32 wallMS {}; /* since the previous frame started */
+    f32 simMS {}; /* every updateState() of this frame */
+    f32 drawMS {};
+    f32 swapMS {};
+    u32 nTicks {}; /* updateState() calls */
+};
+
+struct Percentiles
+{
+    f32 p50 {};
+    f32 p95 {};
+    f32 p99 {};
+    f32 max {};
+    f32 mean {};
+};
+
+/* samples that don't come one per frame: sim tick intervals, input latency */
+struct SampleRing
+{
+    static constexpr u32 RING_SIZE = 4096;
+
+    f32 m_aRing[RING_SIZE] {};
+    u64 m_nSamples {};
+
+    /* */
+
+    void push(f32 x) { m_aRing[m_nSamples & (RING_SIZE - 1)] = x; ++m_nSamples; }
+    [[nodiscard]] u32 getSize() const { return m_nSamples < RING_SIZE ? u32(m_nSamples) : RING_SIZE; }
+    [[nodiscard]] Percentiles percentiles() const;
+};
+
+/* The last RING_SIZE frames for the overlay, and every frame when keeping the history (--bench-frames). */
+struct FrameStats
+{
+    static constexpr u32 RING_SIZE = 1024;
+
+    FrameRecord m_aRing[RING_SIZE] {};
+    u64 m_nFrames {};
+
+    IAllocator* m_pAlloc {}; /* for the history */
+    VecBase<FrameRecord> m_aHistory {};
+    bool m_bKeepHistory {};
+
+    SampleRing m_tickMS {}; /* between updateState() starts, pushed by the main thread from the published ticks */
+    SampleRing m_inputMS {}; /* key state change read to the swap of the first frame ticked after it */
+
+    /* */
+
+    void push(const FrameRecord& r);
+    [[nodiscard]] u32 getSize() const { return m_nFrames < RING_SIZE ? u32(m_nFrames) : RING_SIZE; }
+    /* 0 is the oldest one still in the ring */
+    [[nodiscard]] const FrameRecord& at(u32 i) const { return m_aRing[(m_nFrames - getSize() + i) & (RING_SIZE - 1)]; }
+    /* nearest rank, over the ring */
+    [[nodiscard]] Percentiles percentiles(f32 FrameRecord::* pField) const;
+    /* over the history, or the ring without one */
+    [[nodiscard]] Percentiles percentilesAll(f32 FrameRecord::* pField) const;
+
+    void keepHistory(IAllocator* pAlloc);
+    /* one row per stat: p50, p95, p99, max, mean. tick and input over their rings */
+    void writeSummaryCSV(FILE* pf) const;
+    /* one row per frame of the history */
+    bool writeFramesCSV(const char* ntsPath) const;
+    void destroy();
+};
+
+/* pScratch holds n samples, gets sorted in place */
+[[nodiscard]] Percentiles computePercentiles(f32* pScratch, u32 n);
+
+} /* namespace frame */
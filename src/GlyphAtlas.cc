@@ -0,0 +1,351 @@
+#include "GlyphAtlas.hh"
+
+#include "adt/defer.hh"
+#include "adt/logs.hh"
+#include "adt/utils.hh"
+#include "gl/state.hh"
+
+#include <cstring>
+
+namespace text
+{
+
+GlyphAtlas::GlyphAtlas(IAllocator* pAlloc, u16 width, u16 initialHeight, u16 maxHeight)
+    : m_pAlloc(pAlloc),
+      m_width(width),
+      m_height(initialHeight),
+      m_maxHeight(utils::max(initialHeight, maxHeight)),
+      m_pPixels((u8*)pAlloc->zalloc(usize(width) * initialHeight, 1)),
+      m_aShelves(pAlloc, 32),
+      m_aEntries(pAlloc, 128),
+      m_aFreeEntries(pAlloc, 32),
+      m_mKeyToEntryIdx(pAlloc, 256)
+{
+}
+
+const GlyphEntry*
+GlyphAtlas::find(const GlyphKey& key)
+{
+    auto f = m_mKeyToEntryIdx.search(key);
+    if (!f) return nullptr;
+
+    auto& e = m_aEntries[f.data().val];
+    e.lastUsed = m_frame;
+    if (e.shelfIdx != NPOS32) m_aShelves[e.shelfIdx].lastUsed = m_frame;
+
+    return &e;
+}
+
+const GlyphEntry*
+GlyphAtlas::insert(const GlyphKey& key, const Span2D<u8> spBitmap, const GlyphMetrics& metrics)
+{
+    ADT_ASSERT(!m_mKeyToEntryIdx.search(key), "already inserted");
+
+    const u16 width = u16(spBitmap.getWidth());
+    const u16 height = u16(spBitmap.getHeight());
+
+    GlyphEntry entry {
+        .key = key,
+        .metrics = metrics,
+        .width = width,
+        .height = height,
+        .lastUsed = m_frame,
+    };
+
+    /* empty glyphs (space) only carry metrics */
+    if (width > 0 && height > 0)
+    {
+        const u16 slotWidth = width + ATLAS_PADDING;
+        const u16 slotHeight = height + ATLAS_PADDING;
+
+        if (slotWidth > m_width)
+        {
+            LOG_WARN("glyph is wider ({}) than the atlas ({})\n", slotWidth, m_width);
+            ++m_stats.nFailed;
+            return nullptr;
+        }
+
+        u32 shelfIdx = findShelf(slotWidth, slotHeight);
+        while (shelfIdx == NPOS32 && grow())
+            shelfIdx = findShelf(slotWidth, slotHeight);
+
+        if (shelfIdx == NPOS32)
+            shelfIdx = evictShelf(slotWidth, slotHeight);
+
+        if (shelfIdx == NPOS32)
+        {
+            ++m_stats.nFailed;
+            return nullptr;
+        }
+
+        auto& shelf = m_aShelves[shelfIdx];
+        entry.x = shelf.xCursor;
+        entry.y = shelf.y;
+        entry.shelfIdx = shelfIdx;
+
+        shelf.xCursor += slotWidth;
+        shelf.lastUsed = m_frame;
+
+        for (u16 row = 0; row < height; ++row)
+        {
+            memcpy(
+                m_pPixels + usize(entry.y + row)*m_width + entry.x,
+                spBitmap.data() + usize(row)*width,
+                width
+            );
+        }
+
+        markDirty(entry.x, entry.y, width, height);
+    }
+
+    u32 idx = NPOS32;
+    if (!m_aFreeEntries.empty())
+    {
+        idx = *m_aFreeEntries.pop();
+        m_aEntries[idx] = entry;
+    }
+    else
+    {
+        idx = m_aEntries.push(m_pAlloc, entry);
+    }
+
+    m_mKeyToEntryIdx.insert(m_pAlloc, key, idx);
+    ++m_stats.nInserted;
+
+    return &m_aEntries[idx];
+}
+
+u32
+GlyphAtlas::findShelf(u16 width, u16 height)
+{
+    u32 bestIdx = NPOS32;
+    u16 bestHeight = 0xffff;
+
+    /* best fit by height, but don't put tiny glyphs on tall shelves */
+    for (auto& shelf : m_aShelves)
+    {
+        if (shelf.height < height || shelf.height > height + height/4 + 2) continue;
+        if (shelf.xCursor + width > m_width) continue;
+
+        if (shelf.height < bestHeight)
+        {
+            bestHeight = shelf.height;
+            bestIdx = m_aShelves.idx(&shelf);
+        }
+    }
+
+    if (bestIdx != NPOS32) return bestIdx;
+
+    if (m_shelvesEnd + height <= m_height)
+    {
+        bestIdx = m_aShelves.push(m_pAlloc, {
+            .y = m_shelvesEnd,
+            .height = height,
+            .xCursor = 0,
+            .lastUsed = m_frame,
+        });
+        m_shelvesEnd += height;
+    }
+
+    return bestIdx;
+}
+
+void
+GlyphAtlas::releaseShelf(u32 shelfIdx)
+{
+    for (auto& e : m_aEntries)
+    {
+        if (e.shelfIdx != shelfIdx) continue;
+
+        m_mKeyToEntryIdx.remove(e.key);
+        m_aFreeEntries.push(m_pAlloc, u32(m_aEntries.idx(&e)));
+        e = {};
+    }
+
+    auto& shelf = m_aShelves[shelfIdx];
+    shelf.xCursor = 0;
+    shelf.lastUsed = m_frame;
+
+    memset(m_pPixels + usize(shelf.y)*m_width, 0, usize(shelf.height)*m_width);
+    markDirty(0, shelf.y, m_width, shelf.height);
+
+    ++m_generation;
+    ++m_stats.nEvictedShelves;
+}
+
+u32
+GlyphAtlas::evictShelf(u16 width, u16 height)
+{
+    u32 lruIdx = NPOS32;
+    u64 lruFrame = m_frame;
+
+    /* never evict anything touched this frame, the current mesh may reference it */
+    for (auto& shelf : m_aShelves)
+    {
+        if (shelf.height < height || shelf.lastUsed >= m_frame) continue;
+
+        if (shelf.lastUsed < lruFrame)
+        {
+            lruFrame = shelf.lastUsed;
+            lruIdx = m_aShelves.idx(&shelf);
+        }
+    }
+
+    if (lruIdx != NPOS32)
+    {
+        releaseShelf(lruIdx);
+        return lruIdx;
+    }
+
+    /* nothing tall enough (text size changed etc.), merge a run of stale neighbours */
+    const u32 nShelves = u32(m_aShelves.getSize());
+    for (u32 first = 0; first < nShelves; ++first)
+    {
+        if (m_aShelves[first].lastUsed >= m_frame) continue;
+
+        u32 last = first;
+        u32 runHeight = m_aShelves[first].height;
+        while (runHeight < height && last + 1 < nShelves && m_aShelves[last + 1].lastUsed < m_frame)
+            runHeight += m_aShelves[++last].height;
+
+        const bool bTop = last + 1 == nShelves;
+        if (runHeight < height && !(bTop && runHeight + (m_height - m_shelvesEnd) >= height))
+        {
+            first = last;
+            continue;
+        }
+
+        for (u32 i = first; i <= last; ++i)
+            releaseShelf(i);
+
+        if (bTop)
+        {
+            /* give everything back to the free space above */
+            m_shelvesEnd = m_aShelves[first].y;
+            m_aShelves.setSize(m_pAlloc, first);
+            return findShelf(width, height);
+        }
+
+        const u32 nRemoved = last - first;
+        m_aShelves[first].height = u16(runHeight);
+        for (u32 i = 0; i < nRemoved; ++i)
+            m_aShelves.removeAndShift(first + 1);
+
+        for (auto& e : m_aEntries)
+            if (e.shelfIdx != NPOS32 && e.shelfIdx > last) e.shelfIdx -= nRemoved;
+
+        return first;
+    }
+
+    return NPOS32;
+}
+
+bool
+GlyphAtlas::grow()
+{
+    if (m_height >= m_maxHeight) return false;
+
+    u16 newHeight = utils::min(u32(m_height) * 2, u32(m_maxHeight));
+
+    m_pPixels = (u8*)m_pAlloc->realloc(m_pPixels, usize(m_width) * m_height, usize(m_width) * newHeight, 1);
+    memset(m_pPixels + usize(m_width) * m_height, 0, usize(m_width) * (newHeight - m_height));
+
+    LOG_NOTIFY("glyph atlas: {}x{} -> {}x{}\n", m_width, m_height, m_width, newHeight);
+
+    m_height = newHeight;
+    m_bResized = true;
+
+    return true;
+}
+
+void
+GlyphAtlas::markDirty(u16 x, u16 y, u16 width, u16 height)
+{
+    if (!m_bDirty)
+    {
+        m_dirty = {x, y, u16(x + width), u16(y + height)};
+        m_bDirty = true;
+    }
+    else
+    {
+        m_dirty.x0 = utils::min(m_dirty.x0, x);
+        m_dirty.y0 = utils::min(m_dirty.y0, y);
+        m_dirty.x1 = utils::max(m_dirty.x1, u16(x + width));
+        m_dirty.y1 = utils::max(m_dirty.y1, u16(y + height));
+    }
+}
+
+void
+GlyphAtlas::flush()
+{
+    if (!m_bDirty && !m_bResized && m_texId != 0) return;
+
+    if (m_texId == 0)
+    {
+        glGenTextures(1, &m_texId);
+        gl::bindTexture(GL_TEXTURE_2D, m_texId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        m_bResized = true;
+    }
+    else gl::bindTexture(GL_TEXTURE_2D, m_texId);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    defer(
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        gl::bindTexture(GL_TEXTURE_2D, 0);
+    );
+
+    if (m_bResized)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, m_width, m_height, 0, GL_RED, GL_UNSIGNED_BYTE, m_pPixels);
+        m_stats.uploadedBytes += usize(m_width) * m_height;
+    }
+    else
+    {
+        const u16 width = m_dirty.x1 - m_dirty.x0;
+        const u16 height = m_dirty.y1 - m_dirty.y0;
+
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, m_width);
+        glTexSubImage2D(
+            GL_TEXTURE_2D, 0, m_dirty.x0, m_dirty.y0, width, height, GL_RED, GL_UNSIGNED_BYTE,
+            m_pPixels + usize(m_dirty.y0)*m_width + m_dirty.x0
+        );
+        m_stats.uploadedBytes += usize(width) * height;
+    }
+
+    ++m_stats.nUploads;
+    m_bDirty = false;
+    m_bResized = false;
+}
+
+AtlasStats
+GlyphAtlas::getStats() const
+{
+    AtlasStats ret = m_stats;
+    ret.nGlyphs = u32(m_mKeyToEntryIdx.getSize());
+    ret.nShelves = u32(m_aShelves.getSize());
+    ret.width = m_width;
+    ret.height = m_height;
+
+    return ret;
+}
+
+void
+GlyphAtlas::destroy()
+{
+    if (m_texId != 0) gl::deleteTexture(m_texId);
+
+    m_pAlloc->free(m_pPixels);
+    m_aShelves.destroy(m_pAlloc);
+    m_aEntries.destroy(m_pAlloc);
+    m_aFreeEntries.destroy(m_pAlloc);
+    m_mKeyToEntryIdx.destroy(m_pAlloc);
+
+    *this = {};
+}
+
+} /* namespace text */
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "adt/Map.hh"
+#include "adt/Span2D.hh"
+#include "adt/Vec.hh"
+#include "gl/gl.hh" /* IWYU pragma: keep */
+#include "reader/ttf.hh"
+
+using namespace adt;
+
+namespace text
+{
+
+/* 1 pixel gap around every glyph, so linear filtering doesn't bleed into neighbours */
+constexpr u16 ATLAS_PADDING = 1;
+
+struct GlyphKey
+{
+    reader::ttf::Font* pFont {};
+    u32 glyphIdx {};
+    u32 size {}; /* pixel size the glyph was rasterized at */
+
+    bool operator==(const GlyphKey& r) const { return pFont == r.pFont && glyphIdx == r.glyphIdx && size == r.size; }
+};
+
+struct GlyphMetrics
+{
+    f32 xBearing {}; /* pixels from the pen position to the left edge of the bitmap */
+    f32 yBearing {}; /* pixels from the baseline to the bottom edge of the bitmap */
+    f32 advance {}; /* pixels */
+};
+
+struct GlyphEntry
+{
+    GlyphKey key {};
+    GlyphMetrics metrics {};
+    u16 x {};
+    u16 y {};
+    u16 width {};
+    u16 height {};
+    u32 shelfIdx = NPOS32;
+    u64 lastUsed {};
+};
+
+/* Horizontal strip of the atlas, glyphs of similar height are packed left to right. */
+struct AtlasShelf
+{
+    u16 y {};
+    u16 height {};
+    u16 xCursor {};
+    u64 lastUsed {};
+};
+
+struct AtlasRect
+{
+    u16 x0 {};
+    u16 y0 {};
+    u16 x1 {};
+    u16 y1 {};
+};
+
+struct AtlasStats
+{
+    u32 nGlyphs {};
+    u32 nShelves {};
+    u32 width {};
+    u32 height {};
+    u64 nInserted {};
+    u64 nEvictedShelves {};
+    u64 nFailed {};
+    u64 nUploads {};
+    u64 uploadedBytes {};
+};
+
+/* Single channel shelf packed glyph cache.
+ * Texture height grows on demand up to m_maxHeight, after that the least recently used shelf is recycled.
+ * Only the rectangle touched since the last flush() is uploaded. */
+struct GlyphAtlas
+{
+    IAllocator* m_pAlloc {};
+    u16 m_width {};
+    u16 m_height {};
+    u16 m_maxHeight {};
+    u16 m_shelvesEnd {}; /* first row not covered by any shelf */
+    u8* m_pPixels {};
+    GLuint m_texId {};
+
+    VecBase<AtlasShelf> m_aShelves {};
+    VecBase<GlyphEntry> m_aEntries {};
+    VecBase<u32> m_aFreeEntries {};
+    MapBase<GlyphKey, u32> m_mKeyToEntryIdx {};
+
+    u64 m_frame = 1; /* lru clock, advanced once per mesh build */
+    u64 m_generation {}; /* bumped on every eviction, lets users know cached uvs are stale */
+    AtlasRect m_dirty {};
+    bool m_bDirty {};
+    bool m_bResized {};
+
+    AtlasStats m_stats {};
+
+    /* */
+
+    GlyphAtlas() = default;
+    GlyphAtlas(IAllocator* pAlloc, u16 width, u16 initialHeight, u16 maxHeight);
+
+    /* */
+
+    /* nullptr if not cached, marks entry as used this frame */
+    [[nodiscard]] const GlyphEntry* find(const GlyphKey& key);
+
+    /* copy bitmap into the atlas, nullptr if everything is in use this frame */
+    const GlyphEntry* insert(const GlyphKey& key, const Span2D<u8> spBitmap, const GlyphMetrics& metrics);
+
+    /* upload dirty region, requires gl context */
+    void flush();
+
+    void nextFrame() { ++m_frame; }
+
+    [[nodiscard]] AtlasStats getStats() const;
+
+    void destroy();
+
+    /* */
+
+private:
+    u32 findShelf(u16 width, u16 height);
+    u32 evictShelf(u16 width, u16 height);
+    void releaseShelf(u32 shelfIdx);
+    bool grow();
+    void markDirty(u16 x, u16 y, u16 width, u16 height);
+};
+
+} /* namespace text */
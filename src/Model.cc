@@ -1,15 +1,22 @@
 #include "Model.hh"
 
+#include "adt/Arena.hh"
 #include "adt/MutexArena.hh"
+#include "adt/OsAllocator.hh"
 #include "adt/ThreadPool.hh"
+#include "adt/prof.hh"
 #include "adt/file.hh"
 #include "adt/logs.hh"
 #include "adt/utils.hh"
 #include "app.hh"
+#include "gl/state.hh"
+#include "meshopt.hh"
 
 void
 Model::load(String path, GLint drawMode, GLint texMode)
 {
+    PROFILE_SCOPE("Model::load");
+
     if (path.endsWith(".gltf"))
         loadGLTF(path, drawMode, texMode);
     else
@@ -26,6 +33,7 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
     auto& a = m_modelData;;
 
     MutexArena mArena(SIZE_1M * 10);
+    mArena.setStats(allocStatsGet("model:loadGLTF"));
     defer( mArena.freeAll() );
 
     /* load buffers first */
@@ -36,14 +44,14 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
         app::g_pWindow->bindGlContext();
         defer(
             app::g_pWindow->unbindGlContext();
-            gl::g_mtxGlContext.lock();
+            gl::g_mtxGlContext.unlock();
         );
 
         GLuint b;
         glGenBuffers(1, &b);
-        glBindBuffer(GL_ARRAY_BUFFER, b);
+        gl::bindBuffer(GL_ARRAY_BUFFER, b);
         glBufferData(GL_ARRAY_BUFFER, a.m_aBuffers[i].byteLength, a.m_aBuffers[i].aBin.data(), drawMode);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gl::bindBuffer(GL_ARRAY_BUFFER, 0);
         aBufferMap.push(b);
     }
 
@@ -54,12 +62,14 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
     /* preload texures */
     Vec<texture::Img> aTex(&mArena, a.m_aImages.getSize());
     aTex.setSize(a.m_aImages.getCap());
+    Vec<String> aTexPaths(&mArena, a.m_aImages.getSize());
+    aTexPaths.setSize(a.m_aImages.getCap());
 
     for (u32 i = 0; i < a.m_aImages.getSize(); i++)
     {
         auto uri = a.m_aImages[i].uri;
 
-        if (!uri.endsWith(".bmp"))
+        if (!uri.endsWith(".bmp") && !uri.endsWith(".png") && !uri.endsWith(".tga"))
             LOG_FATAL("trying to load unsupported texture: '{}'\n", uri);
 
         struct Args
@@ -72,11 +82,13 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
             GLint texMode;
         };
 
+        aTexPaths[i] = file::replacePathEnding(m_pAlloc, path, uri);
+
         auto* arg = (Args*)mArena.malloc(1, sizeof(Args));
         *arg = {
             .p = &aTex[i],
             .pAlloc = &mArena,
-            .path = file::replacePathEnding(m_pAlloc, path, uri),
+            .path = aTexPaths[i],
             .type = texture::TYPE::DIFFUSE,
             .flip = true,
             .texMode = texMode
@@ -92,7 +104,16 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
         tp.submit(task, arg);
     }
 
+    /* workers only fill upload slots and block when they run out, the context thread flushes them like it does
+     * for loadAssets(). The queued requests point into aTex, so they have to be issued before aTex goes away */
     tp.wait();
+    texture::g_uploadQueue.waitIdle();
+
+    /* the pool has the ids, aTex[i] doesn't if the path was loaded before (Img::load() returns early) */
+    auto loadedTex = [&](ssize imgIdx) {
+        auto f = texture::g_mAllTexturesIdxs.search(aTexPaths[imgIdx]);
+        return f ? texture::g_aAllTextures[f.data().val] : texture::Img {};
+    };
 
     for (auto& mesh : a.m_aMeshes)
     {
@@ -127,7 +148,7 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
                 );
 
                 glGenVertexArrays(1, &nMesh.meshData.vao);
-                glBindVertexArray(nMesh.meshData.vao);
+                gl::bindVertexArray(nMesh.meshData.vao);
 
                 if (accIndIdx != NPOS)
                 {
@@ -139,7 +160,7 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
 
                     /* TODO: figure out how to reuse VBO data for index buffer (possible?) */
                     glGenBuffers(1, &nMesh.meshData.ebo);
-                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, nMesh.meshData.ebo);
+                    gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, nMesh.meshData.ebo);
                     glBufferData(
                         GL_ELEMENT_ARRAY_BUFFER, bvInd.byteLength,
                         &a.m_aBuffers[bvInd.buffer].aBin[bvInd.byteOffset + accInd.byteOffset], drawMode
@@ -156,7 +177,7 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
                 /* if there are different VBO's for positions textures or normals,
                  * given gltf file should be considered harmful, and this will crash ofc */
                 nMesh.meshData.vbo = aBufferMap[bvPos.buffer];
-                glBindBuffer(GL_ARRAY_BUFFER, nMesh.meshData.vbo);
+                gl::bindBuffer(GL_ARRAY_BUFFER, nMesh.meshData.vbo);
 
                 /* positions */
                 glEnableVertexAttribArray(0);
@@ -198,7 +219,7 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
                     );
                 }
 
-                glBindVertexArray(0);
+                gl::bindVertexArray(0);
             }
 
             /* load textures */
@@ -212,7 +233,7 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
                     ssize diffTexInd = a.m_aTextures[baseColorSourceIdx].source;
                     if (diffTexInd != NPOS)
                     {
-                        nMesh.meshData.materials.diffuse = aTex[diffTexInd];
+                        nMesh.meshData.materials.diffuse = loadedTex(diffTexInd);
                         nMesh.meshData.materials.diffuse.m_eType = texture::TYPE::DIFFUSE;
                     }
                 }
@@ -223,7 +244,7 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
                     ssize normTexIdx = a.m_aTextures[normalSourceIdx].source;
                     if (normTexIdx != NPOS)
                     {
-                        nMesh.meshData.materials.normal = aTex[normalSourceIdx];
+                        nMesh.meshData.materials.normal = loadedTex(normTexIdx);
                         nMesh.meshData.materials.normal.m_eType = texture::TYPE::NORMAL;
                     }
                 }
@@ -251,51 +272,145 @@ Model::loadGLTF(String path, GLint drawMode, GLint texMode)
             m_aTmIdxs[at(ch, m_aTmCounters[ch]++)] = i; /* give each children it's parent's idx's */
     }
 
+    mergeMeshes(&tp);
+
+    {
+        gl::g_mtxGlContext.lock();
+        app::g_pWindow->bindGlContext();
+        defer(
+            app::g_pWindow->unbindGlContext();
+            gl::g_mtxGlContext.unlock();
+        );
+
+        uploadIndirect(drawMode);
+    }
+
     return true;
 }
 
+static render::Queue s_queue(OsAllocatorGet());
+
+static render::DrawItem
+meshItem(const Mesh& e, DRAW flags, Shader* sh, String svUniform, String svUniformM3Norm, const math::M4& tm, render::PASS ePass)
+{
+    render::DrawItem it {};
+    it.ePass = ePass;
+    it.eFlags = flags;
+    it.pShader = sh;
+    it.vao = e.meshData.vao;
+    it.diffuse = e.meshData.materials.diffuse.m_id;
+    it.normal = e.meshData.materials.normal.m_id;
+    it.mode = GLenum(e.mode);
+    it.tm = tm;
+
+    if (e.triangleCount != NPOS)
+    {
+        it.count = GLsizei(e.triangleCount);
+    }
+    else
+    {
+        it.count = GLsizei(e.meshData.eboSize);
+        it.indType = GLenum(e.indType);
+    }
+
+    if (sh)
+    {
+        it.svUniform = svUniform;
+        it.svUniformM3Norm = svUniformM3Norm;
+    }
+
+    return it;
+}
+
 void
-Model::draw(DRAW flags, Shader* sh, String svUniform, String svUniformM3Norm, const math::M4& tmGlobal)
+Model::submit(
+    render::Queue* pQueue,
+    DRAW flags,
+    Shader* sh,
+    String svUniform,
+    String svUniformM3Norm,
+    const math::M4& tmGlobal,
+    render::PASS ePass
+)
 {
-    for (auto& m : m_aaMeshes)
+    math::M4 m = math::M4Iden();
+    if (flags & DRAW::APPLY_TM)
+        m *= tmGlobal;
+
+    for (auto& aMeshes : m_aaMeshes)
+        for (auto& e : aMeshes)
+            pQueue->submit(meshItem(e, flags, sh, svUniform, svUniformM3Norm, m, ePass));
+}
+
+math::M4
+Model::nodeTm(int nodeIdx, const math::M4& tmGlobal) const
+{
+    auto& aNodes = m_modelData.m_aNodes;
+    auto& node = aNodes[nodeIdx];
+
+    auto at = [&](int r, int c) -> int {
+        return r*aNodes.getSize() + c;
+    };
+
+    math::M4 tm = tmGlobal;
+    math::Qt rot = math::QtIden();
+    for (int j = 0; j < m_aTmCounters[nodeIdx]; j++)
     {
-        for (auto& e : m)
-        {
-            glBindVertexArray(e.meshData.vao);
+        /* collect each transformation from parent's map */
+        auto& n = aNodes[ m_aTmIdxs[at(nodeIdx, j)] ];
 
-            if (flags & DRAW::DIFF)
-                e.meshData.materials.diffuse.bind(GL_TEXTURE0);
-            if (flags & DRAW::NORM)
-                e.meshData.materials.normal.bind(GL_TEXTURE1);
+        tm = M4Scale(tm, n.scale);
+        rot *= n.rotation;
+        tm *= n.matrix;
+    }
+    tm = M4Scale(tm, node.scale);
+    tm *= QtRot(rot * node.rotation);
+    tm = M4Translate(tm, node.translation);
+    tm *= node.matrix;
 
-            math::M4 m = math::M4Iden();
-            if (flags & DRAW::APPLY_TM)
-                m *= tmGlobal;
+    return tm;
+}
 
-            if (sh)
-            {
-                sh->setM4(svUniform, m);
-                if (flags & DRAW::APPLY_NM) sh->setM3(svUniformM3Norm, M3Normal(M4ToM3(m)));
-            }
+void
+Model::submitGraph(
+    render::Queue* pQueue,
+    DRAW flags,
+    Shader* sh,
+    String svUniform,
+    String svUniformM3Norm,
+    const math::M4& tmGlobal,
+    render::PASS ePass
+)
+{
+    auto& aNodes = m_modelData.m_aNodes;
 
-            if (e.triangleCount != NPOS)
-                glDrawArrays(GLenum(e.mode), 0, e.triangleCount);
-            else
+    for (int i = 0; i < (int)aNodes.getSize(); i++)
+    {
+        auto& node = aNodes[i];
+        if (node.mesh != NPOS)
+        {
+            const math::M4 tm = nodeTm(i, tmGlobal);
+
+            for (auto& e : m_aaMeshes[node.mesh])
             {
-                glDrawElements(
-                    GLenum(e.mode),
-                    e.meshData.eboSize,
-                    GLenum(e.indType),
-                    nullptr
-                );
+                if ((flags & DRAW::SKIP_INDIRECT) && e.bIndirect) continue;
+                pQueue->submit(meshItem(e, flags, sh, svUniform, svUniformM3Norm, tm, ePass));
             }
         }
     }
 }
 
+void
+Model::draw(DRAW flags, Shader* sh, String svUniform, String svUniformM3Norm, const math::M4& tmGlobal)
+{
+    submit(&s_queue, flags, sh, svUniform, svUniformM3Norm, tmGlobal);
+    s_queue.sort();
+    s_queue.execute();
+}
+
 void
 Model::drawGraph(
-    [[maybe_unused]] IAllocator* pFrameAlloc,
+    IAllocator* pFrameAlloc,
     DRAW flags,
     Shader* sh,
     String svUniform,
@@ -303,63 +418,312 @@ Model::drawGraph(
     const math::M4& tmGlobal
 )
 {
-    auto& aNodes = m_modelData.m_aNodes;
+    render::Queue q(pFrameAlloc);
+    defer( q.destroy() );
 
-    auto at = [&](int r, int c) -> int {
-        return r*aNodes.getSize() + c;
+    submitGraph(&q, flags, sh, svUniform, svUniformM3Norm, tmGlobal);
+    q.sort();
+    q.execute();
+}
+
+void
+Model::mergeMeshes(ThreadPool* pTp)
+{
+    auto& a = m_modelData;
+    auto& ind = m_indirect;
+
+    Arena arena(SIZE_8K);
+    defer( arena.freeAll() );
+
+    meshopt::Packed packed = meshopt::loadOrBuild(OsAllocatorGet(), pTp, a, a.m_sPath);
+    defer( packed.destroy() );
+
+    struct PrimRef
+    {
+        u32 layoutIdx = NPOS32;
+        u32 firstIndex {};
+        s32 baseVertex {};
+        u32 count {};
+        math::V4 posOffset {};
+        math::V4 posScale {};
     };
 
-    for (int i = 0; i < (int)aNodes.getSize(); i++)
+    /* where each primitive ended up */
+    Vec<Vec<PrimRef>> aaRefs(&arena, a.m_aMeshes.getSize());
+    for (auto& mesh : a.m_aMeshes)
     {
-        auto& node = aNodes[i];
-        if (node.mesh != NPOS)
+        aaRefs.push(Vec<PrimRef>(&arena, mesh.aPrimitives.getSize()));
+        aaRefs.last().setSize(mesh.aPrimitives.getSize());
+        for (auto& ref : aaRefs.last()) ref = {};
+    }
+
+    meshopt::CacheStats before {}, after {};
+    u32 nTris = 0;
+    const u32 nPrims = packed.header().nPrims;
+
+    for (u32 p = 0; p < nPrims; p++)
+    {
+        const meshopt::Primitive& prim = packed.prim(p);
+        const bool bNormals = prim.flags & meshopt::PRIM_FLAGS::NORMALS;
+        const bool bTangents = prim.flags & meshopt::PRIM_FLAGS::TANGENTS;
+        const GLenum indType = prim.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+        u32 layoutIdx = NPOS32;
+        for (u32 l = 0; l < ind.aLayouts.getSize(); l++)
         {
-            math::M4 tm = tmGlobal;
-            math::Qt rot = math::QtIden();
-            for (int j = 0; j < m_aTmCounters[i]; j++)
+            auto& e = ind.aLayouts[l];
+            if (e.bNormals == bNormals && e.bTangents == bTangents && e.indType == indType)
             {
-                /* collect each transformation from parent's map */
-                auto& n = aNodes[ m_aTmIdxs[at(i, j)] ];
-
-                tm = M4Scale(tm, n.scale);
-                rot *= n.rotation;
-                tm *= n.matrix;
+                layoutIdx = l;
+                break;
             }
-            tm = M4Scale(tm, node.scale);
-            tm *= QtRot(rot * node.rotation);
-            tm = M4Translate(tm, node.translation);
-            tm *= node.matrix;
+        }
+        if (layoutIdx == NPOS32)
+        {
+            IndirectLayout nLayout {};
+            nLayout.bNormals = bNormals;
+            nLayout.bTangents = bTangents;
+            nLayout.indType = indType;
+            nLayout.stride = prim.stride;
+            layoutIdx = ind.aLayouts.push(m_pAlloc, nLayout);
+        }
 
-            for (auto& e : m_aaMeshes[node.mesh])
-            {
-                glBindVertexArray(e.meshData.vao);
+        auto& lay = ind.aLayouts[layoutIdx];
+        ADT_ASSERT(lay.stride == prim.stride, "stride: %u, prim.stride: %u", lay.stride, prim.stride);
 
-                if (flags & DRAW::DIFF)
-                    e.meshData.materials.diffuse.bind(GL_TEXTURE0);
-                if (flags & DRAW::NORM)
-                    e.meshData.materials.normal.bind(GL_TEXTURE1);
+        aaRefs[prim.meshIdx][prim.primIdx] = {
+            .layoutIdx = layoutIdx,
+            .firstIndex = lay.nIndices,
+            .baseVertex = s32(lay.nVertices),
+            .count = prim.nIdxs,
+            .posOffset = {prim.aPosOffset[0], prim.aPosOffset[1], prim.aPosOffset[2], 0.0f},
+            .posScale = {prim.aPosScale[0], prim.aPosScale[1], prim.aPosScale[2], 0.0f},
+        };
 
-                if (sh)
-                {
-                    sh->setM4(svUniform, tm);
-                    if (flags & DRAW::APPLY_NM)
-                        sh->setM3(svUniformM3Norm, M3Normal(M4ToM3(tm)));
-                }
+        const usize vertsSize = usize(prim.nVerts) * prim.stride;
+        const usize idxsSize = usize(prim.nIdxs) * prim.indexSize;
+        const usize vertsAt = lay.aVertices.getSize();
+        const usize idxsAt = lay.aIndices.getSize();
+        lay.aVertices.setSize(m_pAlloc, vertsAt + vertsSize);
+        lay.aIndices.setSize(m_pAlloc, idxsAt + idxsSize);
+        memcpy(&lay.aVertices[vertsAt], packed.verts(p), vertsSize);
+        memcpy(&lay.aIndices[idxsAt], packed.idxs(p), idxsSize);
+
+        lay.nVertices += prim.nVerts;
+        lay.nIndices += prim.nIdxs;
+        m_aaMeshes[prim.meshIdx][prim.primIdx].bIndirect = true;
+
+        const u32 n = prim.nIdxs / 3;
+        before.acmr += prim.before.acmr * n, before.atvr += prim.before.atvr * n;
+        after.acmr += prim.after.acmr * n, after.atvr += prim.after.atvr * n;
+        nTris += n;
+    }
 
-                if (e.triangleCount != NPOS)
-                    glDrawArrays(GLenum(e.mode), 0, e.triangleCount);
-                else
+    /* one command per (node, primitive), grouped into batches of the same layout and material */
+    struct Draw
+    {
+        u32 batchIdx;
+        PrimRef ref;
+        math::M4 tm;
+    };
+
+    Vec<Draw> aDraws(&arena);
+    auto& aNodes = a.m_aNodes;
+
+    for (int i = 0; i < (int)aNodes.getSize(); i++)
+    {
+        auto& node = aNodes[i];
+        if (node.mesh == NPOS) continue;
+
+        const math::M4 tm = nodeTm(i, math::M4Iden());
+
+        for (u32 j = 0; j < aaRefs[node.mesh].getSize(); j++)
+        {
+            const PrimRef& ref = aaRefs[node.mesh][j];
+            if (ref.layoutIdx == NPOS32) continue;
+
+            /* ids can still be pending in the upload queue, paths can't */
+            const Materials& mat = m_aaMeshes[node.mesh][j].meshData.materials;
+            u32 batchIdx = NPOS32;
+            for (u32 b = 0; b < ind.aBatches.getSize(); b++)
+            {
+                auto& e = ind.aBatches[b];
+                if (e.layoutIdx == ref.layoutIdx &&
+                    e.materials.diffuse.m_texPath == mat.diffuse.m_texPath &&
+                    e.materials.normal.m_texPath == mat.normal.m_texPath)
                 {
-                    glDrawElements(
-                        GLenum(e.mode),
-                        e.meshData.eboSize,
-                        GLenum(e.indType),
-                        nullptr
-                    );
+                    batchIdx = b;
+                    break;
                 }
             }
+            if (batchIdx == NPOS32)
+                batchIdx = ind.aBatches.push(m_pAlloc, {ref.layoutIdx, mat, 0, 0});
+
+            ++ind.aBatches[batchIdx].nCmds;
+            aDraws.push({batchIdx, ref, tm});
         }
     }
+
+    u32 nCmds = 0;
+    for (auto& b : ind.aBatches)
+    {
+        b.firstCmd = nCmds;
+        nCmds += b.nCmds;
+    }
+
+    ind.aCommands.setSize(m_pAlloc, nCmds);
+    ind.aDraws.setSize(m_pAlloc, nCmds);
+
+    Vec<u32> aCursors(&arena, ind.aBatches.getSize());
+    for (auto& b : ind.aBatches) aCursors.push(b.firstCmd);
+
+    for (auto& d : aDraws)
+    {
+        const u32 c = aCursors[d.batchIdx]++;
+        /* baseInstance reaches the shader through the per instance draw id attribute */
+        ind.aCommands[c] = {d.ref.count, 1, d.ref.firstIndex, d.ref.baseVertex, c};
+        ind.aDraws[c] = {d.tm, d.ref.posOffset, d.ref.posScale};
+    }
+
+    if (nTris > 0)
+    {
+        LOG_OK("indirect: {} primitives merged into {} layouts, {} commands in {} batches, acmr: {:.3} -> {:.3}, atvr: {:.3} -> {:.3}\n",
+            nPrims, ind.aLayouts.getSize(), nCmds, ind.aBatches.getSize(),
+            before.acmr / nTris, after.acmr / nTris, before.atvr / nTris, after.atvr / nTris
+        );
+    }
+}
+
+void
+Model::uploadIndirect(GLint drawMode)
+{
+    auto& ind = m_indirect;
+    const u32 nCmds = ind.aCommands.getSize();
+    if (nCmds == 0) return;
+
+    VecBase<u32> aDrawIds(m_pAlloc, nCmds);
+    defer( aDrawIds.destroy(m_pAlloc) );
+    for (u32 i = 0; i < nCmds; i++) aDrawIds.push(m_pAlloc, i);
+
+    glGenBuffers(1, &ind.drawIdVbo);
+    gl::bindBuffer(GL_ARRAY_BUFFER, ind.drawIdVbo);
+    glBufferData(GL_ARRAY_BUFFER, nCmds * sizeof(u32), aDrawIds.data(), drawMode);
+
+    for (auto& lay : ind.aLayouts)
+    {
+        const GLsizei stride = lay.stride;
+
+        glGenVertexArrays(1, &lay.vao);
+        gl::bindVertexArray(lay.vao);
+
+        glGenBuffers(1, &lay.vbo);
+        gl::bindBuffer(GL_ARRAY_BUFFER, lay.vbo);
+        glBufferData(GL_ARRAY_BUFFER, lay.aVertices.getSize(), lay.aVertices.data(), drawMode);
+
+        glGenBuffers(1, &lay.ebo);
+        gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, lay.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, lay.aIndices.getSize(), lay.aIndices.data(), drawMode);
+
+        /* same locations as the per mesh vaos, positions come in as [0, 1] and are scaled back per draw */
+        u32 off = 0;
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, reinterpret_cast<void*>(off));
+        off += 4 * sizeof(u16);
+
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(off));
+        off += 2 * sizeof(f32);
+
+        if (lay.bNormals)
+        {
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(off));
+            off += 3 * sizeof(f32);
+        }
+
+        if (lay.bTangents)
+        {
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(off));
+        }
+
+        gl::bindBuffer(GL_ARRAY_BUFFER, ind.drawIdVbo);
+        glEnableVertexAttribArray(INDIRECT_DRAW_ID_ATTRIB);
+        glVertexAttribIPointer(INDIRECT_DRAW_ID_ATTRIB, 1, GL_UNSIGNED_INT, 0, nullptr);
+        glVertexAttribDivisor(INDIRECT_DRAW_ID_ATTRIB, 1);
+
+        gl::bindVertexArray(0);
+
+        lay.aVertices.destroy(m_pAlloc);
+        lay.aIndices.destroy(m_pAlloc);
+    }
+
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenBuffers(1, &ind.cmdBuffer);
+    gl::bindBuffer(GL_DRAW_INDIRECT_BUFFER, ind.cmdBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, nCmds * sizeof(DrawElementsIndirectCommand), ind.aCommands.data(), drawMode);
+    gl::bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    glGenBuffers(1, &ind.tmSsbo);
+    gl::bindBuffer(GL_SHADER_STORAGE_BUFFER, ind.tmSsbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, nCmds * sizeof(IndirectDraw), ind.aDraws.data(), drawMode);
+    gl::bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void
+Model::destroyIndirect()
+{
+    auto& ind = m_indirect;
+
+    for (auto& lay : ind.aLayouts)
+    {
+        gl::deleteVertexArray(lay.vao);
+        gl::deleteBuffer(lay.vbo);
+        gl::deleteBuffer(lay.ebo);
+        lay.aVertices.destroy(m_pAlloc);
+        lay.aIndices.destroy(m_pAlloc);
+    }
+
+    gl::deleteBuffer(ind.cmdBuffer);
+    gl::deleteBuffer(ind.tmSsbo);
+    gl::deleteBuffer(ind.drawIdVbo);
+
+    ind.aLayouts.destroy(m_pAlloc);
+    ind.aBatches.destroy(m_pAlloc);
+    ind.aCommands.destroy(m_pAlloc);
+    ind.aDraws.destroy(m_pAlloc);
+    ind = {};
+}
+
+void
+Model::drawIndirect(DRAW flags, Shader* sh, String svUniform, const math::M4& tmGlobal)
+{
+    auto& ind = m_indirect;
+    if (ind.aBatches.empty()) return;
+
+    if (sh) sh->setM4(svUniform, tmGlobal);
+
+    gl::bindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_TM_BINDING, ind.tmSsbo);
+    gl::bindBuffer(GL_DRAW_INDIRECT_BUFFER, ind.cmdBuffer);
+
+    for (auto& b : ind.aBatches)
+    {
+        auto& lay = ind.aLayouts[b.layoutIdx];
+
+        gl::bindVertexArray(lay.vao);
+
+        if (flags & DRAW::DIFF)
+            b.materials.diffuse.bind(GL_TEXTURE0);
+        if (flags & DRAW::NORM)
+            b.materials.normal.bind(GL_TEXTURE1);
+
+        glMultiDrawElementsIndirect(
+            GL_TRIANGLES, lay.indType,
+            reinterpret_cast<void*>(usize(b.firstCmd) * sizeof(DrawElementsIndirectCommand)),
+            b.nCmds, 0
+        );
+    }
 }
 
 void
@@ -367,9 +731,9 @@ Ubo::createBuffer(u32 size, GLint drawMode)
 {
     this->size = size;
     glGenBuffers(1, &this->id);
-    glBindBuffer(GL_UNIFORM_BUFFER, this->id);
+    gl::bindBuffer(GL_UNIFORM_BUFFER, this->id);
     glBufferData(GL_UNIFORM_BUFFER, size, nullptr, drawMode);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    gl::bindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void
@@ -380,7 +744,7 @@ Ubo::bindShader(Shader* sh, String block, GLuint point)
     glUniformBlockBinding(sh->m_id, index, this->point);
     LOG_OK("uniform block: '{}' at '{}', in shader '{}'\n", block, index, sh->m_id);
 
-    glBindBufferBase(GL_UNIFORM_BUFFER, point, this->id);
+    gl::bindBufferBase(GL_UNIFORM_BUFFER, point, this->id);
     /* or */
     /* glBindBufferRange(GL_UNIFORM_BUFFER, _point, id, 0, size); */
 }
@@ -388,15 +752,15 @@ Ubo::bindShader(Shader* sh, String block, GLuint point)
 void
 Ubo::bufferData(void* pData, u32 offset, u32 size)
 {
-    glBindBuffer(GL_UNIFORM_BUFFER, this->id);
+    gl::bindBuffer(GL_UNIFORM_BUFFER, this->id);
     glBufferSubData(GL_UNIFORM_BUFFER, offset, size, pData);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    gl::bindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void
 Ubo::destroy()
 {
-    glDeleteBuffers(1, &this->id);
+    gl::deleteBuffer(this->id);
 }
 
 Quad::Quad(GLint drawMode)
@@ -423,14 +787,14 @@ Quad::Quad(GLint drawMode)
     Quad q {};
 
     glGenVertexArrays(1, &q.m_vao);
-    glBindVertexArray(q.m_vao);
+    gl::bindVertexArray(q.m_vao);
 
     glGenBuffers(1, &q.m_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, q.m_vbo);
+    gl::bindBuffer(GL_ARRAY_BUFFER, q.m_vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, drawMode);
 
     glGenBuffers(1, &q.m_ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, q.m_ebo);
+    gl::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, q.m_ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, drawMode);
     q.m_eboSize = utils::size(indices);
 
@@ -441,7 +805,7 @@ Quad::Quad(GLint drawMode)
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(sizeof(f32)*4*3));
 
-    glBindVertexArray(0);
+    gl::bindVertexArray(0);
 
     LOG_OK("quad '{}' created\n", q.m_vao);
     *this = q;
@@ -450,7 +814,7 @@ Quad::Quad(GLint drawMode)
 void
 Quad::draw()
 {
-    glBindVertexArray(m_vao);
+    gl::bindVertexArray(m_vao);
     glDrawElements(GL_TRIANGLES, m_eboSize, GL_UNSIGNED_INT, nullptr);
 }
 
@@ -479,10 +843,10 @@ Plain::Plain(GLint drawMode)
     Plain p;
 
     glGenVertexArrays(1, &p.m_vao);
-    glBindVertexArray(p.m_vao);
+    gl::bindVertexArray(p.m_vao);
 
     glGenBuffers(1, &p.m_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, p.m_vbo);
+    gl::bindBuffer(GL_ARRAY_BUFFER, p.m_vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(plainVertices), plainVertices, drawMode);
 
     constexpr u32 v3Size = sizeof(math::V3) / sizeof(f32);
@@ -498,7 +862,7 @@ Plain::Plain(GLint drawMode)
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, v3Size, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(f32) * (3*6 + v2Size)));
 
-    glBindVertexArray(0);
+    gl::bindVertexArray(0);
 
     LOG_OK("plane '{}' created\n", p.m_vao);
     *this = p;
@@ -507,21 +871,21 @@ Plain::Plain(GLint drawMode)
 void
 Plain::draw()
 {
-    glBindVertexArray(m_vao);
+    gl::bindVertexArray(m_vao);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 }
 
 void
 Plain::drawBox()
 {
-    glBindVertexArray(m_vao);
+    gl::bindVertexArray(m_vao);
     glDrawArrays(GL_LINE_LOOP, 0, 6);
 }
 
 void
 Plain::destroy()
 {
-    glDeleteBuffers(1, &m_vao);
+    gl::deleteVertexArray(m_vao);
     /*glDeleteBuffers(1, &vbo);*/
     LOG_OK("plain {}(vao), {}(vbo) destroyed\n", m_vao, m_vbo);
 }
@@ -531,10 +895,10 @@ TextPlain::TextPlain(GLint drawMode)
     Plain p;
 
     // glGenVertexArrays(1, &p.vao);
-    // glBindVertexArray(p.vao);
+    // gl::bindVertexArray(p.vao);
 
     // glGenBuffers(1, &p.vbo);
-    // glBindBuffer(GL_ARRAY_BUFFER, p.vbo);
+    // gl::bindBuffer(GL_ARRAY_BUFFER, p.vbo);
     // glBufferData(GL_ARRAY_BUFFER, sizeof(plainVertices), plainVertices, drawMode);
 
     // constexpr u32 v3Size = sizeof(math::V3) / sizeof(f32);
@@ -550,5 +914,5 @@ TextPlain::TextPlain(GLint drawMode)
     // glEnableVertexAttribArray(2);
     // glVertexAttribPointer(2, v3Size, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(f32) * (3*6 + v2Size)));
 
-    // glBindVertexArray(0);
+    // gl::bindVertexArray(0);
 }
@@ -1,24 +1,14 @@
 #pragma once
 
 #include "gltf/gltf.hh"
+#include "adt/ThreadPool.hh"
 #include "adt/math.hh"
-#include "adt/enum.hh"
+#include "RenderQueue.hh"
 #include "Shader.hh"
 #include "texture.hh"
 
 #include <limits.h>
 
-enum DRAW : u32
-{
-    NONE     = 0,
-    DIFF     = 1,      /* bind diffuse textures */
-    NORM     = 1 << 1, /* bind normal textures */
-    APPLY_TM = 1 << 2, /* apply transformation matrix */
-    APPLY_NM = 1 << 3, /* generate and apply normal matrix */
-    ALL      = NPOS32
-};
-ADT_ENUM_BITWISE_OPERATORS(DRAW);
-
 struct Ubo
 {
     GLuint id;
@@ -54,6 +44,68 @@ struct Mesh
     gltf::COMPONENT_TYPE indType;
     gltf::PRIMITIVES mode;
     ssize triangleCount;
+    bool bIndirect; /* also packed into one of Model::m_indirect's layouts */
+};
+
+constexpr GLuint INDIRECT_TM_BINDING = 1; /* shader storage binding of the per draw transforms */
+constexpr GLuint INDIRECT_DRAW_ID_ATTRIB = 4; /* per instance u32, the command's baseInstance picks the transform */
+
+/* matches the gl struct layout */
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+/* meshopt's packed vertex format (u16 positions, f32 uv, [normal], [tangent]) and index size,
+ * primitives of the same kind end up one after another in the same buffers */
+struct IndirectLayout
+{
+    bool bNormals;
+    bool bTangents;
+    GLenum indType;
+    u32 stride; /* bytes */
+
+    VecBase<u8> aVertices; /* freed after the upload */
+    VecBase<u8> aIndices;
+    u32 nVertices;
+    u32 nIndices;
+
+    GLuint vao;
+    GLuint vbo;
+    GLuint ebo;
+};
+
+/* std430 element of the transform buffer */
+struct IndirectDraw
+{
+    math::M4 tm; /* node transform without tmGlobal */
+    math::V4 posOffset; /* dequantization of the primitive's positions */
+    math::V4 posScale;
+};
+
+/* one glMultiDrawElementsIndirect(): same layout and material */
+struct IndirectBatch
+{
+    u32 layoutIdx;
+    Materials materials;
+    u32 firstCmd;
+    u32 nCmds;
+};
+
+struct IndirectMeshes
+{
+    VecBase<IndirectLayout> aLayouts;
+    VecBase<IndirectBatch> aBatches;
+    VecBase<DrawElementsIndirectCommand> aCommands;
+    VecBase<IndirectDraw> aDraws; /* one per command */
+
+    GLuint cmdBuffer;
+    GLuint tmSsbo;
+    GLuint drawIdVbo;
 };
 
 struct Model
@@ -64,6 +116,7 @@ struct Model
     gltf::Model m_modelData;
     VecBase<int> m_aTmIdxs; /* parents map */
     VecBase<int> m_aTmCounters; /* map's sizes */
+    IndirectMeshes m_indirect {};
 
     /* */
 
@@ -71,10 +124,43 @@ struct Model
 
     /* */
 
+    /* node's transformation through its parents, tmGlobal first */
+    [[nodiscard]] math::M4 nodeTm(int nodeIdx, const math::M4& tmGlobal) const;
+
+    /* Optimizes indexed triangle primitives (meshopt, cooked after the first run) and packs them into m_indirect,
+     * one command per node that draws them. Cpu only, m_aTmIdxs and the materials of m_aaMeshes have to be ready.
+     * Primitives are optimized in parallel on pTp unless it's nullptr */
+    void mergeMeshes(ThreadPool* pTp = nullptr);
+    /* buffers and vaos of the merged data, needs the context */
+    void uploadIndirect(GLint drawMode);
+    void destroyIndirect();
+
     void load(String path, GLint drawMode, GLint texMode);
 
     bool loadGLTF(String path, GLint drawMode, GLint texMode);
 
+    /* draw() and drawGraph() submit here, sort and execute right away */
+    void submit(
+        render::Queue* pQueue,
+        DRAW flags,
+        Shader* sh,
+        String svUniform,
+        String svUniformM3Norm,
+        const math::M4& tmGlobal,
+        render::PASS ePass = render::PASS::OPAQUE
+    );
+
+    void
+    submitGraph(
+        render::Queue* pQueue,
+        DRAW flags,
+        Shader* sh,
+        String svUniform,
+        String svUniformM3Norm,
+        const math::M4& tmGlobal,
+        render::PASS ePass = render::PASS::OPAQUE
+    );
+
     void draw(
         DRAW flags,
         Shader* sh = nullptr,
@@ -92,6 +178,11 @@ struct Model
         String svUniformM3Norm,
         const math::M4& tmGlobal
     );
+
+    /* drawGraph() with one glMultiDrawElementsIndirect() per batch, sh has to read the transforms
+     * from INDIRECT_TM_BINDING (shaders/indirectUB.vert). Primitives that weren't merged (not indexed triangles)
+     * are left to drawGraph() with DRAW::SKIP_INDIRECT */
+    void drawIndirect(DRAW flags, Shader* sh, String svUniform, const math::M4& tmGlobal);
 };
 
 struct Quad
@@ -0,0 +1,250 @@
+#include "RenderQueue.hh"
+
+#include "adt/utils.hh"
+#include "gl/state.hh"
+
+#include <cstring>
+
+namespace render
+{
+
+static inline u64
+mask(u64 v, u32 nBits)
+{
+    return v & ((u64(1) << nBits) - 1);
+}
+
+static inline u64
+quantizeDepth(f32 depth)
+{
+    constexpr f32 maxDepth = f32((1 << KEY_DEPTH_BITS) - 1);
+    const f32 d = depth < 0.0f ? 0.0f : depth > 1.0f ? 1.0f : depth;
+    return u64(d * maxDepth);
+}
+
+u64
+makeKey(const DrawItem& it)
+{
+    constexpr u32 halfMat = KEY_MATERIAL_BITS / 2;
+
+    const u64 pass = u64(it.ePass);
+    const u64 shader = mask(it.pShader ? it.pShader->m_id : 0, KEY_SHADER_BITS);
+    /* textures the flags don't bind don't split batches either */
+    const u64 diff = (it.eFlags & DRAW::DIFF) ? mask(it.diffuse, halfMat) : 0;
+    const u64 norm = (it.eFlags & DRAW::NORM) ? mask(it.normal, halfMat) : 0;
+    const u64 material = (diff << halfMat) | norm;
+    const u64 vao = mask(it.vao, KEY_VAO_BITS);
+    const u64 depth = quantizeDepth(it.depth);
+
+    u64 key = pass << 60;
+
+    if (it.ePass == PASS::TRANSLUCENT)
+    {
+        key |= mask(~depth, KEY_DEPTH_BITS) << 40;
+        key |= shader << 30;
+        key |= material << 12;
+        key |= vao;
+    }
+    else
+    {
+        key |= shader << 50;
+        key |= material << 32;
+        key |= vao << 20;
+        key |= depth;
+    }
+
+    return key;
+}
+
+void
+radixSort(u64* pKeys, u32* pIdxs, u64* pTmpKeys, u32* pTmpIdxs, u32 n)
+{
+    if (n < 2) return;
+
+    u32 aaCounts[8][256] {};
+    for (u32 i = 0; i < n; ++i)
+    {
+        const u64 k = pKeys[i];
+        for (u32 b = 0; b < 8; ++b)
+            ++aaCounts[b][(k >> (b * 8)) & 0xff];
+    }
+
+    u64* pSrcK = pKeys;
+    u32* pSrcI = pIdxs;
+    u64* pDstK = pTmpKeys;
+    u32* pDstI = pTmpIdxs;
+
+    for (u32 b = 0; b < 8; ++b)
+    {
+        u32* aCounts = aaCounts[b];
+        const u32 shift = b * 8;
+
+        /* every key has the same byte here, nothing to move */
+        if (aCounts[(pSrcK[0] >> shift) & 0xff] == n) continue;
+
+        u32 sum = 0;
+        for (u32 i = 0; i < 256; ++i)
+        {
+            const u32 c = aCounts[i];
+            aCounts[i] = sum;
+            sum += c;
+        }
+
+        for (u32 i = 0; i < n; ++i)
+        {
+            const u32 at = aCounts[(pSrcK[i] >> shift) & 0xff]++;
+            pDstK[at] = pSrcK[i];
+            pDstI[at] = pSrcI[i];
+        }
+
+        utils::swap(&pSrcK, &pDstK);
+        utils::swap(&pSrcI, &pDstI);
+    }
+
+    if (pSrcK != pKeys)
+    {
+        memcpy(pKeys, pSrcK, n * sizeof(*pKeys));
+        memcpy(pIdxs, pSrcI, n * sizeof(*pIdxs));
+    }
+}
+
+void
+Queue::submit(const DrawItem& it)
+{
+    m_aItems.push(m_pAlloc, it);
+    m_bSorted = false;
+}
+
+void
+Queue::sort()
+{
+    const s64 t0 = utils::timeNowUS();
+    const u32 n = m_aItems.getSize();
+
+    m_aKeys.setSize(m_pAlloc, n);
+    m_aOrder.setSize(m_pAlloc, n);
+    m_aTmpKeys.setSize(m_pAlloc, n);
+    m_aTmpOrder.setSize(m_pAlloc, n);
+
+    for (u32 i = 0; i < n; ++i)
+    {
+        m_aKeys[i] = makeKey(m_aItems[i]);
+        m_aOrder[i] = i;
+    }
+
+    radixSort(m_aKeys.data(), m_aOrder.data(), m_aTmpKeys.data(), m_aTmpOrder.data(), n);
+
+    m_bSorted = true;
+    m_stats.sortUS = utils::timeNowUS() - t0;
+}
+
+template<bool B_ISSUE>
+static QueueStats
+walk(const Queue& q, bool bSorted)
+{
+    QueueStats st {};
+
+    Shader* pShader = nullptr;
+    GLuint vao = gl::STATE_UNKNOWN;
+    GLuint aTex[2] {gl::STATE_UNKNOWN, gl::STATE_UNKNOWN};
+    GLenum aTarget[2] {};
+
+    const u32 n = q.m_aItems.getSize();
+    for (u32 i = 0; i < n; ++i)
+    {
+        const DrawItem& it = q.m_aItems[bSorted ? q.m_aOrder[i] : i];
+
+        if (it.pShader && it.pShader != pShader)
+        {
+            pShader = it.pShader;
+            ++st.nPrograms;
+            if constexpr (B_ISSUE) pShader->use();
+        }
+
+        if (it.vao != vao)
+        {
+            vao = it.vao;
+            ++st.nVaos;
+            if constexpr (B_ISSUE) gl::bindVertexArray(vao);
+        }
+
+        const GLuint aWant[2] {it.diffuse, it.normal};
+        const DRAW aFlag[2] {DRAW::DIFF, DRAW::NORM};
+        for (u32 u = 0; u < 2; ++u)
+        {
+            if (!(it.eFlags & aFlag[u])) continue;
+            if (aWant[u] == aTex[u] && it.texTarget == aTarget[u]) continue;
+
+            aTex[u] = aWant[u];
+            aTarget[u] = it.texTarget;
+            ++st.nTextures;
+            if constexpr (B_ISSUE) gl::bindTextureUnit(GL_TEXTURE0 + u, it.texTarget, aWant[u]);
+        }
+
+        ++st.nDraws;
+
+        if constexpr (B_ISSUE)
+        {
+            /* uniforms go to whatever program is in use */
+            if (it.pShader)
+            {
+                if (it.svUniform.getSize() > 0)
+                    pShader->setM4(it.svUniform, it.tm);
+                if ((it.eFlags & DRAW::APPLY_NM) && it.svUniformM3Norm.getSize() > 0)
+                    pShader->setM3(it.svUniformM3Norm, M3Normal(M4ToM3(it.tm)));
+                if (it.eFlags & DRAW::SPRITE)
+                {
+                    pShader->setI("uLayer", it.layer);
+                    pShader->setV4("uUvRect", it.uvRect);
+                    pShader->setV3("uColor", it.color);
+                }
+            }
+
+            if (it.indType == 0)
+                glDrawArrays(it.mode, 0, it.count);
+            else glDrawElements(it.mode, it.count, it.indType, nullptr);
+        }
+    }
+
+    return st;
+}
+
+void
+Queue::execute()
+{
+    const s64 sortUS = m_stats.sortUS;
+    m_stats = walk<true>(*this, m_bSorted);
+    m_stats.sortUS = sortUS;
+
+    reset();
+}
+
+QueueStats
+Queue::replay(bool bSorted)
+{
+    if (bSorted && !m_bSorted) sort();
+
+    QueueStats st = walk<false>(*this, bSorted);
+    st.sortUS = m_stats.sortUS;
+
+    return st;
+}
+
+void
+Queue::reset()
+{
+    m_aItems.setSize(m_pAlloc, 0);
+    m_bSorted = false;
+}
+
+void
+Queue::destroy()
+{
+    m_aItems.destroy(m_pAlloc);
+    m_aKeys.destroy(m_pAlloc);
+    m_aOrder.destroy(m_pAlloc);
+    m_aTmpKeys.destroy(m_pAlloc);
+    m_aTmpOrder.destroy(m_pAlloc);
+}
+
+} /* namespace render */
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "adt/Vec.hh"
+#include "adt/enum.hh"
+#include "adt/math.hh"
+#include "Shader.hh"
+
+using namespace adt;
+
+enum DRAW : u32
+{
+    NONE          = 0,
+    DIFF          = 1,      /* bind diffuse textures */
+    NORM          = 1 << 1, /* bind normal textures */
+    APPLY_TM      = 1 << 2, /* apply transformation matrix */
+    APPLY_NM      = 1 << 3, /* generate and apply normal matrix */
+    SPRITE        = 1 << 4, /* set sprite layer, uv rect and color */
+    SKIP_INDIRECT = 1 << 5, /* Model::drawGraph() leaves out what drawIndirect() draws */
+    ALL           = DIFF | NORM | APPLY_TM | APPLY_NM /* the mesh ones */
+};
+ADT_ENUM_BITWISE_OPERATORS(DRAW);
+
+/* Draws are submitted as items, sorted by a 64 bit key and executed with state changes only
+ * where consecutive items differ. Key layout, msb first:
+ *   opaque/ui:   pass:4 | shader:10 | material:18 | vao:12 | depth:20 (front to back)
+ *   translucent: pass:4 | ~depth:20 (back to front) | shader:10 | material:18 | vao:12
+ * Ids are masked to fit, collisions only cost ordering, execute() compares the real ids. */
+namespace render
+{
+
+enum class PASS : u8
+{
+    OPAQUE,
+    TRANSLUCENT,
+    UI,
+};
+
+constexpr u32 KEY_DEPTH_BITS = 20;
+constexpr u32 KEY_VAO_BITS = 12;
+constexpr u32 KEY_MATERIAL_BITS = 18;
+constexpr u32 KEY_SHADER_BITS = 10;
+
+struct DrawItem
+{
+    PASS ePass {};
+    DRAW eFlags {}; /* DIFF/NORM decide which textures go into the key and get bound */
+    f32 depth {}; /* [0, 1], 0 is nearest */
+
+    Shader* pShader {}; /* nullptr: whatever is in use */
+    GLuint vao {};
+    GLenum texTarget = GL_TEXTURE_2D;
+    GLuint diffuse {}; /* unit 0 */
+    GLuint normal {}; /* unit 1 */
+
+    GLenum mode = GL_TRIANGLES;
+    GLsizei count {};
+    GLenum indType {}; /* 0: glDrawArrays */
+
+    math::M4 tm = math::M4Iden();
+    String svUniform {}; /* model matrix, set when not empty */
+    String svUniformM3Norm {}; /* with APPLY_NM */
+
+    /* with SPRITE */
+    s32 layer {};
+    math::V4 uvRect {};
+    math::V3 color {};
+};
+
+struct QueueStats
+{
+    u32 nDraws {};
+    u32 nPrograms {};
+    u32 nTextures {};
+    u32 nVaos {};
+    s64 sortUS {};
+};
+
+/* ascending by key, stable, the idxs are permuted along. Tmp arrays are the same size */
+void radixSort(u64* pKeys, u32* pIdxs, u64* pTmpKeys, u32* pTmpIdxs, u32 n);
+
+[[nodiscard]] u64 makeKey(const DrawItem& it);
+
+struct Queue
+{
+    IAllocator* m_pAlloc {};
+    VecBase<DrawItem> m_aItems {};
+    VecBase<u64> m_aKeys {};
+    VecBase<u32> m_aOrder {};
+    VecBase<u64> m_aTmpKeys {};
+    VecBase<u32> m_aTmpOrder {};
+    bool m_bSorted {};
+    QueueStats m_stats {};
+
+    /* */
+
+    Queue() = default;
+    Queue(IAllocator* p) : m_pAlloc(p) {}
+
+    /* */
+
+    void submit(const DrawItem& it);
+    void sort();
+    /* issue every item, in key order if sorted, then reset() */
+    void execute();
+    /* same walk without touching gl, only counts what execute() would change */
+    [[nodiscard]] QueueStats replay(bool bSorted);
+    /* keeps the memory */
+    void reset();
+    void destroy();
+    [[nodiscard]] u32 getSize() const { return m_aItems.getSize(); }
+};
+
+} /* namespace render */
@@ -2,14 +2,31 @@
 
 #include "adt/Arena.hh"
 #include "adt/file.hh"
+#include "adt/hash.hh"
 #include "adt/logs.hh"
+#include "adt/print.hh"
+#include "adt/prof.hh"
+#include "adt/utils.hh"
+#include "cook.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
 
 Pool<Shader, SHADER_MAX_COUNT> g_aAllShaders(INIT);
 
-static GLuint ShaderLoadOne(GLenum type, String path);
+ShaderCacheStats g_shaderCacheStats {};
+
+struct ProgramStage
+{
+    GLenum type {};
+    String sPath {};
+    String sSource {};
+};
 
-static void loadVertFrag(Shader* s, String vertexPath, String fragmentPath);
-static void loadVertGeomFrag(Shader* s, String vertexPath, String geometryPath, String fragmentPath);
+static GLuint ShaderLoadOne(GLenum type, String path, String source);
+
+static void loadStages(Shader* s, ProgramStage* aStages, int nStages);
 
 static void
 addToMap()
@@ -20,86 +37,197 @@ addToMap()
 void
 Shader::load(String vertexPath, String fragmentPath)
 {
+    PROFILE_SCOPE("Shader::load");
+
     addToMap();
-    loadVertFrag(this, vertexPath, fragmentPath);
+
+    ProgramStage aStages[] {
+        {GL_VERTEX_SHADER, vertexPath},
+        {GL_FRAGMENT_SHADER, fragmentPath},
+    };
+    loadStages(this, aStages, utils::size(aStages));
 }
 
 void
 Shader::load(String vertexPath, String geometryPath, String fragmentPath)
 {
+    PROFILE_SCOPE("Shader::load");
+
     addToMap();
-    loadVertGeomFrag(this, vertexPath, geometryPath, fragmentPath);
+
+    ProgramStage aStages[] {
+        {GL_VERTEX_SHADER, vertexPath},
+        {GL_FRAGMENT_SHADER, fragmentPath},
+        {GL_GEOMETRY_SHADER, geometryPath},
+    };
+    loadStages(this, aStages, utils::size(aStages));
 }
 
-static void
-loadVertFrag(Shader* s, String vertexPath, String fragmentPath)
+ssize
+shaderCachePath(char* pBuff, ssize buffSize, const String* aPaths, int nPaths)
 {
-    GLint linked;
-    GLuint vertex = ShaderLoadOne(GL_VERTEX_SHADER, vertexPath);
-    GLuint fragment = ShaderLoadOne(GL_FRAGMENT_SHADER, fragmentPath);
+    u64 h = 0;
+    for (int i = 0; i < nPaths; ++i)
+        h = hash::xxh64::hash(aPaths[i].data(), aPaths[i].getSize(), h);
 
-    s->m_id = glCreateProgram();
-    if (s->m_id == 0)
-        LOG_FATAL("glCreateProgram failed: {}\n", s->m_id);
+    const ssize n = print::toBuffer(pBuff, buffSize - 1, "{}/shader_{:x}.bprog", cook::COOKED_DIR, h);
+    pBuff[n] = '\0';
 
-    glAttachShader(s->m_id, vertex);
-    glAttachShader(s->m_id, fragment);
+    return n;
+}
 
-    glLinkProgram(s->m_id);
+static u64
+driverKey()
+{
+    /* same context for the whole run */
+    static const u64 s_key = [] {
+        u64 h = 0;
+        for (GLenum e : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        {
+            const char* nts = (const char*)glGetString(e);
+            if (nts) h = hash::xxh64::hash(nts, strlen(nts), h);
+        }
+        return h;
+    }();
+
+    return s_key;
+}
+
+static bool
+cacheSupported()
+{
+    static const bool s_bSupported = [] {
+        GLint nFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+        if (nFormats == 0) LOG_WARN("driver has no program binary formats, shader cache is off\n");
+        return nFormats > 0;
+    }();
+
+    return s_bSupported;
+}
+
+static bool
+loadCachedProgram(Shader* s, IAllocator* pAlloc, const char* ntsPath, u64 key)
+{
+    /* first run, not worth a warning */
+    struct stat st {};
+    if (stat(ntsPath, &st) != 0) return false;
+
+    Opt<String> rsFile = file::load(pAlloc, ntsPath);
+    if (!rsFile) return false;
+
+    const String sFile = rsFile.value();
+
+    ProgramCacheHeader h {};
+    if (sFile.getSize() < ssize(sizeof(h))) return false;
+    memcpy(&h, sFile.data(), sizeof(h));
+
+    if (h.magic != PROGRAM_CACHE_MAGIC || h.version != PROGRAM_CACHE_VERSION || h.key != key) return false;
+    if (sizeof(h) + h.binarySize > usize(sFile.getSize())) return false;
+
+    s->m_id = glCreateProgram();
+    glProgramBinary(s->m_id, h.binaryFormat, sFile.data() + sizeof(h), h.binarySize);
+
+    GLint linked = 0;
     glGetProgramiv(s->m_id, GL_LINK_STATUS, &linked);
     if (!linked)
     {
-        GLint infoLen = 0;
-        char infoLog[255] {};
-        glGetProgramiv(s->m_id, GL_INFO_LOG_LENGTH, &infoLen);
-        if (infoLen > 1)
-        {
-            glGetProgramInfoLog(s->m_id, infoLen, nullptr, infoLog);
-            LOG_FATAL("error linking program: {}\n", infoLog);
-        }
-        glDeleteProgram(s->m_id);
-        LOG_FATAL("error linking program.\n");
+        /* driver update that kept the version string, or anything else it didn't like */
+        gl::deleteProgram(s->m_id);
+        s->m_id = 0;
+        return false;
     }
 
-#ifndef NDEBUG
-    glValidateProgram(s->m_id);
-#endif
+    return true;
+}
+
+static void
+saveCachedProgram(GLuint id, IAllocator* pAlloc, const char* ntsPath, u64 key)
+{
+    GLint binarySize = 0;
+    glGetProgramiv(id, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+    if (binarySize <= 0) return;
+
+    u8* pOut = (u8*)pAlloc->malloc(sizeof(ProgramCacheHeader) + binarySize, 1);
+
+    ProgramCacheHeader h {
+        .magic = PROGRAM_CACHE_MAGIC,
+        .version = PROGRAM_CACHE_VERSION,
+        .key = key,
+    };
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(id, binarySize, &written, &format, pOut + sizeof(h));
+    if (written <= 0) return;
 
-    /*g_aAllShaders.getHandle(*s);*/
+    h.binaryFormat = format;
+    h.binarySize = u32(written);
+    memcpy(pOut, &h, sizeof(h));
+
+    /* warns on its own, the next run compiles again */
+    cook::writeFile(ntsPath, pOut, sizeof(h) + written);
 }
 
 static void
-loadVertGeomFrag(Shader* s, String vertexPath, String geometryPath, String fragmentPath)
+loadStages(Shader* s, ProgramStage* aStages, int nStages)
 {
-    GLint linked;
-    GLuint vertex = ShaderLoadOne(GL_VERTEX_SHADER, vertexPath);
-    GLuint fragment = ShaderLoadOne(GL_FRAGMENT_SHADER, fragmentPath);
-    GLuint geometry = ShaderLoadOne(GL_GEOMETRY_SHADER, geometryPath);
+    const s64 t0 = utils::timeNowUS();
+
+    Arena al(SIZE_8K);
+    defer( al.freeAll() );
+
+    /* sources are needed for the key either way */
+    u64 key = driverKey();
+    String aPaths[3] {};
+    for (int i = 0; i < nStages; ++i)
+    {
+        Opt<String> src = file::load(&al, aStages[i].sPath);
+        if (!src) LOG_FATAL("error opening shader file: '{}'\n", aStages[i].sPath);
+
+        aStages[i].sSource = src.value();
+        aPaths[i] = aStages[i].sPath;
+        key = hash::xxh64::hash(aStages[i].sSource.data(), aStages[i].sSource.getSize(), key);
+    }
+
+    char aCachePath[256] {};
+    shaderCachePath(aCachePath, sizeof(aCachePath), aPaths, nStages);
+
+    const bool bCache = cacheSupported();
+    if (bCache && loadCachedProgram(s, &al, aCachePath, key))
+    {
+        ++g_shaderCacheStats.nHits;
+        g_shaderCacheStats.cachedUS += utils::timeNowUS() - t0;
+        return;
+    }
+
+    GLuint aShaders[3] {};
+    for (int i = 0; i < nStages; ++i)
+        aShaders[i] = ShaderLoadOne(aStages[i].type, aStages[i].sPath, aStages[i].sSource);
 
     s->m_id = glCreateProgram();
     if (s->m_id == 0)
         LOG_FATAL("glCreateProgram failed: {}\n", s->m_id);
 
-    glAttachShader(s->m_id, vertex);
-    glAttachShader(s->m_id, fragment);
-    glAttachShader(s->m_id, geometry);
+    for (int i = 0; i < nStages; ++i)
+        glAttachShader(s->m_id, aShaders[i]);
+
+    if (bCache) glProgramParameteri(s->m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
+    GLint linked;
     glLinkProgram(s->m_id);
     glGetProgramiv(s->m_id, GL_LINK_STATUS, &linked);
     if (!linked)
     {
         GLint infoLen = 0;
+        char infoLog[255] {};
         glGetProgramiv(s->m_id, GL_INFO_LOG_LENGTH, &infoLen);
         if (infoLen > 1)
         {
-            char infoLog[255] {};
-            glGetProgramInfoLog(s->m_id, infoLen, nullptr, infoLog);
+            glGetProgramInfoLog(s->m_id, sizeof(infoLog), nullptr, infoLog);
             LOG_FATAL("error linking program: {}\n", infoLog);
         }
-        glDeleteProgram(s->m_id);
+        gl::deleteProgram(s->m_id);
         LOG_FATAL("error linking program.\n");
     }
 
@@ -107,9 +235,13 @@ loadVertGeomFrag(Shader* s, String vertexPath, String geometryPath, String fragm
     glValidateProgram(s->m_id);
 #endif
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-    glDeleteShader(geometry);
+    for (int i = 0; i < nStages; ++i)
+        glDeleteShader(aShaders[i]);
+
+    if (bCache) saveCachedProgram(s->m_id, &al, aCachePath, key);
+
+    ++g_shaderCacheStats.nMisses;
+    g_shaderCacheStats.compiledUS += utils::timeNowUS() - t0;
 }
 
 void
@@ -117,7 +249,7 @@ Shader::destroy()
 {
     if (m_id != 0)
     {
-        glDeleteProgram(m_id);
+        gl::deleteProgram(m_id);
         LOG_OK("Shader '{}' destroyed\n", m_id);
         m_id = 0;
     }
@@ -181,21 +313,16 @@ Shader::queryActiveUniforms()
 }
 
 static GLuint
-ShaderLoadOne(GLenum type, String path)
+ShaderLoadOne(GLenum type, [[maybe_unused]] String path, String source)
 {
     GLuint shader = glCreateShader(type);
     if (!shader)
         return 0;
 
-    Arena al(SIZE_8K);
-    defer( al.freeAll() );
-
-    Opt<String> src = file::load(&al, path);
-    if (!src) LOG_FATAL("error opening shader file: '{}'\n", path);
-
-    const char* srcData = src.value().data();
+    const char* srcData = source.data();
+    const GLint srcSize = GLint(source.getSize());
 
-    glShaderSource(shader, 1, &srcData, nullptr);
+    glShaderSource(shader, 1, &srcData, &srcSize);
     glCompileShader(shader);
 
     GLint ok;
@@ -207,7 +334,7 @@ ShaderLoadOne(GLenum type, String path)
         if (infoLen > 1)
         {
             char infoLog[255] {};
-            glGetShaderInfoLog(shader, infoLen, nullptr, infoLog);
+            glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
             LOG_FATAL("error compiling shader '{}'\n{}\n", path, infoLog);
         }
         glDeleteShader(shader);
@@ -4,6 +4,7 @@
 #include "adt/String.hh"
 #include "adt/math.hh"
 #include "gl/gl.hh" /* IWYU pragma: keep */
+#include "gl/state.hh"
 
 using namespace adt;
 
@@ -13,6 +14,34 @@ constexpr u32 SHADER_MAX_COUNT = 256;
 
 extern Pool<Shader, SHADER_MAX_COUNT> g_aAllShaders;
 
+/* Program binaries are cached in cook::COOKED_DIR/shader_<hash of the paths>.bprog.
+ * The key hashes every source with the driver's vendor, renderer and version strings,
+ * any mismatch (or a driver that refuses the binary) falls back to a normal compile and rewrites the file. */
+constexpr u32 PROGRAM_CACHE_MAGIC = 0x47525042; /* "BPRG" */
+constexpr u32 PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader
+{
+    u32 magic {};
+    u32 version {};
+    u64 key {};
+    u32 binaryFormat {};
+    u32 binarySize {}; /* followed by the binary */
+};
+
+struct ShaderCacheStats
+{
+    u32 nHits {};
+    u32 nMisses {};
+    s64 cachedUS {}; /* read sources + glProgramBinary, summed */
+    s64 compiledUS {}; /* read sources + compile + link + glGetProgramBinary, summed */
+};
+
+extern ShaderCacheStats g_shaderCacheStats;
+
+/* where a program made of these shaders is cached, null terminated */
+ssize shaderCachePath(char* pBuff, ssize buffSize, const String* aPaths, int nPaths);
+
 struct ShaderHash
 {
     String sKeyWord {};
@@ -45,41 +74,41 @@ struct Shader
     void queryActiveUniforms();
     void destroy();
 
-    void use() const { glUseProgram(m_id); }
+    void use() const { gl::useProgram(m_id); }
     
     void 
     setM3(String name, const math::M3& m)
     {
         GLint ul = glGetUniformLocation(m_id, name.data());
-        glUniformMatrix3fv(ul, 1, GL_FALSE, (GLfloat*)m.e);
+        gl::uniformMatrix3fv(ul, (GLfloat*)m.e);
     }
     
     void 
     setM4(String name, const math::M4& m)
     {
         GLint ul = glGetUniformLocation(m_id, name.data());
-        glUniformMatrix4fv(ul, 1, GL_FALSE, (GLfloat*)m.e);
+        gl::uniformMatrix4fv(ul, (GLfloat*)m.e);
     }
     
     void
     setV3(String name, const math::V3& v)
     {
         GLint ul = glGetUniformLocation(m_id, name.data());
-        glUniform3fv(ul, 1, (GLfloat*)v.e);
+        gl::uniform3fv(ul, (GLfloat*)v.e);
     }
     
     void
     setV4(String name, const math::V4& v)
     {
         GLint ul = glGetUniformLocation(m_id, name.data());
-        glUniform4fv(ul, 1, (GLfloat*)v.e);
+        gl::uniform4fv(ul, (GLfloat*)v.e);
     }
     
     void
     setI(String name, const GLint i)
     {
         GLint ul = glGetUniformLocation(m_id, name.data());
-        glUniform1i(ul, i);
+        gl::uniform1i(ul, i);
     }
     
     
@@ -87,6 +116,6 @@ struct Shader
     setF(String name, const f32 f)
     {
         GLint ul = glGetUniformLocation(m_id, name.data());
-        glUniform1f(ul, f);
+        gl::uniform1f(ul, f);
     }
 };
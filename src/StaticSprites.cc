@@ -0,0 +1,127 @@
+#include "StaticSprites.hh"
+
+#include "adt/utils.hh"
+#include "gl/state.hh"
+
+#include <cstddef>
+
+namespace render
+{
+
+static_assert(sizeof(SpriteInstance) == 13 * sizeof(f32), "attributes expect no padding");
+
+void
+StaticSprites::init(GLuint quadVbo)
+{
+    glGenVertexArrays(1, &m_vao);
+    gl::bindVertexArray(m_vao);
+
+    /* the quad, like Plain */
+    gl::bindBuffer(GL_ARRAY_BUFFER, quadVbo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(f32), (void*)(sizeof(f32) * 3*6));
+
+    glGenBuffers(1, &m_vbo);
+    gl::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+    struct Attrib { GLint size; usize offset; };
+    constexpr Attrib aAttribs[] {
+        {4, offsetof(SpriteInstance, pos)}, /* pos and layer */
+        {2, offsetof(SpriteInstance, scale)},
+        {4, offsetof(SpriteInstance, uvRect)},
+        {3, offsetof(SpriteInstance, color)},
+    };
+
+    for (u32 i = 0; i < utils::size(aAttribs); ++i)
+    {
+        const GLuint loc = 2 + i;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, aAttribs[i].size, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)aAttribs[i].offset);
+        glVertexAttribDivisor(loc, 1);
+    }
+
+    gl::bindVertexArray(0);
+}
+
+void
+StaticSprites::reset(u32 n)
+{
+    m_aInstances.setSize(m_pAlloc, n);
+    for (auto& inst : m_aInstances) inst = {};
+
+    m_dirtyFirst = n > 0 ? 0 : NPOS32;
+    m_dirtyLast = n > 0 ? n - 1 : 0;
+}
+
+void
+StaticSprites::markDirty(u32 i)
+{
+    m_dirtyFirst = utils::min(m_dirtyFirst, i);
+    m_dirtyLast = utils::max(m_dirtyLast, i);
+}
+
+void
+StaticSprites::set(u32 i, const SpriteInstance& inst)
+{
+    m_aInstances[i] = inst;
+    markDirty(i);
+}
+
+void
+StaticSprites::hide(u32 i)
+{
+    m_aInstances[i].scale = {};
+    markDirty(i);
+}
+
+void
+StaticSprites::flush()
+{
+    m_lastFlush = {};
+    if (m_dirtyFirst == NPOS32) return;
+
+    const u32 n = m_aInstances.getSize();
+    gl::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
+    if (n > m_gpuCap)
+    {
+        glBufferData(GL_ARRAY_BUFFER, n * sizeof(SpriteInstance), m_aInstances.data(), GL_DYNAMIC_DRAW);
+        m_gpuCap = n;
+        m_lastFlush = {.nFlushed = n, .nBytes = u32(n * sizeof(SpriteInstance)), .bRealloc = true};
+    }
+    else
+    {
+        /* one range, changes between frames are few and usually close (a chain of explosions) */
+        const u32 count = m_dirtyLast - m_dirtyFirst + 1;
+        glBufferSubData(GL_ARRAY_BUFFER, m_dirtyFirst * sizeof(SpriteInstance),
+            count * sizeof(SpriteInstance), &m_aInstances[m_dirtyFirst]
+        );
+        m_lastFlush = {.nFlushed = count, .nBytes = u32(count * sizeof(SpriteInstance))};
+    }
+
+    m_dirtyFirst = NPOS32;
+    m_dirtyLast = 0;
+}
+
+void
+StaticSprites::draw()
+{
+    if (m_aInstances.getSize() == 0) return;
+
+    gl::bindVertexArray(m_vao);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, m_aInstances.getSize());
+}
+
+void
+StaticSprites::destroy()
+{
+    gl::deleteBuffer(m_vbo);
+    gl::deleteVertexArray(m_vao);
+    m_aInstances.destroy(m_pAlloc);
+
+    *this = StaticSprites(m_pAlloc);
+}
+
+} /* namespace render */
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "adt/Vec.hh"
+#include "adt/math.hh"
+#include "gl/gl.hh" /* IWYU pragma: keep */
+
+using namespace adt;
+
+/* Sprites that rarely change (the blocks), one instance each in a buffer that stays on the gpu and is drawn with
+ * a single glDrawArraysInstanced() (shaders/2d/spriteInstanced.*). Changes go into a cpu copy first, flush() uploads
+ * the range that covers them, so a frame with nothing new uploads nothing and builds no matrices. */
+namespace render
+{
+
+/* the per instance attributes, tightly packed */
+struct SpriteInstance
+{
+    math::V3 pos {}; /* lower left corner, same space as the sprite quad's translation */
+    f32 layer {}; /* in the sprite array */
+    math::V2 scale {}; /* of the 2x2 quad, 0: hidden */
+    math::V4 uvRect {};
+    math::V3 color {};
+};
+
+struct StaticSpritesStats
+{
+    u32 nFlushed {}; /* instances in the last flush() */
+    u32 nBytes {};
+    bool bRealloc {}; /* buffer was (re)created */
+};
+
+struct StaticSprites
+{
+    IAllocator* m_pAlloc {};
+    VecBase<SpriteInstance> m_aInstances {}; /* cpu copy, what the buffer has after flush() */
+    GLuint m_vao {};
+    GLuint m_vbo {}; /* instances */
+    u32 m_gpuCap {}; /* instances m_vbo has room for */
+    u32 m_dirtyFirst = NPOS32;
+    u32 m_dirtyLast {};
+    StaticSpritesStats m_lastFlush {};
+
+    /* */
+
+    StaticSprites() = default;
+    StaticSprites(IAllocator* pAlloc) : m_pAlloc(pAlloc) {}
+
+    /* */
+
+    /* quadVbo has Plain's layout, positions then texcoords */
+    void init(GLuint quadVbo);
+    /* n hidden instances, all of them go up on the next flush() */
+    void reset(u32 n);
+    void set(u32 i, const SpriteInstance& inst);
+    void hide(u32 i);
+    void flush();
+    /* the program with ubProjView and uSprites on unit 0 has to be in use, sprite array bound */
+    void draw();
+    void destroy();
+    [[nodiscard]] u32 getSize() const { return m_aInstances.getSize(); }
+
+    /* */
+
+private:
+    void markDirty(u32 i);
+};
+
+} /* namespace render */
@@ -0,0 +1,272 @@
+#include "UploadQueue.hh"
+
+#include "adt/guard.hh"
+#include "adt/logs.hh"
+#include "adt/utils.hh"
+#include "texture.hh"
+
+#include <cstring>
+
+namespace texture
+{
+
+void
+UploadQueue::createBuffer(u32 nSlots, u32 slotSize)
+{
+    ADT_ASSERT(nSlots > 0 && nSlots <= UPLOAD_MAX_SLOTS, "nSlots: %u, max: %u", nSlots, UPLOAD_MAX_SLOTS);
+
+    m_nSlots = nSlots;
+    m_slotSize = slotSize;
+    m_mtx = Mutex(MUTEX_TYPE::PLAIN);
+    m_cndFree = CndVar(INIT);
+    m_cndIdle = CndVar(INIT);
+    m_aFreeSlots = VecBase<u32>(m_pAlloc, nSlots);
+    m_qPending = QueueBase<UploadRequest>(m_pAlloc, nSlots * 2);
+
+    for (u32 i = 0; i < nSlots; ++i)
+        m_aFreeSlots.push(m_pAlloc, i);
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size = GLsizeiptr(nSlots) * slotSize;
+
+    glGenBuffers(1, &m_pbo);
+    gl::bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+    m_pMapped = (u8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    gl::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!m_pMapped) LOG_FATAL("failed to map upload buffer ({} bytes)\n", size);
+
+    LOG_OK("upload queue: {} slots, {} KB each\n", nSlots, slotSize / 1024);
+}
+
+u32
+UploadQueue::acquire()
+{
+    const s64 t0 = utils::timeNowUS();
+
+    guard::Mtx lock(&m_mtx);
+    while (m_aFreeSlots.empty())
+        m_cndFree.wait(&m_mtx);
+
+    m_stats.slotWaitUS += utils::timeNowUS() - t0;
+
+    return *m_aFreeSlots.pop();
+}
+
+void
+UploadQueue::submit(const UploadRequest& req)
+{
+    ADT_ASSERT(req.slotIdx < m_nSlots, "slotIdx: %u, nSlots: %u", req.slotIdx, m_nSlots);
+
+    guard::Mtx lock(&m_mtx);
+    auto* p = m_qPending.pushBack(m_pAlloc, req);
+    p->submitUS = utils::timeNowUS();
+}
+
+bool
+UploadQueue::upload(
+    Img* pImg, u32 poolIdx, const UploadLevel* aLevels, u32 nLevels, u32 nStorageLevels, bool bGenMips,
+    GLint texMode, GLint magFilter, GLint minFilter
+)
+{
+    if (usize(aLevels[0].width)*4 > m_slotSize) return false;
+
+    UploadRequest req {
+        .pImg = pImg,
+        .poolIdx = poolIdx,
+        .bCreate = true,
+        .width = aLevels[0].width,
+        .height = aLevels[0].height,
+        .nLevels = nStorageLevels,
+        .texMode = texMode,
+        .magFilter = magFilter,
+        .minFilter = minFilter,
+    };
+
+    /* pack whole levels (or runs of rows) until the slot is full */
+    u32 level = 0, y = 0;
+    while (level < nLevels)
+    {
+        req.slotIdx = acquire();
+        req.nRegions = 0;
+        u8* pSlot = slotData(req.slotIdx);
+        u32 offset = 0;
+
+        while (level < nLevels && req.nRegions < UPLOAD_MAX_REGIONS && offset < m_slotSize)
+        {
+            const UploadLevel& l = aLevels[level];
+            const u32 pitch = l.width * 4;
+            const u32 nRows = utils::min(l.height - y, (m_slotSize - offset) / pitch);
+            if (nRows == 0) break;
+
+            memcpy(pSlot + offset, l.pData + usize(y)*pitch, usize(nRows)*pitch);
+            req.aRegions[req.nRegions++] = {.level = level, .y = y, .width = l.width, .height = nRows, .offset = offset};
+
+            offset = align(offset + nRows*pitch, 16);
+            y += nRows;
+            if (y == l.height)
+            {
+                ++level;
+                y = 0;
+            }
+        }
+
+        req.bGenMips = bGenMips && level == nLevels;
+        submit(req);
+        req.bCreate = false;
+    }
+
+    return true;
+}
+
+void
+UploadQueue::flush()
+{
+    if (!m_pbo) return;
+
+    /* retire, zero timeout, never stall the frame */
+    for (u32 i = 0; i < m_nSlots; ++i)
+    {
+        if (!m_aFences[i]) continue;
+
+        GLenum res = glClientWaitSync(m_aFences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (res != GL_ALREADY_SIGNALED && res != GL_CONDITION_SATISFIED) continue;
+
+        glDeleteSync(m_aFences[i]);
+        m_aFences[i] = {};
+
+        const s64 now = utils::timeNowUS();
+        const s64 gpuUS = now - m_aInFlight[i].issueUS;
+
+        guard::Mtx lock(&m_mtx);
+        m_stats.gpuUS += gpuUS;
+        m_stats.maxGpuUS = utils::max(m_stats.maxGpuUS, gpuUS);
+        m_stats.lastDoneUS = now;
+        m_aFreeSlots.push(m_pAlloc, i);
+        m_cndFree.signal();
+    }
+
+    while (true)
+    {
+        UploadRequest req {};
+        {
+            guard::Mtx lock(&m_mtx);
+            if (m_qPending.empty()) break;
+            req = *m_qPending.popFront();
+        }
+
+        Img* pImg = req.pImg;
+
+        if (req.bCreate)
+        {
+            glGenTextures(1, &pImg->m_id);
+            gl::bindTexture(GL_TEXTURE_2D, pImg->m_id);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, req.texMode);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, req.texMode);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, req.magFilter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, req.minFilter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, req.nLevels - 1);
+            glTexStorage2D(GL_TEXTURE_2D, req.nLevels, GL_RGBA8, req.width, req.height);
+
+            if (req.poolIdx != NPOS32) g_aAllTextures[req.poolIdx].m_id = pImg->m_id;
+        }
+        else gl::bindTexture(GL_TEXTURE_2D, pImg->m_id);
+
+        u64 nBytes = 0;
+        const usize slotOffset = usize(req.slotIdx) * m_slotSize;
+
+        /* with a bound unpack buffer the pointer is an offset into it */
+        gl::bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+        for (u32 i = 0; i < req.nRegions; ++i)
+        {
+            const auto& r = req.aRegions[i];
+            glTexSubImage2D(
+                GL_TEXTURE_2D, r.level, 0, r.y, r.width, r.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                (void*)(slotOffset + r.offset)
+            );
+            nBytes += u64(r.width) * r.height * 4;
+        }
+        gl::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (req.bGenMips) glGenerateMipmap(GL_TEXTURE_2D);
+        gl::bindTexture(GL_TEXTURE_2D, 0);
+
+        m_aFences[req.slotIdx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        req.issueUS = utils::timeNowUS();
+        m_aInFlight[req.slotIdx] = req;
+
+        const s64 queuedUS = req.issueUS - req.submitUS;
+
+#ifdef D_TEXTURE
+        LOG_OK("upload: '{}' slot {}, {} regions, {} KB, queued for {} us\n",
+            pImg->m_texPath, req.slotIdx, req.nRegions, nBytes / 1024, queuedUS
+        );
+#endif
+
+        guard::Mtx lock(&m_mtx);
+        if (m_stats.nUploads == 0) m_stats.firstIssueUS = req.issueUS;
+        ++m_stats.nUploads;
+        m_stats.nBytes += nBytes;
+        m_stats.queuedUS += queuedUS;
+        m_stats.maxQueuedUS = utils::max(m_stats.maxQueuedUS, queuedUS);
+    }
+
+    guard::Mtx lock(&m_mtx);
+    if (m_qPending.empty() && m_aFreeSlots.getSize() == m_nSlots)
+        m_cndIdle.broadcast();
+}
+
+bool
+UploadQueue::idle()
+{
+    guard::Mtx lock(&m_mtx);
+    return m_qPending.empty() && m_aFreeSlots.getSize() == m_nSlots;
+}
+
+void
+UploadQueue::waitIdle()
+{
+    if (!m_pbo) return;
+
+    guard::Mtx lock(&m_mtx);
+    while (!m_qPending.empty() || m_aFreeSlots.getSize() != m_nSlots)
+        m_cndIdle.wait(&m_mtx);
+}
+
+UploadStats
+UploadQueue::getStats()
+{
+    guard::Mtx lock(&m_mtx);
+    return m_stats;
+}
+
+void
+UploadQueue::destroy()
+{
+    if (!m_pbo) return;
+
+    for (u32 i = 0; i < m_nSlots; ++i)
+    {
+        if (!m_aFences[i]) continue;
+
+        glClientWaitSync(m_aFences[i], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(m_aFences[i]);
+    }
+
+    gl::bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    gl::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    gl::deleteBuffer(m_pbo);
+
+    m_aFreeSlots.destroy(m_pAlloc);
+    m_qPending.destroy(m_pAlloc);
+    m_mtx.destroy();
+    m_cndFree.destroy();
+    m_cndIdle.destroy();
+
+    *this = UploadQueue(m_pAlloc);
+}
+
+} /* namespace texture */
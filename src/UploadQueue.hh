@@ -0,0 +1,137 @@
+#pragma once
+
+#include "adt/Queue.hh"
+#include "adt/Thread.hh"
+#include "adt/Vec.hh"
+#include "gl/gl.hh" /* IWYU pragma: keep */
+
+using namespace adt;
+
+namespace texture
+{
+
+struct Img;
+
+constexpr u32 UPLOAD_MAX_SLOTS = 8;
+constexpr u32 UPLOAD_MAX_REGIONS = 16;
+
+/* rows [y, y + height) of one mip level, packed at offset in the slot */
+struct UploadRegion
+{
+    u32 level {};
+    u32 y {};
+    u32 width {};
+    u32 height {};
+    u32 offset {};
+};
+
+struct UploadLevel
+{
+    const u8* pData {}; /* RGBA8, tightly packed */
+    u32 width {};
+    u32 height {};
+};
+
+struct UploadRequest
+{
+    Img* pImg {};
+    u32 poolIdx = NPOS32; /* g_aAllTextures copy that also needs the id */
+    u32 slotIdx = NPOS32;
+
+    /* texture parameters, only used by the first request of an image */
+    bool bCreate {};
+    u32 width {};
+    u32 height {};
+    u32 nLevels {};
+    GLint texMode {};
+    GLint magFilter {};
+    GLint minFilter {};
+
+    bool bGenMips {}; /* after the last region of a single level upload */
+
+    u32 nRegions {};
+    UploadRegion aRegions[UPLOAD_MAX_REGIONS] {};
+
+    s64 submitUS {};
+    s64 issueUS {};
+};
+
+struct UploadStats
+{
+    u64 nUploads {};
+    u64 nBytes {};
+    s64 queuedUS {}; /* submit() -> glTexSubImage2D, summed */
+    s64 maxQueuedUS {};
+    s64 gpuUS {}; /* glTexSubImage2D -> fence signaled, summed */
+    s64 maxGpuUS {};
+    s64 slotWaitUS {}; /* workers blocked in acquire() with every slot in flight */
+    s64 firstIssueUS {};
+    s64 lastDoneUS {};
+
+    f64 MBps() const { return lastDoneUS > firstIssueUS ? f64(nBytes) / f64(lastDoneUS - firstIssueUS) : 0.0; }
+};
+
+/* Texture uploads without touching the gl context from worker threads.
+ * One persistently mapped pixel unpack buffer split into equal slots.
+ * Workers acquire() a slot, write pixels straight into it and submit() the regions,
+ * the context thread flush()es every frame: issues glTexSubImage2D from the buffer and fences it,
+ * slots go back to the free list once their fence is signaled. */
+struct UploadQueue
+{
+    IAllocator* m_pAlloc {};
+    GLuint m_pbo {};
+    u8* m_pMapped {};
+    u32 m_slotSize {};
+    u32 m_nSlots {};
+
+    Mutex m_mtx {};
+    CndVar m_cndFree {};
+    CndVar m_cndIdle {};
+    VecBase<u32> m_aFreeSlots {};
+    QueueBase<UploadRequest> m_qPending {}; /* submitted, not issued */
+
+    /* context thread only */
+    GLsync m_aFences[UPLOAD_MAX_SLOTS] {};
+    UploadRequest m_aInFlight[UPLOAD_MAX_SLOTS] {};
+
+    UploadStats m_stats {};
+
+    /* */
+
+    UploadQueue() = default;
+    UploadQueue(IAllocator* pAlloc) : m_pAlloc(pAlloc) {}
+
+    /* */
+
+    explicit operator bool() const { return m_pbo != 0; }
+
+    /* context thread */
+    void createBuffer(u32 nSlots, u32 slotSize);
+
+    /* any thread, blocks while every slot is in flight */
+    [[nodiscard]] u32 acquire();
+    u8* slotData(u32 slotIdx) { return m_pMapped + usize(slotIdx)*m_slotSize; }
+    void submit(const UploadRequest& req);
+
+    /* any thread: copy levels into as many slots as needed, the first request allocates nStorageLevels.
+     * false if a single row doesn't fit in a slot, nothing is queued then */
+    bool upload(
+        Img* pImg, u32 poolIdx, const UploadLevel* aLevels, u32 nLevels, u32 nStorageLevels, bool bGenMips,
+        GLint texMode, GLint magFilter, GLint minFilter
+    );
+
+    /* context thread: retire signaled fences, then issue everything that's pending */
+    void flush();
+
+    /* nothing pending or in flight */
+    [[nodiscard]] bool idle();
+
+    /* not the context thread: blocks until idle(), someone else has to keep calling flush() */
+    void waitIdle();
+
+    [[nodiscard]] UploadStats getStats();
+
+    void destroy();
+};
+
+} /* namespace texture */
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "types.hh"
+
+#include <atomic>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+
+#if defined ADT_ALLOC_STATS
+    #if defined ADT_USE_MIMALLOC
+        #include "mimalloc.h"
+    #else
+        #include <malloc.h>
+    #endif
+#endif
+
+/* Per allocator counters, compiled in with ADT_ALLOC_STATS.
+ * Allocators only count once they are given a record: IAllocator::setStats(allocStatsGet("name")).
+ * Records are looked up by name, so every instance with the same name (per call arenas) adds up in one. */
+
+namespace adt
+{
+
+constexpr u32 ALLOC_STATS_MAX = 128;
+constexpr u32 ALLOC_STATS_NAME_SIZE = 48;
+constexpr u32 ALLOC_STATS_N_BUCKETS = 16; /* <= 16 bytes, <= 32, ..., <= 256K, bigger */
+
+struct AllocStats
+{
+    char aName[ALLOC_STATS_NAME_SIZE] {};
+
+    std::atomic<s64> nBytesLive {}; /* handed out and not freed (or reset) yet */
+    std::atomic<s64> nBytesPeak {};
+    std::atomic<s64> nBytesReserved {}; /* taken from the backing allocator (blocks) */
+    std::atomic<s64> nBytesReservedPeak {};
+    std::atomic<u64> nAllocs {};
+    std::atomic<u64> nFrees {};
+    std::atomic<u64> nResets {}; /* freeAll()/reset() */
+    std::atomic<u64> aSizeHist[ALLOC_STATS_N_BUCKETS] {};
+};
+
+inline AllocStats g_aAllocStats[ALLOC_STATS_MAX] {};
+inline std::atomic<u32> g_nAllocStats {};
+inline std::atomic_flag g_allocStatsLock = ATOMIC_FLAG_INIT;
+
+inline u32
+allocStatsBucket(usize size)
+{
+    if (size <= 16) return 0;
+
+    const u32 b = u32(std::bit_width(size - 1)) - 4;
+    return b < ALLOC_STATS_N_BUCKETS ? b : ALLOC_STATS_N_BUCKETS - 1;
+}
+
+inline void
+_AllocStatsMax(std::atomic<s64>* pMax, s64 val)
+{
+    s64 prev = pMax->load(std::memory_order_relaxed);
+    while (val > prev && !pMax->compare_exchange_weak(prev, val, std::memory_order_relaxed))
+        ;
+}
+
+/* record for ntsName, created on first use. nullptr without ADT_ALLOC_STATS or when the table is full */
+[[nodiscard]] inline AllocStats*
+allocStatsGet([[maybe_unused]] const char* ntsName)
+{
+#if defined ADT_ALLOC_STATS
+    while (g_allocStatsLock.test_and_set(std::memory_order_acquire))
+        ;
+
+    AllocStats* pRet = nullptr;
+    const u32 n = g_nAllocStats.load(std::memory_order_relaxed);
+    for (u32 i = 0; i < n; ++i)
+    {
+        if (strncmp(g_aAllocStats[i].aName, ntsName, ALLOC_STATS_NAME_SIZE - 1) == 0)
+        {
+            pRet = &g_aAllocStats[i];
+            break;
+        }
+    }
+
+    if (!pRet && n < ALLOC_STATS_MAX)
+    {
+        pRet = &g_aAllocStats[n];
+        strncpy(pRet->aName, ntsName, ALLOC_STATS_NAME_SIZE - 1);
+        g_nAllocStats.store(n + 1, std::memory_order_release);
+    }
+
+    g_allocStatsLock.clear(std::memory_order_release);
+    return pRet;
+#else
+    return nullptr;
+#endif
+}
+
+inline void
+allocStatsAlloc([[maybe_unused]] AllocStats* s, [[maybe_unused]] usize size)
+{
+#if defined ADT_ALLOC_STATS
+    if (!s) return;
+
+    s->nAllocs.fetch_add(1, std::memory_order_relaxed);
+    s->aSizeHist[allocStatsBucket(size)].fetch_add(1, std::memory_order_relaxed);
+    _AllocStatsMax(&s->nBytesPeak, s->nBytesLive.fetch_add(s64(size), std::memory_order_relaxed) + s64(size));
+#endif
+}
+
+/* realloc in place, only the size changes */
+inline void
+allocStatsResize([[maybe_unused]] AllocStats* s, [[maybe_unused]] usize oldSize, [[maybe_unused]] usize newSize)
+{
+#if defined ADT_ALLOC_STATS
+    if (!s) return;
+
+    const s64 delta = s64(newSize) - s64(oldSize);
+    _AllocStatsMax(&s->nBytesPeak, s->nBytesLive.fetch_add(delta, std::memory_order_relaxed) + delta);
+#endif
+}
+
+inline void
+allocStatsFree([[maybe_unused]] AllocStats* s, [[maybe_unused]] usize size)
+{
+#if defined ADT_ALLOC_STATS
+    if (!s) return;
+
+    s->nFrees.fetch_add(1, std::memory_order_relaxed);
+    s->nBytesLive.fetch_sub(s64(size), std::memory_order_relaxed);
+#endif
+}
+
+/* everything handed out is gone at once (arena reset) */
+inline void
+allocStatsReset([[maybe_unused]] AllocStats* s, [[maybe_unused]] usize size)
+{
+#if defined ADT_ALLOC_STATS
+    if (!s) return;
+
+    s->nResets.fetch_add(1, std::memory_order_relaxed);
+    s->nBytesLive.fetch_sub(s64(size), std::memory_order_relaxed);
+#endif
+}
+
+inline void
+allocStatsReserve([[maybe_unused]] AllocStats* s, [[maybe_unused]] s64 delta)
+{
+#if defined ADT_ALLOC_STATS
+    if (!s) return;
+
+    _AllocStatsMax(&s->nBytesReservedPeak, s->nBytesReserved.fetch_add(delta, std::memory_order_relaxed) + delta);
+#endif
+}
+
+/* bytes the os allocator really gave for p */
+[[nodiscard]] inline usize
+allocStatsUsableSize([[maybe_unused]] void* p)
+{
+#if defined ADT_ALLOC_STATS
+    if (!p) return 0;
+
+    #if defined ADT_USE_MIMALLOC
+    return mi_usable_size(p);
+    #elif defined _WIN32
+    return _msize(p);
+    #else
+    return malloc_usable_size(p);
+    #endif
+#else
+    return 0;
+#endif
+}
+
+/* one line per record, the most overreserved first:
+ * reserved peak vs live peak is how much of a fixed size reservation was never used */
+inline void
+allocStatsReport(FILE* pf)
+{
+    const u32 n = g_nAllocStats.load(std::memory_order_acquire);
+
+    u32 aOrder[ALLOC_STATS_MAX];
+    for (u32 i = 0; i < n; ++i) aOrder[i] = i;
+
+    auto waste = [](const AllocStats& s) {
+        return s.nBytesReservedPeak.load(std::memory_order_relaxed) - s.nBytesPeak.load(std::memory_order_relaxed);
+    };
+
+    for (u32 i = 1; i < n; ++i)
+    {
+        const u32 key = aOrder[i];
+        u32 j = i;
+        for (; j > 0 && waste(g_aAllocStats[aOrder[j - 1]]) < waste(g_aAllocStats[key]); --j)
+            aOrder[j] = aOrder[j - 1];
+        aOrder[j] = key;
+    }
+
+    fprintf(pf, "%-32s %12s %12s %12s %12s %6s %10s %10s %8s  size histogram (<=16B, x2 .. >256KB)\n",
+        "allocator", "live", "peak", "reserved", "res. peak", "used%", "allocs", "frees", "resets"
+    );
+
+    for (u32 o = 0; o < n; ++o)
+    {
+        const AllocStats& s = g_aAllocStats[aOrder[o]];
+        const s64 peak = s.nBytesPeak.load(std::memory_order_relaxed);
+        const s64 resPeak = s.nBytesReservedPeak.load(std::memory_order_relaxed);
+
+        fprintf(pf, "%-32s %12lld %12lld %12lld %12lld %5.1f%% %10llu %10llu %8llu ",
+            s.aName,
+            (long long)s.nBytesLive.load(std::memory_order_relaxed), (long long)peak,
+            (long long)s.nBytesReserved.load(std::memory_order_relaxed), (long long)resPeak,
+            resPeak > 0 ? 100.0 * f64(peak) / f64(resPeak) : 100.0,
+            (unsigned long long)s.nAllocs.load(std::memory_order_relaxed),
+            (unsigned long long)s.nFrees.load(std::memory_order_relaxed),
+            (unsigned long long)s.nResets.load(std::memory_order_relaxed)
+        );
+
+        for (u32 b = 0; b < ALLOC_STATS_N_BUCKETS; ++b)
+            fprintf(pf, " %llu", (unsigned long long)s.aSizeHist[b].load(std::memory_order_relaxed));
+        fputc('\n', pf);
+    }
+}
+
+} /* namespace adt */
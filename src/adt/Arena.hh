@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AllocStats.hh"
 #include "OsAllocator.hh"
 #include "utils.hh"
 
@@ -51,6 +52,9 @@ public:
 
     void shrinkToFirstBlock() noexcept;
 
+    /* counts the blocks allocated before the call too */
+    virtual void setStats(AllocStats* pStats) noexcept override final;
+
     /* */
 
 private:
@@ -103,6 +107,8 @@ Arena::allocBlock(usize size)
     pBlock->size = size;
     pBlock->pLastAlloc = pBlock->pMem;
 
+    allocStatsReserve(m_pStats, size);
+
     return pBlock;
 }
 
@@ -136,6 +142,8 @@ Arena::malloc(usize mCount, usize mSize)
     pBlock->pLastAlloc = pRet;
     pBlock->lastAllocSize = realSize;
 
+    allocStatsAlloc(m_pStats, realSize);
+
     return pRet;
 }
 
@@ -165,6 +173,8 @@ Arena::realloc(void* ptr, usize oldCount, usize mCount, usize mSize)
     if (ptr == pBlock->pLastAlloc &&
         pBlock->pLastAlloc + realSize < pBlock->pMem + pBlock->size) /* bump case */
     {
+        allocStatsResize(m_pStats, pBlock->lastAllocSize, realSize);
+
         pBlock->nBytesOccupied -= pBlock->lastAllocSize;
         pBlock->nBytesOccupied += realSize;
         pBlock->lastAllocSize = realSize;
@@ -189,28 +199,40 @@ Arena::free(void*) noexcept
 inline void
 Arena::freeAll() noexcept
 {
+    usize nOccupied = 0, nReserved = 0;
+
     auto* it = m_pBlocks;
     while (it)
     {
         auto* next = it->pNext;
+        nOccupied += it->nBytesOccupied;
+        nReserved += it->size;
         m_pBackAlloc->free(it);
         it = next;
     }
     m_pBlocks = nullptr;
+
+    allocStatsReset(m_pStats, nOccupied);
+    allocStatsReserve(m_pStats, -ssize(nReserved));
 }
 
 inline void
 Arena::reset() noexcept
 {
+    usize nOccupied = 0;
+
     auto* it = m_pBlocks;
     while (it)
     {
+        nOccupied += it->nBytesOccupied;
         it->nBytesOccupied = 0;
         it->lastAllocSize = 0;
         it->pLastAlloc = it->pMem;
 
         it = it->pNext;
     }
+
+    allocStatsReset(m_pStats, nOccupied);
 }
 
 inline void
@@ -225,10 +247,24 @@ Arena::shrinkToFirstBlock() noexcept
         fprintf(stderr, "[Arena]: shrinking %llu sized block\n", it->size);
 #endif
         auto* next = it->pNext;
+        allocStatsResize(m_pStats, it->nBytesOccupied, 0);
+        allocStatsReserve(m_pStats, -ssize(it->size));
         m_pBackAlloc->free(it);
         it = next;
     }
     m_pBlocks = it;
 }
 
+inline void
+Arena::setStats(AllocStats* pStats) noexcept
+{
+    m_pStats = pStats;
+
+    for (auto* it = m_pBlocks; it; it = it->pNext)
+    {
+        allocStatsReserve(m_pStats, it->size);
+        allocStatsResize(m_pStats, 0, it->nBytesOccupied);
+    }
+}
+
 } /* namespace adt */
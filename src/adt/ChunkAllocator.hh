@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AllocStats.hh"
 #include "OsAllocator.hh"
 
 #include <cassert>
@@ -48,6 +49,8 @@ public:
     [[nodiscard]] virtual void* realloc(void* ptr, usize oldCount, usize newCount, usize mSize) noexcept(false) override final;
     void virtual free(void* ptr) noexcept override final;
     void virtual freeAll() noexcept override final;
+    /* counts the blocks allocated before the call too */
+    virtual void setStats(AllocStats* pStats) noexcept override final;
 
     /* */
 
@@ -74,6 +77,8 @@ ChunkAllocator::newBlock()
     }
     p->next = nullptr;
 
+    allocStatsReserve(m_pStats, m_blockCap);
+
     return r;
 }
 
@@ -102,6 +107,8 @@ ChunkAllocator::malloc(usize, usize)
     pBlock->head = head->next;
     pBlock->used += m_chunkSize;
 
+    allocStatsAlloc(m_pStats, m_chunkSize);
+
     return head->pNodeMem;
 }
 
@@ -141,19 +148,40 @@ ChunkAllocator::free(void* p) noexcept
     node->next = pBlock->head;
     pBlock->head = node;
     pBlock->used -= m_chunkSize;
+
+    allocStatsFree(m_pStats, m_chunkSize);
 }
 
 inline void
 ChunkAllocator::freeAll() noexcept
 {
+    usize nUsed = 0, nReserved = 0;
+
     ChunkAllocatorBlock* p = m_pBlocks, * next = nullptr;
     while (p)
     {
         next = p->next;
+        nUsed += p->used;
+        nReserved += m_blockCap;
         ::free(p);
         p = next;
     }
     m_pBlocks = nullptr;
+
+    allocStatsReset(m_pStats, nUsed);
+    allocStatsReserve(m_pStats, -ssize(nReserved));
+}
+
+inline void
+ChunkAllocator::setStats(AllocStats* pStats) noexcept
+{
+    m_pStats = pStats;
+
+    for (auto* p = m_pBlocks; p; p = p->next)
+    {
+        allocStatsReserve(m_pStats, m_blockCap);
+        allocStatsResize(m_pStats, 0, p->used);
+    }
 }
 
 } /* namespace adt */
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AllocStats.hh"
 #include "RBTree.hh"
 #include "OsAllocator.hh"
 
@@ -73,6 +74,8 @@ public:
     virtual void free(void* ptr) noexcept override;
     virtual void freeAll() noexcept override;
     usize nBytesAllocated();
+    /* counts the blocks allocated before the call too */
+    virtual void setStats(AllocStats* pStats) noexcept override;
 
 #ifndef NDEBUG
     void verify();
@@ -133,6 +136,8 @@ FreeList::allocBlock(usize size)
 
     m_tree.insert(true, pNode);
 
+    allocStatsReserve(m_pStats, size);
+
 #if defined ADT_DBG_MEMORY
         CERR("[FreeList]: new block of '{}' bytes\n", size);
 #endif
@@ -154,15 +159,32 @@ FreeList::blockPrepend(usize size)
 inline void
 FreeList::freeAll() noexcept
 {
+    usize nReserved = 0;
+
     auto* it = m_pBlocks;
     while (it)
     {
         auto* next = it->pNext;
+        nReserved += it->size;
         m_pBackAlloc->free(it);
         it = next;
     }
     m_pBlocks = nullptr;
     m_tree = {};
+
+    allocStatsReset(m_pStats, m_totalAllocated);
+    allocStatsReserve(m_pStats, -ssize(nReserved));
+    m_totalAllocated = 0;
+}
+
+inline void
+FreeList::setStats(AllocStats* pStats) noexcept
+{
+    m_pStats = pStats;
+
+    for (auto* it = m_pBlocks; it; it = it->pNext)
+        allocStatsReserve(m_pStats, it->size);
+    allocStatsResize(m_pStats, 0, m_totalAllocated);
 }
 
 inline FreeListData*
@@ -312,6 +334,8 @@ again:
     pBlock->nBytesOccupied += pFree->data().getSize();
     m_totalAllocated += pFree->data().getSize();
 
+    allocStatsAlloc(m_pStats, pFree->data().getSize());
+
     return pFree->m_data.m_pMem;
 }
 
@@ -337,6 +361,8 @@ FreeList::free(void* ptr) noexcept
     pBlock->nBytesOccupied -= pNode->m_data.getSize();
     m_totalAllocated -= pNode->m_data.getSize();
 
+    allocStatsFree(m_pStats, pNode->m_data.getSize());
+
     /* next adjecent node coalescence */
     if (pNode->m_data.m_pNext && pNode->m_data.m_pNext->isFree())
     {
@@ -392,6 +418,8 @@ FreeList::realloc(void* ptr, usize oldCount, usize newCount, usize mSize)
             pBlock->nBytesOccupied += realSize - pNode->m_data.getSize();
             m_totalAllocated += realSize - pNode->m_data.getSize();
 
+            allocStatsResize(m_pStats, pNode->m_data.getSize(), realSize);
+
             /* remove next from the free list */
             pNext->setFree(false);
             m_tree.remove(_FreeListNodeFromPtr(pNext->m_pMem));
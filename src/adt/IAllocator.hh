@@ -22,8 +22,14 @@ constexpr ssize SIZE_8M = SIZE_1M * 8;
 constexpr ssize SIZE_1G = SIZE_1M * SIZE_1K;
 constexpr ssize SIZE_8G = SIZE_1G * 8;
 
+struct AllocStats; /* AllocStats.hh */
+
 struct IAllocator
 {
+    AllocStats* m_pStats {}; /* counts only with ADT_ALLOC_STATS */
+
+    /* */
+
     [[nodiscard]] virtual constexpr void* malloc(usize mCount, usize mSize) noexcept(false) = 0;
 
     [[nodiscard]] virtual constexpr void* zalloc(usize mCount, usize mSize) noexcept(false) = 0;
@@ -34,6 +40,9 @@ struct IAllocator
     virtual constexpr void free(void* ptr) noexcept = 0;
 
     virtual constexpr void freeAll() noexcept = 0;
+
+    /* start counting into pStats (allocStatsGet()), nullptr stops */
+    virtual void setStats(AllocStats* pStats) noexcept { m_pStats = pStats; }
 };
 
 /* NOTE: allocator can throw on malloc/zalloc/realloc */
@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include "AllocStats.hh"
 #include "IAllocator.hh"
 #include "mimalloc.h"
 
@@ -32,6 +33,7 @@ MiMalloc::malloc(usize mCount, usize mSize)
 {
     auto* r = ::mi_malloc(mCount * mSize);
     if (!r) throw AllocException("MiMalloc::malloc()");
+    if (m_pStats) allocStatsAlloc(m_pStats, mi_usable_size(r));
     return r;
 }
 
@@ -40,20 +42,30 @@ MiMalloc::zalloc(usize mCount, usize mSize)
 {
     auto* r = ::mi_calloc(mCount, mSize);
     if (!r) throw AllocException("MiMalloc::zalloc()");
+    if (m_pStats) allocStatsAlloc(m_pStats, mi_usable_size(r));
     return r;
 }
 
 inline void*
 MiMalloc::realloc(void* p, usize, usize newCount, usize mSize)
 {
+    const usize oldSize = m_pStats && p ? mi_usable_size(p) : 0;
+
     auto* r = ::mi_reallocn(p, newCount, mSize);
     if (!r) throw AllocException("MiMalloc::realloc()");
+
+    if (m_pStats)
+    {
+        if (p) allocStatsResize(m_pStats, oldSize, mi_usable_size(r));
+        else allocStatsAlloc(m_pStats, mi_usable_size(r));
+    }
     return r;
 }
 
 inline void
 MiMalloc::free(void* p) noexcept
 {
+    if (m_pStats && p) allocStatsFree(m_pStats, mi_usable_size(p));
     ::mi_free(p);
 }
 
@@ -67,6 +79,7 @@ MiMalloc::freeAll() noexcept
 struct MiHeap : IAllocator
 {
     mi_heap_t* m_pHeap {};
+    usize m_nBytesLive {}; /* for the stats, freeAll() drops everything at once */
 
     /* */
 
@@ -84,13 +97,27 @@ struct MiHeap : IAllocator
     /* */
 
     void reset() noexcept;
+
+    /* */
+
+private:
+    void countAlloc(void* p) noexcept;
 };
 
+inline void
+MiHeap::countAlloc(void* p) noexcept
+{
+    const usize size = mi_usable_size(p);
+    m_nBytesLive += size;
+    allocStatsAlloc(m_pStats, size);
+}
+
 inline void*
 MiHeap::malloc(usize mCount, usize mSize)
 {
     auto* r = ::mi_heap_mallocn(m_pHeap, mCount, mSize);
     if (!r) throw AllocException("MiHeap::malloc()");
+    if (m_pStats) countAlloc(r);
     return r;
 }
 
@@ -99,20 +126,38 @@ MiHeap::zalloc(usize mCount, usize mSize)
 {
     auto* r = ::mi_heap_zalloc(m_pHeap, mCount * mSize);
     if (!r) throw AllocException("MiHeap::zalloc()");
+    if (m_pStats) countAlloc(r);
     return r;
 }
 
 inline void*
 MiHeap::realloc(void* p, usize, usize newCount, usize mSize)
 {
+    const usize oldSize = m_pStats && p ? mi_usable_size(p) : 0;
+
     auto* r = ::mi_reallocn(p, newCount, mSize);
     if (!r) throw AllocException("MiHeap::realloc()");
+
+    if (m_pStats)
+    {
+        const usize newSize = mi_usable_size(r);
+        m_nBytesLive += newSize - oldSize;
+        if (p) allocStatsResize(m_pStats, oldSize, newSize);
+        else allocStatsAlloc(m_pStats, newSize);
+    }
     return r;
 }
 
 inline void
 MiHeap::free(void* ptr) noexcept
 {
+    if (m_pStats && ptr)
+    {
+        const usize size = mi_usable_size(ptr);
+        m_nBytesLive -= size;
+        allocStatsFree(m_pStats, size);
+    }
+
     ::mi_free(ptr);
 }
 
@@ -120,6 +165,7 @@ inline void
 MiHeap::freeAll() noexcept
 {
     mi_heap_destroy(m_pHeap);
+    allocStatsReset(m_pStats, m_nBytesLive);
     *this = {};
 }
 
@@ -129,6 +175,9 @@ MiHeap::reset() noexcept
     /* NOTE: no idea how to use this correctly */
     mi_heap_destroy(m_pHeap);
     m_pHeap = mi_heap_new();
+
+    allocStatsReset(m_pStats, m_nBytesLive);
+    m_nBytesLive = 0;
 }
 
 } /* namespace adt */
@@ -24,6 +24,7 @@ struct MutexArena : IAllocator
     [[nodiscard]] virtual void* realloc(void* ptr, usize oldCount, usize newCount, usize mSize) noexcept(false) override final;
     virtual void free(void* ptr) noexcept override final;
     virtual void freeAll() noexcept override final;
+    virtual void setStats(AllocStats* pStats) noexcept override final;
 };
 
 inline void*
@@ -75,4 +76,12 @@ MutexArena::freeAll() noexcept
     m_mtx.destroy();
 }
 
+inline void
+MutexArena::setStats(AllocStats* pStats) noexcept
+{
+    /* the arena does the counting */
+    guard::Mtx lock(&m_mtx);
+    m_arena.setStats(pStats);
+}
+
 } /* namespace adt */
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AllocStats.hh"
 #include "IAllocator.hh"
 
 #include <cassert>
@@ -26,7 +27,15 @@ struct OsAllocator : IAllocator
 inline OsAllocator*
 OsAllocatorGet()
 {
+#if defined ADT_ALLOC_STATS
+    static OsAllocator alloc = [] {
+        OsAllocator a {};
+        a.setStats(allocStatsGet("os"));
+        return a;
+    }();
+#else
     static OsAllocator alloc {};
+#endif
     return &alloc;
 }
 
@@ -39,6 +48,7 @@ OsAllocator::malloc(usize mCount, usize mSize)
     auto* r = ::malloc(mCount * mSize);
 #endif
     if (!r) throw AllocException("OsAllocator::malloc()");
+    if (m_pStats) allocStatsAlloc(m_pStats, allocStatsUsableSize(r));
     return r;
 }
 
@@ -52,12 +62,15 @@ OsAllocator::zalloc(usize mCount, usize mSize)
 #endif
 
     if (!r) throw AllocException("OsAllocator::zalloc()");
+    if (m_pStats) allocStatsAlloc(m_pStats, allocStatsUsableSize(r));
     return r;
 }
 
 inline void*
 OsAllocator::realloc(void* p, usize, usize newCount, usize mSize)
 {
+    const usize oldSize = m_pStats ? allocStatsUsableSize(p) : 0;
+
 #ifdef ADT_USE_MIMALLOC
     auto* r = ::mi_realloc(p, newCount * mSize);
 #else
@@ -65,12 +78,19 @@ OsAllocator::realloc(void* p, usize, usize newCount, usize mSize)
 #endif
 
     if (!r) throw AllocException("OsAllocator::realloc()");
+    if (m_pStats)
+    {
+        if (p) allocStatsResize(m_pStats, oldSize, allocStatsUsableSize(r));
+        else allocStatsAlloc(m_pStats, allocStatsUsableSize(r));
+    }
     return r;
 }
 
 inline void
 OsAllocator::free(void* p) noexcept
 {
+    if (m_pStats && p) allocStatsFree(m_pStats, allocStatsUsableSize(p));
+
 #ifdef ADT_USE_MIMALLOC
     ::mi_free(p);
 #else
@@ -51,6 +51,7 @@ struct Pool
     [[nodiscard]] PoolHnd push(const T& value);
     template<typename ...ARGS> requires(std::is_constructible_v<T, ARGS...>) [[nodiscard]] PoolHnd emplace(ARGS&&... args);
     void giveBack(PoolHnd hnd);
+    void clear(); /* every handle is released, elements are reset to T{} */
     ssize getCap() const { return CAP; }
     ssize getSize() const { return m_nOccupied; }
 
@@ -247,6 +248,18 @@ Pool<T, CAP>::giveBack(PoolHnd hnd)
     }
 }
 
+template<typename T, ssize CAP>
+inline void
+Pool<T, CAP>::clear()
+{
+    guard::Mtx lock(&m_mtx);
+
+    for (auto& node : m_aNodes) node = {};
+    m_aNodes.setSize(0);
+    m_aFreeIdxs.setSize(0);
+    m_nOccupied = 0;
+}
+
 template<typename T, ssize CAP>
 inline T&
 Pool<T, CAP>::at(ssize i)
@@ -4,6 +4,7 @@
 #include "adt/Vec.hh"
 #include "defer.hh"
 #include "guard.hh"
+#include "prof.hh"
 #include "Thread.hh"
 
 #include <atomic>
@@ -172,6 +173,8 @@ _ThreadPoolLoop(void* p)
     s->m_nActiveThreadsInLoop.fetch_add(1, std::memory_order_relaxed);
     defer( s->m_nActiveThreadsInLoop.fetch_sub(1, std::memory_order_relaxed) );
 
+    ADT_PROFILE_THREAD_NAME("ThreadPool");
+
     while (!s->m_bDone)
     {
         ThreadTask task;
@@ -188,7 +191,10 @@ _ThreadPoolLoop(void* p)
             s->m_nActiveTasks.fetch_add(1, std::memory_order_relaxed);
         }
 
-        task.pfn(task.pArgs);
+        {
+            ADT_PROFILE_SCOPE("ThreadPool task");
+            task.pfn(task.pArgs);
+        }
         s->m_nActiveTasks.fetch_sub(1, std::memory_order_relaxed);
 
         if (task.eWait == WAIT_FLAG::WAIT)
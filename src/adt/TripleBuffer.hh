@@ -0,0 +1,48 @@
+#pragma once
+
+#include "types.hh"
+
+#include <atomic>
+
+namespace adt
+{
+
+/* One writer and one reader hand whole T's over without locking or waiting on each other.
+ * Writer fills getBack() and publish()es it, reader acquire()s the newest one and reads getFront().
+ * The writer never waits for the reader, unread values get overwritten. */
+template<typename T>
+struct TripleBuffer
+{
+    static constexpr u8 NEW_BIT = 1 << 2; /* m_middle holds something the reader hasn't seen */
+    static constexpr u8 IDX_MASK = NEW_BIT - 1;
+
+    /* */
+
+    T m_aBufs[3] {};
+    u8 m_back = 0; /* writer only */
+    std::atomic<u8> m_middle {1};
+    u8 m_front = 2; /* reader only */
+
+    /* */
+
+    [[nodiscard]] T& getBack() { return m_aBufs[m_back]; }
+    [[nodiscard]] const T& getFront() const { return m_aBufs[m_front]; }
+
+    void
+    publish()
+    {
+        m_back = m_middle.exchange(m_back | NEW_BIT, std::memory_order_acq_rel) & IDX_MASK;
+    }
+
+    /* false if nothing new was published, getFront() stays the same */
+    bool
+    acquire()
+    {
+        if (!(m_middle.load(std::memory_order_relaxed) & NEW_BIT)) return false;
+
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & IDX_MASK;
+        return true;
+    }
+};
+
+} /* namespace adt */
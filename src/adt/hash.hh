@@ -150,11 +150,12 @@ func(const T& x)
     return xxh64::hash((const char*)&x, sizeof(T), 0);
 }
 
+/* without the terminator, same as hashing the String */
 template<ssize N>
 constexpr usize
 func(const char (&aChars)[N])
 {
-    return xxh64::hash(aChars, N, 0);
+    return xxh64::hash(aChars, N - 1, 0);
 }
 
 template<typename T>
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "utils.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/* Scoped zones for the hot paths:
+ *     ADT_PROFILE_SCOPE("draw");
+ * Each thread writes finished zones into its own ring, single producer, no locks.
+ * writeChromeTrace() dumps every ring as trace event json (chrome://tracing, ui.perfetto.dev).
+ * The macros compile to nothing without ADT_PROF, the functions stay usable. */
+
+namespace adt::prof
+{
+
+constexpr u32 RING_SIZE = 1 << 14; /* zones per thread, oldest ones get overwritten */
+constexpr u32 MAX_THREADS = 64;
+constexpr u32 THREAD_NAME_SIZE = 32;
+
+struct Zone
+{
+    const char* ntsName {}; /* string literal, only the pointer is stored */
+    s64 beginUS {};
+    s64 endUS {};
+};
+
+struct Ring
+{
+    Zone aZones[RING_SIZE] {};
+    std::atomic<u64> head {}; /* zones ever written, only the owner stores */
+    u32 tid {};
+    char aName[THREAD_NAME_SIZE] {};
+};
+
+inline std::atomic<Ring*> g_aRings[MAX_THREADS] {};
+inline std::atomic<u32> g_nRings {};
+inline thread_local Ring* tl_pRing {};
+
+/* nullptr after MAX_THREADS threads, their zones are dropped */
+[[nodiscard]] inline Ring*
+threadRing()
+{
+    if (tl_pRing) [[likely]] return tl_pRing;
+
+    const u32 idx = g_nRings.fetch_add(1, std::memory_order_relaxed);
+    if (idx >= MAX_THREADS) return nullptr;
+
+    /* never freed, the export can happen after the thread is gone */
+    Ring* p = (Ring*)::calloc(1, sizeof(Ring));
+    if (!p) return nullptr;
+
+    p->tid = idx + 1;
+    snprintf(p->aName, sizeof(p->aName), "thread %u", idx + 1);
+
+    g_aRings[idx].store(p, std::memory_order_release);
+    tl_pRing = p;
+
+    return p;
+}
+
+inline void
+setThreadName(const char* ntsName)
+{
+    Ring* p = threadRing();
+    if (!p) return;
+
+    memset(p->aName, 0, sizeof(p->aName));
+    strncpy(p->aName, ntsName, sizeof(p->aName) - 1);
+}
+
+inline void
+push(Ring* p, const char* ntsName, s64 beginUS, s64 endUS)
+{
+    const u64 h = p->head.load(std::memory_order_relaxed);
+    p->aZones[h & (RING_SIZE - 1)] = {ntsName, beginUS, endUS};
+    p->head.store(h + 1, std::memory_order_release);
+}
+
+struct Scope
+{
+    Ring* m_pRing {};
+    const char* m_ntsName {};
+    s64 m_beginUS {};
+
+    /* */
+
+    Scope(const char* ntsName)
+        : m_pRing(threadRing()), m_ntsName(ntsName), m_beginUS(utils::timeNowUS()) {}
+
+    ~Scope()
+    {
+        const s64 endUS = utils::timeNowUS();
+        if (m_pRing) push(m_pRing, m_ntsName, m_beginUS, endUS);
+    }
+};
+
+/* every zone still in the rings, safe while other threads keep pushing:
+ * zones that could have been overwritten during the copy are left out.
+ * Returns the number of zones written or -1 */
+inline ssize
+writeChromeTrace(const char* ntsPath)
+{
+    FILE* pf = fopen(ntsPath, "wb");
+    if (!pf) return -1;
+
+    Zone* aCopy = (Zone*)::malloc(sizeof(Zone) * RING_SIZE);
+    if (!aCopy)
+    {
+        fclose(pf);
+        return -1;
+    }
+
+    ssize nZones = 0;
+    bool bFirst = true;
+    auto comma = [&] { if (!bFirst) fputs(",\n", pf); bFirst = false; };
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", pf);
+
+    const u32 nRings = utils::min(g_nRings.load(std::memory_order_relaxed), MAX_THREADS);
+    for (u32 r = 0; r < nRings; ++r)
+    {
+        Ring* p = g_aRings[r].load(std::memory_order_acquire);
+        if (!p) continue;
+
+        comma();
+        fprintf(pf, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            p->tid, p->aName
+        );
+
+        const u64 headBefore = p->head.load(std::memory_order_acquire);
+        const u64 first = headBefore > RING_SIZE ? headBefore - RING_SIZE : 0;
+        for (u64 i = first; i < headBefore; ++i)
+            aCopy[i - first] = p->aZones[i & (RING_SIZE - 1)];
+        /* the copies can't move past the head re-read */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const u64 headAfter = p->head.load(std::memory_order_relaxed);
+
+        /* slots the owner reached again while copying, headAfter's own slot may be half written,
+         * its index is published after the store */
+        const u64 firstValid = headAfter + 1 > RING_SIZE ? headAfter + 1 - RING_SIZE : 0;
+
+        for (u64 i = utils::max(first, firstValid); i < headBefore; ++i)
+        {
+            const Zone& z = aCopy[i - first];
+            comma();
+            fprintf(pf, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld}",
+                z.ntsName, p->tid, (long long)z.beginUS, (long long)(z.endUS - z.beginUS)
+            );
+            ++nZones;
+        }
+    }
+
+    ::free(aCopy);
+
+    fputs("\n]}\n", pf);
+    const bool bOk = fclose(pf) == 0;
+
+    return bOk ? nZones : -1;
+}
+
+} /* namespace adt::prof */
+
+#define ADT_PROF_GLUE2(x, y) x##y##_
+#define ADT_PROF_GLUE1(x, y) ADT_PROF_GLUE2(x, y)
+
+#ifdef ADT_PROF
+    #define ADT_PROFILE_SCOPE(ntsName) adt::prof::Scope ADT_PROF_GLUE1(_profScope, __COUNTER__) {ntsName}
+    #define ADT_PROFILE_THREAD_NAME(ntsName) adt::prof::setThreadName(ntsName)
+#else
+    #define ADT_PROFILE_SCOPE(ntsName) (void)0
+    #define ADT_PROFILE_THREAD_NAME(ntsName) (void)0
+#endif
+
+#ifdef ADT_PROF_LESS_TYPING
+    #define PROFILE_SCOPE(ntsName) ADT_PROFILE_SCOPE(ntsName)
+    #define PROFILE_THREAD_NAME(ntsName) ADT_PROFILE_THREAD_NAME(ntsName)
+#endif
@@ -28,6 +28,24 @@ char** g_argv = nullptr;
 audio::IMixer* g_pMixer;
 IWindow* g_pWindow;
 
+/* --audio-latency <frames> */
+static u32
+argAudioLatency()
+{
+    for (int i = 1; i < g_argc - 1; ++i)
+    {
+        if (String(g_argv[i]) == "--audio-latency")
+        {
+            int n = atoi(g_argv[i + 1]);
+            if (n > 0) return n;
+
+            LOG_WARN("bad --audio-latency value: '{}'\n", g_argv[i + 1]);
+        }
+    }
+
+    return audio::DEFAULT_LATENCY_FRAMES;
+}
+
 audio::IMixer*
 platformMixerAlloc(IAllocator* pAlloc)
 {
@@ -36,7 +54,7 @@ platformMixerAlloc(IAllocator* pAlloc)
         namespace pw = platform::pipewire;
 
         auto* pMixer = (pw::Mixer*)pAlloc->zalloc(1, sizeof(pw::Mixer));
-        new(pMixer) pw::Mixer(pAlloc);
+        new(pMixer) pw::Mixer(pAlloc, argAudioLatency());
 
         return pMixer;
     }
@@ -9,6 +9,8 @@ namespace audio
 
 constexpr u64 CHUNK_SIZE = 0x4000; /* big enough */
 constexpr u32 MAX_TRACK_COUNT = 8;
+constexpr u32 DEFAULT_LATENCY_FRAMES = 512; /* PW_KEY_NODE_LATENCY quantum request */
+constexpr u32 N_CALLBACK_BUCKETS = 8; /* [<16us, <32us, ... <1024us, >=1024us] */
 
 extern f32 g_globalVolume;
 
@@ -20,8 +22,34 @@ struct Track
     u8 nChannels = 0;
     bool bRepeat = false;
     f32 volume = 0.0f;
+    s64 addTimeUS = 0; /* stamped by IMixer::add(), cleared once the first sample is mixed */
 };
 
+/* Snapshot of mixer telemetry, cheap enough to poll every frame. */
+struct Stats
+{
+    u32 sampleRate {};
+    u32 targetLatencyFrames {};
+    u32 lastNFrames {};
+    f64 delayMS {}; /* stream delay reported by the backend + frames still queued */
+    u64 nCallbacks {};
+    u64 nUnderruns {}; /* no buffer available when the callback fired */
+    u64 nXruns {}; /* graph advanced more than one quantum between callbacks */
+    s64 lastCallbackUS {};
+    s64 maxCallbackUS {};
+    f64 lastAddToFirstSampleMS {};
+    f64 maxAddToFirstSampleMS {};
+    u64 aCallbackHist[N_CALLBACK_BUCKETS] {};
+};
+
+inline u32
+callbackBucket(s64 us)
+{
+    u32 i = 0;
+    for (s64 lim = 16; i < N_CALLBACK_BUCKETS - 1 && us >= lim; lim *= 2) ++i;
+    return i;
+}
+
 /* Platrform abstracted audio interface */
 struct IMixer
 {
@@ -34,6 +62,7 @@ struct IMixer
     virtual void destroy() = 0;
     virtual void add(Track t) = 0;
     virtual void addBackground(Track t) = 0;
+    virtual Stats getStats() { return {}; };
 };
 
 struct DummyMixer : IMixer
@@ -0,0 +1,426 @@
+#include "balls.hh"
+
+#include "adt/utils.hh"
+
+#include <cstring>
+#include <immintrin.h>
+
+namespace balls
+{
+
+void
+Balls::grow(u32 cap)
+{
+    /* multiple of 8 so every array starts 32 byte aligned relative to the block */
+    cap = utils::max((cap + 7u) & ~7u, 8u);
+
+    f32* pNew = (f32*)m_pAlloc->malloc(usize(cap) * N_ARRAYS, sizeof(f32));
+    f32** aArrays[N_ARRAYS] {&m_aPosX, &m_aPosY, &m_aDirX, &m_aDirY, &m_aSpeed, &m_aStep};
+
+    for (u32 a = 0; a < N_ARRAYS; ++a)
+    {
+        f32* pDst = pNew + usize(a) * cap;
+        if (m_size > 0) memcpy(pDst, *aArrays[a], m_size * sizeof(f32));
+        *aArrays[a] = pDst;
+    }
+
+    if (m_pMem) m_pAlloc->free(m_pMem);
+    m_pMem = pNew;
+    m_cap = cap;
+}
+
+u32
+Balls::push(math::V2 pos, math::V2 dir, f32 speed)
+{
+    if (m_size >= m_cap) grow(m_cap * 2);
+
+    const u32 i = m_size++;
+    setPos(i, pos);
+    setDir(i, dir);
+    m_aSpeed[i] = speed;
+    m_aStep[i] = 0.0f;
+
+    return i;
+}
+
+void
+Balls::swapRemove(u32 i)
+{
+    ADT_ASSERT(i < m_size, "i: %u, m_size: %u", i, m_size);
+
+    const u32 last = --m_size;
+    if (i == last) return;
+
+    m_aPosX[i] = m_aPosX[last];
+    m_aPosY[i] = m_aPosY[last];
+    m_aDirX[i] = m_aDirX[last];
+    m_aDirY[i] = m_aDirY[last];
+    m_aSpeed[i] = m_aSpeed[last];
+    m_aStep[i] = m_aStep[last];
+}
+
+void
+Balls::setSize(u32 size)
+{
+    ADT_ASSERT(size <= m_size, "size: %u, m_size: %u", size, m_size);
+    m_size = size;
+}
+
+void
+Balls::setDir(u32 i, math::V2 dir)
+{
+    const f32 len = math::V2Length(dir);
+    const math::V2 n = len > 0.0f ? dir / len : math::V2 {0.0f, 1.0f};
+
+    m_aDirX[i] = n.x;
+    m_aDirY[i] = n.y;
+}
+
+void
+Balls::destroy()
+{
+    if (m_pMem) m_pAlloc->free(m_pMem);
+    *this = {};
+}
+
+void
+Grid::init(IAllocator* pAlloc, s32 width, s32 height)
+{
+    m_width = width;
+    m_height = height;
+    m_aNear = (u8*)pAlloc->zalloc(usize(width) * height, 1);
+}
+
+void
+Grid::add(s32 x, s32 y)
+{
+    for (s32 ny = utils::max(y - 1, 0); ny <= utils::min(y + 1, m_height - 1); ++ny)
+        for (s32 nx = utils::max(x - 1, 0); nx <= utils::min(x + 1, m_width - 1); ++nx)
+            ++m_aNear[ny*m_width + nx];
+}
+
+void
+Grid::remove(s32 x, s32 y)
+{
+    for (s32 ny = utils::max(y - 1, 0); ny <= utils::min(y + 1, m_height - 1); ++ny)
+    {
+        for (s32 nx = utils::max(x - 1, 0); nx <= utils::min(x + 1, m_width - 1); ++nx)
+        {
+            ADT_ASSERT(m_aNear[ny*m_width + nx] > 0, "(%d, %d) was never added", x, y);
+            --m_aNear[ny*m_width + nx];
+        }
+    }
+}
+
+bool
+Grid::bNear(f32 x, f32 y) const
+{
+    const s32 ix = s32(std::floor(x + 0.5f));
+    const s32 iy = s32(std::floor(y + 0.5f));
+
+    /* outside the grid is sweepGrid()'s business */
+    if (ix < 0 || ix >= m_width || iy < 0 || iy >= m_height) return true;
+
+    return m_aNear[iy*m_width + ix] != 0;
+}
+
+static inline u32
+countBits(u32 bits)
+{
+    u32 n = 0;
+    for (; bits; bits &= bits - 1) ++n;
+    return n;
+}
+
+u32
+paddleScalar(Balls* pBalls, u32 first, u32 last, const Paddle& p)
+{
+    Balls& b = *pBalls;
+    const f32 addX = p.dir.x * 0.1f;
+    const f32 addY = p.dir.y * 0.1f;
+    u32 nHits = 0;
+
+    for (u32 i = first; i < last; ++i)
+    {
+        const f32 x = b.m_aPosX[i], y = b.m_aPosY[i];
+        if (!(x >= p.left && x <= p.right && y <= p.lineY)) continue;
+
+        const f32 dx = b.m_aDirX[i] + addX;
+        const f32 dy = -b.m_aDirY[i] + addY;
+        const f32 len = std::sqrt(dx*dx + dy*dy);
+
+        b.m_aPosY[i] = p.lineY;
+        b.m_aDirX[i] = dx / len;
+        b.m_aDirY[i] = dy / len;
+        ++nHits;
+    }
+
+    return nHits;
+}
+
+u32
+paddle(Balls* pBalls, u32 first, const Paddle& p)
+{
+    Balls& b = *pBalls;
+    u32 i = first;
+    u32 nHits = 0;
+
+#ifdef ADT_AVX2
+    {
+        const __m256 vLeft = _mm256_set1_ps(p.left);
+        const __m256 vRight = _mm256_set1_ps(p.right);
+        const __m256 vLine = _mm256_set1_ps(p.lineY);
+        const __m256 vAddX = _mm256_set1_ps(p.dir.x * 0.1f);
+        const __m256 vAddY = _mm256_set1_ps(p.dir.y * 0.1f);
+
+        for (; i + 8 <= b.m_size; i += 8)
+        {
+            const __m256 x = _mm256_loadu_ps(b.m_aPosX + i);
+            const __m256 y = _mm256_loadu_ps(b.m_aPosY + i);
+
+            const __m256 m = _mm256_and_ps(
+                _mm256_and_ps(_mm256_cmp_ps(x, vLeft, _CMP_GE_OQ), _mm256_cmp_ps(x, vRight, _CMP_LE_OQ)),
+                _mm256_cmp_ps(y, vLine, _CMP_LE_OQ)
+            );
+            const u32 bits = _mm256_movemask_ps(m);
+            if (!bits) continue;
+
+            const __m256 dirX = _mm256_loadu_ps(b.m_aDirX + i);
+            const __m256 dirY = _mm256_loadu_ps(b.m_aDirY + i);
+            const __m256 dx = _mm256_add_ps(dirX, vAddX);
+            const __m256 dy = _mm256_add_ps(_mm256_sub_ps(_mm256_setzero_ps(), dirY), vAddY);
+            const __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+
+            _mm256_storeu_ps(b.m_aPosY + i, _mm256_blendv_ps(y, vLine, m));
+            _mm256_storeu_ps(b.m_aDirX + i, _mm256_blendv_ps(dirX, _mm256_div_ps(dx, len), m));
+            _mm256_storeu_ps(b.m_aDirY + i, _mm256_blendv_ps(dirY, _mm256_div_ps(dy, len), m));
+            nHits += countBits(bits);
+        }
+    }
+#endif
+
+#ifdef ADT_SSE4_2
+    {
+        const __m128 vLeft = _mm_set1_ps(p.left);
+        const __m128 vRight = _mm_set1_ps(p.right);
+        const __m128 vLine = _mm_set1_ps(p.lineY);
+        const __m128 vAddX = _mm_set1_ps(p.dir.x * 0.1f);
+        const __m128 vAddY = _mm_set1_ps(p.dir.y * 0.1f);
+
+        for (; i + 4 <= b.m_size; i += 4)
+        {
+            const __m128 x = _mm_loadu_ps(b.m_aPosX + i);
+            const __m128 y = _mm_loadu_ps(b.m_aPosY + i);
+
+            const __m128 m = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, vLeft), _mm_cmple_ps(x, vRight)), _mm_cmple_ps(y, vLine));
+            const u32 bits = _mm_movemask_ps(m);
+            if (!bits) continue;
+
+            const __m128 dirX = _mm_loadu_ps(b.m_aDirX + i);
+            const __m128 dirY = _mm_loadu_ps(b.m_aDirY + i);
+            const __m128 dx = _mm_add_ps(dirX, vAddX);
+            const __m128 dy = _mm_add_ps(_mm_sub_ps(_mm_setzero_ps(), dirY), vAddY);
+            const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+
+            _mm_storeu_ps(b.m_aPosY + i, _mm_blendv_ps(y, vLine, m));
+            _mm_storeu_ps(b.m_aDirX + i, _mm_blendv_ps(dirX, _mm_div_ps(dx, len), m));
+            _mm_storeu_ps(b.m_aDirY + i, _mm_blendv_ps(dirY, _mm_div_ps(dy, len), m));
+            nHits += countBits(bits);
+        }
+    }
+#endif
+
+    return nHits + paddleScalar(pBalls, i, b.m_size, p);
+}
+
+u32
+wallsScalar(Balls* pBalls, u32 first, u32 last, const Bounds& bo, IAllocator* pAlloc, VecBase<u32>* paLost)
+{
+    Balls& b = *pBalls;
+    u32 nBounces = 0;
+
+    for (u32 i = first; i < last; ++i)
+    {
+        f32& x = b.m_aPosX[i];
+        f32& y = b.m_aPosY[i];
+
+        if (y < bo.bottom)
+        {
+            if (!bo.bBounceBottom)
+            {
+                paLost->push(pAlloc, i);
+                continue;
+            }
+
+            y = bo.bottom;
+            b.m_aDirY[i] = -b.m_aDirY[i];
+        }
+        else if (y > bo.top)
+        {
+            y = bo.top;
+            b.m_aDirY[i] = -b.m_aDirY[i];
+        }
+        else if (x < bo.left)
+        {
+            x = bo.left;
+            b.m_aDirX[i] = -b.m_aDirX[i];
+        }
+        else if (x > bo.right)
+        {
+            x = bo.right;
+            b.m_aDirX[i] = -b.m_aDirX[i];
+        }
+        else continue;
+
+        ++nBounces;
+    }
+
+    return nBounces;
+}
+
+u32
+walls(Balls* pBalls, u32 first, const Bounds& bo, IAllocator* pAlloc, VecBase<u32>* paLost)
+{
+    Balls& b = *pBalls;
+    u32 i = first;
+    u32 nBounces = 0;
+
+    /* same if/else chain as wallsScalar() with masks, each one excludes the ones before */
+
+#ifdef ADT_AVX2
+    {
+        const __m256 vLeft = _mm256_set1_ps(bo.left);
+        const __m256 vRight = _mm256_set1_ps(bo.right);
+        const __m256 vBottom = _mm256_set1_ps(bo.bottom);
+        const __m256 vTop = _mm256_set1_ps(bo.top);
+        const __m256 vBounceBottom = _mm256_castsi256_ps(_mm256_set1_epi32(bo.bBounceBottom ? -1 : 0));
+        const __m256 vSign = _mm256_set1_ps(-0.0f);
+
+        for (; i + 8 <= b.m_size; i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(b.m_aPosX + i);
+            __m256 y = _mm256_loadu_ps(b.m_aPosY + i);
+
+            const __m256 mBelow = _mm256_cmp_ps(y, vBottom, _CMP_LT_OQ);
+            const __m256 mAbove = _mm256_andnot_ps(mBelow, _mm256_cmp_ps(y, vTop, _CMP_GT_OQ));
+            const __m256 mY = _mm256_or_ps(mBelow, mAbove);
+            const __m256 mLeft = _mm256_andnot_ps(mY, _mm256_cmp_ps(x, vLeft, _CMP_LT_OQ));
+            const __m256 mRight = _mm256_andnot_ps(_mm256_or_ps(mY, mLeft), _mm256_cmp_ps(x, vRight, _CMP_GT_OQ));
+
+            const u32 belowBits = _mm256_movemask_ps(mBelow);
+            const u32 anyBits = _mm256_movemask_ps(_mm256_or_ps(_mm256_or_ps(mY, mLeft), mRight));
+            if (!anyBits) continue;
+
+            const __m256 mBounceBelow = _mm256_and_ps(mBelow, vBounceBottom);
+            const __m256 mFlipY = _mm256_or_ps(mBounceBelow, mAbove);
+            const __m256 mFlipX = _mm256_or_ps(mLeft, mRight);
+
+            y = _mm256_blendv_ps(y, vBottom, mBounceBelow);
+            y = _mm256_blendv_ps(y, vTop, mAbove);
+            x = _mm256_blendv_ps(x, vLeft, mLeft);
+            x = _mm256_blendv_ps(x, vRight, mRight);
+
+            _mm256_storeu_ps(b.m_aPosX + i, x);
+            _mm256_storeu_ps(b.m_aPosY + i, y);
+            _mm256_storeu_ps(b.m_aDirX + i, _mm256_xor_ps(_mm256_loadu_ps(b.m_aDirX + i), _mm256_and_ps(mFlipX, vSign)));
+            _mm256_storeu_ps(b.m_aDirY + i, _mm256_xor_ps(_mm256_loadu_ps(b.m_aDirY + i), _mm256_and_ps(mFlipY, vSign)));
+
+            nBounces += countBits(_mm256_movemask_ps(_mm256_or_ps(mFlipX, mFlipY)));
+
+            if (!bo.bBounceBottom)
+                for (u32 bits = belowBits; bits; bits &= bits - 1)
+                    paLost->push(pAlloc, i + __builtin_ctz(bits));
+        }
+    }
+#endif
+
+#ifdef ADT_SSE4_2
+    {
+        const __m128 vLeft = _mm_set1_ps(bo.left);
+        const __m128 vRight = _mm_set1_ps(bo.right);
+        const __m128 vBottom = _mm_set1_ps(bo.bottom);
+        const __m128 vTop = _mm_set1_ps(bo.top);
+        const __m128 vBounceBottom = _mm_castsi128_ps(_mm_set1_epi32(bo.bBounceBottom ? -1 : 0));
+        const __m128 vSign = _mm_set1_ps(-0.0f);
+
+        for (; i + 4 <= b.m_size; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(b.m_aPosX + i);
+            __m128 y = _mm_loadu_ps(b.m_aPosY + i);
+
+            const __m128 mBelow = _mm_cmplt_ps(y, vBottom);
+            const __m128 mAbove = _mm_andnot_ps(mBelow, _mm_cmpgt_ps(y, vTop));
+            const __m128 mY = _mm_or_ps(mBelow, mAbove);
+            const __m128 mLeft = _mm_andnot_ps(mY, _mm_cmplt_ps(x, vLeft));
+            const __m128 mRight = _mm_andnot_ps(_mm_or_ps(mY, mLeft), _mm_cmpgt_ps(x, vRight));
+
+            const u32 belowBits = _mm_movemask_ps(mBelow);
+            const u32 anyBits = _mm_movemask_ps(_mm_or_ps(_mm_or_ps(mY, mLeft), mRight));
+            if (!anyBits) continue;
+
+            const __m128 mBounceBelow = _mm_and_ps(mBelow, vBounceBottom);
+            const __m128 mFlipY = _mm_or_ps(mBounceBelow, mAbove);
+            const __m128 mFlipX = _mm_or_ps(mLeft, mRight);
+
+            y = _mm_blendv_ps(y, vBottom, mBounceBelow);
+            y = _mm_blendv_ps(y, vTop, mAbove);
+            x = _mm_blendv_ps(x, vLeft, mLeft);
+            x = _mm_blendv_ps(x, vRight, mRight);
+
+            _mm_storeu_ps(b.m_aPosX + i, x);
+            _mm_storeu_ps(b.m_aPosY + i, y);
+            _mm_storeu_ps(b.m_aDirX + i, _mm_xor_ps(_mm_loadu_ps(b.m_aDirX + i), _mm_and_ps(mFlipX, vSign)));
+            _mm_storeu_ps(b.m_aDirY + i, _mm_xor_ps(_mm_loadu_ps(b.m_aDirY + i), _mm_and_ps(mFlipY, vSign)));
+
+            nBounces += countBits(_mm_movemask_ps(_mm_or_ps(mFlipX, mFlipY)));
+
+            if (!bo.bBounceBottom)
+                for (u32 bits = belowBits; bits; bits &= bits - 1)
+                    paLost->push(pAlloc, i + __builtin_ctz(bits));
+        }
+    }
+#endif
+
+    return nBounces + wallsScalar(pBalls, i, b.m_size, bo, pAlloc, paLost);
+}
+
+void
+integrateScalar(Balls* pBalls, u32 first, u32 last)
+{
+    Balls& b = *pBalls;
+
+    for (u32 i = first; i < last; ++i)
+    {
+        b.m_aPosX[i] += b.m_aDirX[i] * b.m_aStep[i];
+        b.m_aPosY[i] += b.m_aDirY[i] * b.m_aStep[i];
+    }
+}
+
+void
+integrate(Balls* pBalls, u32 first)
+{
+    Balls& b = *pBalls;
+    u32 i = first;
+
+#ifdef ADT_AVX2
+    for (; i + 8 <= b.m_size; i += 8)
+    {
+        const __m256 s = _mm256_loadu_ps(b.m_aStep + i);
+        _mm256_storeu_ps(b.m_aPosX + i, _mm256_add_ps(_mm256_loadu_ps(b.m_aPosX + i), _mm256_mul_ps(_mm256_loadu_ps(b.m_aDirX + i), s)));
+        _mm256_storeu_ps(b.m_aPosY + i, _mm256_add_ps(_mm256_loadu_ps(b.m_aPosY + i), _mm256_mul_ps(_mm256_loadu_ps(b.m_aDirY + i), s)));
+    }
+#endif
+
+#ifdef ADT_SSE4_2
+    for (; i + 4 <= b.m_size; i += 4)
+    {
+        const __m128 s = _mm_loadu_ps(b.m_aStep + i);
+        _mm_storeu_ps(b.m_aPosX + i, _mm_add_ps(_mm_loadu_ps(b.m_aPosX + i), _mm_mul_ps(_mm_loadu_ps(b.m_aDirX + i), s)));
+        _mm_storeu_ps(b.m_aPosY + i, _mm_add_ps(_mm_loadu_ps(b.m_aPosY + i), _mm_mul_ps(_mm_loadu_ps(b.m_aDirY + i), s)));
+    }
+#endif
+
+    integrateScalar(pBalls, i, b.m_size);
+}
+
+} /* namespace balls */
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "collision.hh"
+
+#include "adt/IAllocator.hh"
+#include "adt/Vec.hh"
+
+using namespace adt;
+
+/* Every ball in play, struct of arrays so the paddle, wall and integration kernels go over 8 (ADT_AVX2) or
+ * 4 (ADT_SSE4_2) balls at a time. Blocks go through collision::moveCircle(), but only for the balls that
+ * are close enough to a live block to touch one this tick (Grid::aNear), the rest just integrate. */
+namespace balls
+{
+
+struct Balls
+{
+    static constexpr u32 N_ARRAYS = 6;
+
+    /* */
+
+    IAllocator* m_pAlloc {};
+    f32* m_pMem {}; /* all arrays in one block */
+    f32* m_aPosX {};
+    f32* m_aPosY {};
+    f32* m_aDirX {}; /* unit */
+    f32* m_aDirY {};
+    f32* m_aSpeed {};
+    f32* m_aStep {}; /* this tick's distance, 0 for the ones moveCircle() took care of */
+    u32 m_size {};
+    u32 m_cap {};
+
+    /* */
+
+    Balls() = default;
+    Balls(IAllocator* pAlloc, u32 prealloc = 8) : m_pAlloc(pAlloc) { grow(prealloc); }
+
+    /* */
+
+    u32 push(math::V2 pos, math::V2 dir, f32 speed); /* dir gets normalized */
+    void swapRemove(u32 i);
+    void setSize(u32 size); /* only shrinks */
+    [[nodiscard]] math::V2 pos(u32 i) const { return {m_aPosX[i], m_aPosY[i]}; }
+    [[nodiscard]] math::V2 dir(u32 i) const { return {m_aDirX[i], m_aDirY[i]}; }
+    void setPos(u32 i, math::V2 pos) { m_aPosX[i] = pos.x, m_aPosY[i] = pos.y; }
+    void setDir(u32 i, math::V2 dir);
+    void destroy();
+
+    /* */
+
+private:
+    void grow(u32 cap);
+};
+
+/* Live blocks around each cell (3x3, itself included), cells centered on integer coordinates like
+ * collision::sweepGrid(). A ball that moves less than a cell per tick can't touch anything from a 0 cell. */
+struct Grid
+{
+    u8* m_aNear {};
+    s32 m_width {};
+    s32 m_height {};
+
+    /* */
+
+    void init(IAllocator* pAlloc, s32 width, s32 height); /* all 0, memory from pAlloc is not freed */
+    void add(s32 x, s32 y); /* block came alive */
+    void remove(s32 x, s32 y); /* block died */
+    [[nodiscard]] bool bNear(f32 x, f32 y) const;
+};
+
+struct Paddle
+{
+    f32 left {};
+    f32 right {};
+    f32 lineY {}; /* at or below: bounced back up, put on the line */
+    math::V2 dir {}; /* a tenth of it is added to the bounce */
+};
+
+struct Bounds
+{
+    f32 left {};
+    f32 right {};
+    f32 bottom {};
+    f32 top {};
+    bool bBounceBottom {}; /* otherwise lost below the bottom */
+};
+
+/* Kernels over [first, m_size). One bounce per ball and tick, checked in the order of the old single ball code. */
+u32 paddle(Balls* pBalls, u32 first, const Paddle& p); /* returns the number of hits */
+u32 walls(Balls* pBalls, u32 first, const Bounds& b, IAllocator* pAlloc, VecBase<u32>* paLost); /* bounces */
+void integrate(Balls* pBalls, u32 first); /* pos += dir * m_aStep */
+
+/* same thing one ball at a time, for tests and comparisons */
+u32 paddleScalar(Balls* pBalls, u32 first, u32 last, const Paddle& p);
+u32 wallsScalar(Balls* pBalls, u32 first, u32 last, const Bounds& b, IAllocator* pAlloc, VecBase<u32>* paLost);
+void integrateScalar(Balls* pBalls, u32 first, u32 last);
+
+struct StepStats
+{
+    u32 nPaddleHits {};
+    u32 nWallBounces {};
+    u32 nBlockHits {};
+    u32 nSwept {}; /* went through moveCircle() */
+    u32 nLost {}; /* removed, ball 0 is never removed */
+    bool bLost0 {};
+};
+
+/* A whole tick for [first, m_size): paddle, walls, blocks, integration. bSolid(x, y) and onHit(const GridHit&,
+ * collision::Move*) as in collision::moveCircle(), onHit is expected to keep the grid up to date.
+ * Lost balls are swap removed, except ball 0 which is only reported. pScratch holds the lost list for the tick. */
+template<typename SOLID_FN, typename HIT_FN>
+inline StepStats
+step(
+    Balls* pBalls, u32 first, f32 dt, f32 radius, u32 maxHits,
+    const Paddle& pad, const Bounds& bounds, const Grid& grid,
+    IAllocator* pScratch, SOLID_FN bSolid, HIT_FN onHit
+)
+{
+    StepStats st {};
+    Balls& b = *pBalls;
+
+    st.nPaddleHits = paddle(pBalls, first, pad);
+
+    VecBase<u32> aLost {};
+    st.nWallBounces = walls(pBalls, first, bounds, pScratch, &aLost);
+
+    /* back to front, swapping the last one in doesn't move any lost ball that is still to go */
+    for (ssize i = aLost.getSize() - 1; i >= 0; --i)
+    {
+        if (aLost[i] == 0) st.bLost0 = true;
+        else
+        {
+            b.swapRemove(aLost[i]);
+            ++st.nLost;
+        }
+    }
+
+    /* anything faster than a cell minus the radius per tick can reach past the 3x3 ring, always swept */
+    const f32 maxNearStep = 1.0f - radius;
+
+    for (u32 i = first; i < b.m_size; ++i)
+    {
+        const f32 dist = b.m_aSpeed[i] * dt;
+
+        if (dist <= maxNearStep && !grid.bNear(b.m_aPosX[i], b.m_aPosY[i]))
+        {
+            b.m_aStep[i] = dist;
+            continue;
+        }
+
+        collision::Move m {.pos = b.pos(i), .dir = b.dir(i), .dist = dist};
+        st.nBlockHits += collision::moveCircle(&m, radius, grid.m_width, grid.m_height, maxHits, bSolid, onHit);
+        ++st.nSwept;
+
+        b.setPos(i, m.pos);
+        b.m_aDirX[i] = m.dir.x;
+        b.m_aDirY[i] = m.dir.y;
+        b.m_aStep[i] = 0.0f;
+    }
+
+    integrate(pBalls, first);
+
+    return st;
+}
+
+} /* namespace balls */
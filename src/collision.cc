@@ -0,0 +1,99 @@
+#include "collision.hh"
+
+namespace collision
+{
+
+/* ray p + t*d against the circle at k, smallest t in [0, 1] */
+static bool
+rayCircle(math::V2 p, math::V2 d, math::V2 k, f32 r, f32* pT)
+{
+    const math::V2 f = p - k;
+    const f32 a = math::V2Dot(d, d);
+    const f32 b = math::V2Dot(f, d);
+    const f32 c = math::V2Dot(f, f) - r*r;
+
+    if (a <= 0.0f) return false;
+
+    const f32 disc = b*b - a*c;
+    if (disc < 0.0f) return false;
+
+    const f32 t = (-b - std::sqrt(disc)) / a;
+    if (t < 0.0f || t > 1.0f) return false;
+
+    *pT = t;
+    return true;
+}
+
+bool
+sweepCircleAABB(math::V2 p, math::V2 d, f32 r, math::V2 c, math::V2 h, Hit* pHit)
+{
+    const math::V2 rel = p - c;
+
+    /* already touching: push out along the shortest way, but only if the motion goes deeper */
+    const math::V2 closest = math::V2Clamp(rel, -h, h);
+    const math::V2 gap = rel - closest;
+    const f32 gap2 = math::V2Dot(gap, gap);
+    if (gap2 < r*r)
+    {
+        math::V2 n {};
+        if (gap2 > 0.0f) n = gap / std::sqrt(gap2);
+        else if (h.x - std::abs(rel.x) < h.y - std::abs(rel.y)) n = {rel.x < 0.0f ? -1.0f : 1.0f, 0.0f};
+        else n = {0.0f, rel.y < 0.0f ? -1.0f : 1.0f};
+
+        if (math::V2Dot(d, n) >= 0.0f) return false;
+
+        *pHit = {.t = 0.0f, .normal = n};
+        return true;
+    }
+
+    /* slabs of the box grown by r (the rounded corners are checked after) */
+    const math::V2 e = h + math::V2 {r, r};
+    f32 tEnter = -INFINITY, tExit = INFINITY;
+    math::V2 n {};
+
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        const f32 o = axis == 0 ? rel.x : rel.y;
+        const f32 v = axis == 0 ? d.x : d.y;
+        const f32 ext = axis == 0 ? e.x : e.y;
+
+        if (v == 0.0f)
+        {
+            if (o < -ext || o > ext) return false;
+            continue;
+        }
+
+        f32 t0 = (-ext - o) / v;
+        f32 t1 = (ext - o) / v;
+        if (t0 > t1) utils::swap(&t0, &t1);
+
+        if (t0 > tEnter)
+        {
+            tEnter = t0;
+            n = axis == 0 ? math::V2 {v > 0.0f ? -1.0f : 1.0f, 0.0f} : math::V2 {0.0f, v > 0.0f ? -1.0f : 1.0f};
+        }
+        tExit = utils::min(tExit, t1);
+    }
+
+    if (tEnter > tExit || tEnter > 1.0f || tExit < 0.0f) return false;
+
+    /* entering through a corner square of the grown box, the real shape there is the circle around the corner */
+    const math::V2 q = rel + d*utils::max(tEnter, 0.0f);
+    if (std::abs(q.x) > h.x && std::abs(q.y) > h.y)
+    {
+        const math::V2 k {q.x < 0.0f ? -h.x : h.x, q.y < 0.0f ? -h.y : h.y};
+
+        f32 t;
+        if (!rayCircle(rel, d, k, r, &t)) return false;
+
+        *pHit = {.t = t, .normal = math::V2Norm(rel + d*t - k)};
+        return true;
+    }
+
+    if (tEnter < 0.0f) return false; /* inside a face slab means touching, handled above */
+
+    *pHit = {.t = tEnter, .normal = n};
+    return true;
+}
+
+} /* namespace collision */
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "adt/math.hh"
+
+#include <cmath>
+
+using namespace adt;
+
+/* Continuous ball collision: a moving circle is swept against boxes so nothing is skipped between ticks,
+ * however far the ball moves in one of them. */
+namespace collision
+{
+
+constexpr f32 SKIN = 1e-4f; /* contacts are pushed this far out, the next sweep starts clear of the box */
+
+struct Hit
+{
+    f32 t {}; /* [0, 1] of the motion */
+    math::V2 normal {}; /* unit, from the box towards the circle */
+};
+
+struct GridHit : Hit
+{
+    s32 x {};
+    s32 y {};
+};
+
+/* circle of radius r at p moving by d against the box centered at c with half size h.
+ * Starting inside counts as a hit at t = 0 only when moving further in. */
+[[nodiscard]] bool sweepCircleAABB(math::V2 p, math::V2 d, f32 r, math::V2 c, math::V2 h, Hit* pHit);
+
+[[nodiscard]] inline math::V2
+reflect(math::V2 v, math::V2 n)
+{
+    return v - n * (2.0f * math::V2Dot(v, n));
+}
+
+/* Unit cells centered on integer coordinates (like the blocks), [0, width) x [0, height).
+ * Walks the cells under the center of the circle (DDA) and sweeps the 3x3 ring around each, which covers
+ * everything a circle with r <= 0.5 can touch. Cells further along can't be hit earlier, so the walk stops
+ * as soon as the best hit comes before the next cell. bSolid(x, y) is only asked about cells in the grid. */
+template<typename SOLID_FN>
+[[nodiscard]] inline bool
+sweepGrid(math::V2 p, math::V2 d, f32 r, s32 width, s32 height, SOLID_FN bSolid, GridHit* pHit)
+{
+    assert(r <= 0.5f);
+
+    s32 ix = s32(std::floor(p.x + 0.5f));
+    s32 iy = s32(std::floor(p.y + 0.5f));
+
+    const s32 stepX = d.x > 0.0f ? 1 : -1;
+    const s32 stepY = d.y > 0.0f ? 1 : -1;
+    const f32 tDeltaX = d.x != 0.0f ? 1.0f / std::abs(d.x) : INFINITY;
+    const f32 tDeltaY = d.y != 0.0f ? 1.0f / std::abs(d.y) : INFINITY;
+    f32 tMaxX = d.x != 0.0f ? (f32(ix) + 0.5f*stepX - p.x) / d.x : INFINITY;
+    f32 tMaxY = d.y != 0.0f ? (f32(iy) + 0.5f*stepY - p.y) / d.y : INFINITY;
+
+    GridHit best {};
+    best.t = INFINITY;
+
+    auto test = [&](s32 x, s32 y) {
+        if (x < 0 || x >= width || y < 0 || y >= height || !bSolid(x, y)) return;
+
+        Hit h;
+        if (sweepCircleAABB(p, d, r, {f32(x), f32(y)}, {0.5f, 0.5f}, &h) && h.t < best.t)
+        {
+            best.t = h.t;
+            best.normal = h.normal;
+            best.x = x;
+            best.y = y;
+        }
+    };
+
+    /* whole ring first, then each step only brings in the 3 cells on its leading side */
+    for (s32 y = iy - 1; y <= iy + 1; ++y)
+        for (s32 x = ix - 1; x <= ix + 1; ++x)
+            test(x, y);
+
+    for (;;)
+    {
+        const f32 tNext = utils::min(tMaxX, tMaxY);
+        if (tNext > 1.0f || best.t <= tNext) break;
+
+        /* past the grid on the way out, nothing else to hit */
+        if ((ix < -1 && stepX < 0) || (ix > width && stepX > 0) || (iy < -1 && stepY < 0) || (iy > height && stepY > 0))
+            break;
+
+        if (tMaxX < tMaxY)
+        {
+            ix += stepX;
+            tMaxX += tDeltaX;
+            for (s32 y = iy - 1; y <= iy + 1; ++y) test(ix + stepX, y);
+        }
+        else
+        {
+            iy += stepY;
+            tMaxY += tDeltaY;
+            for (s32 x = ix - 1; x <= ix + 1; ++x) test(x, iy + stepY);
+        }
+    }
+
+    if (best.t > 1.0f) return false;
+
+    *pHit = best;
+    return true;
+}
+
+/* what's left of a tick's motion */
+struct Move
+{
+    math::V2 pos {};
+    math::V2 dir {}; /* unit */
+    f32 dist {};
+};
+
+/* Moves the circle through the grid, bouncing off every solid cell on the way, at most maxHits times.
+ * onHit(const GridHit&, Move*) runs after each bounce, dir is already reflected, the cell can go non solid and
+ * dir can be changed. When maxHits runs out the circle stays at the last contact. Returns the number of hits. */
+template<typename SOLID_FN, typename HIT_FN>
+inline u32
+moveCircle(Move* pMove, f32 r, s32 width, s32 height, u32 maxHits, SOLID_FN bSolid, HIT_FN onHit)
+{
+    u32 nHits = 0;
+
+    while (pMove->dist > 0.0f)
+    {
+        const math::V2 d = pMove->dir * pMove->dist;
+
+        GridHit hit;
+        if (!sweepGrid(pMove->pos, d, r, width, height, bSolid, &hit))
+        {
+            pMove->pos += d;
+            pMove->dist = 0.0f;
+            break;
+        }
+
+        pMove->pos += d*hit.t + hit.normal*SKIN;
+        pMove->dist *= 1.0f - hit.t;
+        pMove->dir = reflect(pMove->dir, hit.normal);
+
+        onHit(hit, pMove);
+
+        if (++nHits >= maxHits)
+        {
+            pMove->dist = 0.0f;
+            break;
+        }
+    }
+
+    return nHits;
+}
+
+} /* namespace collision */
@@ -1,11 +1,14 @@
 #include "controls.hh"
 
+#include "adt/AllocStats.hh"
 #include "adt/logs.hh"
+#include "adt/prof.hh"
 #include "app.hh"
 #include "game.hh"
 #include "keybinds.hh"
 
 #include <cmath>
+#include <cstring>
 
 namespace controls
 {
@@ -163,6 +166,14 @@ releaseBall()
 
     utils::toggle(&game::g_ball.bReleased);
     enBall.dir = math::V2{0.0f, 1.0f} + math::V2{enPlayer.dir * 0.25f};
+    game::g_balls.setDir(0, enBall.dir);
+}
+
+void
+spawnBalls(long n)
+{
+    game::spawnBalls(u32(n));
+    LOG_NOTIFY("balls: {}\n", game::g_balls.m_size);
 }
 
 void
@@ -179,4 +190,48 @@ toggleStepDebug()
     LOG_NOTIFY("g_bStepDebug: {}\n", g_bStepDebug);
 }
 
+void
+writeTrace()
+{
+#ifdef ADT_PROF
+    [[maybe_unused]] const s64 t0 = utils::timeNowUS();
+    [[maybe_unused]] const ssize nZones = prof::writeChromeTrace("trace.json");
+    if (nZones < 0) LOG_WARN("failed to write 'trace.json'\n");
+    else LOG_NOTIFY("trace.json: {} zones in {} us\n", nZones, utils::timeNowUS() - t0);
+#else
+    LOG_NOTIFY("built without ADT_PROF (OPT_PROF), no zones to write\n");
+#endif
+}
+
+u16
+replayKeysMask()
+{
+    static_assert(utils::size(keybinds::inl_aReplayKeys) <= 16);
+
+    u16 mask = 0;
+    for (u32 i = 0; i < utils::size(keybinds::inl_aReplayKeys); ++i)
+        if (g_aPressedKeys[keybinds::inl_aReplayKeys[i]]) mask |= 1 << i;
+
+    return mask;
+}
+
+void
+setReplayKeys(u16 mask)
+{
+    memset(g_aPressedKeys, 0, sizeof(g_aPressedKeys));
+
+    for (u32 i = 0; i < utils::size(keybinds::inl_aReplayKeys); ++i)
+        g_aPressedKeys[keybinds::inl_aReplayKeys[i]] = mask & (1 << i);
+}
+
+void
+printAllocStats()
+{
+#ifdef ADT_ALLOC_STATS
+    allocStatsReport(stderr);
+#else
+    LOG_NOTIFY("built without ADT_ALLOC_STATS (OPT_ALLOC_STATS), nothing to print\n");
+#endif
+}
+
 } /* namespace controls */
@@ -66,7 +66,15 @@ void quit();
 void toggleFullscreen();
 void toggleVSync();
 void releaseBall();
+void spawnBalls(long n);
 void toggleDebugScreen();
 void toggleStepDebug();
+void writeTrace();
+void printAllocStats();
+
+/* keybinds::inl_aReplayKeys as bits */
+[[nodiscard]] u16 replayKeysMask();
+/* replay keys from the mask, every other key up */
+void setReplayKeys(u16 mask);
 
 } /* namespace controls */
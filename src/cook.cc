@@ -0,0 +1,359 @@
+#include "cook.hh"
+
+#include "adt/Arena.hh"
+#include "adt/OsAllocator.hh"
+#include "adt/defer.hh"
+#include "adt/file.hh"
+#include "adt/hash.hh"
+#include "adt/logs.hh"
+#include "adt/print.hh"
+#include "adt/prof.hh"
+#include "adt/utils.hh"
+#include "image.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef __linux__
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#elif _WIN32
+    #include <direct.h>
+    #include <windows.h>
+#endif
+
+namespace cook
+{
+
+static bool
+statFile(const char* ntsPath, u64* pSize, s64* pMTime)
+{
+#ifdef _WIN32
+    struct _stat64 st {};
+    if (_stat64(ntsPath, &st) != 0) return false;
+#else
+    struct stat st {};
+    if (stat(ntsPath, &st) != 0) return false;
+#endif
+
+    *pSize = u64(st.st_size);
+    *pMTime = s64(st.st_mtime);
+    return true;
+}
+
+static void
+makeCookedDir()
+{
+    char aBuff[64] {};
+    print::toBuffer(aBuff, sizeof(aBuff) - 1, "{}", COOKED_DIR);
+
+#ifdef _WIN32
+    _mkdir(aBuff);
+#else
+    mkdir(aBuff, 0755); /* EEXIST is fine */
+#endif
+}
+
+static u64
+hashFile(const String sFile)
+{
+    return hash::xxh64::hash(sFile.data(), sFile.getSize(), 0);
+}
+
+ssize
+cookedPathExt(char* pBuff, ssize buffSize, String sSrcPath, String sSuffix)
+{
+    /* leave room for '\0' */
+    const ssize cap = buffSize - 1;
+
+    ssize n = print::toBuffer(pBuff, cap, "{}/", COOKED_DIR);
+    for (char c : sSrcPath)
+    {
+        if (n >= cap) break;
+        pBuff[n++] = (c == '/' || c == '\\' || c == ':') ? '_' : c;
+    }
+    n += print::toBuffer(pBuff + n, cap - n, "{}", sSuffix);
+    pBuff[n] = '\0';
+
+    return n;
+}
+
+ssize
+cookedPath(char* pBuff, ssize buffSize, String sSrcPath, bool bFlip)
+{
+    return cookedPathExt(pBuff, buffSize, sSrcPath, bFlip ? ".flip.btex" : ".btex");
+}
+
+bool
+writeFile(const char* ntsPath, const void* pData, u64 size)
+{
+    makeCookedDir();
+
+    char aTmpPath[256] {};
+    print::toBuffer(aTmpPath, sizeof(aTmpPath) - 1, "{}.tmp", ntsPath);
+
+    {
+        FILE* pf = fopen(aTmpPath, "wb");
+        if (!pf)
+        {
+            LOG_WARN("unable to write '{}'\n", aTmpPath);
+            return false;
+        }
+        defer( fclose(pf) );
+
+        if (fwrite(pData, 1, size, pf) != size)
+        {
+            LOG_WARN("short write: '{}'\n", aTmpPath);
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    remove(ntsPath);
+#endif
+    if (rename(aTmpPath, ntsPath) != 0)
+    {
+        LOG_WARN("rename('{}', '{}') failed\n", aTmpPath, ntsPath);
+        remove(aTmpPath);
+        return false;
+    }
+
+    return true;
+}
+
+void
+downsampleRGBA(u8* pDst, const u8* pSrc, u32 srcWidth, u32 srcHeight)
+{
+    const u32 width = utils::max(srcWidth / 2, 1u);
+    const u32 height = utils::max(srcHeight / 2, 1u);
+
+    for (u32 y = 0; y < height; ++y)
+    {
+        const u32 y0 = utils::min(y*2, srcHeight - 1);
+        const u32 y1 = utils::min(y*2 + 1, srcHeight - 1);
+
+        for (u32 x = 0; x < width; ++x)
+        {
+            const u32 x0 = utils::min(x*2, srcWidth - 1);
+            const u32 x1 = utils::min(x*2 + 1, srcWidth - 1);
+
+            for (u32 c = 0; c < 4; ++c)
+            {
+                const u32 sum = pSrc[(y0*srcWidth + x0)*4 + c] + pSrc[(y0*srcWidth + x1)*4 + c] +
+                    pSrc[(y1*srcWidth + x0)*4 + c] + pSrc[(y1*srcWidth + x1)*4 + c];
+
+                pDst[(y*width + x)*4 + c] = u8((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+bool
+cookImage(IAllocator* pScratch, String sSrcPath, bool bFlip, CookStats* pStats)
+{
+    CookStats stats {};
+    defer( if (pStats) *pStats = stats );
+
+    s64 t0 = utils::timeNowUS();
+
+    Opt<String> rsFile = file::load(pScratch, sSrcPath);
+    if (!rsFile) return false;
+
+    const String sFile = rsFile.value();
+    Header h {
+        .magic = COOKED_MAGIC,
+        .version = COOKED_VERSION,
+        .srcHash = hashFile(sFile),
+        .nChannels = 4,
+        .bFlipped = bFlip,
+    };
+
+    if (!statFile(sSrcPath.data(), &h.srcSize, &h.srcMTime))
+        return false;
+
+    texture::Data img = texture::decodeImage(pScratch, sFile, bFlip);
+    if (img.width == 0) return false;
+
+    h.width = img.width;
+    h.height = img.height;
+
+    s64 t1 = utils::timeNowUS();
+
+    /* lay out the whole chain down to 1x1 */
+    u64 offset = align(sizeof(Header), LEVEL_ALIGNMENT);
+    u32 w = h.width, hh = h.height;
+    for (h.nMips = 0; h.nMips < MAX_MIPS; )
+    {
+        h.aMips[h.nMips++] = {.offset = offset, .width = w, .height = hh};
+        offset = align(offset + u64(w)*hh*4, LEVEL_ALIGNMENT);
+
+        if (w == 1 && hh == 1) break;
+        w = utils::max(w / 2, 1u);
+        hh = utils::max(hh / 2, 1u);
+    }
+
+    const u64 fileSize = offset;
+    u8* pOut = (u8*)pScratch->zalloc(fileSize, 1);
+    memcpy(pOut, &h, sizeof(h));
+    memcpy(pOut + h.aMips[0].offset, img.aData.data(), usize(h.width)*h.height*4);
+
+    for (u32 i = 1; i < h.nMips; ++i)
+    {
+        const auto& prev = h.aMips[i - 1];
+        downsampleRGBA(pOut + h.aMips[i].offset, pOut + prev.offset, prev.width, prev.height);
+    }
+
+    s64 t2 = utils::timeNowUS();
+
+    char aPath[256] {};
+    cookedPath(aPath, sizeof(aPath), sSrcPath, bFlip);
+
+    if (!writeFile(aPath, pOut, fileSize)) return false;
+
+    s64 t3 = utils::timeNowUS();
+
+    stats = {
+        .srcBytes = u64(sFile.getSize()),
+        .cookedBytes = fileSize,
+        .decodeUS = t1 - t0,
+        .mipsUS = t2 - t1,
+        .writeUS = t3 - t2,
+    };
+
+    return true;
+}
+
+Mapping
+mapFile(const char* ntsPath)
+{
+    Mapping ret {};
+
+#ifdef __linux__
+    int fd = open(ntsPath, O_RDONLY);
+    if (fd < 0) return {};
+    defer( close(fd) );
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) return {};
+
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) return {};
+
+    ret.m_pData = (const u8*)p;
+    ret.m_size = usize(st.st_size);
+#elif _WIN32
+    HANDLE hFile = CreateFileA(ntsPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) return {};
+    defer( CloseHandle(hFile) );
+
+    LARGE_INTEGER size {};
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart <= 0) return {};
+
+    HANDLE hMap = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!hMap) return {};
+
+    void* p = MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+    if (!p)
+    {
+        CloseHandle(hMap);
+        return {};
+    }
+
+    ret.m_pData = (const u8*)p;
+    ret.m_size = usize(size.QuadPart);
+    ret.m_pHandle = hMap;
+#endif
+
+    return ret;
+}
+
+void
+Mapping::unmap()
+{
+    if (!m_pData) return;
+
+#ifdef __linux__
+    munmap((void*)m_pData, m_size);
+#elif _WIN32
+    UnmapViewOfFile(m_pData);
+    CloseHandle((HANDLE)m_pHandle);
+#endif
+
+    *this = {};
+}
+
+Mapping
+mapCooked(String sSrcPath, bool bFlip)
+{
+    char aPath[256] {};
+    cookedPath(aPath, sizeof(aPath), sSrcPath, bFlip);
+
+    Mapping m = mapFile(aPath);
+    if (!m) return {};
+
+    auto bad = [&](const char* ntsWhy) {
+#ifdef D_TEXTURE
+        LOG_WARN("'{}': {}\n", aPath, ntsWhy);
+#endif
+        (void)ntsWhy;
+        m.unmap();
+        return Mapping {};
+    };
+
+    if (m.m_size < sizeof(Header)) return bad("truncated header");
+
+    const Header& h = m.header();
+    if (h.magic != COOKED_MAGIC || h.version != COOKED_VERSION) return bad("wrong magic/version");
+    if (h.nMips == 0 || h.nMips > MAX_MIPS || h.nChannels != 4) return bad("bad header");
+    if (bool(h.bFlipped) != bFlip) return bad("flip mismatch");
+
+    const auto& last = h.aMips[h.nMips - 1];
+    if (last.offset + u64(last.width)*last.height*4 > m.m_size) return bad("truncated payload");
+
+    u64 srcSize = 0;
+    s64 srcMTime = 0;
+    if (!statFile(sSrcPath.data(), &srcSize, &srcMTime))
+        return m; /* shipped without sources, cooked file is all we have */
+
+    if (srcSize == h.srcSize && srcMTime == h.srcMTime) return m;
+
+    /* touched, but maybe not changed */
+    Arena arena(srcSize + 64);
+    defer( arena.freeAll() );
+
+    Opt<String> rsFile = file::load(&arena, sSrcPath);
+    if (!rsFile || hashFile(rsFile.value()) != h.srcHash) return bad("source changed");
+
+    return m;
+}
+
+THREAD_STATUS
+CookSubmit(void* pArg)
+{
+    PROFILE_SCOPE("CookSubmit");
+
+    auto* a = (CookArg*)pArg;
+
+    if (!a->bForce)
+    {
+        Mapping m = mapCooked(a->sPath, a->bFlip);
+        if (m)
+        {
+            m.unmap();
+            a->bOk = a->bSkipped = true;
+            return {};
+        }
+    }
+
+    Arena arena(SIZE_1M);
+    arena.setStats(allocStatsGet("cook:CookSubmit"));
+    defer( arena.freeAll() );
+
+    a->bOk = cookImage(&arena, a->sPath, a->bFlip, &a->stats);
+
+    return {};
+}
+
+} /* namespace cook */
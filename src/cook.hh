@@ -0,0 +1,102 @@
+#pragma once
+
+#include "adt/IAllocator.hh"
+#include "adt/String.hh"
+#include "adt/Thread.hh"
+
+using namespace adt;
+
+/* Offline (or first run) texture cooking.
+ * Source images are decoded once, converted to RGBA8 with a cpu generated mip chain and written to COOKED_DIR.
+ * Warm loads mmap the cooked file and upload the levels as is. */
+namespace cook
+{
+
+constexpr String COOKED_DIR = "cooked";
+constexpr u32 COOKED_MAGIC = 0x58544b42; /* "BKTX" */
+constexpr u32 COOKED_VERSION = 1;
+constexpr u32 MAX_MIPS = 16;
+constexpr u32 LEVEL_ALIGNMENT = 16;
+
+struct MipLevel
+{
+    u64 offset {}; /* from the start of the file */
+    u32 width {};
+    u32 height {};
+};
+
+struct Header
+{
+    u32 magic {};
+    u32 version {};
+    u64 srcHash {}; /* xxh64 of the whole source file */
+    u64 srcSize {};
+    s64 srcMTime {}; /* when size and mtime match the source isn't rehashed */
+    u32 width {};
+    u32 height {};
+    u32 nChannels {}; /* always 4 (RGBA8) */
+    u32 nMips {};
+    u32 bFlipped {};
+    u32 _pad {};
+    MipLevel aMips[MAX_MIPS] {};
+};
+
+/* read only view of a cooked file */
+struct Mapping
+{
+    const u8* m_pData {};
+    usize m_size {};
+    void* m_pHandle {}; /* win32 file mapping */
+
+    /* */
+
+    explicit operator bool() const { return m_pData != nullptr; }
+
+    const Header& header() const { return *(const Header*)m_pData; }
+    const u8* level(u32 i) const { return m_pData + header().aMips[i].offset; }
+
+    void unmap();
+};
+
+struct CookStats
+{
+    u64 srcBytes {};
+    u64 cookedBytes {};
+    s64 decodeUS {};
+    s64 mipsUS {};
+    s64 writeUS {};
+};
+
+/* e.g. "test-assets/ball.bmp" -> "cooked/test-assets_ball.bmp.btex" */
+ssize cookedPath(char* pBuff, ssize buffSize, String sSrcPath, bool bFlip);
+/* same with any ending, e.g. ".bmesh" */
+ssize cookedPathExt(char* pBuff, ssize buffSize, String sSrcPath, String sSuffix);
+
+/* whole file, read only, empty Mapping on failure (header() is only meaningful for textures) */
+[[nodiscard]] Mapping mapFile(const char* ntsPath);
+
+/* into COOKED_DIR through a temporary and rename(), concurrent readers never see half a file */
+bool writeFile(const char* ntsPath, const void* pData, u64 size);
+
+/* decode the source, build mips and write the cooked file, false on failure */
+bool cookImage(IAllocator* pScratch, String sSrcPath, bool bFlip, CookStats* pStats = nullptr);
+
+/* empty Mapping if there is no cooked file or it's stale */
+[[nodiscard]] Mapping mapCooked(String sSrcPath, bool bFlip);
+
+/* 2x2 box filter into half size (rounded down, min 1), odd edges reuse the last row/column */
+void downsampleRGBA(u8* pDst, const u8* pSrc, u32 srcWidth, u32 srcHeight);
+
+struct CookArg
+{
+    String sPath {};
+    bool bFlip {};
+    bool bForce {}; /* cook even if the cooked file is up to date */
+    bool bOk {};
+    bool bSkipped {};
+    CookStats stats {};
+};
+
+THREAD_STATUS CookSubmit(void* pArg);
+
+} /* namespace cook */
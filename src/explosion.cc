@@ -0,0 +1,57 @@
+#include "explosion.hh"
+
+#include <cstring>
+
+namespace explosion
+{
+
+void
+Chain::init(IAllocator* pAlloc, u32 width, u32 height)
+{
+    m_pAlloc = pAlloc;
+    m_width = width;
+    m_height = height;
+    m_rowWords = (width + 63) / 64;
+
+    /* bits past the width stay 0, nothing spills from one row into the next */
+    const usize nWords = usize(m_rowWords) * height;
+    m_aLive = (u64*)pAlloc->zalloc(nWords, sizeof(u64));
+    m_aChains = (u64*)pAlloc->zalloc(nWords, sizeof(u64));
+    m_aVisited = (u64*)pAlloc->zalloc(nWords, sizeof(u64));
+
+    /* grows on the first long chain and stays that way */
+    m_qExploding = QueueBase<Pending>(pAlloc, 64);
+}
+
+void
+Chain::add(u32 x, u32 y, bool bChains)
+{
+    ADT_ASSERT(x < m_width && y < m_height, "(%u, %u) is outside of %u x %u", x, y, m_width, m_height);
+
+    const u32 i = y*m_rowWords + x/64;
+    const u64 bit = u64(1) << (x & 63);
+
+    m_aLive[i] |= bit;
+    if (bChains) m_aChains[i] |= bit;
+    else m_aChains[i] &= ~bit;
+}
+
+void
+Chain::remove(u32 x, u32 y)
+{
+    ADT_ASSERT(x < m_width && y < m_height, "(%u, %u) is outside of %u x %u", x, y, m_width, m_height);
+
+    const u32 i = y*m_rowWords + x/64;
+    const u64 bit = u64(1) << (x & 63);
+
+    m_aLive[i] &= ~bit;
+    m_aChains[i] &= ~bit;
+}
+
+void
+Chain::clearVisited(u32 firstRow, u32 lastRow)
+{
+    memset(m_aVisited + usize(firstRow)*m_rowWords, 0, usize(lastRow - firstRow + 1) * m_rowWords * sizeof(u64));
+}
+
+} /* namespace explosion */
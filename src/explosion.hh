@@ -0,0 +1,158 @@
+#pragma once
+
+#include "adt/IAllocator.hh"
+#include "adt/Queue.hh"
+#include "adt/utils.hh"
+
+using namespace adt;
+
+/* Chain reactions on the level grid: an exploding cell hits the live blocks around it (8 neighbors), the hit ones
+ * that chain explode next. Breadth first with an explicit queue, so a chain is only as long as memory allows, not the
+ * stack. Which cells are live and which chain is kept here as bits (like balls::Grid, the owner keeps it up to date),
+ * so the queue holds 64 cells of a row at a time and their neighbors are a few word operations.
+ * The visited bits and the queue stay between explosions, once the queue has grown to the longest chain so far
+ * nothing is allocated. */
+namespace explosion
+{
+
+/* cells of one word that explode together */
+struct Pending
+{
+    u32 row {};
+    u32 word {};
+    u64 mask {};
+};
+
+struct Chain
+{
+    IAllocator* m_pAlloc {};
+    u64* m_aLive {}; /* m_rowWords per row, bit x & 63 of word x / 64 */
+    u64* m_aChains {};
+    u64* m_aVisited {}; /* all 0 outside of run() */
+    QueueBase<Pending> m_qExploding {};
+    u32 m_width {};
+    u32 m_height {};
+    u32 m_rowWords {};
+
+    /* */
+
+    void init(IAllocator* pAlloc, u32 width, u32 height); /* all empty, nothing is freed, meant for a per level arena */
+    void add(u32 x, u32 y, bool bChains); /* block came alive */
+    void remove(u32 x, u32 y); /* block died */
+
+    /* (x, y) explodes whatever is there. onHit(x, y) runs once for every live block hit ((x, y) included),
+     * it may remove() them. Returns the number of hits. */
+    template<typename HIT_FN>
+    u32 run(u32 x, u32 y, HIT_FN onHit);
+
+    /* */
+
+private:
+    /* mHit (live, not hit yet) are hit and mExplodes go off. What goes off takes its chaining run along the row
+     * with it, the run's neighbors in the row are hit as well and the run is queued for the rows around it */
+    template<typename HIT_FN>
+    u32 hitRun(u32 row, u32 word, u64 mHit, u64 mExplodes, HIT_FN& onHit);
+
+    /* whatever in mask is live and not hit yet */
+    template<typename HIT_FN>
+    u32 hitWord(u32 row, u32 word, u64 mask, HIT_FN& onHit);
+
+    void clearVisited(u32 firstRow, u32 lastRow);
+};
+
+/* seeds spread both ways along the runs of set bits in p they are in (Kogge-Stone occluded fill) */
+[[nodiscard]] inline u64
+fillRuns(u64 seeds, u64 p)
+{
+    u64 up = seeds, pu = p;
+    up |= pu & (up << 1); pu &= pu << 1;
+    up |= pu & (up << 2); pu &= pu << 2;
+    up |= pu & (up << 4); pu &= pu << 4;
+    up |= pu & (up << 8); pu &= pu << 8;
+    up |= pu & (up << 16); pu &= pu << 16;
+    up |= pu & (up << 32);
+
+    u64 down = seeds, pd = p;
+    down |= pd & (down >> 1); pd &= pd >> 1;
+    down |= pd & (down >> 2); pd &= pd >> 2;
+    down |= pd & (down >> 4); pd &= pd >> 4;
+    down |= pd & (down >> 8); pd &= pd >> 8;
+    down |= pd & (down >> 16); pd &= pd >> 16;
+    down |= pd & (down >> 32);
+
+    return up | down;
+}
+
+template<typename HIT_FN>
+inline u32
+Chain::hitRun(u32 row, u32 word, u64 mHit, u64 mExplodes, HIT_FN& onHit)
+{
+    const u32 i = row*m_rowWords + word;
+
+    if (mExplodes)
+    {
+        const u64 mFree = m_aLive[i] & ~m_aVisited[i];
+        mExplodes = fillRuns(mExplodes, (mFree & m_aChains[i]) | mExplodes);
+        mHit |= (mExplodes | (mExplodes << 1) | (mExplodes >> 1)) & mFree;
+
+        m_qExploding.pushBack(m_pAlloc, {row, word, mExplodes});
+    }
+
+    /* chains were read already, onHit() can remove() */
+    m_aVisited[i] |= mHit | mExplodes;
+    for (u64 m = mHit; m; m &= m - 1)
+        onHit(word*64 + __builtin_ctzll(m), row);
+
+    return __builtin_popcountll(mHit);
+}
+
+template<typename HIT_FN>
+inline u32
+Chain::hitWord(u32 row, u32 word, u64 mask, HIT_FN& onHit)
+{
+    const u32 i = row*m_rowWords + word;
+    const u64 mHit = mask & m_aLive[i] & ~m_aVisited[i];
+    if (!mHit) return 0;
+
+    return hitRun(row, word, mHit, mHit & m_aChains[i], onHit);
+}
+
+template<typename HIT_FN>
+inline u32
+Chain::run(u32 x, u32 y, HIT_FN onHit)
+{
+    ADT_ASSERT(x < m_width && y < m_height, "(%u, %u) is outside of %u x %u", x, y, m_width, m_height);
+
+    const u64 startBit = u64(1) << (x & 63);
+    const bool bStartLive = m_aLive[y*m_rowWords + x/64] & startBit;
+    u32 nHits = hitRun(y, x/64, bStartLive ? startBit : 0, startBit, onHit);
+    u32 minRow = y, maxRow = y;
+
+    while (!m_qExploding.empty())
+    {
+        const Pending p = *m_qExploding.popFront();
+
+        /* the row itself was done when the run was queued, what's left is above, below and the words on the sides */
+        const u64 mMid = p.mask | (p.mask << 1) | (p.mask >> 1);
+        const u64 mLeft = p.word > 0 ? p.mask << 63 : 0;
+        const u64 mRight = p.word + 1 < m_rowWords ? p.mask >> 63 : 0;
+
+        const u32 y0 = p.row > 0 ? p.row - 1 : 0;
+        const u32 y1 = p.row + 1 < m_height ? p.row + 1 : p.row;
+        minRow = utils::min(minRow, y0);
+        maxRow = utils::max(maxRow, y1);
+
+        for (u32 row = y0; row <= y1; ++row)
+        {
+            if (row != p.row) nHits += hitWord(row, p.word, mMid, onHit);
+            if (mLeft) nHits += hitWord(row, p.word - 1, mLeft, onHit);
+            if (mRight) nHits += hitWord(row, p.word + 1, mRight, onHit);
+        }
+    }
+
+    clearVisited(minRow, maxRow);
+
+    return nHits;
+}
+
+} /* namespace explosion */
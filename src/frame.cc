@@ -1,11 +1,23 @@
 #include "frame.hh"
 
 #include "adt/Arena.hh"
+#include "adt/Thread.hh"
+#include "adt/TripleBuffer.hh"
 #include "adt/defer.hh"
+#include "adt/guard.hh"
+#include "adt/logs.hh"
+#include "adt/OsAllocator.hh"
+#include "adt/prof.hh"
 #include "app.hh"
 #include "colors.hh"
 #include "controls.hh"
 #include "game.hh"
+#include "gl/state.hh"
+#include "replay.hh"
+#include "texture.hh"
+
+#include <atomic>
+#include <cstring>
 
 #ifndef NDEBUG
     #include "test.hh"
@@ -35,6 +47,48 @@ int g_nfps = 0;
 
 Ubo g_uboProjView;
 
+FrameStats g_frameStats;
+Percentiles g_tickPercentiles;
+Percentiles g_inputPercentiles;
+static u64 s_nBenchFrames = 0; /* --bench-frames N, 0: run until quit */
+
+/* ticks the main thread can fall behind before it loses their intervals */
+constexpr u32 TICK_HISTORY = 64;
+
+/* one published tick */
+struct SimFrame
+{
+    game::Snapshot snap {};
+    u64 tick {}; /* ticks so far */
+    s64 timeUS {}; /* when it was taken */
+    s64 inputUS {}; /* newest key state change the tick saw */
+    f64 simMS {}; /* updateState() time so far */
+    f32 aTickMS[TICK_HISTORY] {}; /* interval before tick t at t % TICK_HISTORY, 0: none (first one, paused) */
+};
+
+/* kept by whichever thread ticks */
+struct SimClock
+{
+    s64 prevTickUS {};
+    u64 nTicks {};
+    f64 simMS {};
+    f32 aTickMS[TICK_HISTORY] {};
+};
+
+static TripleBuffer<SimFrame> s_simFrames;
+static std::atomic<s64> s_lastInputUS {};
+
+static const char* s_ntsRecordPath = nullptr; /* --record FILE */
+static bool s_bSimThread = false; /* --sim-thread */
+static f64 s_slowRenderMS = 0.0; /* --slow-render MS, sleep after draw */
+
+/* sim thread mode */
+static Mutex s_mtxSim(MUTEX_TYPE::PLAIN); /* game state between procKeys() and the ticks */
+static std::atomic<bool> s_bSimRunning {};
+static std::atomic<bool> s_bSimPaused {};
+static std::atomic<bool> s_bSimStepDebug {};
+static std::atomic<bool> s_bSimStep {}; /* step debug: one tick per drawn frame */
+
 static void
 updateDrawTime()
 {
@@ -58,6 +112,10 @@ run()
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
     glDebugMessageCallback(gl::debugCallback, app::g_pWindow);
 
+    /* --gl-check: verify the state cache against glGet* */
+    for (int i = 1; i < app::g_argc; ++i)
+        if (String(app::g_argv[i]) == "--gl-check") gl::g_bStateCrossCheck = true;
+
     /*glPointSize(2.0f);*/
     /*glLineWidth(2.0f);*/
 #endif
@@ -73,24 +131,79 @@ run()
     glClearColor(col.r, col.g, col.b, col.a);
 
     g_uboProjView.createBuffer(sizeof(math::M4)*2, GL_DYNAMIC_DRAW);
+    texture::g_uploadQueue.createBuffer(4, SIZE_1M * 4);
 
     updateDrawTime();
     updateDrawTime();
 
-    app::g_pWindow->setSwapInterval(1);
+    /* --bench-frames N: no vsync, quit after N frames and print the timings as csv.
+     * --sim-thread: tick on a separate thread, draw the latest published tick.
+     * --slow-render MS: sleep MS after each draw.
+     * --record FILE: log the replay keys and a hash per tick, written on quit.
+     * --bench-tests: debug builds, the startup tests also run their benchmarks */
+    for (int i = 1; i < app::g_argc; ++i)
+    {
+        const String sArg = app::g_argv[i];
+        const bool bHasNext = i + 1 < app::g_argc;
+
+        if (sArg == "--bench-frames" && bHasNext)
+            s_nBenchFrames = strtoull(app::g_argv[i + 1], nullptr, 10);
+        else if (sArg == "--slow-render" && bHasNext)
+            s_slowRenderMS = strtod(app::g_argv[i + 1], nullptr);
+        else if (sArg == "--record" && bHasNext)
+            s_ntsRecordPath = app::g_argv[i + 1];
+        else if (sArg == "--sim-thread")
+            s_bSimThread = true;
+#ifndef NDEBUG
+        else if (sArg == "--bench-tests")
+            test::g_bBench = true;
+#endif
+    }
+
+    if (s_nBenchFrames > 0)
+    {
+        g_frameStats.keepHistory(OsAllocatorGet());
+        app::g_pWindow->setSwapInterval(0);
+    }
+    else app::g_pWindow->setSwapInterval(1);
 
 #ifndef NDEBUG
     test::math();
     test::locks();
+    test::ttf();
+    test::cook();
+    test::convert();
+    test::images();
+    test::upload();
+    test::sprites();
+    test::shaders();
+    test::glState();
+    test::renderQueue();
+    test::gltfTextures();
+    test::indirect();
+    test::meshopt();
+    test::prof();
+    test::frameStats();
+    test::allocStats();
+    test::pipeline();
+    test::replay();
+    test::level();
+    test::collision();
+    test::balls();
+    test::explosion();
+    test::staticSprites();
 #endif
 
     game::loadAssets();
-    game::loadLevel();
+    if (!game::loadLevel()) LOG_FATAL("unable to load '{}'\n", game::g_ntsLevelPath);
+
+    if (s_ntsRecordPath) replay::g_recorder.start(OsAllocatorGet(), 0);
 
     /* proc once to get events */
     app::g_pWindow->swapBuffers();
     controls::procMouse();
     controls::procKeys();
+    replay::g_recorder.keys(controls::replayKeysMask());
     app::g_pWindow->procEvents();
 
 #ifdef NDEBUG
@@ -101,10 +214,88 @@ run()
     mainLoop();
 }
 
+/* one fixed step, snapshotted and published for drawing */
+static void
+simTick(Arena* pArena, SimClock* pClock)
+{
+    const s64 t0 = utils::timeNowUS();
+    const f32 intervalMS = pClock->prevTickUS > 0 ? f32(t0 - pClock->prevTickUS) / 1000.0f : 0.0f;
+    pClock->prevTickUS = t0;
+
+    game::updateState(pArena);
+    g_gameTime += g_dt;
+    ++pClock->nTicks;
+    pClock->aTickMS[pClock->nTicks % TICK_HISTORY] = intervalMS;
+
+    if (replay::g_recorder.m_bActive) replay::g_recorder.tick(game::stateHash());
+
+    SimFrame& f = s_simFrames.getBack();
+    game::takeSnapshot(&f.snap);
+
+    const s64 t1 = utils::timeNowUS();
+    pClock->simMS += f64(t1 - t0) / 1000.0;
+
+    f.tick = pClock->nTicks;
+    f.timeUS = t1;
+    f.inputUS = s_lastInputUS.load(std::memory_order_relaxed);
+    f.simMS = pClock->simMS;
+    memcpy(f.aTickMS, pClock->aTickMS, sizeof(f.aTickMS));
+
+    s_simFrames.publish();
+}
+
+/* ticks on time no matter how long the frames take */
+static THREAD_STATUS
+simLoop(void*)
+{
+    PROFILE_THREAD_NAME("sim");
+
+    Arena arena(SIZE_1M);
+    arena.setStats(allocStatsGet("frame:simLoop"));
+    defer( arena.freeAll() );
+
+    SimClock clock {};
+    const s64 dtUS = s64(g_dt * 1'000'000.0);
+    s64 nextUS = utils::timeNowUS();
+
+    while (s_bSimRunning.load(std::memory_order_acquire))
+    {
+        const s64 nowUS = utils::timeNowUS();
+        if (nowUS < nextUS)
+        {
+            utils::sleepMS(f64(nextUS - nowUS) / 1000.0);
+            continue;
+        }
+
+        /* too far behind (debugger, suspend), drop the ticks instead of catching up */
+        if (nowUS - nextUS > 250'000) nextUS = nowUS;
+        nextUS += dtUS;
+
+        if (s_bSimPaused.load(std::memory_order_relaxed) ||
+            (s_bSimStepDebug.load(std::memory_order_relaxed) && !s_bSimStep.exchange(false, std::memory_order_relaxed)))
+        {
+            clock.prevTickUS = 0;
+            continue;
+        }
+
+        {
+            PROFILE_SCOPE("tick");
+            guard::Mtx lock(&s_mtxSim);
+            simTick(&arena, &clock);
+        }
+
+        arena.shrinkToFirstBlock();
+        arena.reset();
+    }
+
+    return {};
+}
+
 static void
 mainLoop()
 {
     Arena arena(SIZE_8M);
+    arena.setStats(allocStatsGet("frame:mainLoop"));
     defer( arena.freeAll() );
 
     g_gameTime = 0.0;
@@ -116,8 +307,32 @@ mainLoop()
     auto& win = *app::g_pWindow;
     auto& mix = *app::g_pMixer;
 
+    PROFILE_THREAD_NAME("main");
+
+    /* something to draw before the first tick */
+    game::takeSnapshot(&s_simFrames.getBack().snap);
+    s_simFrames.publish();
+
+    SimClock clock {};
+    Thread simThread {};
+    if (s_bSimThread)
+    {
+        s_bSimRunning.store(true, std::memory_order_release);
+        simThread = Thread(simLoop, nullptr);
+        LOG_NOTIFY("ticking on the sim thread, {} ticks/s\n", game::TICK_RATE);
+    }
+
+    bool aPrevKeys[sizeof(controls::g_aPressedKeys)] {};
+    u64 lastTick = 0;
+    u64 pushedTick = 0;
+    f64 lastSimMS = 0.0;
+    s64 lastInputUS = 0;
+    bool bBenchDone = false;
+
     while (win.m_bRunning || mix.m_bRunning)
     {
+        PROFILE_SCOPE("frame");
+
         if (!win.m_bPaused)
         {
             f64 newTime = utils::timeNowS();
@@ -128,8 +343,24 @@ mainLoop()
             accumulator += frameTime;
         }
 
-        win.procEvents();
+        {
+            PROFILE_SCOPE("procEvents");
+            win.procEvents();
+        }
+
+        /* latency is counted from here, not from the key press itself */
+        s64 inputUS = 0;
+        if (memcmp(aPrevKeys, controls::g_aPressedKeys, sizeof(aPrevKeys)) != 0)
+        {
+            inputUS = utils::timeNowUS();
+            memcpy(aPrevKeys, controls::g_aPressedKeys, sizeof(aPrevKeys));
+        }
+
         updateDrawTime();
+        {
+            PROFILE_SCOPE("uploadQueue flush");
+            texture::g_uploadQueue.flush();
+        }
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         glViewport(0, 0, win.m_wWidth, win.m_wHeight);
@@ -138,42 +369,223 @@ mainLoop()
         controls::g_camera.proj = math::M4Ortho(-0.0f, WIDTH, 0.0f, HEIGHT, -50.0f, 50.0f);
         g_uboProjView.bufferData(&controls::g_camera, 0, sizeof(math::M4) * 2);
 
-        controls::procKeys();
-        controls::procMouse();
+        {
+            if (s_bSimThread) s_mtxSim.lock();
+
+            controls::procKeys();
+            controls::procMouse();
+            replay::g_recorder.keys(controls::replayKeysMask());
+            if (inputUS > 0) s_lastInputUS.store(inputUS, std::memory_order_relaxed);
+
+            if (s_bSimThread) s_mtxSim.unlock();
+        }
+
+        FrameRecord rec {};
+        rec.wallMS = f32(g_frameTime);
+
+        s64 t0 = utils::timeNowUS();
+        f64 alpha = 0.0;
 
-        if (controls::g_bStepDebug && !win.m_bPaused)
+        if (s_bSimThread)
         {
-            game::updateState(&arena);
-            g_gameTime += g_dt;
-            accumulator -= g_dt;
+            s_bSimPaused.store(win.m_bPaused, std::memory_order_relaxed);
+            s_bSimStepDebug.store(controls::g_bStepDebug, std::memory_order_relaxed);
+            if (controls::g_bStepDebug) s_bSimStep.store(true, std::memory_order_relaxed);
+
+            s_simFrames.acquire();
+            const SimFrame& f = s_simFrames.getFront();
+
+            rec.nTicks = u32(f.tick - lastTick);
+            rec.simMS = f32(f.simMS - lastSimMS);
+            lastTick = f.tick;
+            lastSimMS = f.simMS;
+
+            /* the sim is at most a tick ahead of the snapshot */
+            alpha = utils::clamp(f64(t0 - f.timeUS) / (g_dt * 1'000'000.0), 0.0, 1.0);
         }
         else
         {
-            while (accumulator >= g_dt && !win.m_bPaused)
+            if (win.m_bPaused) clock.prevTickUS = 0;
+
+            if (controls::g_bStepDebug && !win.m_bPaused)
             {
-                game::updateState(&arena);
-                g_gameTime += g_dt;
+                simTick(&arena, &clock);
                 accumulator -= g_dt;
+                ++rec.nTicks;
             }
+            else
+            {
+                while (accumulator >= g_dt && !win.m_bPaused)
+                {
+                    simTick(&arena, &clock);
+                    accumulator -= g_dt;
+                    ++rec.nTicks;
+                }
+            }
+
+            s_simFrames.acquire();
+            rec.simMS = f32(utils::timeNowUS() - t0) / 1000.0f;
+            alpha = accumulator / g_dt;
         }
 
-        const f64 alpha = accumulator / g_dt;
+        const SimFrame& sf = s_simFrames.getFront();
 
-        game::draw(&arena, alpha);
+        /* the tick ring stays on this thread, the intervals come with the snapshot */
+        if (sf.tick > pushedTick)
+        {
+            const u64 first = utils::max(pushedTick + 1, sf.tick >= TICK_HISTORY ? sf.tick - TICK_HISTORY + 1 : 1);
+            for (u64 t = first; t <= sf.tick; ++t)
+            {
+                const f32 ms = sf.aTickMS[t % TICK_HISTORY];
+                if (ms > 0.0f) g_frameStats.m_tickMS.push(ms);
+            }
+
+            /* sorting the ring every tick is too much */
+            if ((sf.tick >> 8) != (pushedTick >> 8)) g_tickPercentiles = g_frameStats.m_tickMS.percentiles();
+            pushedTick = sf.tick;
+        }
+
+        s64 t1 = utils::timeNowUS();
+
+        game::draw(&arena, sf.snap, alpha);
+        if (s_slowRenderMS > 0.0) utils::sleepMS(s_slowRenderMS);
+
+        t0 = utils::timeNowUS();
+        rec.drawMS = f32(t0 - t1) / 1000.0f;
 
         arena.shrinkToFirstBlock();
         arena.reset();
 
-        app::g_pWindow->swapBuffers();
+        {
+            PROFILE_SCOPE("swapBuffers");
+            app::g_pWindow->swapBuffers();
+        }
+        t1 = utils::timeNowUS();
+        rec.swapMS = f32(t1 - t0) / 1000.0f;
+
+        /* first swap of a tick that saw the input */
+        if (sf.inputUS != lastInputUS)
+        {
+            g_frameStats.m_inputMS.push(f32(t1 - sf.inputUS) / 1000.0f);
+            lastInputUS = sf.inputUS;
+        }
+
+        texture::g_bindStats.nextFrame();
+        gl::g_stateStats.nextFrame();
+        g_frameStats.push(rec);
+
+        if ((g_frameStats.m_nFrames & 15) == 0) g_inputPercentiles = g_frameStats.m_inputMS.percentiles();
+
+        if (s_nBenchFrames > 0 && g_frameStats.m_nFrames >= s_nBenchFrames)
+        {
+            s_nBenchFrames = 0;
+            bBenchDone = true;
+            controls::quit();
+        }
+
+#ifndef NDEBUG
+        if (gl::g_bStateCrossCheck) assert(gl::crossCheckAll());
+#endif
         g_nfps++;
     }
 
+    if (s_bSimThread)
+    {
+        s_bSimRunning.store(false, std::memory_order_release);
+        simThread.join();
+    }
+
+    if (replay::g_recorder.m_bActive)
+    {
+        const auto& r = replay::g_recorder;
+        if (!r.write(s_ntsRecordPath)) LOG_WARN("failed to write '{}'\n", s_ntsRecordPath);
+        else LOG_NOTIFY("'{}': {} ticks, {} key changes\n", s_ntsRecordPath, r.m_aHashes.getSize(), r.m_aKeys.getSize());
+
+        replay::g_recorder.destroy();
+    }
+
+    if (bBenchDone)
+    {
+        g_frameStats.writeSummaryCSV(stdout);
+        if (!g_frameStats.writeFramesCSV("bench.csv")) LOG_WARN("failed to write 'bench.csv'\n");
+        else LOG_NOTIFY("{} frames written to 'bench.csv'\n", g_frameStats.m_nFrames);
+    }
+
     app::g_pMixer->destroy();
 
 #ifndef NDEBUG
+    g_frameStats.destroy();
     g_uboProjView.destroy();
     game::cleanup();
 #endif
 }
 
+int
+runReplay(const char* ntsPath)
+{
+    Arena arena(SIZE_1M);
+    defer( arena.freeAll() );
+
+    /* the result is all --replay is for, CERR stays in release where the logs compile out */
+    replay::Log log {};
+    if (!replay::load(&arena, ntsPath, &log))
+    {
+        CERR("'{}': unable to load the replay\n", ntsPath);
+        return 1;
+    }
+
+    const replay::Header& h = log.header;
+    if (h.tickRate != game::TICK_RATE)
+    {
+        CERR("'{}' was recorded at {} ticks/s, the game runs at {}\n", ntsPath, h.tickRate, game::TICK_RATE);
+        return 1;
+    }
+
+    static audio::DummyMixer s_mixer {};
+    app::g_pMixer = &s_mixer;
+    game::g_bHeadless = true;
+
+    g_gameTime = 0.0;
+    g_dt = game::FIXED_DELTA_TIME;
+    if (!game::loadLevel())
+    {
+        CERR("'{}': unable to load '{}'\n", ntsPath, game::g_ntsLevelPath);
+        return 1;
+    }
+
+    Arena tickArena(SIZE_1M);
+    defer( tickArena.freeAll() );
+
+    const s64 t0 = utils::timeNowUS();
+
+    u32 iKey = 0;
+    for (u32 tick = 0; tick < h.nTicks; ++tick)
+    {
+        for (; iKey < h.nKeyEvents && log.pKeys[iKey].tick == tick; ++iKey)
+        {
+            controls::setReplayKeys(log.pKeys[iKey].mask);
+            controls::procKeys();
+        }
+
+        game::updateState(&tickArena);
+        g_gameTime += g_dt;
+        tickArena.reset();
+
+        const u32 hash = game::stateHash();
+        if (hash != log.pHashes[tick])
+        {
+            CERR("'{}': diverged at tick {} of {} (hash: {}, recorded: {})\n", ntsPath, tick, h.nTicks, hash, log.pHashes[tick]);
+            return 1;
+        }
+    }
+
+    const f64 ms = f64(utils::timeNowUS() - t0) / 1000.0;
+    const f64 realMS = f64(h.nTicks) * 1000.0 / game::TICK_RATE;
+    CERR("'{}': {} ticks, {} key changes, every hash matched in {:.3} ms ({:.1}x realtime, {:.3} us per tick)\n",
+        ntsPath, h.nTicks, h.nKeyEvents, ms, realMS / utils::max(ms, 0.001), ms * 1000.0 / utils::max(h.nTicks, 1u)
+    );
+
+    return 0;
+}
+
 } /* namespace frame */
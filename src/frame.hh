@@ -1,5 +1,6 @@
 #pragma once
 
+#include "FrameStats.hh"
 #include "Model.hh"
 #include "adt/Pair.hh"
 
@@ -28,6 +29,12 @@ extern int g_nfps;
 
 extern Ubo g_uboProjView;
 
+extern FrameStats g_frameStats;
+extern Percentiles g_tickPercentiles; /* from the tick ring, refreshed every 256 ticks */
+extern Percentiles g_inputPercentiles;
+
 void run();
+/* --replay FILE: headless, ticks as fast as it can and checks every hash. 0 when all match */
+[[nodiscard]] int runReplay(const char* ntsPath);
 
 } /* namespace frame */
@@ -3,20 +3,28 @@
 #include "AllocatorPool.hh"
 #include "IWindow.hh"
 #include "Shader.hh"
+#include "StaticSprites.hh"
 #include "adt/Arena.hh"
 #include "adt/Pool.hh"
 #include "adt/ScratchBuffer.hh"
 #include "adt/ThreadPool.hh"
 #include "adt/Span2D.hh"
+#include "adt/prof.hh"
 #include "adt/defer.hh"
+#include "adt/hash.hh"
 #include "app.hh"
+#include "collision.hh"
 #include "controls.hh"
+#include "explosion.hh"
 #include "frame.hh"
+#include "level.hh"
 #include "reader/Wave.hh"
 #include "reader/ttf.hh"
 #include "text.hh"
 #include "texture.hh"
 
+#include <atomic>
+
 namespace game
 {
 
@@ -31,33 +39,57 @@ thread_local static ScratchBuffer tls_scratch(tls_aMemBuffer);
 
 static AllocatorPool<Arena, ASSET_MAX_COUNT> s_assetArenas(INIT);
 
-static Vec<game::Block> s_aBlocks(s_assetArenas.get(SIZE_1K));
+static Vec<game::Block> s_aBlocks(s_assetArenas.getNamed("asset:s_aBlocks", SIZE_1K));
 
 static Shader s_shFontBitmap;
 static Shader s_shSprite;
-static Shader s_sh1Col;
+static Shader s_shSpriteInstanced;
+static Shader s_shSdf;
 
-static texture::Img s_tAsciiMap(s_assetArenas.get(SIZE_1M));
-static texture::Img s_tBox(s_assetArenas.get(SIZE_1K * 100));
-static texture::Img s_tBall(s_assetArenas.get(SIZE_1K * 100));
-static texture::Img s_tPaddle(s_assetArenas.get(SIZE_1K * 100));
-static texture::Img s_tWhitePixel(s_assetArenas.get(250));
+static texture::Img s_tAsciiMap(s_assetArenas.getNamed("asset:s_tAsciiMap", SIZE_1M));
+/* only in s_sprites, no textures of their own */
+constexpr String BOX_PATH = "test-assets/box3.bmp";
+constexpr String BALL_PATH = "test-assets/ball.bmp";
+constexpr String PADDLE_PATH = "test-assets/paddle.bmp";
+constexpr String WHITE_PIXEL_PATH = "test-assets/WhitePixel.bmp";
+static texture::ImgArray s_sprites(s_assetArenas.getNamed("asset:s_sprites", SIZE_1K));
 
-static reader::Wave s_sndBeep(s_assetArenas.get(SIZE_1K * 400));
-static reader::Wave s_sndUnatco(s_assetArenas.get(SIZE_1M * 35));
+static reader::Wave s_sndBeep(s_assetArenas.getNamed("asset:s_sndBeep", SIZE_1K * 400));
+static reader::Wave s_sndUnatco(s_assetArenas.getNamed("asset:s_sndUnatco", SIZE_1M * 35));
 
 static Plain s_plain;
+static render::Queue s_renderQueue(s_assetArenas.getNamed("asset:s_renderQueue", SIZE_1K * 64));
+static render::StaticSprites s_staticBlocks(s_assetArenas.getNamed("asset:s_staticBlocks", SIZE_1K * 16));
 
-static text::TTF s_ttfWriter(s_assetArenas.get(SIZE_1K * 520));
-static reader::ttf::Font s_fontLiberation(s_assetArenas.get(SIZE_1K * 500));
+static text::TTF s_ttfWriter(s_assetArenas.getNamed("asset:s_ttfWriter", SIZE_1K * 520));
+static reader::ttf::Font s_fontLiberation(s_assetArenas.getNamed("asset:s_fontLiberation", SIZE_1K * 500));
 
 Pool<Entity, ASSET_MAX_COUNT> g_aEntities(INIT);
 static Arr<math::V2, ASSET_MAX_COUNT> s_aPrevPos;
 
-static const Level* s_pCurrLvl {};
+static Arena* s_pLvlArena = s_assetArenas.getNamed("asset:s_pLvlArena", SIZE_1K * 64); /* reset on each loadLevel() */
+static Level s_currLvl {};
 static WidthHeight s_currLvlSize {};
-static Map<Entity*, Pair<u16, u16>> s_mapPEntityToTilePos(s_assetArenas.get(SIZE_1K));
-static Vec<Entity*> s_aPBlocksMap(s_assetArenas.get(SIZE_1K));
+static Vec<Entity*> s_aPBlocksMap(s_assetArenas.getNamed("asset:s_aPBlocksMap", SIZE_1K));
+static balls::Grid s_ballGrid {}; /* from s_pLvlArena */
+static explosion::Chain s_explosion {}; /* from s_pLvlArena */
+
+static u32 s_whitePixelTex = NPOS32; /* g_aAllTextures idx, the frame graph bars */
+
+/* block changes, sim side. An entity is in s_aDirtyNow once until the next snapshot, then in s_aPendingChanges
+ * (and every snapshot) until draw() has drawn a snapshot as new as its change */
+static Arr<u16, ASSET_MAX_COUNT> s_aDirtyNow;
+static Arr<u16, ASSET_MAX_COUNT> s_aPendingChanges;
+static u32 s_aChangeSeq[ASSET_MAX_COUNT] {}; /* snapshot of the latest change, per entity */
+static DIRTY s_aPendingDirty[ASSET_MAX_COUNT] {}; /* everything since the change was first pending */
+static u32 s_snapSeq = 0;
+static u32 s_levelGen = 0;
+static std::atomic<u32> s_drawnSeq = 0; /* set by draw() */
+
+/* draw side */
+static u32 s_drawnLevelGen = NPOS32;
+static u32 s_appliedSeq = 0; /* changes up to this one are in s_staticBlocks */
+static u32 s_nBlockUpdates = 0; /* last frame */
 
 Player g_player {
     .enIdx = 0,
@@ -67,17 +99,25 @@ Ball g_ball {
     .enIdx = 0,
     .radius = 0.1f,
     .bReleased = false,
-    .bCollided = false,
 };
 
+balls::Balls g_balls(s_assetArenas.getNamed("asset:g_balls", SIZE_1K * 64));
+
+bool g_bHeadless = false;
+const char* g_ntsLevelPath = DEFAULT_LEVEL_PATH;
+
 static void drawFPSCounter(Arena* pAlloc);
+static void drawFrameGraph();
 static void drawInfo(Arena* pArena);
-static void drawEntities(Arena* pAlloc, const f64 alpha);
+static void drawBlocks(const Snapshot& snap);
+static void drawEntities(Arena* pAlloc, const Snapshot& snap, const f64 alpha);
 static void drawTTFTest(Arena* pAlloc);
 
 void
 loadAssets()
 {
+    PROFILE_SCOPE("loadAssets");
+
     f64 t0 = utils::timeNowS();
     LOG_GOOD("loadAssets() at: {}\n", (ssize)t0);
 
@@ -89,48 +129,78 @@ loadAssets()
     s_shFontBitmap.use();
     s_shFontBitmap.setI("tex0", 0);
 
-    s_sh1Col.load("shaders/font/1col.vert", "shaders/font/1col.frag");
-    s_sh1Col.use();
-    s_sh1Col.setI("uTex0", 0);
+    s_shSdf.load("shaders/font/sdf.vert", "shaders/font/sdf.frag");
+    s_shSdf.use();
+    s_shSdf.setI("uTex0", 0);
 
     s_shSprite.load("shaders/2d/sprite.vert", "shaders/2d/sprite.frag");
     s_shSprite.use();
-    s_shSprite.setI("tex0", 0);
+    s_shSprite.setI("uSprites", 0);
+
+    s_shSpriteInstanced.load("shaders/2d/spriteInstanced.vert", "shaders/2d/spriteInstanced.frag");
+    s_shSpriteInstanced.use();
+    s_shSpriteInstanced.setI("uSprites", 0);
 
     frame::g_uboProjView.bindShader(&s_shSprite, "ubProjView", 0);
+    frame::g_uboProjView.bindShader(&s_shSpriteInstanced, "ubProjView", 0);
 
-    s_fontLiberation.loadParse("test-assets/LiberationMono-Regular.ttf");
+    s_staticBlocks.init(s_plain.m_vbo);
 
-    /* unbind before running threads */
-    app::g_pWindow->unbindGlContext();
-    defer( app::g_pWindow->bindGlContext() );
+    LOG_GOOD("shaders: {} from cache in {} us, {} compiled in {} us\n",
+        g_shaderCacheStats.nHits, g_shaderCacheStats.cachedUS, g_shaderCacheStats.nMisses, g_shaderCacheStats.compiledUS
+    );
 
-    text::TTFRasterizeArg argTTF {&s_ttfWriter, &s_fontLiberation};
+    s_fontLiberation.loadParse("test-assets/LiberationMono-Regular.ttf");
+    s_ttfWriter.init(&s_fontLiberation, text::TTF_MODE::SDF);
 
     reader::WaveLoadArg argBeep {&s_sndBeep, "test-assets/c100s16.wav"};
     reader::WaveLoadArg argUnatco {&s_sndUnatco, "test-assets/Unatco.wav"};
 
     texture::ImgLoadArg argFontBitmap {&s_tAsciiMap, "test-assets/bitmapFont20.bmp"};
-    texture::ImgLoadArg argBox {&s_tBox, "test-assets/box3.bmp"};
-    texture::ImgLoadArg argBall {&s_tBall, "test-assets/ball.bmp"};
-    texture::ImgLoadArg argPaddle {&s_tPaddle, "test-assets/paddle.bmp"};
-    texture::ImgLoadArg argWhitePixel {&s_tWhitePixel, "test-assets/WhitePixel.bmp"};
 
-    app::g_pThreadPool->submit(text::TTFRasterizeSubmit, &argTTF);
+    /* distance fields are size independent, so the whole ascii range can be done upfront */
+    s_ttfWriter.cacheParallel(
+        "!\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~ "
+    );
 
     app::g_pThreadPool->submit(reader::WaveSubmit, &argBeep);
     app::g_pThreadPool->submit(reader::WaveSubmit, &argUnatco);
 
     app::g_pThreadPool->submit(texture::ImgSubmit, &argFontBitmap);
-    app::g_pThreadPool->submit(texture::ImgSubmit, &argBox);
-    app::g_pThreadPool->submit(texture::ImgSubmit, &argBall);
-    app::g_pThreadPool->submit(texture::ImgSubmit, &argPaddle);
-    app::g_pThreadPool->submit(texture::ImgSubmit, &argWhitePixel);
 
+    /* workers only fill upload slots, the gl calls happen here, no context handoff */
+    while (app::g_pThreadPool->busy() || !texture::g_uploadQueue.idle())
+    {
+        texture::g_uploadQueue.flush();
+        utils::sleepMS(0.5);
+    }
     app::g_pThreadPool->wait();
 
+    /* every entity texture in one array, drawEntities() binds once */
+    const String aSpritePaths[] {BOX_PATH, BALL_PATH, PADDLE_PATH, WHITE_PIXEL_PATH};
+    s_sprites.build(aSpritePaths, utils::size(aSpritePaths), false, GL_NEAREST, GL_NEAREST_MIPMAP_NEAREST);
+
+    if (auto f = texture::g_mAllTexturesIdxs.search(WHITE_PIXEL_PATH))
+        s_whitePixelTex = f.data().val;
+
+    /* once, not per level */
+    app::g_pMixer->addBackground(s_sndUnatco.getTrack(true, 0.7f));
+
+    const texture::UploadStats up = texture::g_uploadQueue.getStats();
+    if (up.nUploads > 0)
+    {
+        LOG_GOOD("texture uploads: {}, {} KB, {:.1} MB/s, queued avg/max: {}/{} us, gpu avg/max: {}/{} us, slot wait: {} us\n",
+            up.nUploads, up.nBytes / 1024, up.MBps(),
+            up.queuedUS / s64(up.nUploads), up.maxQueuedUS, up.gpuUS / s64(up.nUploads), up.maxGpuUS, up.slotWaitUS
+        );
+    }
+
     f64 t1 = utils::timeNowS();
     LOG_GOOD("loaded in: {} s, at {}\n", t1 - t0, (ssize)t1);
+
+#ifdef ADT_ALLOC_STATS
+    allocStatsReport(stderr);
+#endif
 }
 
 template<typename T>
@@ -176,252 +246,105 @@ getReflectionSide(math::V2 tar)
     return eBestMatch;
 }
 
-static REFLECT_SIDE
-getReflectionSideV2(const Entity& e)
-{
-    auto& enBall = g_aEntities[g_ball.enIdx];
-    REFLECT_SIDE eSide = NONE;
-
-    if (enBall.pos.y < e.pos.y - (e.height / 2.0f))
-        eSide = DOWN;
-    else if (enBall.pos.y > e.pos.y + (e.height / 2.0f))
-        eSide = UP;
-    else if (enBall.pos.x < e.pos.x)
-        eSide = LEFT;
-    else if (enBall.pos.x > e.pos.x)
-        eSide = RIGHT;
-
-    return eSide;
-}
-
-static bool
-AABB(
-    const math::V2 lPos, const f32 lWidth, const f32 lHeight,
-    const math::V2 rPos, const f32 rWidth, const f32 rHeight
-)
+/* p goes into the next snapshot's aBlockChanges */
+static void
+markDirty(Entity* p, DIRTY eDirty)
 {
-    if (
-        lPos.x >= rPos.x - lWidth/2.0f - rWidth/2.0f  && lPos.x <= rPos.x + lWidth/2.0f + rWidth/2.0f &&
-        lPos.y >= rPos.y - lHeight/2.0f - rHeight/2.0f && lPos.y <= rPos.y + lHeight/2.0f + rHeight/2.0f
-    )
-        return true;
-    else return false;
+    if (p->eDirty == DIRTY::CLEAN) s_aDirtyNow.push(u16(g_aEntities.idx(p)));
+    p->eDirty |= eDirty;
 }
 
+/* the only way blocks die, s_ballGrid and s_explosion have to know */
 static void
-explodeBlockDFS(Vec<Entity*>* pVDfsMap, Entity* pEntity)
+killBlock(Entity* p)
 {
-    const u32 lvlWidth = s_pCurrLvl->width;
-    const u32 lvlHeight = s_pCurrLvl->height;
-
-    auto fPos = s_mapPEntityToTilePos.search(pEntity);
-    if (!fPos) return;
-
-    const auto& [tileX, tileY] = fPos.data().val;
-
-    /* xy offsets */
-    constexpr Pair<s8, s8> aKernel[] {
-        {-1,  1}, {0,  1}, {1,  1},
-        {-1,  0},          {1,  0},
-        {-1, -1}, {0, -1}, {1, -1},
-    };
+    if (p->bDead) return;
 
-    Span2D span(s_aPBlocksMap.data(), lvlWidth, lvlHeight);
-    Span2D dfsMap(pVDfsMap->data(), lvlWidth, lvlHeight);
-
-    for (auto [x, y] : aKernel)
-    {
-        u32 px = int(tileX) + x;
-        u32 py = int(tileY) + y;
-
-        if (px < lvlWidth && py < lvlHeight)
-        {
-            auto* pEn = span(px, py);
-            if (pEn && !dfsMap(px, py))
-            {
-                dfsMap(px, py) = pEn;
-
-                if (pEn->eColor == game::COLOR::RED)
-                    explodeBlockDFS(pVDfsMap, pEn);
-            }
-        }
-    }
+    p->bDead = true;
+    markDirty(p, DIRTY::DIED);
+    s_ballGrid.remove(p->tileX, s_currLvl.height - 1 - p->tileY);
+    s_explosion.remove(p->tileX, p->tileY);
 }
 
+/* every live block around p goes, red ones keep going */
 static void
-explodeBlock(Arena* pArena, Entity* p)
+explodeBlock(Entity* p)
 {
-    const u32 lvlWidth = s_pCurrLvl->width;
-    const u32 lvlHeight = s_pCurrLvl->height;
-
-    Vec<Entity*> vDfsMap(pArena, lvlWidth * lvlHeight);
-    vDfsMap.setSize(lvlWidth * lvlHeight);
-
-    explodeBlockDFS(&vDfsMap, p);
+    const u32 lvlWidth = s_currLvl.width;
 
-    for (auto pEn : vDfsMap)
-        if (pEn) pEn->bDead = true;
+    s_explosion.run(p->tileX, p->tileY, [&](u32 x, u32 y) {
+        killBlock(s_aPBlocksMap[y*lvlWidth + x]);
+    });
 }
 
+/* bounces in one tick before the rest of the motion is dropped */
+constexpr u32 MAX_BALL_HITS = 8;
+
+/* every ball in play: paddle, walls, then swept against the blocks, fast balls can't skip over one between ticks */
 static void
-blockHit(Arena* pArena)
+moveBalls(Arena* pArena)
 {
-    auto& mix = *app::g_pMixer;
-    bool bAddSound = false;
-    bool bExplosive = false;
-
-    defer(
-        if (bAddSound)
-        {
-            f32 vol = 1.0f;
-            if (bExplosive) vol *= 1.6;
-
-            mix.add(s_sndBeep.getTrack(false, vol));
-        }
-    );
-
     auto& enBall = g_aEntities[g_ball.enIdx];
-    for (auto& block : s_aBlocks)
-    {
-        auto& b = g_aEntities[block.enIdx];
+    auto& enPlayer = g_aEntities[g_player.enIdx];
+    const s32 lvlWidth = s_currLvl.width;
+    const s32 lvlHeight = s_currLvl.height;
 
-        bool bMarkDead = false;
-        defer(
-            if (bMarkDead)
-                b.bDead = true;
-        );
+    bool bExplosive = false;
 
-        if (b.bDead || b.eColor == game::COLOR::INVISIBLE) continue;
+    /* cell (x, y) is centered where the block at tile (x, height - 1 - y) is */
+    auto blockAt = [&](s32 x, s32 y) {
+        return s_aPBlocksMap[(lvlHeight - 1 - y)*lvlWidth + x];
+    };
+    auto bSolid = [&](s32 x, s32 y) {
+        const Entity* p = blockAt(x, y);
+        return p && !p->bDead && p->eColor != game::COLOR::INVISIBLE;
+    };
+    auto onHit = [&](const collision::GridHit& hit, collision::Move* pMove) {
+        Entity& b = *blockAt(hit.x, hit.y);
 
-        math::V2 center = nextPos(enBall, true);
-        if (AABB(center, g_ball.radius, g_ball.radius, b.pos, b.width, b.height))
+        if (b.eColor == game::COLOR::RED)
         {
-            if (g_ball.bCollided)
-            {
-                g_ball.bCollided = false;
-                break;
-            }
+            pMove->dir = math::normalize(pMove->pos - b.pos);
+            bExplosive = true;
 
-            bAddSound = true;
-            g_ball.bCollided = true;
-
-            auto eSide = getReflectionSideV2(b);
-
-            auto& enBall = g_aEntities[g_ball.enIdx];
-            switch (eSide)
-            {
-                case REFLECT_SIDE::NONE:
-                case REFLECT_SIDE::ELAST:
-                case REFLECT_SIDE::CORNER:
-                break;
-
-                case REFLECT_SIDE::UP:
-                {
-                    enBall.dir.y = -enBall.dir.y;
-                }
-                break;
-
-                case REFLECT_SIDE::DOWN:
-                {
-                    enBall.dir.y = -enBall.dir.y;
-                }
-                break;
-
-                case REFLECT_SIDE::LEFT:
-                {
-                    enBall.dir.x = -enBall.dir.x;
-                }
-                break;
-
-                case REFLECT_SIDE::RIGHT:
-                {
-                    enBall.dir.x = -enBall.dir.x;
-                }
-                break;
-            }
-
-            if (b.eColor != game::COLOR::INVISIBLE && b.eColor != game::COLOR::DIMGRAY)
-                bMarkDead = true;
-
-            if (b.eColor == game::COLOR::RED)
-            {
-                enBall.dir = enBall.pos - b.pos;
-                bExplosive = true;
-
-                explodeBlock(pArena, &b);
-            }
-
-            break;
+            explodeBlock(&b);
         }
-    }
-}
-
-static void
-paddleHit()
-{
-    auto& enBall = g_aEntities[g_ball.enIdx];
-    auto& enPlayer = g_aEntities[g_player.enIdx];
 
-    const auto& bx = enBall.pos.x;
-    const auto& by = enBall.pos.y;
-    const auto& px = enPlayer.pos.x;
-    const auto& py = enPlayer.pos.y;
-
-    const f32 pxOff = enPlayer.width / 2.0f;
-    const f32 pyOff = enPlayer.height / 2.0f;
-
-    bool bLR = (bx >= px - pxOff && bx <= px + pxOff);
-    bool bTB = (by <= py - pyOff/2.0f);
+        if (b.eColor != game::COLOR::DIMGRAY) killBlock(&b);
+    };
 
-    if (bLR && bTB)
-    {
-        enBall.pos.y = py - pyOff/2.0f;
+    const balls::Paddle pad {
+        .left = enPlayer.pos.x - enPlayer.width/2.0f,
+        .right = enPlayer.pos.x + enPlayer.width/2.0f,
+        .lineY = enPlayer.pos.y - enPlayer.height/4.0f,
+        .dir = enPlayer.dir,
+    };
+    const balls::Bounds bounds {
+        .left = -0.5f,
+        .right = s_currLvlSize.width - 0.5f,
+        .bottom = -0.5f,
+        .top = s_currLvlSize.height - 0.5f,
+        .bBounceBottom = controls::g_bStepDebug,
+    };
 
-        app::g_pMixer->add(s_sndBeep.getTrack(false, 1.0f));
+    /* ball 0 sits on the paddle until it's released */
+    const u32 first = g_ball.bReleased ? 0 : 1;
+    if (!g_ball.bReleased) g_balls.setPos(0, enPlayer.pos);
 
-        utils::negate(&enBall.dir.y);
-        if (math::V2Length(enPlayer.dir) > 0.0f)
-            enBall.dir += enPlayer.dir * 0.1f;
-    }
-}
+    const balls::StepStats st = balls::step(
+        &g_balls, first, f32(frame::g_dt), g_ball.radius, MAX_BALL_HITS, pad, bounds, s_ballGrid, pArena, bSolid, onHit
+    );
 
-static void
-outOfBounds()
-{
-    auto& enBall = g_aEntities[g_ball.enIdx];
+    if (st.bLost0) g_ball.bReleased = false;
 
-    bool bAddSound = false;
-    if (enBall.pos.y < -0.5f)
-    {
-        if (controls::g_bStepDebug)
-        {
-            enBall.pos.y = -0.5f;
-            utils::negate(&enBall.dir.y);
-            bAddSound = true;
-        }
-        else g_ball.bReleased = false;
-    }
-    else if (enBall.pos.y > s_currLvlSize.height - 0.5f)
-    {
-        enBall.pos.y = s_currLvlSize.height - 0.5f;
-        utils::negate(&enBall.dir.y);
-        bAddSound = true;
-    }
-    else if (enBall.pos.x < -0.5f)
-    {
-        enBall.pos.x = -0.5f;
-        utils::negate(&enBall.dir.x);
-        bAddSound = true;
-    }
-    else if (enBall.pos.x > s_currLvlSize.width - 0.5f)
-    {
-        enBall.pos.x = s_currLvlSize.width - 0.5f;
-        utils::negate(&enBall.dir.x);
-        bAddSound = true;
-    }
+    enBall.pos = g_balls.pos(0);
+    enBall.dir = g_balls.dir(0);
 
-    if (bAddSound)
-        app::g_pMixer->add(s_sndBeep.getTrack(false, 1.0f));
+    /* one of each a tick, however many balls */
+    auto& mix = *app::g_pMixer;
+    if (st.nPaddleHits > 0) mix.add(s_sndBeep.getTrack(false, 1.0f));
+    if (st.nWallBounces > 0) mix.add(s_sndBeep.getTrack(false, 1.0f));
+    if (st.nBlockHits > 0) mix.add(s_sndBeep.getTrack(false, bExplosive ? 1.6f : 1.0f));
 }
 
 static inline math::V2
@@ -434,35 +357,71 @@ tileToImage(const f32 x, const f32 y)
     };
 }
 
-void
+bool
 loadLevel()
 {
-    const auto& lvl = g_lvl1;
-    const auto& aTiles = lvl.aTiles;
-    s_pCurrLvl = &lvl;
+    PROFILE_SCOPE("loadLevel");
+
+    /* same arena and entity slots every level, nothing piles up across transitions */
+    s_pLvlArena->reset();
+
+    level::Stats st {};
+    if (!level::load(s_pLvlArena, g_ntsLevelPath, &s_currLvl, &st)) return false;
+
+    LOG_NOTIFY("'{}': {}x{}, {} blocks, {} layers, {} runs, {} bytes, map: {} us, decode: {} us\n",
+        g_ntsLevelPath, s_currLvl.width, s_currLvl.height, st.nBlocks, st.nLayers, st.nRuns, st.fileBytes, st.mapUS, st.decodeUS
+    );
+
+    const Level& lvl = s_currLvl;
+    Span2D lvlAt(lvl.aTiles, lvl.width, lvl.height);
 
-    Span2D lvlAt(aTiles, lvl.width, lvl.height);
+    g_aEntities.clear();
+    g_ball.bReleased = false;
 
     frame::g_unit.first = frame::WIDTH / lvl.width / 2;
     frame::g_unit.second = frame::HEIGHT / lvl.height / 2;
 
-    s_aBlocks.setCap(lvl.height*lvl.width);
+    /* player and ball take the last two */
+    const u32 maxBlocks = g_aEntities.getCap() - 2;
+    u32 nSkipped = 0;
+
+    s_aBlocks.setCap(utils::min(st.nBlocks, maxBlocks));
     s_aBlocks.setSize(0);
 
-    auto fBoxTex = texture::g_mAllTexturesIdxs.search("test-assets/box3.bmp");
-    assert(fBoxTex);
-    auto boxTexId = texture::g_aAllTextures[fBoxTex.data().val].m_id;
+    /* entities keep g_aAllTextures handles, the sprite array slot is in there */
+    auto texHandle = [](String path) {
+        if (g_bHeadless) return u16(0);
+
+        auto f = texture::g_mAllTexturesIdxs.search(path);
+        assert(f && texture::g_aAllTextures[f.data().val].m_layer != NPOS32);
+        return u16(f.data().val);
+    };
+    const u16 boxTex = texHandle(BOX_PATH);
 
+    /* cells of the last level would point at whatever took over their pool slots */
     s_aPBlocksMap.setSize(lvl.width * lvl.height);
-    s_mapPEntityToTilePos.zeroOut();
+    for (auto& pBlock : s_aPBlocksMap) pBlock = nullptr;
+    s_ballGrid.init(s_pLvlArena, lvl.width, lvl.height);
+    s_explosion.init(s_pLvlArena, lvl.width, lvl.height);
+
+    /* whatever the last level had pending is gone with its entities, draw() starts over on the new levelGen */
+    ++s_levelGen;
+    s_aDirtyNow.setSize(0);
+    s_aPendingChanges.setSize(0);
+    memset(s_aChangeSeq, 0, sizeof(s_aChangeSeq));
 
-    LOG_NOTIFY("width: {}, height: {}\n", lvl.width, lvl.height);
     for (u32 y = 0; y < lvl.height; ++y)
     {
         for (u32 x = 0; x < lvl.width; ++x)
         {
             if (lvlAt(x, y) != s8(game::COLOR::INVISIBLE))
             {
+                if (s_aBlocks.getSize() >= maxBlocks)
+                {
+                    ++nSkipped;
+                    continue;
+                }
+
                 u32 idx = g_aEntities.getHandle();
                 auto& e = g_aEntities[idx];
 
@@ -474,22 +433,30 @@ loadLevel()
                 e.yOff = 0.0f;
                 e.zOff = 0.0f;
                 e.shaderIdx = 0;
-                e.texIdx = u16(boxTexId);
+                e.texIdx = boxTex;
                 e.eColor = game::COLOR(lvlAt(x, y));
                 e.bDead = false;
                 e.bRemoveAfterDraw = false;
+                e.eDirty = DIRTY::CLEAN;
+                markDirty(&e, DIRTY::MOVED | DIRTY::RECOLORED);
 
-                s_mapPEntityToTilePos.emplace(&e, x, y);
+                e.tileX = u16(x);
+                e.tileY = u16(y);
                 s_aPBlocksMap[y*lvl.width + x] = &e;
+                s_ballGrid.add(x, lvl.height - 1 - y);
+                s_explosion.add(x, y, e.eColor == game::COLOR::RED);
             }
         }
     }
 
+    if (nSkipped > 0) LOG_WARN("only {} entities fit, {} blocks are left out\n", maxBlocks, nSkipped);
+
     g_player.enIdx = g_aEntities.getHandle();
     auto& enPlayer = g_aEntities[g_player.enIdx];
+    enPlayer.eType = ENTITY_TYPE::PLAYER;
     enPlayer.speed = 9.0f;
     enPlayer.pos.x = lvl.width / 2.0f;
-    enPlayer.texIdx = s_tPaddle.m_id;
+    enPlayer.texIdx = texHandle(PADDLE_PATH);
     enPlayer.width = 2.0f;
     enPlayer.height = 1.0f;
     enPlayer.xOff = -0.5f;
@@ -499,15 +466,17 @@ loadLevel()
 
     g_ball.enIdx = g_aEntities.getHandle();
     auto& enBall = g_aEntities[g_ball.enIdx];
+    enBall.eType = ENTITY_TYPE::BALL;
     enBall.speed = 9.0f;
     enBall.eColor = game::COLOR::ORANGERED;
-    enBall.texIdx = s_tBall.m_id;
+    enBall.texIdx = texHandle(BALL_PATH);
     enBall.width = 1.0f;
     enBall.height = 1.0f;
     enBall.zOff = 10.0f;
     enBall.bRemoveAfterDraw = false;
 
-    app::g_pMixer->addBackground(s_sndUnatco.getTrack(true, 0.7f));
+    g_balls.setSize(0);
+    g_balls.push(enPlayer.pos, {0.0f, 1.0f}, enBall.speed);
 
     s_aPrevPos.setSize(0);
     for (auto& en : g_aEntities)
@@ -515,22 +484,21 @@ loadLevel()
 
     s_currLvlSize.width = lvl.width;
     s_currLvlSize.height = lvl.height;
+
+    return true;
 }
 
 void
 updateState(Arena* pArena)
 {
+    PROFILE_SCOPE("updateState");
+
     auto& enBall = g_aEntities[g_ball.enIdx];
     auto& enPlayer = g_aEntities[g_player.enIdx];
 
-    /* keep prev positions */
-    {
-        for (auto& en : g_aEntities)
-        {
-            auto idx = g_aEntities.idx(&en);
-            s_aPrevPos[idx] = en.pos;
-        }
-    }
+    /* keep prev positions, blocks don't move */
+    s_aPrevPos[g_player.enIdx] = enPlayer.pos;
+    s_aPrevPos[g_ball.enIdx] = enBall.pos;
 
     /* player */
     {
@@ -548,32 +516,137 @@ updateState(Arena* pArena)
         }
     }
 
-    /* ball */
+    /* balls */
+    {
+        moveBalls(pArena);
+        if (!g_ball.bReleased) enBall.pos = enPlayer.pos;
+    }
+}
+
+void
+spawnBalls(u32 n)
+{
+    if (!g_ball.bReleased) return;
+
+    const math::V2 pos = g_balls.pos(0);
+    const math::V2 dir = g_balls.dir(0);
+    const f32 speed = g_aEntities[g_ball.enIdx].speed;
+
+    n = utils::min(n, MAX_BALLS - g_balls.m_size);
+    for (u32 i = 0; i < n; ++i)
     {
-        if (g_ball.bReleased)
+        /* spread over 90 degrees around ball 0 */
+        const f32 a = math::toRad(-45.0f + 90.0f * (f32(i) + 0.5f) / f32(n));
+        const math::V2 d {dir.x*std::cos(a) - dir.y*std::sin(a), dir.x*std::sin(a) + dir.y*std::cos(a)};
+        g_balls.push(pos, d, speed);
+    }
+}
+
+u32
+stateHash()
+{
+    /* field by field, Entity has padding */
+    usize h = hash::func(u32(g_ball.bReleased));
+    for (const Entity& en : g_aEntities)
+    {
+        const f32 aF[] {en.pos.x, en.pos.y, en.dir.x, en.dir.y, en.speed};
+        const u32 flags = u32(en.bDead) | (u32(en.eColor) << 8);
+
+        h = hash::func(aF, sizeof(aF), h);
+        h = hash::func(&flags, sizeof(flags), h);
+    }
+
+    h = hash::func(&g_balls.m_size, sizeof(g_balls.m_size), h);
+    for (const f32* a : {g_balls.m_aPosX, g_balls.m_aPosY, g_balls.m_aDirX, g_balls.m_aDirY})
+        h = hash::func(a, g_balls.m_size * sizeof(f32), h);
+
+    return u32(h ^ (h >> 32));
+}
+
+void
+takeSnapshot(Snapshot* pSnap)
+{
+    const u32 seq = ++s_snapSeq;
+    const u32 drawnSeq = s_drawnSeq.load(std::memory_order_acquire);
+
+    /* drop what draw() has, add what changed since the last snapshot */
+    {
+        u32 nKept = 0;
+        for (const u16 idx : s_aPendingChanges)
+            if (s_aChangeSeq[idx] > drawnSeq) s_aPendingChanges[nKept++] = idx;
+        s_aPendingChanges.setSize(nKept);
+
+        for (const u16 idx : s_aDirtyNow)
         {
-            blockHit(pArena);
-            paddleHit();
-            outOfBounds();
-            enBall.pos = nextPos(enBall, true);
+            Entity& en = g_aEntities[idx];
+
+            if (s_aChangeSeq[idx] <= drawnSeq)
+            {
+                s_aPendingChanges.push(idx);
+                s_aPendingDirty[idx] = DIRTY::CLEAN;
+            }
+
+            s_aPendingDirty[idx] |= en.eDirty;
+            s_aChangeSeq[idx] = seq;
+            en.eDirty = DIRTY::CLEAN;
+        }
+        s_aDirtyNow.setSize(0);
+    }
+
+    pSnap->seq = seq;
+    pSnap->levelGen = s_levelGen;
+    pSnap->aBlockChanges.setSize(0);
+    for (const u16 idx : s_aPendingChanges)
+    {
+        BlockChange& ch = pSnap->aBlockChanges[pSnap->aBlockChanges.push({g_aEntities[idx], s_aChangeSeq[idx], idx})];
+        ch.en.eDirty = s_aPendingDirty[idx];
+    }
+
+    pSnap->aEntities.setSize(0);
+    pSnap->aPrevPos.setSize(0);
+
+    for (const u16 idx : {g_player.enIdx, g_ball.enIdx})
+    {
+        const Entity& en = g_aEntities[idx];
+        if (en.bDead || en.eColor == game::COLOR::INVISIBLE) continue;
+
+        pSnap->aEntities.push(en);
+        pSnap->aPrevPos.push(s_aPrevPos[idx]);
+    }
 
-        } else enBall.pos = enPlayer.pos;
+    /* the rest of the balls look like ball 0, previous position from the direction they have now */
+    const Entity& enBall = g_aEntities[g_ball.enIdx];
+    const f32 dt = f32(frame::g_dt);
+    const u32 nBalls = utils::min(g_balls.m_size, MAX_DRAWN_BALLS + 1);
+
+    for (u32 i = 1; i < nBalls; ++i)
+    {
+        Entity en = enBall;
+        en.pos = g_balls.pos(i);
+        en.dir = g_balls.dir(i);
+
+        pSnap->aEntities.push(en);
+        pSnap->aPrevPos.push(en.pos - en.dir * (g_balls.m_aSpeed[i] * dt));
     }
 }
 
 void
-draw(Arena* pArena, const f64 alpha)
+draw(Arena* pArena, const Snapshot& snap, const f64 alpha)
 {
+    PROFILE_SCOPE("draw");
+
     if (controls::g_bTTFDebugScreen)
     {
         drawTTFTest(pArena);
     }
     else
     {
-        drawEntities(pArena, alpha);
+        drawBlocks(snap);
+        drawEntities(pArena, snap, alpha);
     }
 
     drawFPSCounter(pArena);
+    drawFrameGraph();
     drawInfo(pArena);
 }
 
@@ -591,8 +664,31 @@ drawFPSCounter(Arena* pAlloc)
     if ((currTime - f::g_prevTime) >= 1000.0)
         nLastFps = f::g_nfps; 
 
+    const audio::Stats audioStats = app::g_pMixer->getStats();
+
+    /* sorting the ring every frame is wasted work, a few times a second is enough to catch hitches */
+    static f::Percentiles s_wall {};
+    static f::Percentiles s_sim {}, s_draw {}, s_swap {};
+    if ((f::g_frameStats.m_nFrames & 15) == 0)
+    {
+        s_wall = f::g_frameStats.percentiles(&f::FrameRecord::wallMS);
+        s_sim = f::g_frameStats.percentiles(&f::FrameRecord::simMS);
+        s_draw = f::g_frameStats.percentiles(&f::FrameRecord::drawMS);
+        s_swap = f::g_frameStats.percentiles(&f::FrameRecord::swapMS);
+    }
+
     auto sp = tls_scratch.nextMemZero<char>(s_ttfWriter.m_maxSize);
-    ssize nChars = print::toSpan(sp, "FPS: {}\nFrame time: {:.3} ms", nLastFps, f::g_frameTime);
+    ssize nChars = print::toSpan(sp,
+        "FPS: {}\nFrame time: {:.3} ms\np50/p95/p99/max: {:.2}/{:.2}/{:.2}/{:.2} ms\n"
+        "p95 sim/draw/swap: {:.2}/{:.2}/{:.2} ms\ntick p99/max: {:.2}/{:.2} ms, input p50/p95: {:.1}/{:.1} ms\n"
+        "Audio: {:.1} ms, xruns: {}, underruns: {}\nTexture binds: {}\n"
+        "GL calls: {}, elided: {}\nBlock updates: {}, uploaded: {}",
+        nLastFps, f::g_frameTime, s_wall.p50, s_wall.p95, s_wall.p99, s_wall.max,
+        s_sim.p95, s_draw.p95, s_swap.p95, f::g_tickPercentiles.p99, f::g_tickPercentiles.max,
+        f::g_inputPercentiles.p50, f::g_inputPercentiles.p95, audioStats.delayMS, audioStats.nXruns, audioStats.nUnderruns,
+        texture::g_bindStats.nLastFrame, gl::g_stateStats.nLastIssued, gl::g_stateStats.nLastElided,
+        s_nBlockUpdates, s_staticBlocks.m_lastFlush.nFlushed
+    );
 
     s_ttfWriter.updateText(pAlloc, String(sp.data(), nChars), 0.0f, height - 2.0f, 1.0f);
 
@@ -603,16 +699,71 @@ drawFPSCounter(Arena* pAlloc)
     }
 
     math::M4 proj = math::M4Ortho(0.0f, width, 0.0f, height, -1.0f, 1.0f);
-    auto* sh = &s_sh1Col;
+    auto* sh = &s_shSdf;
 
     sh->use();
     sh->setM4("uProj", proj);
     sh->setV4("uColor", colors::hexToV4(0x00ff00ff));
-    texture::ImgBind(s_ttfWriter.m_texId, GL_TEXTURE0);
-
     s_ttfWriter.draw();
 }
 
+/* last frames as bars in the top right corner, 0 to 2x the 60 hz budget, through the sprite queue */
+static void
+drawFrameGraph()
+{
+    if (s_whitePixelTex == NPOS32) return;
+
+    constexpr u32 nBars = 128;
+    constexpr f32 barWidth = 2.0f;
+    constexpr f32 graphHeight = 100.0f;
+    constexpr f32 budgetMS = 1000.0f / 60.0f;
+    constexpr f32 x0 = frame::WIDTH - nBars * barWidth - 10.0f;
+    constexpr f32 y0 = frame::HEIGHT - graphHeight - 10.0f;
+
+    const auto& tex = texture::g_aAllTextures[s_whitePixelTex];
+
+    auto bar = [&](f32 x, f32 y, f32 w, f32 h, math::V3 color) {
+        math::M4 tm = math::M4Iden();
+        tm = M4Translate(tm, {x, y, 40.0f});
+        /* the plain is 2x2 */
+        tm = M4Scale(tm, {w / 2.0f, h / 2.0f, 1.0f});
+
+        render::DrawItem it {};
+        it.ePass = render::PASS::UI;
+        it.eFlags = DRAW::DIFF | DRAW::SPRITE;
+        it.pShader = &s_shSprite;
+        it.vao = s_plain.m_vao;
+        it.texTarget = GL_TEXTURE_2D_ARRAY;
+        it.diffuse = s_sprites.m_id;
+        it.count = 6;
+        it.tm = tm;
+        it.svUniform = "uModel";
+        it.layer = tex.m_layer;
+        it.uvRect = tex.m_uvRect;
+        it.color = color;
+
+        s_renderQueue.submit(it);
+    };
+
+    const auto& st = frame::g_frameStats;
+    const u32 n = utils::min(st.getSize(), nBars);
+    for (u32 i = 0; i < n; ++i)
+    {
+        const f32 ms = st.at(st.getSize() - n + i).wallMS;
+        const f32 h = utils::min(ms / (2.0f * budgetMS), 1.0f) * graphHeight;
+        const math::V3 color = ms <= budgetMS * 1.05f ? math::V3{0.2f, 0.9f, 0.2f} :
+            ms <= budgetMS * 2.0f ? math::V3{0.9f, 0.8f, 0.1f} : math::V3{0.9f, 0.2f, 0.2f};
+
+        bar(x0 + (nBars - n + i) * barWidth, y0, barWidth * 0.75f, utils::max(h, 1.0f), color);
+    }
+
+    /* the budget line */
+    bar(x0, y0 + graphHeight / 2.0f, nBars * barWidth, 1.0f, {0.6f, 0.6f, 0.6f});
+
+    s_renderQueue.sort();
+    s_renderQueue.execute();
+}
+
 static void
 drawTTFTest(Arena* pAlloc)
 {
@@ -634,13 +785,11 @@ drawTTFTest(Arena* pAlloc)
 
     s_ttfWriter.updateText(pAlloc, {sp.data(), j}, 0, height/2.0f + 2.0f, 1.0f);
 
-    auto* sh = &s_sh1Col;
+    auto* sh = &s_shSdf;
 
     sh->use();
     sh->setM4("uProj", proj);
     sh->setV4("uColor", colors::hexToV4(0xeeeeeeff));
-    texture::ImgBind(s_ttfWriter.m_texId, GL_TEXTURE0);
-
     s_ttfWriter.draw();
 }
 
@@ -648,18 +797,17 @@ static void
 drawInfo(Arena* pArena)
 {
     math::M4 proj = math::M4Ortho(0.0f, frame::g_uiWidth, 0.0f, frame::g_uiHeight, -1.0f, 1.0f);
-    auto* sh = &s_sh1Col;
+    auto* sh = &s_shSdf;
     sh->use();
 
     sh->setM4("uProj", proj);
     sh->setV4("uColor", {colors::hexToV4(0x666666ff)});
 
-    texture::ImgBind(s_ttfWriter.m_texId, GL_TEXTURE0);
-
     auto sp = tls_scratch.nextMem<char>(256);
     ssize nChars = print::toSpan(sp,
         "Fullscreen: F\n"
         "Mouse lock: Q\n"
+        "More balls: M\n"
         "Quit: ESC\n"
     );
     String s = {sp.data(), nChars};
@@ -671,17 +819,69 @@ drawInfo(Arena* pArena)
     s_ttfWriter.draw();
 }
 
+/* what drawEntities() would submit for en, as an instance */
+static render::SpriteInstance
+blockInstance(const Entity& en)
+{
+    if (en.bDead || en.eColor == game::COLOR::INVISIBLE) return {};
+
+    const math::V2 pos = tileToImage(en.pos.x, en.pos.y);
+    const math::V2 off = tileToImage(en.xOff, en.yOff);
+    const auto& tex = texture::g_aAllTextures[en.texIdx];
+
+    return {
+        .pos = {pos.x + off.x, pos.y + off.y, en.zOff},
+        .layer = f32(tex.m_layer),
+        .scale = {frame::g_unit.first * en.width, frame::g_unit.second * en.height},
+        .uvRect = tex.m_uvRect,
+        .color = blockColorToV3(en.eColor),
+    };
+}
+
+/* the changes draw() hasn't seen go into s_staticBlocks, all of them are drawn with one call */
 static void
-drawEntities([[maybe_unused]] Arena* pArena, const f64 alpha)
+drawBlocks(const Snapshot& snap)
 {
-    s_shSprite.use();
-    GLuint idxLastTex = 0;
+    PROFILE_SCOPE("drawBlocks");
 
-    for (const Entity& en : g_aEntities)
+    if (snap.levelGen != s_drawnLevelGen)
     {
-        if (en.bDead || en.eColor == game::COLOR::INVISIBLE) continue;
+        s_drawnLevelGen = snap.levelGen;
+        s_appliedSeq = 0;
+        s_staticBlocks.reset(ASSET_MAX_COUNT);
+    }
+
+    s_nBlockUpdates = 0;
+    if (snap.seq > s_appliedSeq)
+    {
+        for (u32 i = 0; i < snap.aBlockChanges.getSize(); ++i)
+        {
+            const BlockChange& ch = snap.aBlockChanges[i];
+            if (ch.seq <= s_appliedSeq) continue;
+
+            if (ch.en.eDirty & DIRTY::DIED) s_staticBlocks.hide(ch.enIdx);
+            else s_staticBlocks.set(ch.enIdx, blockInstance(ch.en));
 
-        auto enIdx = g_aEntities.idx(&en);
+            ++s_nBlockUpdates;
+        }
+
+        s_appliedSeq = snap.seq;
+        s_drawnSeq.store(snap.seq, std::memory_order_release);
+    }
+
+    s_staticBlocks.flush();
+
+    s_shSpriteInstanced.use();
+    s_sprites.bind(GL_TEXTURE0);
+    s_staticBlocks.draw();
+}
+
+static void
+drawEntities([[maybe_unused]] Arena* pArena, const Snapshot& snap, const f64 alpha)
+{
+    for (u32 i = 0; i < snap.aEntities.getSize(); ++i)
+    {
+        const Entity& en = snap.aEntities[i];
 
         math::V2 pos;
 
@@ -691,7 +891,7 @@ drawEntities([[maybe_unused]] Arena* pArena, const f64 alpha)
         }
         else
         {
-            const auto& prevPos = s_aPrevPos[enIdx];
+            const auto& prevPos = snap.aPrevPos[i];
             pos = math::lerp(
                 tileToImage(prevPos.x, prevPos.y),
                 tileToImage(en.pos.x, en.pos.y),
@@ -705,26 +905,41 @@ drawEntities([[maybe_unused]] Arena* pArena, const f64 alpha)
         tm = M4Translate(tm, {pos.x + off.x, pos.y + off.y, 0.0f + en.zOff});
         tm = M4Scale(tm, {frame::g_unit.first * en.width, frame::g_unit.second * en.height, 1.0f});
 
-        if (idxLastTex != en.texIdx)
-        {
-            idxLastTex = en.texIdx;
-            texture::ImgBind(en.texIdx, GL_TEXTURE0);
-        }
-
-        s_shSprite.setM4("uModel", tm);
-        s_shSprite.setV3("uColor", blockColorToV3(en.eColor));
-        s_plain.draw();
+        const auto& tex = texture::g_aAllTextures[en.texIdx];
+
+        render::DrawItem it {};
+        it.eFlags = DRAW::DIFF | DRAW::SPRITE;
+        it.depth = 0.5f - en.zOff; /* the paddle and ball (zOff 10) sort in front */
+        it.pShader = &s_shSprite;
+        it.vao = s_plain.m_vao;
+        it.texTarget = GL_TEXTURE_2D_ARRAY;
+        it.diffuse = s_sprites.m_id;
+        it.count = 6;
+        it.tm = tm;
+        it.svUniform = "uModel";
+        it.layer = tex.m_layer;
+        it.uvRect = tex.m_uvRect;
+        it.color = blockColorToV3(en.eColor);
+
+        s_renderQueue.submit(it);
     }
+
+    s_renderQueue.sort();
+    s_renderQueue.execute();
 }
 
 void
 cleanup()
 {
     s_plain.destroy();
+    s_staticBlocks.destroy();
+    s_ttfWriter.destroy();
 
     for (auto& e : g_aAllShaders) e.destroy();
 
     for (auto& t : texture::g_aAllTextures) t.destroy();
+    s_sprites.destroy();
+    texture::g_uploadQueue.destroy();
     texture::g_mAllTexturesIdxs.destroy();
 
     s_assetArenas.freeAll();
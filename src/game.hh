@@ -2,7 +2,9 @@
 
 #include "adt/Arena.hh"
 #include "adt/Pool.hh"
+#include "adt/enum.hh"
 #include "adt/types.hh"
+#include "balls.hh"
 #include "colors.hh"
 
 #include <cassert>
@@ -15,6 +17,8 @@ using namespace adt;
 constexpr u32 ASSET_MAX_COUNT = 256;
 constexpr u32 TICK_RATE = 240;
 constexpr f64 FIXED_DELTA_TIME = 1.0 / f64(TICK_RATE);
+constexpr u32 MAX_BALLS = 1 << 17;
+constexpr u32 MAX_DRAWN_BALLS = 1024; /* past ball 0, the rest still play, they just aren't drawn */
 
 enum REFLECT_SIDE : s8
 {
@@ -48,6 +52,16 @@ enum ENTITY_TYPE : u8
     GEN, PLAYER, BALL
 };
 
+/* what happened to an entity since it was last handed to draw(), blocks are only redrawn when it's not CLEAN */
+enum DIRTY : u8
+{
+    CLEAN     = 0,
+    MOVED     = 1,
+    DIED      = 1 << 1,
+    RECOLORED = 1 << 2,
+};
+ADT_ENUM_BITWISE_OPERATORS(DIRTY);
+
 struct Entity
 {
     ENTITY_TYPE eType {};
@@ -60,9 +74,12 @@ struct Entity
     f32 xOff {};
     f32 yOff {};
     f32 zOff {};
+    u16 tileX {}; /* blocks: where in the level, top row is 0 */
+    u16 tileY {};
     u16 shaderIdx {};
     u16 texIdx {};
     game::COLOR eColor {};
+    DIRTY eDirty {}; /* since the last takeSnapshot() */
     bool bDead {};
     bool bRemoveAfterDraw {};
 };
@@ -72,12 +89,12 @@ struct Player
     u16 enIdx {};
 };
 
+/* ball 0 of g_balls, the one served from the paddle, its entity is also how every other ball is drawn */
 struct Ball
 {
     u16 enIdx {};
     f32 radius {};
     bool bReleased {};
-    bool bCollided {};
 };
 
 struct Block
@@ -92,10 +109,36 @@ struct Level
     s8* aTiles;
 };
 
+/* a block as it is now, draw() keeps the blocks on the gpu and only redoes these */
+struct BlockChange
+{
+    Entity en {}; /* eDirty: everything since the last snapshot draw() got to */
+    u32 seq {}; /* snapshot of its latest change */
+    u16 enIdx {};
+};
+
+/* what draw() needs from a tick, copied out so drawing never reads the entities the sim is updating */
+struct Snapshot
+{
+    Arr<Entity, ASSET_MAX_COUNT + MAX_DRAWN_BALLS> aEntities {}; /* the ones that move, paddle and balls */
+    Arr<math::V2, ASSET_MAX_COUNT + MAX_DRAWN_BALLS> aPrevPos {}; /* same order */
+    /* Snapshots can be skipped, so a change stays in every one of them until draw() says (s_drawnSeq) it has
+     * drawn a snapshot at least as new as the change. */
+    Arr<BlockChange, ASSET_MAX_COUNT> aBlockChanges {};
+    u32 seq {};
+    u32 levelGen {}; /* bumped by loadLevel(), every block of the level is in aBlockChanges then */
+};
+
 void loadAssets();
-void loadLevel();
+/* g_ntsLevelPath, the previous level's entities are dropped. false if the file can't be loaded */
+[[nodiscard]] bool loadLevel();
 void updateState(Arena* pArena);
-void draw(Arena* pAlloc, const f64 alpha);
+/* a fan of n more balls from where ball 0 is, nothing until it's released */
+void spawnBalls(u32 n);
+/* entities after the last tick, for replay checks */
+[[nodiscard]] u32 stateHash();
+void takeSnapshot(Snapshot* pSnap);
+void draw(Arena* pAlloc, const Snapshot& snap, const f64 alpha);
 void cleanup();
 
 constexpr math::V3
@@ -121,43 +164,14 @@ blockColorToV3(COLOR col)
     return colors::get(map[int(col)]);
 }
 
-static constexpr s8 LEVEL_ONE_BLOCK[][10] {
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 8, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
-};
-
-static constexpr s8 LEVEL0[][10] {
-    {4, 5, 6, 1, 2, 3, 4, 5, 6, 7},
-    {1, 2, 3, 4, 5, 6, 1, 2, 3, 4},
-    {3, 2, 1, 6, 3, 2, 1, 2, 6, 7},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
-};
-
-static constexpr s8 LEVEL1[][15] {
-    {3, 3, 3, 3, 4, 4, 0, 0, 0, 1, 3, 3, 4, 3, 3},
-    {5, 4, 2, 4, 3, 3, 0, 0, 0, 4, 2, 2, 5, 2, 4},
-    {3, 4, 3, 2, 2, 6, 0, 0, 0, 2, 2, 5, 3, 2, 5},
-    {2, 2, 4, 3, 2, 3, 2, 0, 0, 3, 2, 4, 2, 4, 6},
-    {5, 4, 2, 4, 3, 3, 0, 0, 0, 4, 2, 2, 4, 2, 6},
-    {3, 1, 1, 1, 2, 6, 0, 0, 0, 2, 2, 5, 3, 4, 5},
-    {2, 1, 1, 1, 3, 5, 2, 0, 0, 2, 4, 6, 2, 2, 4},
-    {3, 4, 1, 4, 3, 4, 0, 0, 0, 3, 3, 6, 4, 3, 2},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 7, 5, 7, 3},
-    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}
-};
-
-#define LEVEL_INIT(LVL) {.width = sizeof(LVL[0]) / sizeof(LVL[0][0]), .height = sizeof(LVL) / sizeof(LVL[0]), .aTiles = (s8*)LVL}
+constexpr const char* DEFAULT_LEVEL_PATH = "test-assets/levels/1.lvl";
 
-const inline Level g_lvlOneBlock = LEVEL_INIT(LEVEL_ONE_BLOCK);
-const inline Level g_lvl0 = LEVEL_INIT(LEVEL0);
-const inline Level g_lvl1 = LEVEL_INIT(LEVEL1);
 
+extern bool g_bHeadless; /* replay: no window, no gl, no assets */
+extern const char* g_ntsLevelPath; /* --level FILE, text or cooked */
 extern Player g_player;
 extern Ball g_ball;
+extern balls::Balls g_balls;
 extern Pool<Entity, ASSET_MAX_COUNT> g_aEntities;
 
 inline Entity&
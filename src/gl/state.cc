@@ -0,0 +1,401 @@
+#include "state.hh"
+
+#include "adt/logs.hh"
+
+#include <cstring>
+
+namespace gl
+{
+
+StateStats g_stateStats {};
+
+#ifndef NDEBUG
+bool g_bStateCrossCheck = false;
+#endif
+
+enum TEX_TARGET : u8 { TEX_2D, TEX_2D_ARRAY, TEX_CUBE_MAP, TEX_ESIZE };
+enum BUFFER_TARGET : u8 { BUF_ARRAY, BUF_UNIFORM, BUF_PIXEL_UNPACK, BUF_DRAW_INDIRECT, BUF_SHADER_STORAGE, BUF_ESIZE };
+
+static const GLenum s_aTexTargets[TEX_ESIZE] {GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP};
+static const GLenum s_aTexQueries[TEX_ESIZE] {
+    GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_2D_ARRAY, GL_TEXTURE_BINDING_CUBE_MAP
+};
+
+static const GLenum s_aBufTargets[BUF_ESIZE] {
+    GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_DRAW_INDIRECT_BUFFER, GL_SHADER_STORAGE_BUFFER
+};
+static const GLenum s_aBufQueries[BUF_ESIZE] {
+    GL_ARRAY_BUFFER_BINDING, GL_UNIFORM_BUFFER_BINDING, GL_PIXEL_UNPACK_BUFFER_BINDING,
+    GL_DRAW_INDIRECT_BUFFER_BINDING, GL_SHADER_STORAGE_BUFFER_BINDING
+};
+
+struct UniformEntry
+{
+    GLuint program = STATE_UNKNOWN;
+    GLint loc = -1;
+    u8 size {};
+    bool bInt {};
+    alignas(16) u8 aValue[64] {};
+};
+
+struct State
+{
+    GLuint program = STATE_UNKNOWN;
+    GLuint vao = STATE_UNKNOWN;
+    GLenum activeUnit = STATE_UNKNOWN;
+    GLuint aaTextures[STATE_MAX_TEXTURE_UNITS][TEX_ESIZE] {};
+    GLuint aBuffers[BUF_ESIZE] {};
+    UniformEntry aUniforms[STATE_UNIFORM_CACHE_SIZE] {};
+
+    State() { invalidateBindings(); }
+
+    void
+    invalidateBindings()
+    {
+        program = vao = activeUnit = STATE_UNKNOWN;
+        for (auto& aTargets : aaTextures)
+            for (auto& id : aTargets) id = STATE_UNKNOWN;
+        for (auto& id : aBuffers) id = STATE_UNKNOWN;
+        for (auto& e : aUniforms) e = {};
+    }
+};
+
+static State s_state {};
+
+static int
+texTargetIdx(GLenum target)
+{
+    for (int i = 0; i < TEX_ESIZE; ++i)
+        if (s_aTexTargets[i] == target) return i;
+
+    return -1;
+}
+
+static int
+bufTargetIdx(GLenum target)
+{
+    for (int i = 0; i < BUF_ESIZE; ++i)
+        if (s_aBufTargets[i] == target) return i;
+
+    return -1;
+}
+
+static GLuint
+query(GLenum pname)
+{
+    GLint v = 0;
+    glGetIntegerv(pname, &v);
+    return GLuint(v);
+}
+
+#ifndef NDEBUG
+    #define CROSS_CHECK(CACHED, PNAME, NTS_WHAT)                                                                       \
+        if (g_bStateCrossCheck)                                                                                        \
+        {                                                                                                              \
+            const GLuint real = query(PNAME);                                                                          \
+            if (real != (CACHED))                                                                                      \
+            {                                                                                                          \
+                CERR("gl state: stale {}: cached: {}, real: {}\n", NTS_WHAT, (CACHED), real);                          \
+                assert(false);                                                                                         \
+            }                                                                                                          \
+        }
+#else
+    #define CROSS_CHECK(CACHED, PNAME, NTS_WHAT)
+#endif
+
+void
+invalidate()
+{
+    s_state.invalidateBindings();
+}
+
+bool
+crossCheckAll()
+{
+    bool bOk = true;
+    auto check = [&](GLuint cached, GLuint real, const char* ntsWhat, u32 i) {
+        if (cached == STATE_UNKNOWN || cached == real) return;
+        CERR("gl state: stale {} [{}]: cached: {}, real: {}\n", ntsWhat, i, cached, real);
+        bOk = false;
+    };
+
+    check(s_state.program, query(GL_CURRENT_PROGRAM), "program", 0);
+    check(s_state.vao, query(GL_VERTEX_ARRAY_BINDING), "vertex array", 0);
+    for (u32 i = 0; i < BUF_ESIZE; ++i)
+        check(s_state.aBuffers[i], query(s_aBufQueries[i]), "buffer", i);
+
+    const GLenum realUnit = query(GL_ACTIVE_TEXTURE);
+    check(s_state.activeUnit, realUnit, "active texture", 0);
+
+    /* texture bindings can only be queried for the active unit */
+    for (u32 unit = 0; unit < STATE_MAX_TEXTURE_UNITS; ++unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        for (u32 t = 0; t < TEX_ESIZE; ++t)
+            check(s_state.aaTextures[unit][t], query(s_aTexQueries[t]), "texture unit", unit);
+    }
+    glActiveTexture(realUnit);
+
+    return bOk;
+}
+
+void
+useProgram(GLuint id)
+{
+    if (s_state.program == id)
+    {
+        CROSS_CHECK(s_state.program, GL_CURRENT_PROGRAM, "program");
+        g_stateStats.elided();
+        return;
+    }
+
+    glUseProgram(id);
+    s_state.program = id;
+    g_stateStats.issued();
+}
+
+void
+bindVertexArray(GLuint id)
+{
+    if (s_state.vao == id)
+    {
+        CROSS_CHECK(s_state.vao, GL_VERTEX_ARRAY_BINDING, "vertex array");
+        g_stateStats.elided();
+        return;
+    }
+
+    glBindVertexArray(id);
+    s_state.vao = id;
+    g_stateStats.issued();
+}
+
+void
+activeTexture(GLenum unit)
+{
+    if (s_state.activeUnit == unit)
+    {
+        CROSS_CHECK(s_state.activeUnit, GL_ACTIVE_TEXTURE, "active texture");
+        g_stateStats.elided();
+        return;
+    }
+
+    glActiveTexture(unit);
+    s_state.activeUnit = unit;
+    g_stateStats.issued();
+}
+
+void
+bindTexture(GLenum target, GLuint id)
+{
+    const int t = texTargetIdx(target);
+    const u32 unit = s_state.activeUnit - GL_TEXTURE0;
+
+    /* untracked target or unit, or nobody set the active unit through here yet */
+    if (t < 0 || unit >= STATE_MAX_TEXTURE_UNITS)
+    {
+        glBindTexture(target, id);
+        g_stateStats.issued();
+        return;
+    }
+
+    GLuint& cached = s_state.aaTextures[unit][t];
+    if (cached == id)
+    {
+        CROSS_CHECK(cached, s_aTexQueries[t], "texture");
+        g_stateStats.elided();
+        return;
+    }
+
+    glBindTexture(target, id);
+    cached = id;
+    g_stateStats.issued();
+}
+
+void
+bindTextureUnit(GLenum unit, GLenum target, GLuint id)
+{
+    const int t = texTargetIdx(target);
+    const u32 i = unit - GL_TEXTURE0;
+
+    /* don't touch the active unit at all if the binding is already there */
+    if (t >= 0 && i < STATE_MAX_TEXTURE_UNITS && s_state.aaTextures[i][t] == id)
+    {
+#ifndef NDEBUG
+        if (g_bStateCrossCheck)
+        {
+            const GLenum realUnit = query(GL_ACTIVE_TEXTURE);
+            glActiveTexture(unit);
+            CROSS_CHECK(s_state.aaTextures[i][t], s_aTexQueries[t], "texture");
+            glActiveTexture(realUnit);
+        }
+#endif
+        g_stateStats.elided();
+        return;
+    }
+
+    activeTexture(unit);
+    bindTexture(target, id);
+}
+
+void
+bindBuffer(GLenum target, GLuint id)
+{
+    const int b = bufTargetIdx(target);
+    if (b < 0)
+    {
+        glBindBuffer(target, id);
+        g_stateStats.issued();
+        return;
+    }
+
+    GLuint& cached = s_state.aBuffers[b];
+    if (cached == id)
+    {
+        CROSS_CHECK(cached, s_aBufQueries[b], "buffer");
+        g_stateStats.elided();
+        return;
+    }
+
+    glBindBuffer(target, id);
+    cached = id;
+    g_stateStats.issued();
+}
+
+void
+bindBufferBase(GLenum target, GLuint index, GLuint id)
+{
+    /* indexed bindings aren't tracked, but this also sets the generic one */
+    glBindBufferBase(target, index, id);
+    g_stateStats.issued();
+
+    const int b = bufTargetIdx(target);
+    if (b >= 0) s_state.aBuffers[b] = id;
+}
+
+void
+deleteProgram(GLuint id)
+{
+    if (id == 0) return;
+
+    glDeleteProgram(id);
+    /* a program in use is only flagged for deletion, the name could come back from glCreateProgram while it's still bound */
+    if (s_state.program == id) s_state.program = STATE_UNKNOWN;
+    for (auto& e : s_state.aUniforms)
+        if (e.program == id) e = {};
+}
+
+void
+deleteVertexArray(GLuint id)
+{
+    if (id == 0) return;
+
+    glDeleteVertexArrays(1, &id);
+    if (s_state.vao == id) s_state.vao = 0;
+}
+
+void
+deleteTexture(GLuint id)
+{
+    if (id == 0) return;
+
+    glDeleteTextures(1, &id);
+    for (auto& aTargets : s_state.aaTextures)
+        for (auto& bound : aTargets)
+            if (bound == id) bound = 0;
+}
+
+void
+deleteBuffer(GLuint id)
+{
+    if (id == 0) return;
+
+    glDeleteBuffers(1, &id);
+    for (auto& bound : s_state.aBuffers)
+        if (bound == id) bound = 0;
+}
+
+/* true if the write can be skipped, otherwise the entry now holds the new value */
+static bool
+uniformCached(GLint loc, const void* pValue, u32 size, bool bInt)
+{
+    const GLuint program = s_state.program;
+    if (loc < 0 || program == STATE_UNKNOWN || program == 0) return false;
+
+    UniformEntry& e = s_state.aUniforms[(program * 31 + u32(loc)) % STATE_UNIFORM_CACHE_SIZE];
+    if (e.program == program && e.loc == loc && e.size == size && memcmp(e.aValue, pValue, size) == 0)
+    {
+#ifndef NDEBUG
+        if (g_bStateCrossCheck)
+        {
+            alignas(16) u8 aReal[64] {};
+            if (bInt) glGetUniformiv(program, loc, (GLint*)aReal);
+            else glGetUniformfv(program, loc, (GLfloat*)aReal);
+
+            if (memcmp(aReal, pValue, size) != 0)
+            {
+                CERR("gl state: stale uniform {} of program {}\n", loc, program);
+                assert(false);
+            }
+        }
+#endif
+        return true;
+    }
+
+    e.program = program;
+    e.loc = loc;
+    e.size = u8(size);
+    e.bInt = bInt;
+    memcpy(e.aValue, pValue, size);
+
+    return false;
+}
+
+#define UNIFORM_BODY(VALUE_PTR, SIZE, B_INT, CALL)                                                                     \
+    if (uniformCached(loc, VALUE_PTR, SIZE, B_INT))                                                                    \
+    {                                                                                                                  \
+        g_stateStats.elided();                                                                                         \
+        return;                                                                                                        \
+    }                                                                                                                  \
+    CALL;                                                                                                              \
+    g_stateStats.issued();
+
+void
+uniform1i(GLint loc, GLint v)
+{
+    UNIFORM_BODY(&v, sizeof(v), true, glUniform1i(loc, v));
+}
+
+void
+uniform1f(GLint loc, GLfloat v)
+{
+    UNIFORM_BODY(&v, sizeof(v), false, glUniform1f(loc, v));
+}
+
+void
+uniform3fv(GLint loc, const GLfloat* p)
+{
+    UNIFORM_BODY(p, sizeof(f32)*3, false, glUniform3fv(loc, 1, p));
+}
+
+void
+uniform4fv(GLint loc, const GLfloat* p)
+{
+    UNIFORM_BODY(p, sizeof(f32)*4, false, glUniform4fv(loc, 1, p));
+}
+
+void
+uniformMatrix3fv(GLint loc, const GLfloat* p)
+{
+    UNIFORM_BODY(p, sizeof(f32)*9, false, glUniformMatrix3fv(loc, 1, GL_FALSE, p));
+}
+
+void
+uniformMatrix4fv(GLint loc, const GLfloat* p)
+{
+    UNIFORM_BODY(p, sizeof(f32)*16, false, glUniformMatrix4fv(loc, 1, GL_FALSE, p));
+}
+
+#undef UNIFORM_BODY
+#undef CROSS_CHECK
+
+} /* namespace gl */
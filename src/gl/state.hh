@@ -0,0 +1,71 @@
+#pragma once
+
+#include "gl.hh" /* IWYU pragma: keep */
+
+#include "adt/types.hh"
+
+/* Last known binding state of the context, the wrappers skip calls that wouldn't change it.
+ * Anything that binds or deletes programs, vaos, textures or buffers has to go through here
+ * (or call invalidate() after), otherwise the cache goes stale and a needed bind gets elided.
+ * Only one thread at a time owns the context, so there is no locking. */
+namespace gl
+{
+
+using namespace adt;
+
+constexpr u32 STATE_MAX_TEXTURE_UNITS = 16;
+constexpr u32 STATE_UNIFORM_CACHE_SIZE = 256; /* direct mapped, collisions just get issued */
+constexpr GLuint STATE_UNKNOWN = ~0u;
+
+struct StateStats
+{
+    u32 nIssued {};
+    u32 nElided {};
+    u32 nLastIssued {};
+    u32 nLastElided {};
+    u64 nTotalIssued {};
+    u64 nTotalElided {};
+
+    void issued() { ++nIssued; ++nTotalIssued; }
+    void elided() { ++nElided; ++nTotalElided; }
+    void nextFrame() { nLastIssued = nIssued; nLastElided = nElided; nIssued = nElided = 0; }
+};
+
+extern StateStats g_stateStats;
+
+#ifndef NDEBUG
+/* query the real value with glGet* before every elided call and assert it matches */
+extern bool g_bStateCrossCheck;
+#endif
+
+/* forget everything, next call of each kind is issued */
+void invalidate();
+
+/* checks the whole cache against glGet*, true if nothing is stale */
+[[nodiscard]] bool crossCheckAll();
+
+void useProgram(GLuint id);
+void bindVertexArray(GLuint id);
+void activeTexture(GLenum unit); /* GL_TEXTURE0 + i */
+void bindTexture(GLenum target, GLuint id); /* on the active unit */
+void bindTextureUnit(GLenum unit, GLenum target, GLuint id); /* activeTexture() + bindTexture() */
+
+/* element array binding belongs to the vao, those are always issued */
+void bindBuffer(GLenum target, GLuint id);
+void bindBufferBase(GLenum target, GLuint index, GLuint id);
+
+/* delete and drop the id from every binding it had */
+void deleteProgram(GLuint id);
+void deleteVertexArray(GLuint id);
+void deleteTexture(GLuint id);
+void deleteBuffer(GLuint id);
+
+/* for the program in use, skipped when the location already holds the same value */
+void uniform1i(GLint loc, GLint v);
+void uniform1f(GLint loc, GLfloat v);
+void uniform3fv(GLint loc, const GLfloat* p);
+void uniform4fv(GLint loc, const GLfloat* p);
+void uniformMatrix3fv(GLint loc, const GLfloat* p);
+void uniformMatrix4fv(GLint loc, const GLfloat* p);
+
+} /* namespace gl */
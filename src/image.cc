@@ -0,0 +1,390 @@
+#include "image.hh"
+
+#include "adt/file.hh"
+#include "adt/logs.hh"
+#include "pixel.hh"
+#include "png.hh"
+#include "reader/Bin.hh"
+#include "tga.hh"
+
+#include <cstdio>
+#include <cstring>
+#include <immintrin.h>
+
+/* Bitmap file format
+ *
+ * SECTION
+ * Address:Bytes	Name
+ *
+ * HEADER:
+ *	  0:	2		"BM" magic number
+ *	  2:	4		file size
+ *	  6:	4		junk
+ *	 10:	4		Starting address of image data
+ * BITMAP HEADER:
+ *	 14:	4		header size
+ *	 18:	4		width  (signed)
+ *	 22:	4		height (signed)
+ *	 26:	2		Number of color planes
+ *	 28:	2		Bits per pixel
+ *	[...]
+ * [OPTIONAL COLOR PALETTE, NOT PRESENT IN 32 BIT BITMAPS]
+ * BITMAP DATA:
+ *	DATA:	X	Pixels
+ */
+
+namespace texture
+{
+
+Data
+loadBMP(IAllocator* pAlloc, String path, bool flip)
+{
+    reader::Bin p(pAlloc);
+    p.load(path);
+
+    return decodeBMP(pAlloc, p.m_sFile, flip);
+}
+
+Data
+decodeBMP(IAllocator* pAlloc, String sFile, bool flip)
+{
+    u32 imageDataAddress;
+    u32 width;
+    u32 height;
+    u32 nPixels;
+    u16 bitDepth;
+    u8 byteDepth;
+
+    reader::Bin p(pAlloc);
+    p.m_sFile = sFile;
+    p.m_pos = 0;
+
+    auto BM = p.readString(2);
+
+    if (BM != "BM")
+        LOG_FATAL("BM: '{}', bmp file should have 'BM' as first 2 bytes\n", BM);
+
+    p.skipBytes(8);
+    imageDataAddress = p.read32();
+
+#ifdef D_TEXTURE
+    LOG_OK("imageDataAddress: {}\n", imageDataAddress);
+#endif
+
+    p.skipBytes(4);
+    width = p.read32();
+    height = p.read32();
+#ifdef D_TEXTURE
+    LOG_OK("width: {}, height: {}\n", width, height);
+#endif
+
+    [[maybe_unused]] auto colorPlane = p.read16();
+#ifdef D_TEXTURE
+    LOG_OK("colorPlane: {}\n", colorPlane);
+#endif
+
+    GLint format = GL_RGB;
+    bitDepth = p.read16();
+#ifdef D_TEXTURE
+    LOG_OK("bitDepth: {}\n", bitDepth);
+#endif
+
+    switch (bitDepth)
+    {
+        case 24:
+            format = GL_RGB;
+            break;
+
+        case 32:
+            format = GL_RGBA;
+            break;
+
+        default:
+            LOG_WARN("support only for 32 and 24 bit bmp's, read '{}', setting to GL_RGB\n", bitDepth);
+            break;
+    }
+
+    bitDepth = 32; /* use RGBA anyway */
+    nPixels = width * height;
+    byteDepth = bitDepth / 8;
+#ifdef D_TEXTURE
+    LOG_OK("nPixels: {}, byteDepth: {}, format: {}\n", nPixels, byteDepth, format);
+#endif
+    Vec<u8> pixels(pAlloc, nPixels * byteDepth);
+
+    p.m_pos = imageDataAddress;
+    const u8* pSrc = (const u8*)(&p[p.m_pos]);
+
+    /* rows are padded to 4 bytes */
+    switch (format)
+    {
+        default:
+        case GL_RGB:
+            pixel::BGRtoRGBA(pixels.data(), width*4, pSrc, align(width*3, 4), width, height, flip);
+            format = GL_RGBA;
+            break;
+
+        case GL_RGBA:
+            pixel::BGRAtoRGBA(pixels.data(), width*4, pSrc, width*4, width, height, flip);
+            break;
+    }
+
+    return {
+        .aData = pixels,
+        .width = width,
+        .height = height,
+        .bitDepth = bitDepth,
+        .format = format
+    };
+}
+
+/* 15/16 bit tga pixels are 5:5:5 bgr with one attribute bit */
+static inline void
+tga16toRGBA(u8* pDst, u16 v, bool bAlpha)
+{
+    const u32 r = (v >> 10) & 0x1f, g = (v >> 5) & 0x1f, b = v & 0x1f;
+    pDst[0] = u8((r << 3) | (r >> 2));
+    pDst[1] = u8((g << 3) | (g >> 2));
+    pDst[2] = u8((b << 3) | (b >> 2));
+    pDst[3] = bAlpha && !(v & 0x8000) ? 0 : 0xff;
+}
+
+/* one stored pixel of bytesPP bytes into RGBA */
+static inline void
+tgaPixel(u8* pDst, const u8* pSrc, u32 bytesPP, bool bAlpha16)
+{
+    switch (bytesPP)
+    {
+        case 1: pDst[0] = pDst[1] = pDst[2] = pSrc[0]; pDst[3] = 0xff; break;
+        case 2: tga16toRGBA(pDst, u16(pSrc[0] | (pSrc[1] << 8)), bAlpha16); break;
+        case 3: pDst[0] = pSrc[2]; pDst[1] = pSrc[1]; pDst[2] = pSrc[0]; pDst[3] = 0xff; break;
+        case 4: pDst[0] = pSrc[2]; pDst[1] = pSrc[1]; pDst[2] = pSrc[0]; pDst[3] = pSrc[3]; break;
+    }
+}
+
+Data
+decodeTGA(IAllocator* pAlloc, String sFile, bool flip)
+{
+    auto bad = [&](const char* ntsWhy) -> Data {
+        LOG_WARN("tga: {}\n", ntsWhy);
+        (void)ntsWhy;
+        return {};
+    };
+
+    if (sFile.getSize() < ssize(sizeof(tga::Header))) return bad("truncated header");
+
+    tga::Header h;
+    memcpy(&h, sFile.data(), sizeof(h));
+
+    const u8* p = (const u8*)sFile.data() + sizeof(h) + h.idLen;
+    const u8* pEnd = (const u8*)sFile.data() + sFile.getSize();
+
+    const bool bRLE = h.dataTypeCode >= tga::RLE_COLOR_MAPPED;
+    const u8 eType = bRLE ? h.dataTypeCode - 8 : h.dataTypeCode;
+    if (eType != tga::COLOR_MAPPED && eType != tga::TRUE_COLOR && eType != tga::GRAY)
+        return bad("unsupported data type");
+
+    const u32 width = h.width, height = h.height;
+    if (width == 0 || height == 0) return bad("empty image");
+
+    const u32 bytesPP = (h.bitsPerPixel + 7) / 8;
+    if (eType == tga::GRAY && bytesPP != 1) return bad("unsupported gray depth");
+    if (eType == tga::TRUE_COLOR && (bytesPP < 2 || bytesPP > 4)) return bad("unsupported bits per pixel");
+    if (eType == tga::COLOR_MAPPED && (h.colorMapType != 1 || (bytesPP != 1 && bytesPP != 2)))
+        return bad("bad color map");
+
+    /* color map is converted up front, indices then are just table lookups */
+    u32 aMap[256] {};
+    if (h.colorMapType == 1)
+    {
+        const u32 mapBytesPP = (h.colorMapDepth + 7) / 8;
+        const u32 mapSize = h.colorMapLenght * mapBytesPP;
+        if (mapBytesPP < 2 || mapBytesPP > 4 || pEnd - p < ssize(mapSize)) return bad("bad color map");
+
+        if (eType == tga::COLOR_MAPPED)
+        {
+            for (u32 i = 0; i < h.colorMapLenght && h.colorMapOrigin + i < 256; ++i)
+                tgaPixel((u8*)&aMap[h.colorMapOrigin + i], p + i*mapBytesPP, mapBytesPP, h.colorMapDepth == 16);
+        }
+
+        p += mapSize;
+    }
+
+    const bool bAlpha16 = (h.imageDescriptor & 0xf) != 0;
+    const bool bTopDown = h.imageDescriptor & tga::DESCRIPTOR_TOP_TO_BOTTOM;
+    const bool bMirror = h.imageDescriptor & tga::DESCRIPTOR_RIGHT_TO_LEFT;
+
+    /* same convention as bmp: without flip row 0 is the bottom one */
+    const bool bVertFlip = bTopDown != flip;
+
+    Vec<u8> pixels(pAlloc, width * height * 4);
+    pixels.setSize(width * height * 4);
+    const ssize stride = ssize(width) * 4;
+    auto dstRow = [&](u32 y) { return pixels.data() + (bVertFlip ? height - 1 - y : y)*stride; };
+
+    auto writePixel = [&](u8* pDst, const u8* pSrc) {
+        if (eType == tga::COLOR_MAPPED)
+        {
+            const u32 idx = bytesPP == 1 ? pSrc[0] : (pSrc[0] | (pSrc[1] << 8)) & 0xff;
+            memcpy(pDst, &aMap[idx], 4);
+        }
+        else tgaPixel(pDst, pSrc, bytesPP, bAlpha16);
+    };
+
+    if (!bRLE)
+    {
+        if (pEnd - p < ssize(width) * height * bytesPP) return bad("truncated pixel data");
+
+        if (eType == tga::TRUE_COLOR && bytesPP >= 3)
+        {
+            if (bytesPP == 3) pixel::BGRtoRGBA(pixels.data(), stride, p, width*3, width, height, bVertFlip);
+            else pixel::BGRAtoRGBA(pixels.data(), stride, p, width*4, width, height, bVertFlip);
+        }
+        else
+        {
+            for (u32 y = 0; y < height; ++y)
+            {
+                u8* pRow = dstRow(y);
+                const u8* pSrc = p + usize(y)*width*bytesPP;
+                for (u32 x = 0; x < width; ++x) writePixel(pRow + x*4, pSrc + x*bytesPP);
+            }
+        }
+    }
+    else
+    {
+        /* packets may run across row ends, so decode as one linear stream */
+        u32 x = 0, y = 0;
+        u8* pRow = dstRow(0);
+
+        auto advance = [&] {
+            if (++x == width)
+            {
+                x = 0;
+                if (++y < height) pRow = dstRow(y);
+            }
+        };
+
+        while (y < height)
+        {
+            if (p >= pEnd) return bad("truncated rle data");
+
+            const u8 packet = *p++;
+            const u32 count = (packet & 0x7f) + 1;
+
+            if (packet & 0x80)
+            {
+                if (pEnd - p < ssize(bytesPP)) return bad("truncated rle data");
+
+                u8 aPx[4] {};
+                writePixel(aPx, p);
+                p += bytesPP;
+                for (u32 i = 0; i < count && y < height; ++i)
+                {
+                    memcpy(pRow + x*4, aPx, 4);
+                    advance();
+                }
+            }
+            else
+            {
+                if (pEnd - p < ssize(count * bytesPP)) return bad("truncated rle data");
+
+                for (u32 i = 0; i < count && y < height; ++i)
+                {
+                    writePixel(pRow + x*4, p);
+                    p += bytesPP;
+                    advance();
+                }
+            }
+        }
+    }
+
+    if (bMirror)
+    {
+        for (u32 y = 0; y < height; ++y)
+        {
+            u32* pRow = (u32*)(pixels.data() + y*stride);
+            for (u32 l = 0, r = width - 1; l < r; ++l, --r) utils::swap(&pRow[l], &pRow[r]);
+        }
+    }
+
+    return {
+        .aData = pixels,
+        .width = width,
+        .height = height,
+        .bitDepth = 32,
+        .format = GL_RGBA
+    };
+}
+
+Data
+decodePNG(IAllocator* pAlloc, String sFile, bool flip)
+{
+    png::Info info {};
+    u8* pPixels = png::decode(pAlloc, sFile, !flip, &info);
+    if (!pPixels) return {};
+
+    /* adopt the decoder's buffer, no copy */
+    Vec<u8> aData {};
+    aData.m_pAlloc = pAlloc;
+    aData.base.m_pData = pPixels;
+    aData.base.m_size = aData.base.m_capacity = ssize(info.width) * info.height * 4;
+
+    return {
+        .aData = aData,
+        .width = info.width,
+        .height = info.height,
+        .bitDepth = 32,
+        .format = GL_RGBA
+    };
+}
+
+Data
+decodeImage(IAllocator* pAlloc, String sFile, bool flip)
+{
+    if (sFile.getSize() >= 2 && sFile[0] == 'B' && sFile[1] == 'M') return decodeBMP(pAlloc, sFile, flip);
+    if (png::isPNG(sFile)) return decodePNG(pAlloc, sFile, flip);
+
+    /* tga has no magic, anything else goes to the tga decoder which checks the header */
+    return decodeTGA(pAlloc, sFile, flip);
+}
+
+Data
+loadImage(IAllocator* pAlloc, String path, bool flip)
+{
+    Opt<String> rsFile = file::load(pAlloc, path);
+    if (!rsFile) return {};
+
+    Data ret = decodeImage(pAlloc, rsFile.value(), flip);
+    pAlloc->free(rsFile.value().data());
+
+    return ret;
+}
+
+THREAD_STATUS
+DecodeSubmit(void* pArg)
+{
+    auto* a = (DecodeArg*)pArg;
+    a->data = loadImage(a->pAlloc, a->sPath, a->bFlip);
+
+    return {};
+}
+
+#ifndef NDEBUG
+[[maybe_unused]] static void
+printPack(String s, __m128i m)
+{
+    u32 f[4];
+    memcpy(f, &m, sizeof(f));
+    fprintf(stderr, "'%.*s': %08x, %08x, %08x, %08x\n", (int)s.getSize(), s.data(), f[0], f[1], f[2], f[3]);
+};
+#endif
+
+[[maybe_unused]] static u32
+swapRedBlueBits(u32 col)
+{
+    u32 r = col & 0x00'ff'00'00;
+    u32 b = col & 0x00'00'00'ff;
+    return (col & 0xff'00'ff'00) | (r >> (4*4)) | (b << (4*4));
+};
+
+} /* namespace texture */
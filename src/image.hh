@@ -0,0 +1,53 @@
+#pragma once
+
+#include "adt/IAllocator.hh"
+#include "adt/String.hh"
+#include "adt/Thread.hh"
+#include "adt/Vec.hh"
+#include "gl/gl.hh" /* IWYU pragma: keep */
+
+/* Image decoding, no gl calls in here so offline tools can link it. */
+namespace texture
+{
+
+using namespace adt;
+
+struct Data
+{
+    Vec<u8> aData;
+    u32 width;
+    u32 height;
+    u16 bitDepth;
+    GLint format;
+};
+
+Data loadBMP(IAllocator* pAlloc, String path, bool flip);
+
+/* same as loadBMP() for a file that's already in memory */
+Data decodeBMP(IAllocator* pAlloc, String sFile, bool flip);
+
+/* all of them return RGBA8 with the same row order as decodeBMP(), empty Data (width == 0) on error */
+
+/* uncompressed and rle; true color, gray and color mapped; 8/15/16/24/32 bit */
+Data decodeTGA(IAllocator* pAlloc, String sFile, bool flip);
+
+/* see png.hh */
+Data decodePNG(IAllocator* pAlloc, String sFile, bool flip);
+
+/* picks the decoder by the file contents */
+Data decodeImage(IAllocator* pAlloc, String sFile, bool flip);
+
+Data loadImage(IAllocator* pAlloc, String path, bool flip);
+
+/* loadImage() on a ThreadPool worker, pAlloc has to be thread safe or owned by this arg */
+struct DecodeArg
+{
+    IAllocator* pAlloc {};
+    String sPath {};
+    bool bFlip {};
+    Data data {};
+};
+
+THREAD_STATUS DecodeSubmit(void* pArg);
+
+} /* namespace texture */
@@ -151,7 +151,7 @@ Lexer::nextStringNoQuotes()
 Token
 Lexer::nextNumber()
 {
-    assert(std::isdigit(m_sJson[m_pos]));
+    assert(std::isdigit(m_sJson[m_pos]) || m_sJson[m_pos] == '-' || m_sJson[m_pos] == '+');
 
     auto fPos = m_pos;
     TOKEN_TYPE eType = TOKEN_TYPE::NUMBER;
@@ -63,8 +63,11 @@ inline const Command inl_aCommands[] {
     {false, KEY_F,     (void*)controls::toggleFullscreen,  {ARG_TYPE::NONE}                     },
     {false, KEY_V,     (void*)controls::toggleVSync,       {ARG_TYPE::NONE}                     },
     {false, KEY_SPACE, (void*)controls::releaseBall,       {ARG_TYPE::NONE}                     },
+    {false, KEY_M,     (void*)controls::spawnBalls,        {ARG_TYPE::LONG_, {.l = 8}}          },
     {false, KEY_J,     (void*)controls::toggleDebugScreen, {ARG_TYPE::NONE}                     },
     {false, KEY_B,     (void*)controls::toggleStepDebug,   {ARG_TYPE::NONE}                     },
+    {false, KEY_F11,   (void*)controls::printAllocStats,   {ARG_TYPE::NONE}                     },
+    {false, KEY_F12,   (void*)controls::writeTrace,        {ARG_TYPE::NONE}                     },
 };
 
 inline const Command inl_aModCommands[] {
@@ -72,6 +75,11 @@ inline const Command inl_aModCommands[] {
     {true, KEY_LEFTALT,   (void*)controls::mulDirection, {ARG_TYPE::F32_, {.f = 0.5f}}},
 };
 
+/* keys with commands that change the game state, what replay::Recorder logs (16 at most) */
+inline const u16 inl_aReplayKeys[] {
+    KEY_A, KEY_D, KEY_SPACE, KEY_B, KEY_LEFTSHIFT, KEY_LEFTALT, KEY_M
+};
+
 inline void
 Command::exec() const
 {
@@ -0,0 +1,357 @@
+#include "level.hh"
+
+#include "cook.hh"
+
+#include "adt/defer.hh"
+#include "adt/logs.hh"
+#include "adt/utils.hh"
+
+#include <cstdio>
+#include <cstring>
+
+namespace level
+{
+
+static void
+pushBytes(IAllocator* pAlloc, VecBase<u8>* pV, const void* p, ssize size)
+{
+    const ssize off = pV->getSize();
+    pV->setSize(pAlloc, off + size);
+    memcpy(pV->data() + off, p, size);
+}
+
+static void
+pushLEB128(IAllocator* pAlloc, VecBase<u8>* pV, u64 x)
+{
+    do
+    {
+        u8 b = x & 0x7f;
+        x >>= 7;
+        if (x) b |= 0x80;
+        pV->push(pAlloc, b);
+    }
+    while (x);
+}
+
+bool
+parseText(IAllocator* pAlloc, String sText, Layers* pOut)
+{
+    /* char -> COLOR, -1: not a tile */
+    s8 aMap[256];
+    memset(aMap, -1, sizeof(aMap));
+    aMap[u8('.')] = aMap[u8(' ')] = 0;
+    for (int c = '0'; c <= '9' && c - '0' < int(game::COLOR::ESIZE); ++c)
+        aMap[c] = s8(c - '0');
+
+    Layers ret {};
+    s8* pLayer = nullptr;
+    u32 row = 0;
+    u32 lineNo = 0;
+
+    auto bad = [&](const char* ntsWhy) {
+        LOG_WARN("line {}: {}\n", lineNo, ntsWhy);
+        (void)ntsWhy;
+        return false;
+    };
+
+    ssize pos = 0;
+    while (pos < sText.getSize())
+    {
+        ssize end = pos;
+        while (end < sText.getSize() && sText[end] != '\n') ++end;
+
+        String sLine(sText.data() + pos, end - pos);
+        if (sLine.getSize() > 0 && sLine.last() == '\r') --sLine.m_size;
+        pos = end + 1;
+        ++lineNo;
+
+        /* inside a layer every line is a row, '#' included */
+        if (pLayer && row < ret.height)
+        {
+            if (sLine.getSize() != ssize(ret.width)) return bad("row length doesn't match the width");
+
+            s8* pRow = pLayer + usize(row)*ret.width;
+            for (u32 x = 0; x < ret.width; ++x)
+            {
+                const s8 t = aMap[u8(sLine[x])];
+                if (t < 0) return bad("unknown tile");
+                pRow[x] = t;
+            }
+
+            ++row;
+            continue;
+        }
+
+        if (sLine.getSize() == 0 || sLine[0] == '#') continue;
+
+        char aBuff[64] {};
+        memcpy(aBuff, sLine.data(), utils::min(sLine.getSize(), ssize(sizeof(aBuff) - 1)));
+
+        if (sLine.beginsWith("size "))
+        {
+            if (ret.width) return bad("second 'size'");
+            if (sscanf(aBuff, "size %u %u", &ret.width, &ret.height) != 2) return bad("expected 'size W H'");
+            if (ret.width == 0 || ret.height == 0 || ret.width > MAX_SIDE || ret.height > MAX_SIDE)
+                return bad("size is out of range");
+        }
+        else if (sLine.beginsWith("tile "))
+        {
+            u32 col = 0;
+            if (sLine.getSize() < 7 || sscanf(aBuff + 6, "%u", &col) != 1) return bad("expected 'tile C N'");
+            if (col >= u32(game::COLOR::ESIZE)) return bad("no such color");
+            aMap[u8(sLine[5])] = s8(col);
+        }
+        else if (sLine == "layer")
+        {
+            if (!ret.width) return bad("'layer' before 'size'");
+            if (ret.aLayers.getSize() >= MAX_LAYERS) return bad("too many layers");
+
+            pLayer = (s8*)pAlloc->zalloc(usize(ret.width) * ret.height, 1);
+            ret.aLayers.push(pAlloc, pLayer);
+            row = 0;
+        }
+        else return bad("unknown directive");
+    }
+
+    if (pLayer && row < ret.height) return bad("layer ends early");
+    if (ret.aLayers.getSize() == 0) return bad("no layers");
+
+    *pOut = ret;
+    return true;
+}
+
+game::Level
+composite(IAllocator* pAlloc, const Layers& layers)
+{
+    const usize nTiles = usize(layers.width) * layers.height;
+    s8* pTiles = (s8*)pAlloc->malloc(nTiles, 1);
+    memcpy(pTiles, layers.aLayers[0], nTiles);
+
+    for (ssize l = 1; l < layers.aLayers.getSize(); ++l)
+    {
+        const s8* pSrc = layers.aLayers[l];
+        for (usize i = 0; i < nTiles; ++i)
+            if (pSrc[i]) pTiles[i] = pSrc[i];
+    }
+
+    return {.width = layers.width, .height = layers.height, .aTiles = pTiles};
+}
+
+VecBase<u8>
+encode(IAllocator* pAlloc, const Layers& layers)
+{
+    const usize nTiles = usize(layers.width) * layers.height;
+    const u32 nLayers = u32(layers.aLayers.getSize());
+
+    /* palette of the colors that are used, 0 stays empty */
+    u8 aColorToIdx[256] {};
+    u8 aPalette[256] {};
+    u32 nPalette = 1;
+    for (const s8* pLayer : layers.aLayers)
+    {
+        for (usize i = 0; i < nTiles; ++i)
+        {
+            const u8 c = u8(pLayer[i]);
+            if (c && !aColorToIdx[c])
+            {
+                aColorToIdx[c] = u8(nPalette);
+                aPalette[nPalette++] = c;
+            }
+        }
+    }
+
+    const Header h {
+        .magic = MAGIC,
+        .version = VERSION,
+        .width = layers.width,
+        .height = layers.height,
+        .nPalette = nPalette,
+        .nLayers = nLayers,
+    };
+
+    VecBase<u8> aOut(pAlloc, sizeof(Header) + 256 + nTiles / 4);
+    pushBytes(pAlloc, &aOut, &h, sizeof(h));
+    pushBytes(pAlloc, &aOut, aPalette, nPalette);
+    while (aOut.getSize() % 8) aOut.push(pAlloc, u8(0));
+
+    const ssize descOff = aOut.getSize();
+    aOut.setSize(pAlloc, descOff + nLayers*sizeof(LayerDesc));
+
+    for (u32 l = 0; l < nLayers; ++l)
+    {
+        const s8* pLayer = layers.aLayers[l];
+        const u64 start = aOut.getSize();
+
+        for (usize i = 0; i < nTiles;)
+        {
+            usize j = i + 1;
+            while (j < nTiles && pLayer[j] == pLayer[i]) ++j;
+
+            pushLEB128(pAlloc, &aOut, j - i);
+            aOut.push(pAlloc, aColorToIdx[u8(pLayer[i])]);
+            i = j;
+        }
+
+        const LayerDesc d {.offset = start, .size = aOut.getSize() - start};
+        memcpy(aOut.data() + descOff + l*sizeof(LayerDesc), &d, sizeof(d));
+    }
+
+    return aOut;
+}
+
+/* pTiles is zeroed, empty runs are skipped so layers draw over each other */
+static bool
+decodeLayer(const u8* p, const u8* pEnd, const u8* aPalette, u32 nPalette, s8* pTiles, usize nTiles, u32* pNRuns)
+{
+    usize i = 0;
+    u32 nRuns = 0;
+
+    while (i < nTiles)
+    {
+        u64 len = 0;
+        for (u32 shift = 0;; shift += 7)
+        {
+            if (p >= pEnd || shift > 35) return false;
+
+            const u8 b = *p++;
+            len |= u64(b & 0x7f) << shift;
+            if (!(b & 0x80)) break;
+        }
+
+        if (p >= pEnd) return false;
+        const u8 idx = *p++;
+
+        if (len == 0 || len > nTiles - i || idx >= nPalette) return false;
+        if (idx)
+        {
+            /* most runs are short, skip the call */
+            if (len <= 16) for (u64 k = 0; k < len; ++k) pTiles[i + k] = s8(aPalette[idx]);
+            else memset(pTiles + i, aPalette[idx], len);
+        }
+
+        i += len;
+        ++nRuns;
+    }
+
+    *pNRuns += nRuns;
+    return p == pEnd;
+}
+
+static bool
+decodeBinary(IAllocator* pAlloc, [[maybe_unused]] const char* ntsPath, const u8* pData, usize size, game::Level* pOut, Stats* pStats)
+{
+    auto bad = [&](const char* ntsWhy) {
+        LOG_WARN("'{}': {}\n", ntsPath, ntsWhy);
+        (void)ntsWhy;
+        return false;
+    };
+
+    Header h;
+    memcpy(&h, pData, sizeof(h));
+
+    if (h.version != VERSION) return bad("version mismatch");
+    if (h.width == 0 || h.height == 0 || h.width > MAX_SIDE || h.height > MAX_SIDE) return bad("size is out of range");
+    if (h.nPalette == 0 || h.nPalette > 256 || h.nLayers == 0 || h.nLayers > MAX_LAYERS) return bad("bad header");
+
+    const u8* aPalette = pData + sizeof(Header);
+    const usize descOff = align8(sizeof(Header) + h.nPalette);
+    if (descOff + h.nLayers*sizeof(LayerDesc) > size) return bad("truncated");
+
+    for (u32 i = 1; i < h.nPalette; ++i)
+        if (aPalette[i] >= u8(game::COLOR::ESIZE)) return bad("no such color in the palette");
+
+    const usize nTiles = usize(h.width) * h.height;
+    s8* pTiles = (s8*)pAlloc->zalloc(nTiles, 1);
+
+    for (u32 l = 0; l < h.nLayers; ++l)
+    {
+        LayerDesc d;
+        memcpy(&d, pData + descOff + l*sizeof(LayerDesc), sizeof(d));
+
+        if (d.offset > size || d.size > size - d.offset) return bad("layer is out of the file");
+
+        const u8* p = pData + d.offset;
+        if (!decodeLayer(p, p + d.size, aPalette, h.nPalette, pTiles, nTiles, &pStats->nRuns))
+            return bad("broken run stream");
+    }
+
+    pStats->nLayers = h.nLayers;
+    *pOut = {.width = h.width, .height = h.height, .aTiles = pTiles};
+    return true;
+}
+
+bool
+load(IAllocator* pAlloc, const char* ntsPath, game::Level* pOut, Stats* pStats)
+{
+    const s64 t0 = utils::timeNowUS();
+
+    cook::Mapping m = cook::mapFile(ntsPath);
+    if (!m)
+    {
+        LOG_WARN("unable to map '{}'\n", ntsPath);
+        return false;
+    }
+    defer( m.unmap() );
+
+    const s64 t1 = utils::timeNowUS();
+
+    Stats st {.fileBytes = m.m_size, .mapUS = t1 - t0};
+    game::Level lvl {};
+
+    u32 magic = 0;
+    if (m.m_size >= sizeof(Header)) memcpy(&magic, m.m_pData, sizeof(magic));
+
+    if (magic == MAGIC)
+    {
+        if (!decodeBinary(pAlloc, ntsPath, m.m_pData, m.m_size, &lvl, &st)) return false;
+    }
+    else
+    {
+        Layers layers {};
+        if (!parseText(pAlloc, String((char*)m.m_pData, m.m_size), &layers))
+        {
+            LOG_WARN("'{}': not a level\n", ntsPath);
+            return false;
+        }
+
+        lvl = composite(pAlloc, layers);
+        st.nLayers = u32(layers.aLayers.getSize());
+    }
+
+    /* local counter, s8 stores could alias st */
+    const usize nTiles = usize(lvl.width) * lvl.height;
+    u32 nBlocks = 0;
+    for (usize i = 0; i < nTiles; ++i)
+        nBlocks += lvl.aTiles[i] != 0;
+    st.nBlocks = nBlocks;
+
+    st.decodeUS = utils::timeNowUS() - t1;
+
+    *pOut = lvl;
+    if (pStats) *pStats = st;
+
+    return true;
+}
+
+bool
+cookText(IAllocator* pScratch, String sSrcPath)
+{
+    char aSrc[256] {};
+    memcpy(aSrc, sSrcPath.data(), utils::min(sSrcPath.getSize(), ssize(sizeof(aSrc) - 1)));
+
+    cook::Mapping m = cook::mapFile(aSrc);
+    if (!m) return false;
+    defer( m.unmap() );
+
+    Layers layers {};
+    if (!parseText(pScratch, String((char*)m.m_pData, m.m_size), &layers)) return false;
+
+    VecBase<u8> aBin = encode(pScratch, layers);
+
+    char aPath[256] {};
+    cook::cookedPathExt(aPath, sizeof(aPath), sSrcPath, ".blvl");
+
+    return cook::writeFile(aPath, aBin.data(), aBin.getSize());
+}
+
+} /* namespace level */
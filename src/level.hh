@@ -0,0 +1,84 @@
+#pragma once
+
+#include "game.hh"
+
+#include "adt/String.hh"
+#include "adt/Vec.hh"
+
+using namespace adt;
+
+/* Level files, two flavors of the same thing:
+ *
+ * Text, for authoring (test-assets/levels/NAME.lvl):
+ *     # comment
+ *     size 15 10
+ *     tile # 4       (optional, '#' means COLOR 4 from here on)
+ *     layer
+ *     3333440001...  (height rows of width tiles, top row first)
+ *
+ * '.' and ' ' are empty, '0'-'9' are COLOR values unless redefined. Later layers draw over earlier ones,
+ * empty tiles let the ones below through.
+ *
+ * Binary (cooked/NAME.lvl.blvl, written by the cook tool):
+ *     Header, u8 palette[nPalette] (padded to 8), LayerDesc[nLayers], run streams.
+ * A run stream is (LEB128 length, u8 palette idx) pairs covering width*height tiles, palette idx 0 is always empty.
+ *
+ * load() maps the file and tells the two apart by the magic. */
+namespace level
+{
+
+constexpr u32 MAGIC = 0x564c4b42; /* "BKLV" */
+constexpr u32 VERSION = 1;
+constexpr u32 MAX_SIDE = 1 << 14;
+constexpr u32 MAX_LAYERS = 16;
+
+struct Header
+{
+    u32 magic {};
+    u32 version {};
+    u32 width {};
+    u32 height {};
+    u32 nPalette {};
+    u32 nLayers {};
+};
+
+struct LayerDesc
+{
+    u64 offset {}; /* from the start of the file */
+    u64 size {};
+};
+
+struct Stats
+{
+    u64 fileBytes {};
+    u32 nLayers {};
+    u32 nRuns {};
+    u32 nBlocks {};
+    s64 mapUS {};
+    s64 decodeUS {};
+};
+
+/* every layer is a full width*height grid of COLOR values */
+struct Layers
+{
+    u32 width {};
+    u32 height {};
+    VecBase<s8*> aLayers {};
+};
+
+/* false with a warning on anything malformed */
+[[nodiscard]] bool parseText(IAllocator* pAlloc, String sText, Layers* pOut);
+
+/* later layers over earlier ones, into one grid from pAlloc */
+[[nodiscard]] game::Level composite(IAllocator* pAlloc, const Layers& layers);
+
+/* whole binary file, one run stream per layer */
+[[nodiscard]] VecBase<u8> encode(IAllocator* pAlloc, const Layers& layers);
+
+/* text or binary, the tiles end up in pAlloc, false on failure */
+[[nodiscard]] bool load(IAllocator* pAlloc, const char* ntsPath, game::Level* pOut, Stats* pStats = nullptr);
+
+/* text source -> cooked binary next to the textures (cook::cookedPathExt(..., ".blvl")) */
+bool cookText(IAllocator* pScratch, String sSrcPath);
+
+} /* namespace level */
@@ -1,6 +1,7 @@
 #include "adt/FreeList.hh"
 #include "app.hh"
 #include "frame.hh"
+#include "game.hh"
 
 #include <clocale>
 
@@ -25,6 +26,18 @@ startup()
 {
     setlocale(LC_ALL, "");
 
+    /* --level applies to both, replay needs the level it was recorded on */
+    const char* ntsReplayPath = nullptr;
+    for (int i = 1; i < app::g_argc - 1; ++i)
+    {
+        const String sArg = app::g_argv[i];
+        if (sArg == "--level") game::g_ntsLevelPath = app::g_argv[i + 1];
+        else if (sArg == "--replay") ntsReplayPath = app::g_argv[i + 1];
+    }
+
+    /* headless, no window, audio or threads */
+    if (ntsReplayPath) return frame::runReplay(ntsReplayPath);
+
     FreeList alloc(SIZE_1M);
     defer( alloc.freeAll() );
 
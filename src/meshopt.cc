@@ -0,0 +1,520 @@
+#include "meshopt.hh"
+
+#include "adt/Arena.hh"
+#include "adt/OsAllocator.hh"
+#include "adt/defer.hh"
+#include "adt/hash.hh"
+#include "adt/logs.hh"
+#include "adt/prof.hh"
+#include "adt/utils.hh"
+
+#include <cmath>
+#include <cstring>
+
+namespace meshopt
+{
+
+void
+Packed::destroy()
+{
+    if (m_map) m_map.unmap();
+    else if (m_pAlloc) m_pAlloc->free((void*)m_pData);
+
+    *this = {};
+}
+
+CacheStats
+analyzeCache(const u32* pIdxs, u32 nIdxs, u32 nVerts, u32 cacheSize)
+{
+    if (nIdxs < 3 || nVerts == 0) return {};
+
+    /* fifo without the queue: a vertex stays cached until cacheSize misses happen after its own */
+    u32* aEntered = (u32*)OsAllocatorGet()->zalloc(nVerts, sizeof(u32));
+    defer( OsAllocatorGet()->free(aEntered) );
+
+    u32 nMisses = 0;
+    for (u32 i = 0; i < nIdxs; ++i)
+    {
+        const u32 v = pIdxs[i];
+        if (aEntered[v] == 0 || nMisses - aEntered[v] >= cacheSize)
+            aEntered[v] = ++nMisses;
+    }
+
+    return {
+        .acmr = f32(nMisses) / f32(nIdxs / 3),
+        .atvr = f32(nMisses) / f32(nVerts),
+    };
+}
+
+void
+tipsify(IAllocator* pScratch, u32* pDst, const u32* pIdxs, u32 nIdxs, u32 nVerts, u32 cacheSize)
+{
+    const u32 nTris = nIdxs / 3;
+    if (nTris == 0) return;
+
+    /* vertex -> triangles */
+    u32* aLive = (u32*)pScratch->zalloc(nVerts, sizeof(u32));
+    u32* aOffsets = (u32*)pScratch->zalloc(nVerts + 1, sizeof(u32));
+    u32* aAdj = (u32*)pScratch->malloc(nTris * 3, sizeof(u32));
+
+    for (u32 i = 0; i < nTris * 3; ++i) ++aLive[pIdxs[i]];
+    for (u32 v = 0; v < nVerts; ++v) aOffsets[v + 1] = aOffsets[v] + aLive[v];
+
+    {
+        u32* aCursors = (u32*)pScratch->malloc(nVerts, sizeof(u32));
+        memcpy(aCursors, aOffsets, nVerts * sizeof(u32));
+        for (u32 i = 0; i < nTris * 3; ++i) aAdj[aCursors[pIdxs[i]]++] = i / 3;
+    }
+
+    u32* aCacheTime = (u32*)pScratch->zalloc(nVerts, sizeof(u32));
+    u8* aEmitted = (u8*)pScratch->zalloc(nTris, 1);
+    u32* aDeadEnd = (u32*)pScratch->malloc(nTris * 3, sizeof(u32));
+    u32* aCandidates = (u32*)pScratch->malloc(nTris * 3, sizeof(u32));
+
+    u32 time = cacheSize + 1;
+    u32 nDeadEnd = 0;
+    u32 cursor = 0;
+    u32 nOut = 0;
+    s64 fan = pIdxs[0];
+
+    while (fan >= 0)
+    {
+        /* every triangle around the fanning vertex */
+        u32 nCandidates = 0;
+        for (u32 k = aOffsets[fan]; k < aOffsets[fan + 1]; ++k)
+        {
+            const u32 t = aAdj[k];
+            if (aEmitted[t]) continue;
+
+            for (u32 c = 0; c < 3; ++c)
+            {
+                const u32 v = pIdxs[t*3 + c];
+                pDst[nOut++] = v;
+                aDeadEnd[nDeadEnd++] = v;
+                aCandidates[nCandidates++] = v;
+                --aLive[v];
+
+                if (time - aCacheTime[v] > cacheSize)
+                    aCacheTime[v] = time++;
+            }
+
+            aEmitted[t] = 1;
+        }
+
+        /* next fan: the oldest candidate that would still be cached after its remaining triangles */
+        s64 best = -1;
+        s64 bestPriority = -1;
+        for (u32 i = 0; i < nCandidates; ++i)
+        {
+            const u32 v = aCandidates[i];
+            if (aLive[v] == 0) continue;
+
+            s64 priority = 0;
+            if (s64(time) - aCacheTime[v] + 2*s64(aLive[v]) <= s64(cacheSize))
+                priority = s64(time) - aCacheTime[v];
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        /* dead end: recently used vertices first, then whatever is left in input order */
+        while (best < 0 && nDeadEnd > 0)
+        {
+            const u32 v = aDeadEnd[--nDeadEnd];
+            if (aLive[v] > 0) best = v;
+        }
+        while (best < 0 && cursor < nVerts)
+        {
+            if (aLive[cursor] > 0) best = cursor;
+            else ++cursor;
+        }
+
+        fan = best;
+    }
+
+    ADT_ASSERT(nOut == nTris * 3, "nOut: %u, nTris: %u", nOut, nTris);
+}
+
+u32
+reorderFetch(IAllocator* pScratch, u8* pDstVerts, u32* pIdxs, u32 nIdxs, const u8* pSrcVerts, u32 nVerts, u32 stride)
+{
+    u32* aRemap = (u32*)pScratch->malloc(nVerts, sizeof(u32));
+    memset(aRemap, 0xff, nVerts * sizeof(u32));
+
+    u32 nKept = 0;
+    for (u32 i = 0; i < nIdxs; ++i)
+    {
+        const u32 v = pIdxs[i];
+        if (aRemap[v] == NPOS32)
+        {
+            aRemap[v] = nKept;
+            memcpy(pDstVerts + usize(nKept) * stride, pSrcVerts + usize(v) * stride, stride);
+            ++nKept;
+        }
+
+        pIdxs[i] = aRemap[v];
+    }
+
+    return nKept;
+}
+
+static u32
+nComponents(gltf::ACCESSOR_TYPE eType)
+{
+    switch (eType)
+    {
+        case gltf::ACCESSOR_TYPE::SCALAR: return 1;
+        case gltf::ACCESSOR_TYPE::VEC2: return 2;
+        case gltf::ACCESSOR_TYPE::VEC3: return 3;
+        case gltf::ACCESSOR_TYPE::VEC4: return 4;
+        default: return 0;
+    }
+}
+
+/* float accessor with at least nComps components */
+static bool
+hasFloats(const gltf::Model& a, ssize accIdx, u32 nComps)
+{
+    if (accIdx == NPOS) return false;
+
+    auto& acc = a.m_aAccessors[accIdx];
+    return acc.componentType == gltf::COMPONENT_TYPE::FLOAT && nComponents(acc.type) >= nComps;
+}
+
+/* first nComps floats of element i, missing byteStride means tightly packed */
+static void
+copyFloats(const gltf::Model& a, ssize accIdx, u32 i, u32 nComps, f32* pDst)
+{
+    auto& acc = a.m_aAccessors[accIdx];
+    auto& bv = a.m_aBufferViews[acc.bufferView];
+    const u32 stride = bv.byteStride ? bv.byteStride : nComponents(acc.type) * sizeof(f32);
+    const char* p = &a.m_aBuffers[bv.buffer].aBin[bv.byteOffset + acc.byteOffset + i*stride];
+
+    memcpy(pDst, p, nComps * sizeof(f32));
+}
+
+static bool
+isPackable(const gltf::Model& a, const gltf::Primitive& prim)
+{
+    return prim.mode == gltf::PRIMITIVES::TRIANGLES && ssize(prim.indices) != NPOS &&
+        hasFloats(a, prim.attributes.POSITION, 3) && hasFloats(a, prim.attributes.TEXCOORD_0, 2);
+}
+
+u64
+hashSource(const gltf::Model& a)
+{
+    u64 h = 0;
+    auto mix = [&](u64 x) { h = hash::xxh64::hash((const char*)&x, sizeof(x), h); };
+
+    for (auto& buff : a.m_aBuffers)
+        h = hash::xxh64::hash(buff.aBin.data(), buff.aBin.getSize(), h);
+
+    for (auto& mesh : a.m_aMeshes)
+    {
+        for (auto& prim : mesh.aPrimitives)
+        {
+            mix(u64(prim.mode));
+
+            const s32 aAccs[] {
+                prim.indices, prim.attributes.POSITION, prim.attributes.TEXCOORD_0,
+                prim.attributes.NORMAL, prim.attributes.TANGENT
+            };
+            for (s32 accIdx : aAccs)
+            {
+                mix(u64(accIdx));
+                if (ssize(accIdx) == NPOS) continue;
+
+                auto& acc = a.m_aAccessors[accIdx];
+                auto& bv = a.m_aBufferViews[acc.bufferView];
+                for (u64 x : {u64(acc.bufferView), u64(acc.byteOffset), u64(acc.componentType), u64(acc.count), u64(acc.type)})
+                    mix(x);
+                for (u64 x : {u64(bv.buffer), u64(bv.byteOffset), u64(bv.byteLength), u64(bv.byteStride)})
+                    mix(x);
+            }
+        }
+    }
+
+    return h;
+}
+
+struct Job
+{
+    const gltf::Model* pModel {};
+    Primitive prim {};
+    u8* pVerts {}; /* OsAllocator */
+    u8* pIdxs {};
+    bool bOk {};
+};
+
+static THREAD_STATUS
+optimizeSubmit(void* pArg)
+{
+    auto* j = (Job*)pArg;
+    const gltf::Model& a = *j->pModel;
+    const gltf::Primitive& prim = a.m_aMeshes[j->prim.meshIdx].aPrimitives[j->prim.primIdx];
+
+    const ssize accPosIdx = prim.attributes.POSITION;
+    const ssize accTexIdx = prim.attributes.TEXCOORD_0;
+    const ssize accNormIdx = prim.attributes.NORMAL;
+    const ssize accTanIdx = prim.attributes.TANGENT;
+    const bool bNormals = hasFloats(a, accNormIdx, 3);
+    const bool bTangents = hasFloats(a, accTanIdx, 3);
+
+    auto& accInd = a.m_aAccessors[prim.indices];
+    const u32 nSrcVerts = a.m_aAccessors[accPosIdx].count;
+    const u32 nIdxs = accInd.count - accInd.count % 3;
+    if (nSrcVerts == 0 || nIdxs == 0) return {};
+
+    Arena arena(SIZE_1M);
+    defer( arena.freeAll() );
+
+    /* widen indices to u32 */
+    auto& bvInd = a.m_aBufferViews[accInd.bufferView];
+    const u8* pSrcIdxs = (const u8*)&a.m_aBuffers[bvInd.buffer].aBin[bvInd.byteOffset + accInd.byteOffset];
+    u32* aIdxs = (u32*)arena.malloc(nIdxs, sizeof(u32));
+
+    for (u32 i = 0; i < nIdxs; ++i)
+    {
+        switch (accInd.componentType)
+        {
+            case gltf::COMPONENT_TYPE::UNSIGNED_BYTE:
+            aIdxs[i] = pSrcIdxs[i];
+            break;
+
+            case gltf::COMPONENT_TYPE::UNSIGNED_SHORT:
+            {
+                u16 x;
+                memcpy(&x, pSrcIdxs + i*2, 2);
+                aIdxs[i] = x;
+            } break;
+
+            default:
+            memcpy(&aIdxs[i], pSrcIdxs + i*4, 4);
+            break;
+        }
+
+        if (aIdxs[i] >= nSrcVerts)
+        {
+            LOG_WARN("mesh {}, primitive {}: index {} out of {} vertices\n", j->prim.meshIdx, j->prim.primIdx, aIdxs[i], nSrcVerts);
+            return {};
+        }
+    }
+
+    /* interleave as floats first */
+    const u32 nFloats = 3 + 2 + (bNormals ? 3 : 0) + (bTangents ? 3 : 0);
+    f32* aFloats = (f32*)arena.malloc(usize(nSrcVerts) * nFloats, sizeof(f32));
+    for (u32 v = 0; v < nSrcVerts; ++v)
+    {
+        f32* pV = aFloats + usize(v) * nFloats;
+        copyFloats(a, accPosIdx, v, 3, pV);
+        copyFloats(a, accTexIdx, v, 2, pV + 3);
+        if (bNormals) copyFloats(a, accNormIdx, v, 3, pV + 5);
+        if (bTangents) copyFloats(a, accTanIdx, v, 3, pV + 5 + (bNormals ? 3 : 0));
+    }
+
+    j->prim.before = analyzeCache(aIdxs, nIdxs, nSrcVerts);
+
+    u32* aTipsy = (u32*)arena.malloc(nIdxs, sizeof(u32));
+    tipsify(&arena, aTipsy, aIdxs, nIdxs, nSrcVerts);
+
+    f32* aFetched = (f32*)arena.malloc(usize(nSrcVerts) * nFloats, sizeof(f32));
+    const u32 nVerts = reorderFetch(&arena, (u8*)aFetched, aTipsy, nIdxs, (const u8*)aFloats, nSrcVerts, nFloats * sizeof(f32));
+
+    j->prim.after = analyzeCache(aTipsy, nIdxs, nVerts);
+
+    /* quantize positions over the bounds */
+    f32 aMin[3] {aFetched[0], aFetched[1], aFetched[2]};
+    f32 aMax[3] {aFetched[0], aFetched[1], aFetched[2]};
+    for (u32 v = 1; v < nVerts; ++v)
+    {
+        for (u32 c = 0; c < 3; ++c)
+        {
+            const f32 x = aFetched[usize(v) * nFloats + c];
+            aMin[c] = utils::min(aMin[c], x);
+            aMax[c] = utils::max(aMax[c], x);
+        }
+    }
+
+    for (u32 c = 0; c < 3; ++c)
+    {
+        j->prim.aPosOffset[c] = aMin[c];
+        j->prim.aPosScale[c] = aMax[c] > aMin[c] ? aMax[c] - aMin[c] : 1.0f;
+    }
+
+    const u32 stride = 4*sizeof(u16) + (nFloats - 3) * sizeof(f32);
+    j->pVerts = (u8*)OsAllocatorGet()->malloc(nVerts, stride);
+
+    for (u32 v = 0; v < nVerts; ++v)
+    {
+        const f32* pSrc = aFetched + usize(v) * nFloats;
+        u8* pDst = j->pVerts + usize(v) * stride;
+
+        u16 aQ[4] {};
+        for (u32 c = 0; c < 3; ++c)
+            aQ[c] = u16(std::lround((pSrc[c] - j->prim.aPosOffset[c]) / j->prim.aPosScale[c] * 65535.0f));
+
+        memcpy(pDst, aQ, sizeof(aQ));
+        memcpy(pDst + sizeof(aQ), pSrc + 3, (nFloats - 3) * sizeof(f32));
+    }
+
+    /* baseVertex is added after the fetch, so only the primitive's own count matters */
+    const u32 indexSize = nVerts <= 0x10000 ? 2 : 4;
+    j->pIdxs = (u8*)OsAllocatorGet()->malloc(nIdxs, indexSize);
+
+    if (indexSize == 2)
+    {
+        u16* p = (u16*)j->pIdxs;
+        for (u32 i = 0; i < nIdxs; ++i) p[i] = u16(aTipsy[i]);
+    }
+    else memcpy(j->pIdxs, aTipsy, nIdxs * sizeof(u32));
+
+    j->prim.flags = (bNormals ? u32(PRIM_FLAGS::NORMALS) : 0u) | (bTangents ? u32(PRIM_FLAGS::TANGENTS) : 0u);
+    j->prim.indexSize = indexSize;
+    j->prim.nVerts = nVerts;
+    j->prim.nIdxs = nIdxs;
+    j->prim.stride = stride;
+    j->bOk = true;
+
+    return {};
+}
+
+Packed
+build(IAllocator* pAlloc, ThreadPool* pTp, const gltf::Model& a)
+{
+    PROFILE_SCOPE("meshopt::build");
+
+    Arena arena(SIZE_8K);
+    defer( arena.freeAll() );
+
+    Vec<Job> aJobs(&arena);
+    for (u32 i = 0; i < a.m_aMeshes.getSize(); ++i)
+    {
+        auto& aPrimitives = a.m_aMeshes[i].aPrimitives;
+        for (u32 j = 0; j < aPrimitives.getSize(); ++j)
+        {
+            if (isPackable(a, aPrimitives[j]))
+                aJobs.push({.pModel = &a, .prim = {.meshIdx = i, .primIdx = j}});
+        }
+    }
+
+    if (pTp)
+    {
+        for (auto& j : aJobs) pTp->submit(optimizeSubmit, &j);
+        pTp->wait();
+    }
+    else
+    {
+        for (auto& j : aJobs) optimizeSubmit(&j);
+    }
+
+    defer(
+        for (auto& j : aJobs)
+        {
+            OsAllocatorGet()->free(j.pVerts);
+            OsAllocatorGet()->free(j.pIdxs);
+        }
+    );
+
+    u32 nPrims = 0;
+    for (auto& j : aJobs) nPrims += j.bOk;
+
+    u64 offset = align(sizeof(Header) + nPrims * sizeof(Primitive), DATA_ALIGNMENT);
+    for (auto& j : aJobs)
+    {
+        if (!j.bOk) continue;
+
+        j.prim.vertsOffset = offset;
+        offset = align(offset + u64(j.prim.nVerts) * j.prim.stride, DATA_ALIGNMENT);
+        j.prim.idxsOffset = offset;
+        offset = align(offset + u64(j.prim.nIdxs) * j.prim.indexSize, DATA_ALIGNMENT);
+    }
+
+    u8* pData = (u8*)pAlloc->zalloc(offset, 1);
+
+    const Header h {
+        .magic = COOKED_MAGIC,
+        .version = COOKED_VERSION,
+        .srcHash = hashSource(a),
+        .nPrims = nPrims,
+    };
+    memcpy(pData, &h, sizeof(h));
+
+    Primitive* aPrims = (Primitive*)(pData + sizeof(Header));
+    u32 i = 0;
+    for (auto& j : aJobs)
+    {
+        if (!j.bOk) continue;
+
+        aPrims[i++] = j.prim;
+        memcpy(pData + j.prim.vertsOffset, j.pVerts, usize(j.prim.nVerts) * j.prim.stride);
+        memcpy(pData + j.prim.idxsOffset, j.pIdxs, usize(j.prim.nIdxs) * j.prim.indexSize);
+    }
+
+    return {.m_pData = pData, .m_size = offset, .m_pAlloc = pAlloc};
+}
+
+Packed
+mapCooked(String sSrcPath, u64 srcHash)
+{
+    char aPath[256] {};
+    cook::cookedPathExt(aPath, sizeof(aPath), sSrcPath, ".bmesh");
+
+    Packed p {};
+    p.m_map = cook::mapFile(aPath);
+    if (!p.m_map) return {};
+
+    p.m_pData = p.m_map.m_pData;
+    p.m_size = p.m_map.m_size;
+
+    auto bad = [&](const char* ntsWhy) {
+#ifdef D_MESHOPT
+        LOG_WARN("'{}': {}\n", aPath, ntsWhy);
+#endif
+        (void)ntsWhy;
+        p.destroy();
+        return Packed {};
+    };
+
+    if (p.m_size < sizeof(Header)) return bad("truncated header");
+
+    const Header& h = p.header();
+    if (h.magic != COOKED_MAGIC || h.version != COOKED_VERSION) return bad("wrong magic/version");
+    if (h.srcHash != srcHash) return bad("source changed");
+    if (sizeof(Header) + u64(h.nPrims) * sizeof(Primitive) > p.m_size) return bad("truncated primitives");
+
+    for (u32 i = 0; i < h.nPrims; ++i)
+    {
+        const Primitive& e = p.prim(i);
+        if (e.indexSize != 2 && e.indexSize != 4) return bad("bad index size");
+        if (e.vertsOffset + u64(e.nVerts) * e.stride > p.m_size) return bad("truncated vertices");
+        if (e.idxsOffset + u64(e.nIdxs) * e.indexSize > p.m_size) return bad("truncated indices");
+    }
+
+    return p;
+}
+
+bool
+writeCooked(const Packed& p, String sSrcPath)
+{
+    char aPath[256] {};
+    cook::cookedPathExt(aPath, sizeof(aPath), sSrcPath, ".bmesh");
+
+    return cook::writeFile(aPath, p.m_pData, p.m_size);
+}
+
+Packed
+loadOrBuild(IAllocator* pAlloc, ThreadPool* pTp, const gltf::Model& m, String sSrcPath)
+{
+    Packed p = mapCooked(sSrcPath, hashSource(m));
+    if (p) return p;
+
+    p = build(pAlloc, pTp, m);
+    if (p.header().nPrims > 0) writeCooked(p, sSrcPath);
+
+    return p;
+}
+
+} /* namespace meshopt */
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "adt/ThreadPool.hh"
+#include "cook.hh"
+#include "gltf/gltf.hh"
+
+using namespace adt;
+
+/* Load time (or cooked) optimization of indexed triangle primitives:
+ * Tipsify vertex cache reordering, vertex fetch reordering, positions quantized to u16 over the bounds
+ * and u16 indices whenever the primitive has few enough vertices.
+ * Packed vertex: pos u16x4 (unorm, w unused), uv f32x2, [normal f32x3], [tangent f32x3]. */
+namespace meshopt
+{
+
+constexpr u32 CACHE_SIZE = 16; /* post transform fifo for the metrics, also tipsify's k */
+constexpr u32 COOKED_MAGIC = 0x534d4b42; /* "BKMS" */
+constexpr u32 COOKED_VERSION = 1;
+constexpr u32 DATA_ALIGNMENT = 16;
+
+/* acmr: transformed vertices per triangle (0.5 at best on regular grids, 3 at worst),
+ * atvr: transformed vertices per vertex (1 at best) */
+struct CacheStats
+{
+    f32 acmr {};
+    f32 atvr {};
+};
+
+enum PRIM_FLAGS : u32
+{
+    NORMALS = 1,
+    TANGENTS = 1 << 1,
+};
+
+struct Header
+{
+    u32 magic {};
+    u32 version {};
+    u64 srcHash {}; /* the geometry and how the primitives reference it, see hashSource() */
+    u32 nPrims {};
+    u32 _pad {};
+};
+
+/* nPrims of these follow the header, offsets are from the start of the data */
+struct Primitive
+{
+    u32 meshIdx {};
+    u32 primIdx {};
+    u32 flags {}; /* PRIM_FLAGS */
+    u32 indexSize {}; /* 2 or 4 */
+    u32 nVerts {};
+    u32 nIdxs {};
+    u32 stride {}; /* bytes */
+    f32 aPosOffset[3] {}; /* pos = unorm * scale + offset */
+    f32 aPosScale[3] {};
+    CacheStats before {};
+    CacheStats after {};
+    u64 vertsOffset {};
+    u64 idxsOffset {};
+};
+
+/* header, primitives and data in one block, mapped from the cooked file or built in memory */
+struct Packed
+{
+    const u8* m_pData {};
+    usize m_size {};
+    cook::Mapping m_map {};
+    IAllocator* m_pAlloc {}; /* owner of m_pData if it was built */
+
+    /* */
+
+    explicit operator bool() const { return m_pData != nullptr; }
+
+    const Header& header() const { return *(const Header*)m_pData; }
+    const Primitive& prim(u32 i) const { return ((const Primitive*)(m_pData + sizeof(Header)))[i]; }
+    const u8* verts(u32 i) const { return m_pData + prim(i).vertsOffset; }
+    const u8* idxs(u32 i) const { return m_pData + prim(i).idxsOffset; }
+
+    void destroy();
+};
+
+[[nodiscard]] CacheStats analyzeCache(const u32* pIdxs, u32 nIdxs, u32 nVerts, u32 cacheSize = CACHE_SIZE);
+
+/* Sander, Nehab, Barczak: "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", pDst != pIdxs */
+void tipsify(IAllocator* pScratch, u32* pDst, const u32* pIdxs, u32 nIdxs, u32 nVerts, u32 cacheSize = CACHE_SIZE);
+
+/* vertices in the order the indices first use them, pIdxs are remapped in place, unused vertices are dropped.
+ * Returns how many were kept */
+[[nodiscard]] u32 reorderFetch(IAllocator* pScratch, u8* pDstVerts, u32* pIdxs, u32 nIdxs, const u8* pSrcVerts, u32 nVerts, u32 stride);
+
+/* geometry bytes and the accessors of every primitive */
+[[nodiscard]] u64 hashSource(const gltf::Model& m);
+
+/* every indexed triangle primitive with float positions and uvs, in parallel on pTp unless it's nullptr */
+[[nodiscard]] Packed build(IAllocator* pAlloc, ThreadPool* pTp, const gltf::Model& m);
+
+/* cooked file of sSrcPath if its hash matches */
+[[nodiscard]] Packed mapCooked(String sSrcPath, u64 srcHash);
+
+bool writeCooked(const Packed& p, String sSrcPath);
+
+/* mapCooked() or build() and writeCooked() */
+[[nodiscard]] Packed loadOrBuild(IAllocator* pAlloc, ThreadPool* pTp, const gltf::Model& m, String sSrcPath);
+
+} /* namespace meshopt */
@@ -0,0 +1,269 @@
+#include "pixel.hh"
+
+#include <immintrin.h>
+
+namespace pixel
+{
+
+void
+rowBGRtoRGBAScalar(u8* pDst, const u8* pSrc, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        pDst[x*4 + 0] = pSrc[x*3 + 2];
+        pDst[x*4 + 1] = pSrc[x*3 + 1];
+        pDst[x*4 + 2] = pSrc[x*3 + 0];
+        pDst[x*4 + 3] = 0xff;
+    }
+}
+
+void
+rowRGBtoRGBAScalar(u8* pDst, const u8* pSrc, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        pDst[x*4 + 0] = pSrc[x*3 + 0];
+        pDst[x*4 + 1] = pSrc[x*3 + 1];
+        pDst[x*4 + 2] = pSrc[x*3 + 2];
+        pDst[x*4 + 3] = 0xff;
+    }
+}
+
+void
+rowBGRAtoRGBAScalar(u8* pDst, const u8* pSrc, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        pDst[x*4 + 0] = pSrc[x*4 + 2];
+        pDst[x*4 + 1] = pSrc[x*4 + 1];
+        pDst[x*4 + 2] = pSrc[x*4 + 0];
+        pDst[x*4 + 3] = pSrc[x*4 + 3];
+    }
+}
+
+void
+rowBGRtoRGBScalar(u8* pDst, const u8* pSrc, int width)
+{
+    for (int x = 0; x < width; ++x)
+    {
+        pDst[x*3 + 0] = pSrc[x*3 + 2];
+        pDst[x*3 + 1] = pSrc[x*3 + 1];
+        pDst[x*3 + 2] = pSrc[x*3 + 0];
+    }
+}
+
+#ifdef ADT_SSE4_2
+
+/* BGR to RGB across 3 registers: output byte i comes from input byte 3*(i/3) + 2 - i%3,
+ * which is at most 2 bytes away, so each output register gathers from its own and both neighbouring inputs.
+ * -1 (0x80) zeroes the lane in pshufb. */
+struct BGRtoRGBShuffles
+{
+    alignas(16) s8 aPrev[3][16];
+    alignas(16) s8 aSelf[3][16];
+    alignas(16) s8 aNext[3][16];
+};
+
+static constexpr BGRtoRGBShuffles
+makeBGRtoRGBShuffles()
+{
+    BGRtoRGBShuffles ret {};
+
+    for (int reg = 0; reg < 3; ++reg)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            const int out = reg*16 + i;
+            const int in = 3*(out / 3) + 2 - out % 3;
+            const int inReg = in / 16;
+
+            ret.aPrev[reg][i] = inReg == reg - 1 ? s8(in % 16) : -1;
+            ret.aSelf[reg][i] = inReg == reg ? s8(in % 16) : -1;
+            ret.aNext[reg][i] = inReg == reg + 1 ? s8(in % 16) : -1;
+        }
+    }
+
+    return ret;
+}
+
+static constexpr BGRtoRGBShuffles s_shufBGRtoRGB = makeBGRtoRGBShuffles();
+
+#endif
+
+/* 3 byte pixels into 4 with opaque alpha, bSwap also swaps the first and third byte */
+template<bool bSwap>
+static void
+rowExpand(u8* pDst, const u8* pSrc, int width)
+{
+    int x = 0;
+
+#ifdef ADT_AVX2
+    /* low lane loads from pixel 0 and uses bytes 0..11, high lane loads from byte 8 and uses 4..15,
+     * so 8 pixels need exactly 24 bytes and nothing past them is touched */
+    const __m256i shuf8 = bSwap ?
+        _mm256_setr_epi8(
+            2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+            6, 5, 4, -1, 9, 8, 7, -1, 12, 11, 10, -1, 15, 14, 13, -1
+        ) :
+        _mm256_setr_epi8(
+            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+            4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15, -1
+        );
+    const __m256i alpha8 = _mm256_set1_epi32(0xff000000);
+
+    for (; x + 8 <= width; x += 8)
+    {
+        const u8* s = pSrc + x*3;
+        __m256i pack = _mm256_loadu2_m128i((const __m128i*)(s + 8), (const __m128i*)s);
+        pack = _mm256_or_si256(_mm256_shuffle_epi8(pack, shuf8), alpha8);
+        _mm256_storeu_si256((__m256i*)(pDst + x*4), pack);
+    }
+#endif
+
+#ifdef ADT_SSE4_2
+    /* 4 BGR pixels from the low 12 bytes into RGBA, alpha is or'ed in after */
+    const __m128i shuf = bSwap ?
+        _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1) :
+        _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+
+    /* 16 pixels from 3 loads, alignr stitches the 12 byte groups that straddle registers */
+    for (; x + 16 <= width; x += 16)
+    {
+        const u8* s = pSrc + x*3;
+        u8* d = pDst + x*4;
+
+        const __m128i a = _mm_loadu_si128((const __m128i*)(s + 0));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+
+        const __m128i p0 = a;
+        const __m128i p1 = _mm_alignr_epi8(b, a, 12);
+        const __m128i p2 = _mm_alignr_epi8(c, b, 8);
+        const __m128i p3 = _mm_srli_si128(c, 4);
+
+        _mm_storeu_si128((__m128i*)(d + 0), _mm_or_si128(_mm_shuffle_epi8(p0, shuf), alpha));
+        _mm_storeu_si128((__m128i*)(d + 16), _mm_or_si128(_mm_shuffle_epi8(p1, shuf), alpha));
+        _mm_storeu_si128((__m128i*)(d + 32), _mm_or_si128(_mm_shuffle_epi8(p2, shuf), alpha));
+        _mm_storeu_si128((__m128i*)(d + 48), _mm_or_si128(_mm_shuffle_epi8(p3, shuf), alpha));
+    }
+
+    /* single loads read 16 bytes for 12, so stop while 2 more pixels are still in the row */
+    for (; x + 6 <= width; x += 4)
+    {
+        const __m128i pack = _mm_loadu_si128((const __m128i*)(pSrc + x*3));
+        _mm_storeu_si128((__m128i*)(pDst + x*4), _mm_or_si128(_mm_shuffle_epi8(pack, shuf), alpha));
+    }
+#endif
+
+    if constexpr (bSwap) rowBGRtoRGBAScalar(pDst + x*4, pSrc + x*3, width - x);
+    else rowRGBtoRGBAScalar(pDst + x*4, pSrc + x*3, width - x);
+}
+
+void
+rowBGRtoRGBA(u8* pDst, const u8* pSrc, int width)
+{
+    rowExpand<true>(pDst, pSrc, width);
+}
+
+void
+rowRGBtoRGBA(u8* pDst, const u8* pSrc, int width)
+{
+    rowExpand<false>(pDst, pSrc, width);
+}
+
+void
+rowBGRAtoRGBA(u8* pDst, const u8* pSrc, int width)
+{
+    int x = 0;
+
+#ifdef ADT_AVX2
+    const __m256i shuf8 = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+    );
+
+    for (; x + 8 <= width; x += 8)
+    {
+        __m256i pack = _mm256_loadu_si256((const __m256i*)(pSrc + x*4));
+        _mm256_storeu_si256((__m256i*)(pDst + x*4), _mm256_shuffle_epi8(pack, shuf8));
+    }
+#endif
+
+#ifdef ADT_SSE4_2
+    const __m128i shuf = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128i pack = _mm_loadu_si128((const __m128i*)(pSrc + x*4));
+        _mm_storeu_si128((__m128i*)(pDst + x*4), _mm_shuffle_epi8(pack, shuf));
+    }
+#endif
+
+    rowBGRAtoRGBAScalar(pDst + x*4, pSrc + x*4, width - x);
+}
+
+void
+rowBGRtoRGB(u8* pDst, const u8* pSrc, int width)
+{
+    int x = 0;
+
+#ifdef ADT_SSE4_2
+    const auto& m = s_shufBGRtoRGB;
+    auto load = [](const s8* p) { return _mm_load_si128((const __m128i*)p); };
+
+    for (; x + 16 <= width; x += 16)
+    {
+        const u8* s = pSrc + x*3;
+        u8* d = pDst + x*3;
+
+        const __m128i a = _mm_loadu_si128((const __m128i*)(s + 0));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(s + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i*)(s + 32));
+
+        const __m128i o0 = _mm_or_si128(_mm_shuffle_epi8(a, load(m.aSelf[0])), _mm_shuffle_epi8(b, load(m.aNext[0])));
+        const __m128i o1 = _mm_or_si128(
+            _mm_or_si128(_mm_shuffle_epi8(a, load(m.aPrev[1])), _mm_shuffle_epi8(b, load(m.aSelf[1]))),
+            _mm_shuffle_epi8(c, load(m.aNext[1]))
+        );
+        const __m128i o2 = _mm_or_si128(_mm_shuffle_epi8(b, load(m.aPrev[2])), _mm_shuffle_epi8(c, load(m.aSelf[2])));
+
+        _mm_storeu_si128((__m128i*)(d + 0), o0);
+        _mm_storeu_si128((__m128i*)(d + 16), o1);
+        _mm_storeu_si128((__m128i*)(d + 32), o2);
+    }
+#endif
+
+    rowBGRtoRGBScalar(pDst + x*3, pSrc + x*3, width - x);
+}
+
+template<typename ROW_FN>
+static void
+convert(ROW_FN pfnRow, u8* pDst, ssize dstStride, const u8* pSrc, ssize srcStride, int height, bool bVertFlip)
+{
+    for (int y = 0; y < height; ++y)
+    {
+        const int dstY = bVertFlip ? height - 1 - y : y;
+        pfnRow(pDst + dstY*dstStride, pSrc + y*srcStride);
+    }
+}
+
+void
+BGRtoRGBA(u8* pDst, ssize dstStride, const u8* pSrc, ssize srcStride, int width, int height, bool bVertFlip)
+{
+    convert([=](u8* d, const u8* s) { rowBGRtoRGBA(d, s, width); }, pDst, dstStride, pSrc, srcStride, height, bVertFlip);
+}
+
+void
+BGRAtoRGBA(u8* pDst, ssize dstStride, const u8* pSrc, ssize srcStride, int width, int height, bool bVertFlip)
+{
+    convert([=](u8* d, const u8* s) { rowBGRAtoRGBA(d, s, width); }, pDst, dstStride, pSrc, srcStride, height, bVertFlip);
+}
+
+void
+BGRtoRGB(u8* pDst, ssize dstStride, const u8* pSrc, ssize srcStride, int width, int height, bool bVertFlip)
+{
+    convert([=](u8* d, const u8* s) { rowBGRtoRGB(d, s, width); }, pDst, dstStride, pSrc, srcStride, height, bVertFlip);
+}
+
+} /* namespace pixel */
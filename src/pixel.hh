@@ -0,0 +1,30 @@
+#pragma once
+
+#include "adt/types.hh"
+
+using namespace adt;
+
+/* Pixel format conversion kernels.
+ * Strides are in bytes, so padded rows (bmp rows are 4 byte aligned) just need the real pitch.
+ * Nothing is read or written past width pixels of a row, tails are done one pixel at a time.
+ * bVertFlip writes source row 0 into the last destination row. */
+namespace pixel
+{
+
+void BGRtoRGBA(u8* pDst, ssize dstStride, const u8* pSrc, ssize srcStride, int width, int height, bool bVertFlip);
+void BGRAtoRGBA(u8* pDst, ssize dstStride, const u8* pSrc, ssize srcStride, int width, int height, bool bVertFlip);
+void BGRtoRGB(u8* pDst, ssize dstStride, const u8* pSrc, ssize srcStride, int width, int height, bool bVertFlip);
+
+/* one row, AVX2 under ADT_AVX2, PSHUFB under ADT_SSE4_2, scalar otherwise */
+void rowBGRtoRGBA(u8* pDst, const u8* pSrc, int width);
+void rowBGRAtoRGBA(u8* pDst, const u8* pSrc, int width);
+void rowBGRtoRGB(u8* pDst, const u8* pSrc, int width);
+void rowRGBtoRGBA(u8* pDst, const u8* pSrc, int width);
+
+/* reference kernels, for tests and benchmarks */
+void rowBGRtoRGBAScalar(u8* pDst, const u8* pSrc, int width);
+void rowBGRAtoRGBAScalar(u8* pDst, const u8* pSrc, int width);
+void rowBGRtoRGBScalar(u8* pDst, const u8* pSrc, int width);
+void rowRGBtoRGBAScalar(u8* pDst, const u8* pSrc, int width);
+
+} /* namespace pixel */
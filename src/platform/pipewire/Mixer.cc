@@ -1,6 +1,7 @@
 #include "Mixer.hh"
 
 #include "adt/logs.hh"
+#include "adt/prof.hh"
 #include "adt/utils.hh"
 #include "app.hh"
 
@@ -38,8 +39,9 @@ static const pw_stream_events s_streamEvents {
     .trigger_done {},
 };
 
-Mixer::Mixer(IAllocator* pA)
-    : m_mtxAdd(MUTEX_TYPE::PLAIN),
+Mixer::Mixer(IAllocator* pA, u32 targetLatencyFrames)
+    : m_targetLatencyFrames(targetLatencyFrames),
+      m_mtxAdd(MUTEX_TYPE::PLAIN),
       m_aTracks(pA, audio::MAX_TRACK_COUNT),
       m_aBackgroundTracks(pA, audio::MAX_TRACK_COUNT)
 {
@@ -64,6 +66,10 @@ Mixer::start()
 
     m_pThrdLoop = pw_thread_loop_new("BreakoutThreadLoop", {});
 
+    char aLatency[32] {};
+    print::toBuffer(aLatency, sizeof(aLatency) - 1, "{}/{}", m_targetLatencyFrames, m_sampleRate);
+    LOG_NOTIFY("requesting node latency: '{}'\n", aLatency);
+
     m_pStream = pw_stream_new_simple(
         pw_thread_loop_get_loop(m_pThrdLoop),
         "BreakoutAudioSource",
@@ -71,6 +77,7 @@ Mixer::start()
             PW_KEY_MEDIA_TYPE, "Audio",
             PW_KEY_MEDIA_CATEGORY, "Playback",
             PW_KEY_MEDIA_ROLE, "Game",
+            PW_KEY_NODE_LATENCY, aLatency,
             nullptr
         ),
         &s_streamEvents,
@@ -129,6 +136,7 @@ Mixer::add(audio::Track t)
 {
     guard::Mtx lock(&m_mtxAdd);
 
+    t.addTimeUS = utils::timeNowUS();
     if (m_aTracks.getSize() < audio::MAX_TRACK_COUNT) m_aTracks.push(t);
     else LOG_WARN("MAX_TRACK_COUNT({}) reached, ignoring track push\n", audio::MAX_TRACK_COUNT);
 
@@ -139,10 +147,78 @@ Mixer::addBackground(audio::Track t)
 {
     guard::Mtx lock(&m_mtxAdd);
 
+    t.addTimeUS = utils::timeNowUS();
     if (m_aTracks.getSize() < audio::MAX_TRACK_COUNT) m_aBackgroundTracks.push(t);
     else LOG_WARN("MAX_TRACK_COUNT({}) reached, ignoring track push\n", audio::MAX_TRACK_COUNT);
 }
 
+audio::Stats
+Mixer::getStats()
+{
+    audio::Stats ret {
+        .sampleRate = m_sampleRate,
+        .targetLatencyFrames = m_targetLatencyFrames,
+        .lastNFrames = m_statNFrames.load(std::memory_order_relaxed),
+        .delayMS = m_statDelayMS.load(std::memory_order_relaxed),
+        .nCallbacks = m_statNCallbacks.load(std::memory_order_relaxed),
+        .nUnderruns = m_statNUnderruns.load(std::memory_order_relaxed),
+        .nXruns = m_statNXruns.load(std::memory_order_relaxed),
+        .lastCallbackUS = m_statLastCallbackUS.load(std::memory_order_relaxed),
+        .maxCallbackUS = m_statMaxCallbackUS.load(std::memory_order_relaxed),
+        .lastAddToFirstSampleMS = m_statLastAddToFirstMS.load(std::memory_order_relaxed),
+        .maxAddToFirstSampleMS = m_statMaxAddToFirstMS.load(std::memory_order_relaxed),
+    };
+
+    for (u32 i = 0; i < audio::N_CALLBACK_BUCKETS; ++i)
+        ret.aCallbackHist[i] = m_aStatCallbackHist[i].load(std::memory_order_relaxed);
+
+    return ret;
+}
+
+void
+Mixer::recordFirstSample(audio::Track* pTrack)
+{
+    if (pTrack->addTimeUS == 0) return;
+
+    f64 ms = f64(m_callbackStartUS - pTrack->addTimeUS) / 1000.0;
+    pTrack->addTimeUS = 0;
+
+    m_statLastAddToFirstMS.store(ms, std::memory_order_relaxed);
+    if (ms > m_statMaxAddToFirstMS.load(std::memory_order_relaxed))
+        m_statMaxAddToFirstMS.store(ms, std::memory_order_relaxed);
+}
+
+void
+Mixer::updateTime()
+{
+    pw_time time {};
+#if PW_CHECK_VERSION(0, 3, 50)
+    if (pw_stream_get_time_n(m_pStream, &time, sizeof(time)) != 0) return;
+#else
+    if (pw_stream_get_time(m_pStream, &time) != 0) return;
+#endif
+
+    if (time.rate.denom == 0) return;
+
+    /* delay is in rate units (ticks), queued is in bytes we handed over but the graph didn't consume yet */
+    f64 tickMS = 1000.0 * f64(time.rate.num) / f64(time.rate.denom);
+    f64 queuedMS = 0.0;
+    if (m_sampleRate > 0)
+        queuedMS = 1000.0 * f64(time.queued / (sizeof(s16) * m_channels)) / f64(m_sampleRate);
+
+    m_statDelayMS.store(f64(time.delay) * tickMS + queuedMS, std::memory_order_relaxed);
+
+    /* ticks advance by one quantum per graph cycle, a bigger jump means cycles went by without us */
+    if (m_lastTicks != 0 && m_lastNFrames > 0 && time.ticks > m_lastTicks)
+    {
+        u64 expected = (u64(m_lastNFrames) * time.rate.denom) / (u64(m_sampleRate) * time.rate.num);
+        if (expected > 0 && time.ticks - m_lastTicks > expected + expected/2)
+            m_statNXruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    m_lastTicks = time.ticks;
+}
+
 void
 Mixer::writeFrames(void* pBuff, u32 nFrames)
 {
@@ -172,6 +248,7 @@ Mixer::writeFrames(void* pBuff, u32 nFrames)
 
                 packed8Samples = _mm_add_epi16(packed8Samples, what);
 
+                recordFirstSample(&t);
                 t.pcmPos += 8;
             }
             else
@@ -203,6 +280,7 @@ Mixer::writeFrames(void* pBuff, u32 nFrames)
 
                 packed8Samples = _mm_add_epi16(packed8Samples, what);
 
+                recordFirstSample(&t);
                 t.pcmPos += 8;
             }
             else
@@ -230,9 +308,18 @@ Mixer::writeFrames(void* pBuff, u32 nFrames)
 void
 Mixer::onProcess()
 {
+    PROFILE_THREAD_NAME("pipewire");
+    PROFILE_SCOPE("Mixer::onProcess");
+
+    m_callbackStartUS = utils::timeNowUS();
+    m_statNCallbacks.fetch_add(1, std::memory_order_relaxed);
+
+    updateTime();
+
     pw_buffer* pPwBuffer = pw_stream_dequeue_buffer(m_pStream);
     if (!pPwBuffer)
     {
+        m_statNUnderruns.fetch_add(1, std::memory_order_relaxed);
         pw_log_warn("out of buffers: %m");
         return;
     }
@@ -250,9 +337,11 @@ Mixer::onProcess()
     u32 nFrames = pBuffData.maxsize / stride;
     if (pPwBuffer->requested) nFrames = SPA_MIN(pPwBuffer->requested, (u64)nFrames);
 
-    if (nFrames > 1024*4) nFrames = 1024*4; /* limit to arbitrary number */
+    /* writeFrames() works on 4 frames at a time */
+    nFrames &= ~3u;
 
     m_lastNFrames = nFrames;
+    m_statNFrames.store(nFrames, std::memory_order_relaxed);
 
     writeFrames(pDest, nFrames);
 
@@ -262,6 +351,12 @@ Mixer::onProcess()
 
     pw_stream_queue_buffer(m_pStream, pPwBuffer);
 
+    s64 took = utils::timeNowUS() - m_callbackStartUS;
+    m_statLastCallbackUS.store(took, std::memory_order_relaxed);
+    if (took > m_statMaxCallbackUS.load(std::memory_order_relaxed))
+        m_statMaxCallbackUS.store(took, std::memory_order_relaxed);
+    m_aStatCallbackHist[audio::callbackBucket(took)].fetch_add(1, std::memory_order_relaxed);
+
     /*if (!app::g_pWindow->bRunning) pw_main_loop_quit(pLoop);*/
     /* set bRunning for the mixer outside */
 }
@@ -5,6 +5,8 @@
 #include "adt/Thread.hh"
 #include "adt/Vec.hh"
 
+#include <atomic>
+
 #ifdef __clang__
     #pragma clang diagnostic push
     #pragma clang diagnostic ignored "-Wmissing-field-initializers"
@@ -35,7 +37,22 @@ class Mixer : public audio::IMixer
 
     pw_thread_loop* m_pThrdLoop {};
     pw_stream* m_pStream = nullptr;
+    u32 m_targetLatencyFrames = audio::DEFAULT_LATENCY_FRAMES;
     u32 m_lastNFrames {};
+    u64 m_lastTicks {};
+    s64 m_callbackStartUS {};
+
+    /* written by the pipewire thread, read by getStats() */
+    std::atomic<u32> m_statNFrames {};
+    std::atomic<f64> m_statDelayMS {};
+    std::atomic<u64> m_statNCallbacks {};
+    std::atomic<u64> m_statNUnderruns {};
+    std::atomic<u64> m_statNXruns {};
+    std::atomic<s64> m_statLastCallbackUS {};
+    std::atomic<s64> m_statMaxCallbackUS {};
+    std::atomic<f64> m_statLastAddToFirstMS {};
+    std::atomic<f64> m_statMaxAddToFirstMS {};
+    std::atomic<u64> m_aStatCallbackHist[audio::N_CALLBACK_BUCKETS] {};
 
     Mutex m_mtxAdd {};
     Vec<audio::Track> m_aTracks {};
@@ -46,7 +63,7 @@ class Mixer : public audio::IMixer
 
 public:
     Mixer() = default;
-    Mixer(IAllocator* pA);
+    Mixer(IAllocator* pA, u32 targetLatencyFrames = audio::DEFAULT_LATENCY_FRAMES);
 
     /* */ 
 
@@ -54,6 +71,7 @@ public:
     virtual void destroy() override final;
     virtual void add(audio::Track t) override final;
     virtual void addBackground(audio::Track t) override final;
+    virtual audio::Stats getStats() override final;
 
     /* */
 
@@ -63,6 +81,8 @@ public:
 private:
     void writeFrames(void* pBuff, u32 nFrames);
     void onProcess();
+    void updateTime();
+    void recordFirstSample(audio::Track* pTrack);
 };
 
 } /* namespace pipewire */
@@ -0,0 +1,864 @@
+#include "png.hh"
+
+#include "adt/defer.hh"
+#include "adt/logs.hh"
+#include "adt/utils.hh"
+#include "pixel.hh"
+
+#include <immintrin.h>
+
+namespace png
+{
+
+/* INFLATE */
+
+constexpr int FAST_BITS = 10;
+constexpr u32 FAST_MASK = (1u << FAST_BITS) - 1;
+
+static const u16 s_aLenBase[29] {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const u8 s_aLenExtra[29] {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const u16 s_aDistBase[30] {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const u8 s_aDistExtra[30] {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const u8 s_aCodeLenOrder[19] {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/* lsb first, keeps at least 56 bits after refill() */
+struct BitReader
+{
+    const u8* p {};
+    const u8* pEnd {};
+    u64 bits {};
+    u32 nBits {};
+    u32 nPastEnd {}; /* zero bytes fed after the end, some encoders cut the last byte short */
+
+    /* */
+
+    void
+    refill()
+    {
+        if (pEnd - p >= 8)
+        {
+            /* bytes that don't fit are read again next time, or'ing the same bits is harmless */
+            u64 v;
+            memcpy(&v, p, 8);
+            bits |= v << nBits;
+            p += (63 - nBits) >> 3;
+            nBits |= 56;
+        }
+        else
+        {
+            while (nBits <= 56)
+            {
+                if (p < pEnd) bits |= u64(*p++) << nBits;
+                else ++nPastEnd;
+                nBits += 8;
+            }
+        }
+    }
+
+    u32 peek(u32 n) const { return u32(bits & ((1ull << n) - 1)); }
+    void consume(u32 n) { bits >>= n; nBits -= n; }
+
+    u32
+    get(u32 n)
+    {
+        if (nBits < n) refill();
+        u32 r = peek(n);
+        consume(n);
+        return r;
+    }
+};
+
+struct Huffman
+{
+    u16 aFast[1 << FAST_BITS] {}; /* (length << 9) | symbol, 0 means slow path */
+    u16 aFirstCode[16] {};
+    u16 aFirstSymbol[16] {};
+    u32 aMaxCode[17] {};
+    u8 aSizes[288] {};
+    u16 aValues[288] {};
+};
+
+static inline u32
+reverseBits(u32 v, u32 n)
+{
+    v = ((v & 0xaaaa) >> 1) | ((v & 0x5555) << 1);
+    v = ((v & 0xcccc) >> 2) | ((v & 0x3333) << 2);
+    v = ((v & 0xf0f0) >> 4) | ((v & 0x0f0f) << 4);
+    v = ((v & 0xff00) >> 8) | ((v & 0x00ff) << 8);
+    return v >> (16 - n);
+}
+
+static bool
+buildHuffman(Huffman* h, const u8* aLens, int n)
+{
+    int aCounts[16] {};
+    for (int i = 0; i < n; ++i) ++aCounts[aLens[i]];
+    aCounts[0] = 0;
+
+    int aNext[16] {};
+    int code = 0, k = 0;
+    for (int i = 1; i < 16; ++i)
+    {
+        if (aCounts[i] > (1 << i)) return false;
+
+        aNext[i] = code;
+        h->aFirstCode[i] = u16(code);
+        h->aFirstSymbol[i] = u16(k);
+        code += aCounts[i];
+        if (aCounts[i] && code - 1 >= (1 << i)) return false; /* oversubscribed */
+
+        h->aMaxCode[i] = u32(code) << (16 - i); /* compared against 16 reversed bits in the slow path */
+        code <<= 1;
+        k += aCounts[i];
+    }
+    h->aMaxCode[16] = 0x10000;
+
+    memset(h->aFast, 0, sizeof(h->aFast));
+    for (int i = 0; i < n; ++i)
+    {
+        const int len = aLens[i];
+        if (len == 0) continue;
+
+        const int c = aNext[len] - h->aFirstCode[len] + h->aFirstSymbol[len];
+        h->aSizes[c] = u8(len);
+        h->aValues[c] = u16(i);
+
+        if (len <= FAST_BITS)
+        {
+            for (u32 j = reverseBits(aNext[len], len); j < (1u << FAST_BITS); j += 1u << len)
+                h->aFast[j] = u16((len << 9) | i);
+        }
+
+        ++aNext[len];
+    }
+
+    return true;
+}
+
+/* -1 on bad code */
+static inline int
+decodeSymbol(BitReader* br, const Huffman& h)
+{
+    if (br->nBits < 16) br->refill();
+
+    const u32 fast = h.aFast[br->bits & FAST_MASK];
+    if (fast)
+    {
+        br->consume(fast >> 9);
+        return int(fast & 511);
+    }
+
+    const u32 k = reverseBits(br->peek(16), 16);
+    u32 len = FAST_BITS + 1;
+    while (len < 16 && k >= h.aMaxCode[len]) ++len;
+    if (len >= 16) return -1;
+
+    const u32 idx = (k >> (16 - len)) - h.aFirstCode[len] + h.aFirstSymbol[len];
+    if (idx >= 288 || h.aSizes[idx] != len) return -1;
+
+    br->consume(len);
+    return h.aValues[idx];
+}
+
+static inline void
+copyMatch(u8* pOut, u32 dist, u32 len)
+{
+    const u8* pSrc = pOut - dist;
+
+#ifdef ADT_SSE4_2
+    /* every 16 byte chunk reads only bytes that are already written */
+    if (dist >= 16)
+    {
+        u8* pEnd = pOut + len;
+        do
+        {
+            _mm_storeu_si128((__m128i*)pOut, _mm_loadu_si128((const __m128i*)pSrc));
+            pOut += 16;
+            pSrc += 16;
+        }
+        while (pOut < pEnd);
+
+        return;
+    }
+#endif
+
+    if (dist == 1)
+    {
+        memset(pOut, *pSrc, len);
+        return;
+    }
+
+    for (u32 i = 0; i < len; ++i) pOut[i] = pSrc[i];
+}
+
+static bool
+decodeCodeLengths(BitReader* br, Huffman* pLit, Huffman* pDist)
+{
+    const u32 nLit = br->get(5) + 257;
+    const u32 nDist = br->get(5) + 1;
+    const u32 nCodeLen = br->get(4) + 4;
+    if (nLit > 286 || nDist > 30) return false; /* rfc1951 3.2.7, aLens has no room for more */
+
+    u8 aCodeLenLens[19] {};
+    for (u32 i = 0; i < nCodeLen; ++i)
+        aCodeLenLens[s_aCodeLenOrder[i]] = u8(br->get(3));
+
+    Huffman hCodeLen;
+    if (!buildHuffman(&hCodeLen, aCodeLenLens, 19)) return false;
+
+    u8 aLens[286 + 32] {};
+    u32 n = 0;
+    while (n < nLit + nDist)
+    {
+        int sym = decodeSymbol(br, hCodeLen);
+        if (sym < 0) return false;
+
+        if (sym < 16)
+        {
+            aLens[n++] = u8(sym);
+            continue;
+        }
+
+        u8 fill = 0;
+        u32 rep = 0;
+        if (sym == 16)
+        {
+            if (n == 0) return false;
+            fill = aLens[n - 1];
+            rep = br->get(2) + 3;
+        }
+        else if (sym == 17) rep = br->get(3) + 3;
+        else rep = br->get(7) + 11;
+
+        if (n + rep > nLit + nDist) return false;
+        memset(aLens + n, fill, rep);
+        n += rep;
+    }
+
+    return buildHuffman(pLit, aLens, nLit) && buildHuffman(pDist, aLens + nLit, nDist);
+}
+
+static bool
+decodeBlock(BitReader* br, const Huffman& hLit, const Huffman& hDist, u8* pStart, u8** ppOut, u8* pEnd)
+{
+    u8* pOut = *ppOut;
+
+    while (true)
+    {
+        br->refill();
+
+        int sym = decodeSymbol(br, hLit);
+        if (sym < 256)
+        {
+            if (sym < 0 || pOut >= pEnd) return false;
+            *pOut++ = u8(sym);
+            continue;
+        }
+
+        if (sym == 256) break;
+
+        sym -= 257;
+        if (sym >= 29) return false;
+        const u32 len = s_aLenBase[sym] + br->get(s_aLenExtra[sym]);
+
+        int distSym = decodeSymbol(br, hDist);
+        if (distSym < 0 || distSym >= 30) return false;
+        const u32 dist = s_aDistBase[distSym] + br->get(s_aDistExtra[distSym]);
+
+        if (dist > u32(pOut - pStart) || len > u32(pEnd - pOut)) return false;
+
+        copyMatch(pOut, dist, len);
+        pOut += len;
+    }
+
+    *ppOut = pOut;
+    return true;
+}
+
+ssize
+inflate(u8* pDst, ssize dstSize, const u8* pSrc, ssize srcSize)
+{
+    if (srcSize < 2) return -1;
+
+    /* zlib header: deflate, no preset dictionary */
+    const u8 cmf = pSrc[0], flg = pSrc[1];
+    if ((cmf & 0xf) != 8 || ((u32(cmf) << 8) | flg) % 31 != 0 || (flg & 0x20)) return -1;
+
+    BitReader br {.p = pSrc + 2, .pEnd = pSrc + srcSize};
+    u8* pOut = pDst;
+    u8* pEnd = pDst + dstSize;
+
+    static Huffman s_hFixedLit, s_hFixedDist;
+    static const bool s_bFixed = [] {
+        u8 aLens[288];
+        memset(aLens, 8, 144);
+        memset(aLens + 144, 9, 112);
+        memset(aLens + 256, 7, 24);
+        memset(aLens + 280, 8, 8);
+        u8 aDistLens[32];
+        memset(aDistLens, 5, 32);
+        return buildHuffman(&s_hFixedLit, aLens, 288) && buildHuffman(&s_hFixedDist, aDistLens, 32);
+    }();
+    (void)s_bFixed;
+
+    bool bFinal = false;
+    while (!bFinal)
+    {
+        bFinal = br.get(1);
+        const u32 type = br.get(2);
+
+        if (type == 0)
+        {
+            /* stored, drop to the byte boundary, part of it may still sit in the bit buffer */
+            br.consume(br.nBits & 7);
+            const u32 len = br.get(16);
+            const u32 nlen = br.get(16);
+            if ((len ^ 0xffff) != nlen || len > u32(pEnd - pOut)) return -1;
+
+            u32 left = len;
+            while (left > 0 && br.nBits >= 8)
+            {
+                *pOut++ = u8(br.bits);
+                br.consume(8);
+                --left;
+            }
+
+            if (left > 0)
+            {
+                if (br.pEnd - br.p < left) return -1;
+                memcpy(pOut, br.p, left);
+                pOut += left;
+                br.p += left;
+                br.bits = 0;
+            }
+        }
+        else if (type == 1)
+        {
+            if (!decodeBlock(&br, s_hFixedLit, s_hFixedDist, pDst, &pOut, pEnd)) return -1;
+        }
+        else if (type == 2)
+        {
+            Huffman hLit, hDist;
+            if (!decodeCodeLengths(&br, &hLit, &hDist)) return -1;
+            if (!decodeBlock(&br, hLit, hDist, pDst, &pOut, pEnd)) return -1;
+        }
+        else return -1;
+
+        if (br.nPastEnd > 8) return -1;
+    }
+
+    return pOut - pDst;
+}
+
+/* FILTERS */
+
+enum FILTER : u8 { NONE, SUB, UP, AVG, PAETH };
+
+static inline u8
+paeth(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = p > a ? p - a : a - p, pb = p > b ? p - b : b - p, pc = p > c ? p - c : c - p;
+    if (pa <= pb && pa <= pc) return u8(a);
+    if (pb <= pc) return u8(b);
+    return u8(c);
+}
+
+static void
+unfilterScalar(FILTER eFilter, u8* pRow, const u8* pPrior, u32 rowBytes, u32 bpp)
+{
+    switch (eFilter)
+    {
+        case NONE:
+            break;
+
+        case SUB:
+            for (u32 i = bpp; i < rowBytes; ++i) pRow[i] += pRow[i - bpp];
+            break;
+
+        case UP:
+            for (u32 i = 0; i < rowBytes; ++i) pRow[i] += pPrior[i];
+            break;
+
+        case AVG:
+            for (u32 i = 0; i < bpp; ++i) pRow[i] += pPrior[i] >> 1;
+            for (u32 i = bpp; i < rowBytes; ++i) pRow[i] += u8((pRow[i - bpp] + pPrior[i]) >> 1);
+            break;
+
+        case PAETH:
+            for (u32 i = 0; i < bpp; ++i) pRow[i] += pPrior[i];
+            for (u32 i = bpp; i < rowBytes; ++i) pRow[i] += paeth(pRow[i - bpp], pPrior[i], pPrior[i - bpp]);
+            break;
+    }
+}
+
+#ifdef ADT_SSE4_2
+
+static inline __m128i
+load4(const u8* p)
+{
+    u32 v;
+    memcpy(&v, p, 4);
+    return _mm_cvtsi32_si128(int(v));
+}
+
+/* 3 byte pixels still load 4, the raw buffer always has a byte (next filter type or slack) after the row */
+template<u32 BPP>
+static inline void
+store(u8* p, __m128i v)
+{
+    const u32 x = u32(_mm_cvtsi128_si32(v));
+    memcpy(p, &x, BPP);
+}
+
+/* one pixel per step, Sub/Avg/Paeth depend on the pixel to the left */
+template<u32 BPP>
+static void
+unfilterSSE(FILTER eFilter, u8* pRow, const u8* pPrior, u32 rowBytes)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    switch (eFilter)
+    {
+        case NONE:
+            break;
+
+        case SUB:
+        {
+            __m128i a = zero;
+            for (u32 i = 0; i < rowBytes; i += BPP)
+            {
+                a = _mm_add_epi8(a, load4(pRow + i));
+                store<BPP>(pRow + i, a);
+            }
+        }
+        break;
+
+        case UP:
+        {
+            u32 i = 0;
+            for (; i + 16 <= rowBytes; i += 16)
+            {
+                __m128i r = _mm_add_epi8(_mm_loadu_si128((__m128i*)(pRow + i)), _mm_loadu_si128((const __m128i*)(pPrior + i)));
+                _mm_storeu_si128((__m128i*)(pRow + i), r);
+            }
+            for (; i < rowBytes; ++i) pRow[i] += pPrior[i];
+        }
+        break;
+
+        case AVG:
+        {
+            /* avg_epu8 rounds up, take the carry back out */
+            const __m128i one = _mm_set1_epi8(1);
+            __m128i a = zero;
+            for (u32 i = 0; i < rowBytes; i += BPP)
+            {
+                const __m128i b = load4(pPrior + i);
+                const __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+                a = _mm_add_epi8(load4(pRow + i), avg);
+                store<BPP>(pRow + i, a);
+            }
+        }
+        break;
+
+        case PAETH:
+        {
+            /* 16 bit lanes, same tie breaking as the scalar version: a, then b, then c */
+            __m128i a = zero, c = zero;
+            for (u32 i = 0; i < rowBytes; i += BPP)
+            {
+                const __m128i b = _mm_unpacklo_epi8(load4(pPrior + i), zero);
+
+                __m128i pa = _mm_sub_epi16(b, c);
+                __m128i pb = _mm_sub_epi16(a, c);
+                __m128i pc = _mm_abs_epi16(_mm_add_epi16(pa, pb));
+                pa = _mm_abs_epi16(pa);
+                pb = _mm_abs_epi16(pb);
+
+                const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+                const __m128i nearest = _mm_blendv_epi8(
+                    _mm_blendv_epi8(c, b, _mm_cmpeq_epi16(smallest, pb)),
+                    a,
+                    _mm_cmpeq_epi16(smallest, pa)
+                );
+
+                const __m128i r = _mm_add_epi8(load4(pRow + i), _mm_packus_epi16(nearest, nearest));
+                store<BPP>(pRow + i, r);
+
+                a = _mm_unpacklo_epi8(r, zero);
+                c = b;
+            }
+        }
+        break;
+    }
+}
+
+#endif
+
+static bool
+unfilter(u8* pRaw, u32 rowBytes, u32 nRows, u32 bpp, const u8* pZeroRow)
+{
+    const u8* pPrior = pZeroRow;
+
+    for (u32 y = 0; y < nRows; ++y)
+    {
+        u8* pRow = pRaw + usize(y)*(rowBytes + 1);
+        const u8 eFilter = pRow[0];
+        if (eFilter > PAETH) return false;
+
+        ++pRow;
+
+#ifdef ADT_SSE4_2
+        if (bpp == 4) unfilterSSE<4>(FILTER(eFilter), pRow, pPrior, rowBytes);
+        else if (bpp == 3) unfilterSSE<3>(FILTER(eFilter), pRow, pPrior, rowBytes);
+        else unfilterScalar(FILTER(eFilter), pRow, pPrior, rowBytes, bpp);
+#else
+        unfilterScalar(FILTER(eFilter), pRow, pPrior, rowBytes, bpp);
+#endif
+
+        pPrior = pRow;
+    }
+
+    return true;
+}
+
+/* CONVERSION */
+
+struct Palette
+{
+    u32 aColors[256] {}; /* RGBA8 in memory order */
+    bool bKey {};
+    u16 aKey[3] {}; /* tRNS color key for GRAY (one value) and RGB */
+};
+
+static inline u32
+packRGBA(u8 r, u8 g, u8 b, u8 a)
+{
+    const u8 aBytes[4] {r, g, b, a};
+    u32 ret;
+    memcpy(&ret, aBytes, 4);
+    return ret;
+}
+
+static inline u32
+readSample(const u8* pRow, u32 idx, u32 bitDepth)
+{
+    switch (bitDepth)
+    {
+        case 16: return (u32(pRow[idx*2]) << 8) | pRow[idx*2 + 1];
+        case 8: return pRow[idx];
+
+        default:
+        {
+            const u32 bit = idx * bitDepth;
+            const u32 shift = 8 - bitDepth - (bit & 7);
+            return (pRow[bit >> 3] >> shift) & ((1u << bitDepth) - 1);
+        }
+    }
+}
+
+static void
+rowToRGBA(u32* pDst, const u8* pRow, u32 width, const Info& info, const Palette& pal)
+{
+    const u32 depth = info.bitDepth;
+    const u32 maxVal = (1u << depth) - 1;
+    auto to8 = [&](u32 v) { return u8(depth == 16 ? v >> 8 : v * 255 / maxVal); };
+
+    switch (info.eColorType)
+    {
+        case GRAY:
+        for (u32 x = 0; x < width; ++x)
+        {
+            const u32 v = readSample(pRow, x, depth);
+            const u8 g = to8(v);
+            pDst[x] = packRGBA(g, g, g, pal.bKey && v == pal.aKey[0] ? 0 : 255);
+        }
+        break;
+
+        case RGB:
+        if (depth == 8 && !pal.bKey)
+        {
+            pixel::rowRGBtoRGBA((u8*)pDst, pRow, int(width));
+            break;
+        }
+
+        for (u32 x = 0; x < width; ++x)
+        {
+            const u32 r = readSample(pRow, x*3 + 0, depth);
+            const u32 g = readSample(pRow, x*3 + 1, depth);
+            const u32 b = readSample(pRow, x*3 + 2, depth);
+            const bool bTransparent = pal.bKey && r == pal.aKey[0] && g == pal.aKey[1] && b == pal.aKey[2];
+            pDst[x] = packRGBA(to8(r), to8(g), to8(b), bTransparent ? 0 : 255);
+        }
+        break;
+
+        case PALETTE:
+        for (u32 x = 0; x < width; ++x)
+            pDst[x] = pal.aColors[readSample(pRow, x, depth)];
+        break;
+
+        case GRAY_ALPHA:
+        for (u32 x = 0; x < width; ++x)
+        {
+            const u8 g = to8(readSample(pRow, x*2 + 0, depth));
+            pDst[x] = packRGBA(g, g, g, to8(readSample(pRow, x*2 + 1, depth)));
+        }
+        break;
+
+        case RGBA:
+        if (depth == 8)
+        {
+            memcpy(pDst, pRow, usize(width) * 4);
+            break;
+        }
+
+        for (u32 x = 0; x < width; ++x)
+        {
+            pDst[x] = packRGBA(
+                to8(readSample(pRow, x*4 + 0, depth)), to8(readSample(pRow, x*4 + 1, depth)),
+                to8(readSample(pRow, x*4 + 2, depth)), to8(readSample(pRow, x*4 + 3, depth))
+            );
+        }
+        break;
+    }
+}
+
+/* DECODE */
+
+static inline u32
+readBE32(const u8* p)
+{
+    return (u32(p[0]) << 24) | (u32(p[1]) << 16) | (u32(p[2]) << 8) | p[3];
+}
+
+static u32
+nChannels(COLOR_TYPE eType)
+{
+    switch (eType)
+    {
+        case GRAY: return 1;
+        case RGB: return 3;
+        case PALETTE: return 1;
+        case GRAY_ALPHA: return 2;
+        case RGBA: return 4;
+    }
+
+    return 0;
+}
+
+static bool
+validDepth(COLOR_TYPE eType, u32 depth)
+{
+    switch (eType)
+    {
+        case GRAY: return depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+        case PALETTE: return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+        case RGB:
+        case GRAY_ALPHA:
+        case RGBA: return depth == 8 || depth == 16;
+    }
+
+    return false;
+}
+
+struct Pass
+{
+    u32 x0, y0, dx, dy;
+};
+
+static const Pass s_aAdam7[7] {
+    {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}
+};
+
+u8*
+decode(IAllocator* pAlloc, const String sFile, bool bBottomUp, Info* pInfo)
+{
+    auto bad = [&](const char* ntsWhy) -> u8* {
+        LOG_WARN("png: {}\n", ntsWhy);
+        (void)ntsWhy;
+        return nullptr;
+    };
+
+    if (!isPNG(sFile)) return bad("no signature");
+
+    const u8* p = (const u8*)sFile.data() + 8;
+    const u8* pEnd = (const u8*)sFile.data() + sFile.getSize();
+
+    Info info {};
+    Palette pal {};
+    for (u32 i = 0; i < 256; ++i) pal.aColors[i] = packRGBA(0, 0, 0, 255);
+
+    /* first pass over the chunks: header, palette and where the compressed data is */
+    const u8* pFirstIDAT = nullptr;
+    usize idatSize = 0;
+    u32 nIDATs = 0;
+    bool bHeader = false;
+
+    while (pEnd - p >= 12)
+    {
+        const u32 len = readBE32(p);
+        const u8* pType = p + 4;
+        const u8* pData = p + 8;
+        if (len > u32(pEnd - pData) - 4) return bad("truncated chunk");
+
+        if (memcmp(pType, "IHDR", 4) == 0)
+        {
+            if (len != 13) return bad("bad IHDR");
+
+            info.width = readBE32(pData);
+            info.height = readBE32(pData + 4);
+            info.bitDepth = pData[8];
+            info.eColorType = COLOR_TYPE(pData[9]);
+            info.bInterlaced = pData[12] == 1;
+
+            if (pData[10] != 0 || pData[11] != 0 || pData[12] > 1) return bad("unknown compression/filter/interlace method");
+            if (nChannels(info.eColorType) == 0 || !validDepth(info.eColorType, info.bitDepth)) return bad("bad color type/bit depth");
+            if (info.width == 0 || info.height == 0 || u64(info.width)*info.height > (1ull << 28)) return bad("bad size");
+            bHeader = true;
+        }
+        else if (memcmp(pType, "PLTE", 4) == 0)
+        {
+            if (len % 3 != 0 || len > 256*3) return bad("bad PLTE");
+            for (u32 i = 0; i < len / 3; ++i)
+                pal.aColors[i] = packRGBA(pData[i*3], pData[i*3 + 1], pData[i*3 + 2], 255);
+        }
+        else if (memcmp(pType, "tRNS", 4) == 0)
+        {
+            if (info.eColorType == PALETTE)
+            {
+                for (u32 i = 0; i < len && i < 256; ++i)
+                    ((u8*)&pal.aColors[i])[3] = pData[i];
+            }
+            else if (info.eColorType == GRAY && len >= 2)
+            {
+                pal.bKey = true;
+                pal.aKey[0] = u16((pData[0] << 8) | pData[1]);
+            }
+            else if (info.eColorType == RGB && len >= 6)
+            {
+                pal.bKey = true;
+                for (u32 i = 0; i < 3; ++i) pal.aKey[i] = u16((pData[i*2] << 8) | pData[i*2 + 1]);
+            }
+        }
+        else if (memcmp(pType, "IDAT", 4) == 0)
+        {
+            if (!pFirstIDAT) pFirstIDAT = p;
+            idatSize += len;
+            ++nIDATs;
+        }
+        else if (memcmp(pType, "IEND", 4) == 0)
+        {
+            break;
+        }
+        else if (!(pType[0] & 0x20))
+        {
+            return bad("unknown critical chunk");
+        }
+
+        p = pData + len + 4;
+    }
+
+    if (!bHeader || !pFirstIDAT) return bad("missing IHDR/IDAT");
+
+    /* single IDAT is inflated in place, otherwise glue them together */
+    const u8* pZ = pFirstIDAT + 8;
+    u8* pJoined = nullptr;
+    if (nIDATs > 1)
+    {
+        pJoined = (u8*)pAlloc->malloc(idatSize, 1);
+        usize off = 0;
+        for (const u8* c = pFirstIDAT; pEnd - c >= 12; )
+        {
+            const u32 len = readBE32(c);
+            if (memcmp(c + 4, "IDAT", 4) == 0)
+            {
+                memcpy(pJoined + off, c + 8, len);
+                off += len;
+            }
+            else if (memcmp(c + 4, "IEND", 4) == 0) break;
+
+            c += 12 + len;
+        }
+        pZ = pJoined;
+    }
+
+    const u32 bitsPerPixel = nChannels(info.eColorType) * info.bitDepth;
+    const u32 bpp = utils::max(bitsPerPixel / 8, 1u); /* filter distance */
+    auto rowBytes = [&](u32 width) { return u32((u64(width) * bitsPerPixel + 7) / 8); };
+
+    Pass aPasses[7] {};
+    u32 nPasses = 1;
+    if (info.bInterlaced)
+    {
+        nPasses = 7;
+        for (u32 i = 0; i < 7; ++i) aPasses[i] = s_aAdam7[i];
+    }
+    else aPasses[0] = {0, 0, 1, 1};
+
+    u32 aPassWidth[7] {}, aPassHeight[7] {};
+    usize rawSize = 0;
+    u32 maxRowBytes = 0;
+    for (u32 i = 0; i < nPasses; ++i)
+    {
+        const Pass& ps = aPasses[i];
+        aPassWidth[i] = info.width > ps.x0 ? (info.width - ps.x0 + ps.dx - 1) / ps.dx : 0;
+        aPassHeight[i] = info.height > ps.y0 ? (info.height - ps.y0 + ps.dy - 1) / ps.dy : 0;
+        if (aPassWidth[i] == 0 || aPassHeight[i] == 0) continue;
+
+        rawSize += usize(aPassHeight[i]) * (rowBytes(aPassWidth[i]) + 1);
+        maxRowBytes = utils::max(maxRowBytes, rowBytes(aPassWidth[i]));
+    }
+
+    u8* pRaw = (u8*)pAlloc->malloc(rawSize + INFLATE_SLACK, 1);
+    u8* pZeroRow = (u8*)pAlloc->zalloc(maxRowBytes + INFLATE_SLACK, 1);
+    defer(
+        pAlloc->free(pRaw);
+        pAlloc->free(pZeroRow);
+        if (pJoined) pAlloc->free(pJoined);
+    );
+
+    if (inflate(pRaw, rawSize, pZ, idatSize) != ssize(rawSize)) return bad("corrupt image data");
+
+    u32* pOut = (u32*)pAlloc->malloc(usize(info.width) * info.height, 4);
+    u32* pTmpRow = info.bInterlaced ? (u32*)pAlloc->malloc(info.width, 4) : nullptr;
+    defer( if (pTmpRow) pAlloc->free(pTmpRow) );
+
+    auto outRow = [&](u32 y) { return pOut + usize(bBottomUp ? info.height - 1 - y : y) * info.width; };
+
+    u8* pPass = pRaw;
+    for (u32 i = 0; i < nPasses; ++i)
+    {
+        const u32 w = aPassWidth[i], h = aPassHeight[i];
+        if (w == 0 || h == 0) continue;
+
+        const u32 nRowBytes = rowBytes(w);
+        if (!unfilter(pPass, nRowBytes, h, bpp, pZeroRow))
+        {
+            pAlloc->free(pOut);
+            return bad("bad filter type");
+        }
+
+        const Pass& ps = aPasses[i];
+        for (u32 y = 0; y < h; ++y)
+        {
+            const u8* pRow = pPass + usize(y)*(nRowBytes + 1) + 1;
+
+            if (!info.bInterlaced)
+            {
+                rowToRGBA(outRow(y), pRow, w, info, pal);
+                continue;
+            }
+
+            rowToRGBA(pTmpRow, pRow, w, info, pal);
+            u32* pDst = outRow(ps.y0 + y*ps.dy);
+            for (u32 x = 0; x < w; ++x) pDst[ps.x0 + x*ps.dx] = pTmpRow[x];
+        }
+
+        pPass += usize(h) * (nRowBytes + 1);
+    }
+
+    if (pInfo) *pInfo = info;
+    return (u8*)pOut;
+}
+
+} /* namespace png */
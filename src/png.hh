@@ -0,0 +1,52 @@
+#pragma once
+
+#include "adt/IAllocator.hh"
+#include "adt/String.hh"
+
+#include <cstring>
+
+using namespace adt;
+
+/* Self contained PNG decoder, every color type and bit depth, Adam7 and tRNS, output is always RGBA8.
+ * Inflate copies long matches 16 bytes at a time, Sub/Avg/Paeth of 3 and 4 byte pixels and Up
+ * are undone with SSE (under ADT_SSE4_2). CRCs and the adler32 are not checked. */
+namespace png
+{
+
+constexpr u8 SIGNATURE[8] {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+/* inflate() may write this much past the end of the output while copying matches */
+constexpr ssize INFLATE_SLACK = 16;
+
+enum COLOR_TYPE : u8
+{
+    GRAY = 0,
+    RGB = 2,
+    PALETTE = 3,
+    GRAY_ALPHA = 4,
+    RGBA = 6,
+};
+
+struct Info
+{
+    u32 width {};
+    u32 height {};
+    u8 bitDepth {};
+    COLOR_TYPE eColorType {};
+    bool bInterlaced {};
+};
+
+inline bool
+isPNG(const String sFile)
+{
+    return sFile.getSize() >= 8 && memcmp(sFile.data(), SIGNATURE, 8) == 0;
+}
+
+/* width*height*4 bytes allocated from pAlloc, nullptr if the file is corrupt or unsupported.
+ * Rows go top to bottom, or bottom to top with bBottomUp (gl convention). */
+[[nodiscard]] u8* decode(IAllocator* pAlloc, const String sFile, bool bBottomUp, Info* pInfo);
+
+/* zlib stream into pDst (capacity dstSize + INFLATE_SLACK), bytes written or -1 on error */
+ssize inflate(u8* pDst, ssize dstSize, const u8* pSrc, ssize srcSize);
+
+} /* namespace png */
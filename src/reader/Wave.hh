@@ -2,6 +2,7 @@
 
 #include "Bin.hh"
 #include "adt/Thread.hh"
+#include "adt/prof.hh"
 #include "audio.hh"
 
 namespace reader
@@ -58,6 +59,8 @@ struct WaveLoadArg
 inline THREAD_STATUS
 WaveSubmit(void* pArg)
 {
+    PROFILE_SCOPE("WaveSubmit");
+
     auto a = *(WaveLoadArg*)pArg;
     a.s->load(a.path);
     a.s->parse();
@@ -1,5 +1,7 @@
 #include "ttf.hh"
 
+#include "adt/prof.hh"
+
 #include <cmath>
 
 namespace reader
@@ -10,15 +12,40 @@ namespace ttf
 constexpr f32
 F2Dot14Tof32(F2Dot14 x)
 {
-    f32 ret = f32((0xc000 & x) >> 14);
-    ret += (f32(x & 0x3fff)) / f32(0x3fff);
+    return f32(x) / f32(1 << 14);
+}
 
-    return ret;
+CodepointTable::CodepointTable(IAllocator* pAlloc)
+    : m_pBmp((u16*)pAlloc->zalloc(BMP_SIZE, sizeof(u16))),
+      m_pPageIdxs((u16*)pAlloc->zalloc(N_PAGES, sizeof(u16))),
+      m_aPages(pAlloc, 4)
+{
+    m_aPages.push(pAlloc, Page {}); /* shared empty page */
+}
+
+void
+CodepointTable::set(IAllocator* pAlloc, u32 code, u16 glyphIdx)
+{
+    if (code < BMP_SIZE)
+    {
+        m_pBmp[code] = glyphIdx;
+        return;
+    }
+
+    if (code > MAX_CODEPOINT) return;
+
+    const u32 hi = code - BMP_SIZE;
+    u16& pageIdx = m_pPageIdxs[hi >> PAGE_SHIFT];
+    if (pageIdx == 0) pageIdx = u16(m_aPages.push(pAlloc, Page {}));
+
+    m_aPages[pageIdx].aGlyphIdxs[hi & (PAGE_SIZE - 1)] = glyphIdx;
 }
 
 bool
 Font::loadParse(String path)
 {
+    PROFILE_SCOPE("Font::loadParse");
+
     auto bSuc = m_bin.load(path);
     if (!bSuc)
     {
@@ -180,6 +207,79 @@ Font::readHeadTable()
 #endif
 }
 
+void
+Font::readHheaTable()
+{
+    const u32 savedPos = m_bin.m_pos;
+    defer(m_bin.m_pos = savedPos);
+
+    auto fHhea = getTable("hhea");
+    auto fHmtx = getTable("hmtx");
+    if (!fHhea || !fHmtx)
+    {
+        LOG_WARN("no 'hhea'/'hmtx' tables, advances will fall back to glyph bounds\n");
+        return;
+    }
+
+    m_bin.m_pos = fHhea.pData->val.offset;
+
+    auto& h = m_hhea;
+
+    h.version.l = m_bin.read16Rev();
+    h.version.r = m_bin.read16Rev();
+    h.ascent = m_bin.read16Rev();
+    h.descent = m_bin.read16Rev();
+    h.lineGap = m_bin.read16Rev();
+    h.advanceWidthMax = m_bin.read16Rev();
+    h.minLeftSideBearing = m_bin.read16Rev();
+    h.minRightSideBearing = m_bin.read16Rev();
+    h.xMaxExtent = m_bin.read16Rev();
+    h.caretSlopeRise = m_bin.read16Rev();
+    h.caretSlopeRun = m_bin.read16Rev();
+    h.caretOffset = m_bin.read16Rev();
+    h.reserved0 = m_bin.read16Rev();
+    h.reserved1 = m_bin.read16Rev();
+    h.reserved2 = m_bin.read16Rev();
+    h.reserved3 = m_bin.read16Rev();
+    h.metricDataFormat = m_bin.read16Rev();
+    h.numOfLongHorMetrics = m_bin.read16Rev();
+
+    m_hmtxOffset = fHmtx.pData->val.offset;
+}
+
+LongHorMetric
+Font::getHorMetric(u32 glyphIdx)
+{
+    if (m_hhea.numOfLongHorMetrics == 0)
+    {
+        auto g = readGlyphIdx(glyphIdx);
+        return {.advanceWidth = uFWord(g.xMax), .leftSideBearing = g.xMin};
+    }
+
+    const u32 savedPos = m_bin.m_pos;
+    defer(m_bin.m_pos = savedPos);
+
+    LongHorMetric ret {};
+    const u32 nLong = m_hhea.numOfLongHorMetrics;
+
+    if (glyphIdx < nLong)
+    {
+        m_bin.m_pos = m_hmtxOffset + glyphIdx*4;
+        ret.advanceWidth = m_bin.read16Rev();
+        ret.leftSideBearing = m_bin.read16Rev();
+    }
+    else
+    {
+        /* monospaced tail: advance of the last long record, followed by bare leftSideBearing array */
+        m_bin.m_pos = m_hmtxOffset + (nLong - 1)*4;
+        ret.advanceWidth = m_bin.read16Rev();
+        m_bin.m_pos = m_hmtxOffset + nLong*4 + (glyphIdx - nLong)*2;
+        ret.leftSideBearing = m_bin.read16Rev();
+    }
+
+    return ret;
+}
+
 void
 Font::readCmapFormat4()
 {
@@ -194,7 +294,6 @@ Font::readCmapFormat4()
     c.rangeShift = m_bin.read16Rev();
 
     auto segCount = c.segCountX2 / 2;
-    c.mCodeToGlyphIdx = {m_bin.m_pAlloc, u32(segCount)};
 
     auto searchRangeCheck = 2*(std::pow(2, std::floor(std::log2(segCount))));
     assert(c.searchRange == searchRangeCheck);
@@ -218,6 +317,34 @@ Font::readCmapFormat4()
     c.idRangeOffset = (u16*)&m_bin[m_bin.m_pos];
     m_bin.m_pos += c.segCountX2;
 
+    for (u32 i = 0; i < u32(segCount); ++i)
+    {
+        const u32 start = reader::swapBytes(c.startCode[i]);
+        const u32 end = reader::swapBytes(c.endCode[i]);
+        const u16 delta = reader::swapBytes(c.idDelta[i]);
+        const u16 rangeOffset = reader::swapBytes(c.idRangeOffset[i]);
+
+        /* idRangeOffset is relative to its own position in the file */
+        const ssize rangeAddr = (char*)&c.idRangeOffset[i] - m_bin.m_sFile.data();
+
+        for (u32 code = start; code <= end && code < 0xffff; ++code)
+        {
+            u16 idx = 0;
+
+            if (rangeOffset)
+            {
+                m_bin.m_pos = rangeAddr + rangeOffset + 2*(code - start);
+                if (m_bin.m_pos + 2 > m_bin.m_sFile.getSize()) break;
+
+                idx = m_bin.read16Rev();
+                if (idx) idx += delta;
+            }
+            else idx = u16(code + delta);
+
+            if (idx) m_codepoints.set(m_bin.m_pAlloc, code, idx);
+        }
+    }
+
 #ifdef D_TTF
     LOG_NOTIFY(
         "\treadCmapFormat4:\n"
@@ -242,6 +369,40 @@ Font::readCmapFormat4()
 }
 
 void
+Font::readCmapFormat12()
+{
+    u32 savedPos = m_bin.m_pos;
+    defer(m_bin.m_pos = savedPos);
+
+    m_bin.m_pos += 2; /* reserved */
+    [[maybe_unused]] const u32 length = m_bin.read32Rev();
+    [[maybe_unused]] const u32 language = m_bin.read32Rev();
+    const u32 numGroups = m_bin.read32Rev();
+
+#ifdef D_TTF
+    LOG_NOTIFY("\treadCmapFormat12: length: {}, language: {}, numGroups: {}\n", length, language, numGroups);
+#endif
+
+    for (u32 i = 0; i < numGroups; ++i)
+    {
+        CmapFormat12Group g {
+            .startCharCode = m_bin.read32Rev(),
+            .endCharCode = m_bin.read32Rev(),
+            .startGlyphID = m_bin.read32Rev(),
+        };
+
+        if (g.startCharCode > g.endCharCode || g.endCharCode > CodepointTable::MAX_CODEPOINT)
+        {
+            LOG_WARN("bad cmap group: [{}, {}]\n", g.startCharCode, g.endCharCode);
+            continue;
+        }
+
+        for (u32 code = g.startCharCode; code <= g.endCharCode; ++code)
+            m_codepoints.set(m_bin.m_pAlloc, code, u16(g.startGlyphID + (code - g.startCharCode)));
+    }
+}
+
+bool
 Font::readCmap(u32 offset)
 {
     u32 savedPos = m_bin.m_pos;
@@ -250,21 +411,30 @@ Font::readCmap(u32 offset)
     m_bin.m_pos = offset;
 
     u16 format = m_bin.read16Rev();
-    u16 length = m_bin.read16Rev();
-    u16 language = m_bin.read16Rev();
+
+    if (format == 4)
+    {
+        u16 length = m_bin.read16Rev();
+        u16 language = m_bin.read16Rev();
 
 #ifdef D_TTF
-    LOG_NOTIFY("readCmap: format: {}, length: {}, language: {}\n", format, length, language);
+        LOG_NOTIFY("readCmap: format: {}, length: {}, language: {}\n", format, length, language);
 #endif
 
-    // TODO: other formats
-    if (format == 4)
-    {
         m_cmapF4.format = format;
         m_cmapF4.length = length;
         m_cmapF4.language = language;
         readCmapFormat4();
+        return true;
+    }
+    else if (format == 12)
+    {
+        readCmapFormat12();
+        return true;
     }
+
+    // TODO: other formats
+    return false;
 }
 
 void
@@ -294,26 +464,42 @@ Font::readCmapTable()
             .offset = m_bin.read32Rev(),
         });
 
-        const auto& lastSt = c.aSubtables.last();
-
 #ifdef D_TTF
+        const auto& lastSt = c.aSubtables.last();
         LOG_NOTIFY(
             "readCmap: platformID: {}('{}'), platformSpecificID: {}('{}')\n",
             lastSt.platformID, platformIDToString(lastSt.platformID),
             lastSt.platformSpecificID, platformSpecificIDToString(lastSt.platformSpecificID)
         );
 #endif
-        if (lastSt.platformID == 3 && lastSt.platformSpecificID <= 1)
-        {
-            readCmap(fCmap.pData->val.offset + lastSt.offset);
-            break;
-        }
-        else if (lastSt.platformID == 0 && lastSt.platformSpecificID == 3)
+    }
+
+    /* prefer full unicode coverage (format 12) over the BMP only format 4 */
+    u32 bestOffset = 0;
+    int bestRank = 0;
+    for (const auto& st : c.aSubtables)
+    {
+        const bool bUnicode = st.platformID == 0 ||
+            (st.platformID == 3 && (st.platformSpecificID <= 1 || st.platformSpecificID == 10));
+        if (!bUnicode || st.platformSpecificID == 5) continue; /* 0/5 is variation sequences */
+
+        const u32 offset = fCmap.pData->val.offset + st.offset;
+        m_bin.m_pos = offset;
+        const u16 format = m_bin.read16Rev();
+
+        const int rank = format == 12 ? 2 : format == 4 ? 1 : 0;
+        if (rank > bestRank)
         {
-            // TODO: Unicode, Unicode 2.0 or later (BMP only)
+            bestRank = rank;
+            bestOffset = offset;
         }
     }
 
+    m_codepoints = CodepointTable(m_bin.m_pAlloc);
+
+    if (bestRank == 0 || !readCmap(bestOffset))
+        LOG_WARN("'{}': no supported unicode cmap subtable\n", m_bin.m_sPath);
+
 #ifdef D_TTF
     LOG(
         "\tcmap:\n"
@@ -357,8 +543,9 @@ Font::getGlyphOffset(u32 idx)
     }
     else
     {
+        /* short version stores offset / 2 */
         m_bin.m_pos = locaTable.val.offset + idx*2;
-        offset = m_bin.read16Rev();
+        offset = u32(m_bin.read16Rev()) * 2;
     }
 
     auto fGlyf = getTable("glyf");
@@ -367,11 +554,122 @@ Font::getGlyphOffset(u32 idx)
     return offset + fGlyf.pData->val.offset;
 }
 
+/* Reads every component, transforms its points and appends them as extra contours.
+ * Result looks like a simple glyph to the rest of the code. */
 void
 Font::readCompoundGlyph(Glyph* g)
 {
-    // TODO:
-    LOG_WARN("ignoring compound glyph...\n");
+    auto& sg = g->uGlyph.simple;
+    sg = {};
+    g->numberOfContours = 0;
+
+    /* components may nest, bail on anything too deep (or cyclic) */
+    if (m_compoundDepth >= 8)
+    {
+        LOG_WARN("compound glyph nesting is too deep\n");
+        return;
+    }
+
+    ++m_compoundDepth;
+    defer( --m_compoundDepth );
+
+    IAllocator* pAlloc = m_bin.m_pAlloc;
+    COMPONENT_FLAG eFlag {};
+
+    do
+    {
+        GlyphCompound comp {
+            .eFlag = COMPONENT_FLAG(m_bin.read16Rev()),
+            .glyphIndex = m_bin.read16Rev(),
+            .a = 1.0f,
+            .d = 1.0f,
+        };
+        eFlag = comp.eFlag;
+
+        const bool bXY = eFlag & ARGS_ARE_XY_VALUES;
+
+        if (eFlag & ARG_1_AND_2_ARE_WORDS)
+        {
+            u16 arg1 = m_bin.read16Rev();
+            u16 arg2 = m_bin.read16Rev();
+            comp.argument1 = bXY ? s32(s16(arg1)) : s32(arg1);
+            comp.argument2 = bXY ? s32(s16(arg2)) : s32(arg2);
+        }
+        else
+        {
+            u8 arg1 = m_bin.read8();
+            u8 arg2 = m_bin.read8();
+            comp.argument1 = bXY ? s32(s8(arg1)) : s32(arg1);
+            comp.argument2 = bXY ? s32(s8(arg2)) : s32(arg2);
+        }
+
+        if (eFlag & WE_HAVE_A_SCALE)
+        {
+            comp.a = comp.d = F2Dot14Tof32(m_bin.read16Rev());
+        }
+        else if (eFlag & WE_HAVE_AN_X_AND_Y_SCALE)
+        {
+            comp.a = F2Dot14Tof32(m_bin.read16Rev());
+            comp.d = F2Dot14Tof32(m_bin.read16Rev());
+        }
+        else if (eFlag & WE_HAVE_A_TWO_BY_TWO)
+        {
+            comp.a = F2Dot14Tof32(m_bin.read16Rev());
+            comp.b = F2Dot14Tof32(m_bin.read16Rev());
+            comp.c = F2Dot14Tof32(m_bin.read16Rev());
+            comp.d = F2Dot14Tof32(m_bin.read16Rev());
+        }
+
+        Glyph cg = readGlyphIdx(comp.glyphIndex);
+        if (cg.numberOfContours <= 0) continue;
+
+        const auto& csg = cg.uGlyph.simple;
+
+        f32 e = 0.0f;
+        f32 f = 0.0f;
+
+        if (bXY)
+        {
+            e = f32(comp.argument1);
+            f = f32(comp.argument2);
+
+            if ((eFlag & SCALED_COMPONENT_OFFSET) && !(eFlag & UNSCALED_COMPONENT_OFFSET))
+            {
+                const f32 x = e;
+                e = comp.a*x + comp.c*f;
+                f = comp.b*x + comp.d*f;
+            }
+        }
+        else if (comp.argument1 < sg.aPoints.getSize() && comp.argument2 < csg.aPoints.getSize())
+        {
+            /* line up point argument1 of what's composed so far with point argument2 of the component */
+            const auto& pp = sg.aPoints[comp.argument1];
+            const auto& cp = csg.aPoints[comp.argument2];
+            e = pp.x - (comp.a*cp.x + comp.c*cp.y);
+            f = pp.y - (comp.b*cp.x + comp.d*cp.y);
+        }
+
+        const u16 base = u16(sg.aPoints.getSize());
+
+        for (u16 end : csg.aEndPtsOfContours)
+            sg.aEndPtsOfContours.push(pAlloc, u16(base + end));
+
+        for (ssize i = 0; i < csg.aPoints.getSize(); ++i)
+        {
+            const auto& p = csg.aPoints[i];
+
+            sg.aeFlags.push(pAlloc, csg.aeFlags[i]);
+            sg.aPoints.push(pAlloc, {
+                .x = s16(std::round(comp.a*p.x + comp.c*p.y + e)),
+                .y = s16(std::round(comp.b*p.x + comp.d*p.y + f)),
+                .bOnCurve = p.bOnCurve,
+            });
+        }
+    }
+    while (eFlag & MORE_COMPONENTS);
+
+    /* instructions after the last component are ignored, same as for simple glyphs */
+    g->numberOfContours = s16(sg.aEndPtsOfContours.getSize());
 }
 
 void
@@ -442,50 +740,24 @@ Font::readSimpleGlyph(Glyph* g)
     readCoords(false, Y_SHORT_VECTOR, THIS_Y_IS_SAME);
 }
 
-u32
-Font::getGlyphIdx(u16 code)
+Glyph
+Font::readGlyph(u32 code)
 {
-    auto& c = m_cmapF4;
-    auto fIdx = c.mCodeToGlyphIdx.search(code);
-
-    if (fIdx) return fIdx.data().val;
-
-    u32 savedPos = m_bin.m_pos;
-    defer(m_bin.m_pos = savedPos);
-
-    u32 idx = 0, glyphIndexAddr = 0;
-
-    for (u16 i = 0; i < c.segCountX2/2; ++i)
-    {
-        if (reader::swapBytes(c.startCode[i]) <= code && reader::swapBytes(c.endCode[i]) >= code)
-        {
-            idx = 0, glyphIndexAddr = 0;
-            if (reader::swapBytes(c.idRangeOffset[i]))
-            {
-                glyphIndexAddr = reader::swapBytes(c.idRangeOffset[i]) +
-                    2 * (code - reader::swapBytes(c.startCode[i]));
-                m_bin.m_pos = glyphIndexAddr;
-                idx = m_bin.read16Rev();
-            }
-            else idx = (reader::swapBytes(c.idDelta[i]) + code) & 0xffff;
-
-            c.mCodeToGlyphIdx.insert(m_bin.m_pAlloc, code, u16(idx));
-            break;
-        }
-    }
-
-    return idx;
+    return readGlyphIdx(getGlyphIdx(code));
 }
 
 Glyph
-Font::readGlyph(u32 code)
+Font::readGlyphIdx(u32 glyphIdx)
 {
     const u32 savedPos = m_bin.m_pos;
     defer(m_bin.m_pos = savedPos);
 
-    const auto glyphIdx = getGlyphIdx(code);
     const u32 offset = getGlyphOffset(glyphIdx);
 
+    /* glyphs without outlines (space etc.) have zero length in 'loca' */
+    if (offset == getGlyphOffset(glyphIdx + 1))
+        return {};
+
     auto fCachedGlyph = m_mOffsetToGlyph.search(offset);
     if (fCachedGlyph)
         return fCachedGlyph.pData->val;
@@ -509,9 +781,7 @@ Font::readGlyph(u32 code)
         .yMax = readFWord(),
     };
 
-    assert(g.numberOfContours >= -1);
-
-    if (g.numberOfContours == -1)
+    if (g.numberOfContours < 0)
         readCompoundGlyph(&g);
     else readSimpleGlyph(&g);
 
@@ -648,6 +918,7 @@ Font::parse()
 #endif
 
     readHeadTable();
+    readHheaTable();
     readCmapTable();
 
     return true;
@@ -112,7 +112,53 @@ struct CmapFormat4
     u16* idDelta; /* [segCount] Delta for all character codes in segment */
     u16* idRangeOffset; /* [segCount] Offset in bytes to glyph indexArray, or 0 */
     // VecBase<u16> aGlyghIndex; /* Glyph index array */
-    MapBase<code, glyphIdx> mCodeToGlyphIdx;
+};
+
+/* 'cmap' format 12
+ *
+ * Segmented coverage, used for fonts that map codepoints outside of the BMP.
+ * Header is format(u16), reserved(u16), length(u32), language(u32), numGroups(u32) followed by the groups. */
+struct CmapFormat12Group
+{
+    u32 startCharCode; /* First character code in this group */
+    u32 endCharCode; /* Last character code in this group */
+    u32 startGlyphID; /* Glyph index corresponding to the starting character code */
+};
+
+/* Codepoint to glyph index, filled once from whichever cmap subtable was picked.
+ * BMP is a direct array, everything above goes through a page index where 0 is a shared empty page. */
+struct CodepointTable
+{
+    static constexpr u32 BMP_SIZE = 0x10000;
+    static constexpr u32 MAX_CODEPOINT = 0x10ffff;
+    static constexpr u32 PAGE_SHIFT = 8;
+    static constexpr u32 PAGE_SIZE = 1 << PAGE_SHIFT;
+    static constexpr u32 N_PAGES = (MAX_CODEPOINT + 1 - BMP_SIZE) / PAGE_SIZE;
+
+    struct Page { u16 aGlyphIdxs[PAGE_SIZE]; };
+
+    u16* m_pBmp {}; /* [BMP_SIZE] */
+    u16* m_pPageIdxs {}; /* [N_PAGES] */
+    VecBase<Page> m_aPages {};
+
+    /* */
+
+    CodepointTable() = default;
+    CodepointTable(IAllocator* pAlloc);
+
+    /* */
+
+    [[nodiscard]] u16
+    get(u32 code) const
+    {
+        if (code < BMP_SIZE) return m_pBmp[code];
+        if (code > MAX_CODEPOINT) return 0;
+
+        const u32 hi = code - BMP_SIZE;
+        return m_aPages[m_pPageIdxs[hi >> PAGE_SHIFT]].aGlyphIdxs[hi & (PAGE_SIZE - 1)];
+    }
+
+    void set(IAllocator* pAlloc, u32 code, u16 glyphIdx);
 };
 
 enum OUTLINE_FLAG : u8
@@ -172,12 +218,14 @@ enum COMPONENT_FLAG : u16
     WE_HAVE_A_SCALE = 1 << 3, /* If set, there is a simple scale for the component.
                                * If not set, scale is 1.0. */
     __THIS_BIT_IS_OBSOLETE = 1 << 4, /* (obsolete; set to zero) */
-    MORE_COMPONENST, /* If set, at least one additional glyph follows this one. */
-    WE_HAVE_AN_X_AND_Y_SCALE = 1 << 5, /* If set the x direction will use a different scale than the y direction. */
-    WE_HAVE_A_TWO_BY_TWO = 1 << 6, /* If set there is a 2-by-2 transformation that will be used to scale the component. */
-    WE_HAVE_INSTRUCTIONS = 1 << 7, /* If set, instructions for the component character follow the last component. */
-    USE_MY_METRICS = 1 << 8, /* Use metrics from this component for the compound glyph. */
-    OVERLAP_COMPOUND = 1 << 9, /* If set, the components of this compound glyph overlap. */
+    MORE_COMPONENTS = 1 << 5, /* If set, at least one additional glyph follows this one. */
+    WE_HAVE_AN_X_AND_Y_SCALE = 1 << 6, /* If set the x direction will use a different scale than the y direction. */
+    WE_HAVE_A_TWO_BY_TWO = 1 << 7, /* If set there is a 2-by-2 transformation that will be used to scale the component. */
+    WE_HAVE_INSTRUCTIONS = 1 << 8, /* If set, instructions for the component character follow the last component. */
+    USE_MY_METRICS = 1 << 9, /* Use metrics from this component for the compound glyph. */
+    OVERLAP_COMPOUND = 1 << 10, /* If set, the components of this compound glyph overlap. */
+    SCALED_COMPONENT_OFFSET = 1 << 11, /* The component's offset is scaled by the transform (Apple behaviour). */
+    UNSCALED_COMPONENT_OFFSET = 1 << 12, /* The component's offset is not scaled (Microsoft behaviour, the default). */
 };
 
 /* x' = m((a/m)*x + (c/m)*y + e)
@@ -233,33 +281,16 @@ enum COMPONENT_FLAG : u16
  * that when the component is rotated by a multiple of 45 degrees, the scale factors are doubled.For these reasons,
  * it is much easier to specify offsets through the use of anchor point and matching points than directly through offset values. */
 
-// TODO: not sure about this struct
-union TransformationOptions
-{
-    struct {
-        F2Dot14 scale; /* (same for x and y) */
-    } entry1;
-
-    struct {
-        F2Dot14 xScale;
-        F2Dot14 yScale;
-    } entry2;
-
-    struct {
-        F2Dot14 xScale;
-        F2Dot14 scale01;
-        F2Dot14 scale10;
-        F2Dot14 yScale;
-    } entry3;
-};
-
+/* One decoded component record, the transform maps component points into the compound glyph:
+ * x' = a*x + c*y + e
+ * y' = b*x + d*y + f */
 struct GlyphCompound
 {
-    COMPONENT_FLAG eFlag; /* Component flag */
-    u16 glyphIndex; /* Glyph index of component */
-    void* pArgument1; /* (s16, u16, s8 or u8) X-offset for component or point number; type depends on bits 0 and 1 in component flags */
-    void* pArgument2; /* (s16, u16, s8 or u8) Y-offset for component or point number; type depends on bits 0 and 1 in component flags */
-    TransformationOptions uTransformationOptions; /* One of the transformation options from Table 19 */
+    COMPONENT_FLAG eFlag {}; /* Component flag */
+    u16 glyphIndex {}; /* Glyph index of component */
+    s32 argument1 {}; /* X-offset for component or point number; type depends on bits 0 and 1 in component flags */
+    s32 argument2 {}; /* Y-offset for component or point number; type depends on bits 0 and 1 in component flags */
+    f32 a {}, b {}, c {}, d {}; /* Transformation options from Table 19a */
 };
 
 struct Glyph
@@ -271,8 +302,7 @@ struct Glyph
     FWord xMax {}; /* Maximum x for coordinate data */
     FWord yMax {}; /* Maximum y for coordinate data */
     union {
-        GlyphSimple simple;
-        GlyphCompound compound;
+        GlyphSimple simple; /* compound glyphs are flattened into this too, numberOfContours is positive after reading */
     } uGlyph {};
 };
 
@@ -361,6 +391,13 @@ struct Hhea
     u16 numOfLongHorMetrics; /* number of advance widths in metrics table */
 };
 
+/* One 'hmtx' record, glyphs past numOfLongHorMetrics repeat the last advanceWidth. */
+struct LongHorMetric
+{
+    uFWord advanceWidth; /* Advance width, in font design units. */
+    FWord leftSideBearing; /* Glyph left side bearing, in font design units. */
+};
+
 /* The Font Metrics Table(tag : 'fmtx')
  * identifies a glyph whose points represent various font-wide metrics: ascent, descent, caret angle, caret offset.
  * If this table is present, these points override their corresponding values in the 'hhea' and 'vhea' tables.
@@ -460,9 +497,13 @@ struct Font
     Bin m_bin {};
     TableDirectory m_tableDirectory {};
     Head m_head {};
+    Hhea m_hhea {};
+    u32 m_hmtxOffset {};
     Cmap m_cmap {};
     CmapFormat4 m_cmapF4 {};
+    CodepointTable m_codepoints {};
     MapBase<u32, Glyph> m_mOffsetToGlyph {};
+    u32 m_compoundDepth {};
 
     /* */
 
@@ -473,6 +514,9 @@ struct Font
 
     bool loadParse(String sPath);
     Glyph readGlyph(u32 codePoint);
+    Glyph readGlyphIdx(u32 glyphIdx);
+    u32 getGlyphIdx(u32 code) const { return m_codepoints.get(code); }
+    LongHorMetric getHorMetric(u32 glyphIdx);
     void printGlyphDBG(const Glyph& g, bool bNormalize = false);
     void destroy();
 
@@ -482,11 +526,12 @@ private:
     bool parse();
     MapResult<String, TableRecord> getTable(String sTableTag);
     void readHeadTable();
+    void readHheaTable();
     void readCmapTable();
-    void readCmap(u32 offset);
+    bool readCmap(u32 offset);
     void readCmapFormat4();
+    void readCmapFormat12();
     u32 getGlyphOffset(u32 idx);
-    u32 getGlyphIdx(u16 code);
     FWord readFWord();
     void readCompoundGlyph(Glyph* g);
     void readSimpleGlyph(Glyph* g);
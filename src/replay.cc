@@ -0,0 +1,118 @@
+#include "replay.hh"
+
+#include "game.hh"
+#include "adt/defer.hh"
+#include "adt/file.hh"
+#include "adt/logs.hh"
+
+#include <cstdio>
+#include <cstring>
+
+namespace replay
+{
+
+Recorder g_recorder;
+
+void
+Recorder::start(IAllocator* pAlloc, u64 seed)
+{
+    m_pAlloc = pAlloc;
+    m_seed = seed;
+    m_lastMask = 0;
+    m_aKeys.setSize(pAlloc, 0);
+    m_aHashes.setSize(pAlloc, 0);
+    m_bActive = true;
+}
+
+void
+Recorder::keys(u16 mask)
+{
+    if (!m_bActive || mask == m_lastMask) return;
+
+    m_aKeys.push(m_pAlloc, {.tick = u32(m_aHashes.getSize()), .mask = mask});
+    m_lastMask = mask;
+}
+
+void
+Recorder::tick(u32 hash)
+{
+    if (!m_bActive) return;
+
+    m_aHashes.push(m_pAlloc, hash);
+}
+
+bool
+Recorder::write(const char* ntsPath) const
+{
+    FILE* pf = fopen(ntsPath, "wb");
+    if (!pf)
+    {
+        LOG_WARN("unable to write '{}'\n", ntsPath);
+        return false;
+    }
+
+    const Header h {
+        .magic = MAGIC,
+        .version = VERSION,
+        .tickRate = game::TICK_RATE,
+        .nKeyEvents = u32(m_aKeys.getSize()),
+        .nTicks = u32(m_aHashes.getSize()),
+        .seed = m_seed,
+    };
+
+    bool bOk = fwrite(&h, sizeof(h), 1, pf) == 1;
+    if (h.nKeyEvents > 0) bOk &= fwrite(m_aKeys.data(), sizeof(KeyEvent), h.nKeyEvents, pf) == h.nKeyEvents;
+    if (h.nTicks > 0) bOk &= fwrite(m_aHashes.data(), sizeof(u32), h.nTicks, pf) == h.nTicks;
+
+    return (fclose(pf) == 0) && bOk;
+}
+
+void
+Recorder::destroy()
+{
+    if (!m_pAlloc) return;
+
+    m_aKeys.destroy(m_pAlloc);
+    m_aHashes.destroy(m_pAlloc);
+    m_bActive = false;
+}
+
+bool
+load(IAllocator* pAlloc, const char* ntsPath, Log* pLog)
+{
+    Opt<String> rsFile = file::load(pAlloc, ntsPath);
+    if (!rsFile) return false;
+
+    const String sFile = rsFile.value();
+    if (sFile.getSize() < ssize(sizeof(Header)))
+    {
+        LOG_WARN("'{}': too short for a header\n", ntsPath);
+        return false;
+    }
+
+    Header h;
+    memcpy(&h, sFile.data(), sizeof(h));
+
+    if (h.magic != MAGIC || h.version != VERSION)
+    {
+        LOG_WARN("'{}': not a replay (magic: {}, version: {})\n", ntsPath, h.magic, h.version);
+        return false;
+    }
+
+    const usize size = sizeof(Header) + h.nKeyEvents*sizeof(KeyEvent) + h.nTicks*sizeof(u32);
+    if (usize(sFile.getSize()) < size)
+    {
+        LOG_WARN("'{}': {} bytes, header says {}\n", ntsPath, sFile.getSize(), size);
+        return false;
+    }
+
+    /* allocator memory is 8 byte aligned, so are the sections */
+    const u8* p = (const u8*)sFile.data();
+    pLog->header = h;
+    pLog->pKeys = (const KeyEvent*)(p + sizeof(Header));
+    pLog->pHashes = (const u32*)(p + sizeof(Header) + h.nKeyEvents*sizeof(KeyEvent));
+
+    return true;
+}
+
+} /* namespace replay */
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "adt/IAllocator.hh"
+#include "adt/Vec.hh"
+
+using namespace adt;
+
+/* Input recording for reproducible sessions.
+ * The log keeps every change of the recorded keys (keybinds::inl_aReplayKeys) with the tick it lands before,
+ * and a hash of the entities after each tick. Replaying feeds the same changes to procKeys() between the same
+ * ticks and stops at the first hash that differs. */
+namespace replay
+{
+
+constexpr u32 MAGIC = 0x50524b42; /* "BKRP" */
+constexpr u32 VERSION = 1;
+
+struct Header
+{
+    u32 magic {};
+    u32 version {};
+    u32 tickRate {};
+    u32 nKeyEvents {};
+    u32 nTicks {};
+    u32 _pad {};
+    u64 seed {}; /* the game draws no random numbers yet, kept so the format doesn't change when it does */
+};
+
+struct KeyEvent
+{
+    u32 tick {}; /* applied before this tick runs */
+    u16 mask {}; /* bit i: inl_aReplayKeys[i] is down */
+    u16 _pad {};
+};
+
+/* file layout: Header, KeyEvent[nKeyEvents], u32 hash[nTicks] */
+struct Recorder
+{
+    IAllocator* m_pAlloc {};
+    VecBase<KeyEvent> m_aKeys {};
+    VecBase<u32> m_aHashes {};
+    u64 m_seed {};
+    u16 m_lastMask {};
+    bool m_bActive {};
+
+    /* */
+
+    void start(IAllocator* pAlloc, u64 seed);
+    /* after each procKeys(), only changes get logged */
+    void keys(u16 mask);
+    /* after each updateState() */
+    void tick(u32 hash);
+    bool write(const char* ntsPath) const;
+    void destroy();
+};
+
+/* loaded log, points into the file memory */
+struct Log
+{
+    Header header {};
+    const KeyEvent* pKeys {};
+    const u32* pHashes {};
+};
+
+/* false on a short file, wrong magic or version */
+[[nodiscard]] bool load(IAllocator* pAlloc, const char* ntsPath, Log* pLog);
+
+extern Recorder g_recorder;
+
+} /* namespace replay */
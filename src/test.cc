@@ -1,16 +1,53 @@
 #include "test.hh"
 
+#include "adt/AllocStats.hh"
+#include "adt/Arena.hh"
+#include "adt/ChunkAllocator.hh"
+#include "adt/FreeList.hh"
+#include "adt/OsAllocator.hh"
 #include "adt/ThreadPool.hh"
+#include "adt/TripleBuffer.hh"
 #include "adt/defer.hh"
+#include "adt/file.hh"
 #include "adt/guard.hh"
 #include "adt/math.hh"
+#include "adt/sort.hh"
 #include "adt/logs.hh"
+#include "adt/prof.hh"
+#include "adt/utils.hh"
+#include "FrameStats.hh"
+#include "Shader.hh"
+#include "app.hh"
+#include "balls.hh"
+#include "collision.hh"
+#include "cook.hh"
+#include "explosion.hh"
+#include "game.hh"
+#include "gl/state.hh"
+#include "json/Parser.hh"
+#include "level.hh"
+#include "image.hh"
+#include "meshopt.hh"
+#include "pixel.hh"
+#include "replay.hh"
+#include "png.hh"
+#include "Model.hh"
+#include "RenderQueue.hh"
+#include "StaticSprites.hh"
+#include "text.hh"
+#include "texture.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 
 using namespace adt;
 
 namespace test
 {
 
+bool g_bBench = false;
+
 void
 math()
 {
@@ -91,4 +128,2487 @@ locks()
     LOG_GOOD("'locks' passed\n");
 }
 
+static constexpr String s_ascii =
+    "!\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
+
+void
+ttf()
+{
+    Arena arena(SIZE_8M);
+    defer( arena.freeAll() );
+
+    reader::ttf::Font font(&arena);
+    if (!font.loadParse("test-assets/LiberationMono-Regular.ttf"))
+    {
+        LOG_WARN("'ttf' skipped, no font\n");
+        return;
+    }
+
+    auto makeWriter = [&](text::TTF_MODE eMode) {
+        text::TTF t(&arena);
+        t.m_pFont = &font;
+        t.m_eMode = eMode;
+        t.m_pxSize = t.pixelSize();
+        t.m_maxSize = 100;
+        t.m_atlas = text::GlyphAtlas(OsAllocatorGet(), 512, 64, 1024);
+        return t;
+    };
+
+    /* sdf: serial vs thread pool, must produce identical atlases */
+    {
+        text::TTF serial = makeWriter(text::TTF_MODE::SDF);
+        text::TTF parallel = makeWriter(text::TTF_MODE::SDF);
+        defer( serial.m_atlas.destroy(); parallel.m_atlas.destroy() );
+
+        Arena tmp(SIZE_1M);
+        defer( tmp.freeAll() );
+
+        s64 t0 = utils::timeNowUS();
+        for (char c : s_ascii)
+        {
+            text::GlyphEntry e;
+            serial.getGlyph(&tmp, c, &e);
+        }
+        s64 t1 = utils::timeNowUS();
+        parallel.cacheParallel(s_ascii);
+        s64 t2 = utils::timeNowUS();
+
+        const f64 nGlyphs = f64(s_ascii.getSize());
+        LOG_GOOD("sdf: serial: {:.1} glyphs/s, thread pool: {:.1} glyphs/s\n",
+            nGlyphs / (f64(t1 - t0) / 1'000'000.0), nGlyphs / (f64(t2 - t1) / 1'000'000.0)
+        );
+
+        assert(serial.m_atlas.m_height == parallel.m_atlas.m_height);
+        assert(memcmp(serial.m_atlas.m_pPixels, parallel.m_atlas.m_pPixels,
+            usize(serial.m_atlas.m_width) * serial.m_atlas.m_height) == 0);
+
+        /* middle of the 'I' stem is inside, middle of 'O' is outside */
+        text::GlyphEntry eI, eO;
+        serial.getGlyph(&tmp, 'I', &eI);
+        serial.getGlyph(&tmp, 'O', &eO);
+        Span2D<u8> spAtlas(serial.m_atlas.m_pPixels, serial.m_atlas.m_width, serial.m_atlas.m_height);
+        assert(spAtlas(eI.x + eI.width/2, eI.y + eI.height/2) > 128);
+        assert(spAtlas(eO.x + eO.width/2, eO.y + eO.height/2) < 128);
+    }
+
+    /* coverage: exact area of a rectangle that doesn't sit on pixel boundaries */
+    {
+        u8 aPixels[5*5] {};
+        Span2D<u8> sp(aPixels, 5, 5);
+
+        VecBase<text::OutlineEdge> aRect(&arena, 4);
+        aRect.push(&arena, {{1.25f, 1.5f}, {3.75f, 1.5f}});
+        aRect.push(&arena, {{3.75f, 1.5f}, {3.75f, 3.5f}});
+        aRect.push(&arena, {{3.75f, 3.5f}, {1.25f, 3.5f}});
+        aRect.push(&arena, {{1.25f, 3.5f}, {1.25f, 1.5f}});
+
+        text::rasterizeGlyph(sp, aRect);
+
+        assert(sp(0, 0) == 0 && sp(4, 4) == 0);
+        assert(sp(1, 1) == 96); /* 0.75 * 0.5 */
+        assert(sp(2, 1) == 128); /* 1.0 * 0.5 */
+        assert(sp(2, 2) == 255);
+        assert(sp(3, 2) == 191); /* 0.75 * 1.0 */
+    }
+
+    /* coverage: accumulation vs the old scanline path, and how many glyphs/s each does */
+    {
+        Arena tmp(SIZE_8M);
+        defer( tmp.freeAll() );
+
+        constexpr u32 pxSize = 48;
+        const f32 scale = f32(pxSize) / f32(font.m_head.yMax - font.m_head.yMin);
+
+        struct Outline { Span2D<u8> spNew; Span2D<u8> spOld; VecBase<text::OutlineEdge> aEdges; };
+        VecBase<Outline> aOutlines(&tmp, s_ascii.getSize());
+
+        for (char c : s_ascii)
+        {
+            auto g = font.readGlyph(c);
+            if (g.numberOfContours <= 0) continue;
+
+            const u32 width = u32(std::ceil((g.xMax - g.xMin)*scale + 2.0f));
+            const u32 height = u32(std::ceil((g.yMax - g.yMin)*scale + 2.0f));
+
+            aOutlines.push(&tmp, {
+                .spNew {(u8*)tmp.zalloc(width*height, 1), width, height},
+                .spOld {(u8*)tmp.zalloc(width*height, 1), width, height},
+                .aEdges = text::glyphEdges(&tmp, &g, scale, {-g.xMin*scale + 1.0f, -g.yMin*scale + 1.0f}),
+            });
+        }
+
+        /* one round is enough for the comparison, the glyphs/s want more */
+        const int N_ROUNDS = g_bBench ? 20 : 1;
+
+        s64 t0 = utils::timeNowUS();
+        for (int i = 0; i < N_ROUNDS; ++i)
+            for (auto& o : aOutlines) text::rasterizeGlyph(o.spNew, o.aEdges);
+        s64 t1 = utils::timeNowUS();
+        for (int i = 0; i < N_ROUNDS; ++i)
+            for (auto& o : aOutlines) text::rasterizeGlyphScanline(o.spOld, o.aEdges);
+        s64 t2 = utils::timeNowUS();
+
+        u64 sumDiff = 0;
+        u64 nPixels = 0;
+        u64 nNew = 0;
+        u64 nOld = 0;
+        for (auto& o : aOutlines)
+        {
+            for (ssize i = 0; i < o.spNew.getWidth() * o.spNew.getHeight(); ++i)
+            {
+                sumDiff += std::abs(int(o.spNew.data()[i]) - int(o.spOld.data()[i]));
+                nNew += o.spNew.data()[i];
+                nOld += o.spOld.data()[i];
+            }
+            nPixels += o.spNew.getWidth() * o.spNew.getHeight();
+        }
+
+        const f64 nGlyphs = f64(aOutlines.getSize()) * N_ROUNDS;
+        LOG_GOOD("coverage {}px: accumulation: {:.1} glyphs/s, scanline: {:.1} glyphs/s, mean abs diff: {:.3}, ink ratio: {:.3}\n",
+            pxSize, nGlyphs / (f64(t1 - t0) / 1'000'000.0), nGlyphs / (f64(t2 - t1) / 1'000'000.0),
+            f64(sumDiff) / f64(nPixels), f64(nNew) / f64(nOld)
+        );
+
+        /* same outlines, the old path samples rows at y instead of covering [y, y + 1), so edges differ */
+        assert(f64(sumDiff) / f64(nPixels) < 16.0);
+        assert(std::abs(f64(nNew) / f64(nOld) - 1.0) < 0.05);
+    }
+
+    /* cmap: accented latin glyphs are compounds of the base letter and the accent */
+    {
+        assert(font.getGlyphIdx('A') != 0);
+        assert(font.getGlyphIdx(0x10ffff) == 0 && font.getGlyphIdx(0xffffffff) == 0);
+
+        auto e = font.readGlyph('e');
+        auto eAcute = font.readGlyph(0xe9);
+        assert(eAcute.numberOfContours == e.numberOfContours + 1);
+        assert(eAcute.uGlyph.simple.aPoints.getSize() > e.uGlyph.simple.aPoints.getSize());
+    }
+
+    /* cmap: flat table vs hash map lookups over a mixed script corpus */
+    {
+        Arena tmp(SIZE_8M);
+        defer( tmp.freeAll() );
+
+        struct Range { u32 first; u32 size; };
+        constexpr Range aRanges[] {
+            {0x20, 0x5f}, /* ascii */
+            {0xa0, 0x160}, /* latin-1, latin extended-a */
+            {0x370, 0x90}, /* greek */
+            {0x400, 0x100}, /* cyrillic */
+            {0x4e00, 0x5200}, /* cjk */
+            {0x1f300, 0x300}, /* emoji, outside the BMP */
+        };
+
+        /* a few thousand still hit every range, the timings want the million */
+        const u32 N_CODES = g_bBench ? 1 << 20 : 1 << 12;
+        u32* pCodes = (u32*)tmp.malloc(N_CODES, sizeof(u32));
+
+        u32 rng = 0x12345678;
+        for (u32 i = 0; i < N_CODES; ++i)
+        {
+            rng = rng*1664525u + 1013904223u;
+            /* mostly ascii, like real text */
+            const Range& r = (rng >> 28) < 10 ? aRanges[0] : aRanges[(rng >> 28) % utils::size(aRanges)];
+            pCodes[i] = r.first + (rng >> 8) % r.size;
+        }
+
+        MapBase<u32, u16> mCodeToGlyphIdx(&tmp, 1 << 16);
+        for (const auto& r : aRanges)
+            for (u32 c = r.first; c < r.first + r.size; ++c)
+                mCodeToGlyphIdx.insert(&tmp, c, u16(font.getGlyphIdx(c)));
+
+        u64 sumTable = 0;
+        u64 sumMap = 0;
+
+        s64 t0 = utils::timeNowUS();
+        for (u32 i = 0; i < N_CODES; ++i)
+            sumTable += font.getGlyphIdx(pCodes[i]);
+        s64 t1 = utils::timeNowUS();
+        for (u32 i = 0; i < N_CODES; ++i)
+            sumMap += mCodeToGlyphIdx.search(pCodes[i]).data().val;
+        s64 t2 = utils::timeNowUS();
+
+        LOG_GOOD("cmap: flat table: {:.1} M codepoints/s, hash map: {:.1} M codepoints/s\n",
+            f64(N_CODES) / f64(utils::max(t1 - t0, s64(1))), f64(N_CODES) / f64(utils::max(t2 - t1, s64(1)))
+        );
+
+        assert(sumTable == sumMap);
+    }
+
+    LOG_GOOD("'ttf' passed\n");
+}
+
+void
+cook()
+{
+    Arena arena(SIZE_1M);
+    defer( arena.freeAll() );
+
+    /* odd sizes keep the edge texels */
+    {
+        const u8 aSrc[3*1*4] {
+            0, 0, 0, 0,   200, 100, 50, 255,   255, 255, 255, 255,
+        };
+        u8 aDst[4] {};
+        cook::downsampleRGBA(aDst, aSrc, 3, 1);
+        assert(aDst[0] == 100 && aDst[1] == 50 && aDst[2] == 25 && aDst[3] == 128);
+    }
+
+    /* the rest writes into cooked/, not on every launch */
+    if (!g_bBench)
+    {
+        LOG_NOTIFY("'cook' round trip skipped, run with --bench-tests\n");
+        return;
+    }
+
+    constexpr String sPath = "test-assets/ball.bmp";
+
+    s64 t0 = utils::timeNowUS();
+    texture::Data img = texture::loadBMP(&arena, sPath, false);
+    s64 t1 = utils::timeNowUS();
+
+    cook::CookStats stats {};
+    if (!cook::cookImage(&arena, sPath, false, &stats))
+    {
+        LOG_WARN("'cook' skipped, can't write cooked file\n");
+        return;
+    }
+
+    s64 t2 = utils::timeNowUS();
+    cook::Mapping m = cook::mapCooked(sPath, false);
+    s64 t3 = utils::timeNowUS();
+    assert(m);
+    defer( m.unmap() );
+
+    const cook::Header& h = m.header();
+    assert(h.width == img.width && h.height == img.height);
+    assert(h.aMips[h.nMips - 1].width == 1 && h.aMips[h.nMips - 1].height == 1);
+    assert(memcmp(m.level(0), img.aData.data(), usize(h.width)*h.height*4) == 0);
+
+    LOG_GOOD("cook: bmp decode: {} us, cook: {} us, warm map: {} us ({} mips)\n",
+        t1 - t0, t2 - t1, t3 - t2, h.nMips
+    );
+
+    LOG_GOOD("'cook' passed\n");
+}
+
+void
+convert()
+{
+    using ROW_FN = void (*)(u8*, const u8*, int);
+    using IMAGE_FN = void (*)(u8*, ssize, const u8*, ssize, int, int, bool);
+
+    struct Kernel
+    {
+        const char* ntsName;
+        ROW_FN pfnRef;
+        ROW_FN pfnRow;
+        IMAGE_FN pfnImage;
+        int srcBpp;
+        int dstBpp;
+    };
+
+    const Kernel aKernels[] {
+        {"BGR->RGBA", pixel::rowBGRtoRGBAScalar, pixel::rowBGRtoRGBA, pixel::BGRtoRGBA, 3, 4},
+        {"BGRA->RGBA", pixel::rowBGRAtoRGBAScalar, pixel::rowBGRAtoRGBA, pixel::BGRAtoRGBA, 4, 4},
+        {"BGR->RGB", pixel::rowBGRtoRGBScalar, pixel::rowBGRtoRGB, pixel::BGRtoRGB, 3, 3},
+        {"RGB->RGBA", pixel::rowRGBtoRGBAScalar, pixel::rowRGBtoRGBA, nullptr, 3, 4},
+    };
+
+    constexpr int MAX_WIDTH = 67;
+    constexpr int MAX_HEIGHT = 3;
+    constexpr int MAX_PAD = 5;
+    constexpr u8 CANARY = 0xcd;
+
+    u8 aSrc[(MAX_WIDTH*4 + MAX_PAD) * MAX_HEIGHT];
+    u8 aRef[(MAX_WIDTH*4 + MAX_PAD) * MAX_HEIGHT];
+    u8 aDst[(MAX_WIDTH*4 + MAX_PAD) * MAX_HEIGHT];
+
+    u32 seed = 0x9e3779b9;
+    for (u8& b : aSrc)
+    {
+        seed = seed*1664525 + 1013904223;
+        b = u8(seed >> 24);
+    }
+
+    /* every width through every tail length, with and without row padding, both flips */
+    for (const Kernel& k : aKernels)
+    {
+        for (int width = 1; width <= MAX_WIDTH; ++width)
+        {
+            for (int height = 1; height <= MAX_HEIGHT; ++height)
+            {
+                for (int pad = 0; pad <= MAX_PAD; pad += MAX_PAD)
+                {
+                    for (bool bFlip : {false, true})
+                    {
+                        const ssize srcStride = width*k.srcBpp + pad;
+                        const ssize dstStride = width*k.dstBpp + pad;
+
+                        memset(aRef, CANARY, sizeof(aRef));
+                        memset(aDst, CANARY, sizeof(aDst));
+
+                        for (int y = 0; y < height; ++y)
+                        {
+                            const int dstY = bFlip ? height - 1 - y : y;
+                            k.pfnRef(aRef + dstY*dstStride, aSrc + y*srcStride, width);
+                        }
+
+                        if (k.pfnImage)
+                        {
+                            k.pfnImage(aDst, dstStride, aSrc, srcStride, width, height, bFlip);
+                        }
+                        else
+                        {
+                            for (int y = 0; y < height; ++y)
+                            {
+                                const int dstY = bFlip ? height - 1 - y : y;
+                                k.pfnRow(aDst + dstY*dstStride, aSrc + y*srcStride, width);
+                            }
+                        }
+
+                        /* padding and everything past the last row must stay untouched */
+                        if (memcmp(aRef, aDst, sizeof(aDst)) != 0)
+                        {
+                            CERR("{}: mismatch at width: {}, height: {}, pad: {}, flip: {}\n",
+                                k.ntsName, width, height, pad, bFlip
+                            );
+                            assert(false);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /* throughput on something texture sized */
+    if (g_bBench)
+    {
+        constexpr int W = 1024, H = 1024, N = 8;
+
+        Arena arena(SIZE_1M * 12);
+        defer( arena.freeAll() );
+
+        u8* pSrc = (u8*)arena.zalloc(W*H*4, 1);
+        u8* pDst = (u8*)arena.zalloc(W*H*4, 1);
+
+        for (const Kernel& k : aKernels)
+        {
+            const f64 bytes = f64(W)*H*(k.srcBpp + k.dstBpp) * N;
+
+            auto run = [&](ROW_FN pfn) {
+                s64 t0 = utils::timeNowUS();
+                for (int i = 0; i < N; ++i)
+                    for (int y = 0; y < H; ++y)
+                        pfn(pDst + y*W*k.dstBpp, pSrc + y*W*k.srcBpp, W);
+                return f64(utils::timeNowUS() - t0);
+            };
+
+            const f64 scalarUS = run(k.pfnRef);
+            const f64 simdUS = run(k.pfnRow);
+
+            LOG_GOOD("convert: {}: scalar: {:.2} GB/s, simd: {:.2} GB/s (read + write)\n",
+                k.ntsName, bytes / scalarUS / 1000.0, bytes / simdUS / 1000.0
+            );
+        }
+    }
+
+    LOG_GOOD("'convert' passed\n");
+}
+
+void
+upload()
+{
+    /* small slots so one texture has to go through the ring more than once */
+    constexpr u32 W = 300, H = 200, SLOT_SIZE = SIZE_1K * 64;
+
+    texture::UploadQueue q(OsAllocatorGet());
+    q.createBuffer(2, SLOT_SIZE);
+    defer( q.destroy() );
+
+    Arena arena(SIZE_1M);
+    defer( arena.freeAll() );
+
+    u8* pLevel0 = (u8*)arena.malloc(W*H*4, 1);
+    u8* pLevel1 = (u8*)arena.malloc((W/2)*(H/2)*4, 1);
+    for (u32 i = 0; i < W*H*4; ++i) pLevel0[i] = u8(i * 7 + i / (W*4));
+    for (u32 i = 0; i < (W/2)*(H/2)*4; ++i) pLevel1[i] = u8(i * 13);
+
+    const texture::UploadLevel aLevels[] {
+        {pLevel0, W, H},
+        {pLevel1, W/2, H/2},
+    };
+
+    struct Arg
+    {
+        texture::UploadQueue* pQ;
+        texture::Img* pImg;
+        const texture::UploadLevel* aLevels;
+        bool bOk;
+    };
+
+    texture::Img img {};
+    Arg arg {&q, &img, aLevels, false};
+
+    /* worker never touches the context, this thread issues the gl calls */
+    app::g_pThreadPool->submit(+[](void* p) -> THREAD_STATUS {
+        auto* a = (Arg*)p;
+        a->bOk = a->pQ->upload(a->pImg, NPOS32, a->aLevels, 2, 2, false, GL_CLAMP_TO_EDGE, GL_NEAREST, GL_NEAREST);
+        return {};
+    }, &arg);
+
+    while (app::g_pThreadPool->busy() || !q.idle())
+    {
+        q.flush();
+        utils::sleepMS(0.1);
+    }
+    app::g_pThreadPool->wait();
+
+    assert(arg.bOk);
+    assert(img.m_id != 0);
+    defer( img.destroy() );
+
+    u8* pRead = (u8*)arena.zalloc(W*H*4, 1);
+    gl::bindTexture(GL_TEXTURE_2D, img.m_id);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pRead);
+    assert(memcmp(pRead, pLevel0, W*H*4) == 0);
+    glGetTexImage(GL_TEXTURE_2D, 1, GL_RGBA, GL_UNSIGNED_BYTE, pRead);
+    assert(memcmp(pRead, pLevel1, (W/2)*(H/2)*4) == 0);
+    gl::bindTexture(GL_TEXTURE_2D, 0);
+
+    const texture::UploadStats st = q.getStats();
+    assert(st.nBytes == u64(W*H*4 + (W/2)*(H/2)*4));
+    assert(st.nUploads > 2);
+
+    LOG_GOOD("upload: {} requests, {} KB, {:.1} MB/s, queued max: {} us, gpu max: {} us, slot wait: {} us\n",
+        st.nUploads, st.nBytes / 1024, st.MBps(), st.maxQueuedUS, st.maxGpuUS, st.slotWaitUS
+    );
+
+    LOG_GOOD("'upload' passed\n");
+}
+
+void
+sprites()
+{
+    const String aPaths[] {"test-assets/box3.bmp", "test-assets/ball.bmp", "test-assets/WhitePixel.bmp"};
+
+    Arena arena(SIZE_1M * 2);
+    defer( arena.freeAll() );
+
+    texture::ImgArray arr(&arena);
+    arr.build(aPaths, utils::size(aPaths), false, GL_NEAREST, GL_NEAREST);
+    defer( arr.destroy() );
+
+    assert(arr.m_nLayers == 3 && arr.m_layerWidth == 128 && arr.m_layerHeight == 128);
+    assert(arr.m_aSlots[0].layer == 0 && arr.m_aSlots[0].uvRect.z == 0.5f && arr.m_aSlots[0].uvRect.w == 0.5f);
+    assert(arr.m_aSlots[1].uvRect.z == 1.0f);
+
+    /* sprites find their layer by path, nothing else is uploaded for them */
+    for (u32 i = 0; i < utils::size(aPaths); ++i)
+    {
+        auto f = texture::g_mAllTexturesIdxs.search(aPaths[i]);
+        assert(f);
+        const texture::Img& img = texture::g_aAllTextures[f.data().val];
+        assert(img.m_layer == i && img.m_uvRect == arr.m_aSlots[i].uvRect);
+    }
+
+    const usize layerSize = 128*128*4;
+    u32* pRead = (u32*)arena.zalloc(layerSize * 3, 1);
+    gl::bindTexture(GL_TEXTURE_2D_ARRAY, arr.m_id);
+    glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, GL_UNSIGNED_BYTE, pRead);
+    gl::bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    /* box is in the corner of its layer and its last row/column is repeated over the rest */
+    texture::Data box = texture::loadBMP(&arena, aPaths[0], false);
+    const u32* pBox = (const u32*)box.aData.data();
+    for (u32 y = 0; y < 128; ++y)
+        for (u32 x = 0; x < 128; ++x)
+            assert(pRead[y*128 + x] == pBox[utils::min(y, 63u)*64 + utils::min(x, 63u)]);
+
+    /* 1x1 fills the whole layer */
+    const u32* pWhite = pRead + 128*128*2;
+    for (u32 i = 0; i < 128*128; ++i) assert(pWhite[i] == pWhite[0]);
+
+    LOG_GOOD("'sprites' passed\n");
+}
+
+void
+images()
+{
+    /* every png/tga in test-assets has a bmp it was made from */
+    struct Pair
+    {
+        String sPath;
+        String sBmpPath;
+    };
+
+    const Pair aPairs[] {
+        {"test-assets/ball.png", "test-assets/ball.bmp"}, /* rgba8, every filter type, split IDAT */
+        {"test-assets/ball_adam7.png", "test-assets/ball.bmp"}, /* interlaced */
+        {"test-assets/paddle16.png", "test-assets/paddle.bmp"}, /* rgba16, high bytes are the bmp */
+        {"test-assets/box3.png", "test-assets/box3.bmp"}, /* rgb8, fixed huffman */
+        {"test-assets/box3_indexed.png", "test-assets/box3.bmp"}, /* 1 bit palette with tRNS */
+        {"test-assets/FONT.png", "test-assets/FONT.bmp"}, /* rgb8, 1024x1024 */
+        {"test-assets/paddle.tga", "test-assets/paddle.bmp"}, /* rle 32 bit, bottom-left origin */
+        {"test-assets/bitmapFont20.tga", "test-assets/bitmapFont20.bmp"}, /* rle 32 bit */
+        {"test-assets/box3.tga", "test-assets/box3.bmp"}, /* 24 bit, top-left origin, image id */
+    };
+
+    Arena arena(SIZE_1M * 16);
+    defer( arena.freeAll() );
+
+    for (const Pair& p : aPairs)
+    {
+        for (bool bFlip : {false, true})
+        {
+            texture::Data img = texture::loadImage(&arena, p.sPath, bFlip);
+            texture::Data bmp = texture::loadBMP(&arena, p.sBmpPath, bFlip);
+
+            assert(img.width == bmp.width && img.height == bmp.height);
+            if (memcmp(img.aData.data(), bmp.aData.data(), usize(img.width)*img.height*4) != 0)
+            {
+                CERR("images: '{}' (flip: {}) differs from '{}'\n", p.sPath, bFlip, p.sBmpPath);
+                assert(false);
+            }
+        }
+    }
+
+    /* stored block, zlib only emits those at level 0 */
+    {
+        const u8 aZ[] {0x78, 0x01, 0x01, 5, 0, u8(~5), 0xff, 'h', 'e', 'l', 'l', 'o'};
+        u8 aOut[5 + png::INFLATE_SLACK] {};
+        assert(png::inflate(aOut, 5, aZ, sizeof(aZ)) == 5 && memcmp(aOut, "hello", 5) == 0);
+        assert(png::inflate(aOut, 4, aZ, sizeof(aZ)) == -1);
+    }
+
+    /* garbage must fail cleanly */
+    {
+        u8 aJunk[64] {};
+        memcpy(aJunk, png::SIGNATURE, 8);
+        assert(texture::decodeImage(&arena, {(char*)aJunk, sizeof(aJunk)}, false).width == 0);
+        aJunk[0] = 0;
+        assert(texture::decodeImage(&arena, {(char*)aJunk, sizeof(aJunk)}, false).width == 0);
+
+        /* dynamic block with HLIT = HDIST = 31, 320 code lengths of zeros */
+        const u8 aZ[] {0x78, 0x01, 0xfd, 0x1f, 0x80, 0xe4, 0xff, 0x7f, 0x08};
+        u8 aOut[64 + png::INFLATE_SLACK] {};
+        assert(png::inflate(aOut, 64, aZ, sizeof(aZ)) == -1);
+    }
+
+    arena.freeAll();
+
+    /* decode throughput over the corpus, serially and on the thread pool, MB of RGBA written */
+    if (g_bBench)
+    {
+        constexpr int N = 8;
+        constexpr ssize N_ARGS = N * utils::size(aPairs);
+
+        texture::DecodeArg aArgs[N_ARGS] {};
+        Arena aArenas[N_ARGS] {};
+        for (ssize i = 0; i < N_ARGS; ++i)
+        {
+            aArenas[i] = Arena(SIZE_1M);
+            aArgs[i] = {.pAlloc = &aArenas[i], .sPath = aPairs[i % utils::size(aPairs)].sPath};
+        }
+
+        auto bytes = [&] {
+            f64 n = 0.0;
+            for (auto& a : aArgs) n += f64(a.data.width) * a.data.height * 4;
+            return n;
+        };
+        auto reset = [&] { for (auto& a : aArenas) a.freeAll(); };
+
+        s64 t0 = utils::timeNowUS();
+        for (auto& a : aArgs) texture::DecodeSubmit(&a);
+        const f64 serialUS = f64(utils::timeNowUS() - t0);
+        const f64 serialMB = bytes();
+        reset();
+
+        t0 = utils::timeNowUS();
+        for (auto& a : aArgs) app::g_pThreadPool->submit(texture::DecodeSubmit, &a);
+        app::g_pThreadPool->wait();
+        const f64 poolUS = f64(utils::timeNowUS() - t0);
+        const f64 poolMB = bytes();
+        reset();
+
+        assert(serialMB == poolMB);
+
+        LOG_GOOD("images: decode: serial: {:.1} MB/s, thread pool: {:.1} MB/s ({} files)\n",
+            serialMB / serialUS, poolMB / poolUS, N_ARGS
+        );
+    }
+
+    LOG_GOOD("'images' passed\n");
+}
+
+void
+shaders()
+{
+    /* drops and rewrites the sprite program's file in cooked/, not on every launch */
+    if (!g_bBench)
+    {
+        LOG_NOTIFY("'shaders' skipped, run with --bench-tests\n");
+        return;
+    }
+
+    const String aPaths[] {"shaders/2d/sprite.vert", "shaders/2d/sprite.frag"};
+
+    char aCachePath[256] {};
+    shaderCachePath(aCachePath, sizeof(aCachePath), aPaths, utils::size(aPaths));
+    remove(aCachePath);
+
+    GLint nFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+
+    struct Result
+    {
+        bool bHit;
+        s64 us;
+    };
+
+    auto load = [&](Shader* pSh) {
+        const ShaderCacheStats before = g_shaderCacheStats;
+        pSh->load(aPaths[0], aPaths[1]);
+        const ShaderCacheStats after = g_shaderCacheStats;
+        return Result {
+            after.nHits > before.nHits,
+            (after.cachedUS - before.cachedUS) + (after.compiledUS - before.compiledUS)
+        };
+    };
+
+    Shader cold {}, warm {}, stale {};
+    defer(
+        cold.destroy();
+        warm.destroy();
+        stale.destroy();
+    );
+
+    const auto [bColdHit, coldUS] = load(&cold);
+    const auto [bWarmHit, warmUS] = load(&warm);
+    assert(!bColdHit);
+    assert(bWarmHit == (nFormats > 0));
+
+    /* cached program has to be the same program */
+    GLint nColdUniforms = 0, nWarmUniforms = 0;
+    glGetProgramiv(cold.m_id, GL_ACTIVE_UNIFORMS, &nColdUniforms);
+    glGetProgramiv(warm.m_id, GL_ACTIVE_UNIFORMS, &nWarmUniforms);
+    assert(nColdUniforms == nWarmUniforms && nWarmUniforms > 0);
+    assert(glGetUniformLocation(warm.m_id, "uSprites") == glGetUniformLocation(cold.m_id, "uSprites"));
+    assert(glGetUniformBlockIndex(warm.m_id, "ubProjView") != GL_INVALID_INDEX);
+
+    /* key mismatch recompiles */
+    if (nFormats > 0)
+    {
+        FILE* pf = fopen(aCachePath, "r+b");
+        assert(pf);
+        fseek(pf, offsetof(ProgramCacheHeader, key), SEEK_SET);
+        const u64 badKey = 0;
+        fwrite(&badKey, sizeof(badKey), 1, pf);
+        fclose(pf);
+
+        const auto [bStaleHit, staleUS] = load(&stale);
+        assert(!bStaleHit);
+    }
+
+    LOG_GOOD("shaders: sprite program: cold: {} us, warm: {} us ({} binary formats)\n", coldUS, warmUS, nFormats);
+    LOG_GOOD("'shaders' passed\n");
+}
+
+void
+glState()
+{
+    const bool bWasChecking = gl::g_bStateCrossCheck;
+    gl::g_bStateCrossCheck = true;
+    defer( gl::g_bStateCrossCheck = bWasChecking );
+
+    /* someone may have used raw gl before */
+    gl::invalidate();
+
+    Shader sh {};
+    sh.load("shaders/2d/sprite.vert", "shaders/2d/sprite.frag");
+    defer( sh.destroy() );
+
+    GLuint aTex[2] {};
+    glGenTextures(2, aTex);
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+
+    auto frame = [&] {
+        sh.use();
+        gl::bindTextureUnit(GL_TEXTURE0, GL_TEXTURE_2D, aTex[0]);
+        gl::bindTextureUnit(GL_TEXTURE1, GL_TEXTURE_2D, aTex[1]);
+        gl::bindVertexArray(vao);
+        sh.setI("uLayer", 3);
+        sh.setV3("uColor", {1.0f, 0.5f, 0.25f});
+    };
+
+    /* same thing twice, like drawFPSCounter and drawInfo, second round is free */
+    const gl::StateStats s0 = gl::g_stateStats;
+    frame();
+    const gl::StateStats s1 = gl::g_stateStats;
+    frame();
+    const gl::StateStats s2 = gl::g_stateStats;
+
+    assert(s1.nTotalIssued - s0.nTotalIssued == 8); /* program, 2 units + 2 textures, vao, 2 uniforms */
+    assert(s2.nTotalIssued == s1.nTotalIssued);
+    assert(s2.nTotalElided - s1.nTotalElided == 6);
+    assert(gl::crossCheckAll());
+
+    /* a changed value still goes through */
+    sh.setI("uLayer", 4);
+    GLint layer = 0;
+    glGetUniformiv(sh.m_id, glGetUniformLocation(sh.m_id, "uLayer"), &layer);
+    assert(layer == 4);
+
+    /* deleted names are unbound by gl, the cache has to agree */
+    gl::deleteTexture(aTex[0]);
+    gl::deleteVertexArray(vao);
+    assert(gl::crossCheckAll());
+
+    const u64 nIssued = gl::g_stateStats.nTotalIssued;
+    gl::bindTextureUnit(GL_TEXTURE0, GL_TEXTURE_2D, 0);
+    gl::bindVertexArray(0);
+    assert(gl::g_stateStats.nTotalIssued == nIssued);
+
+    gl::deleteTexture(aTex[1]);
+    gl::useProgram(0);
+    gl::activeTexture(GL_TEXTURE0);
+    assert(gl::crossCheckAll());
+
+    LOG_GOOD("'glState' passed\n");
+}
+
+void
+renderQueue()
+{
+    Arena arena(SIZE_8M);
+    defer( arena.freeAll() );
+
+    u64 rng = 0x9e3779b97f4a7c15;
+    auto next = [&]() -> u64 {
+        rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+        return rng;
+    };
+
+    /* radix sort against quick sort, equal keys have to keep submission order */
+    {
+        constexpr u32 n = 1 << 16;
+        u64* aKeys = (u64*)arena.zalloc(n, sizeof(u64));
+        u64* aRef = (u64*)arena.zalloc(n, sizeof(u64));
+        u64* aTmpKeys = (u64*)arena.zalloc(n, sizeof(u64));
+        u32* aIdxs = (u32*)arena.zalloc(n, sizeof(u32));
+        u32* aTmpIdxs = (u32*)arena.zalloc(n, sizeof(u32));
+
+        for (u32 i = 0; i < n; ++i)
+        {
+            /* few distinct high bytes and a small low range, so some passes get skipped and keys repeat */
+            aKeys[i] = ((next() & 0x3) << 60) | (next() & 0xfff);
+            aRef[i] = aKeys[i];
+            aIdxs[i] = i;
+        }
+
+        const s64 t0 = utils::timeNowUS();
+        render::radixSort(aKeys, aIdxs, aTmpKeys, aTmpIdxs, n);
+        const s64 t1 = utils::timeNowUS();
+        sort::quick(aRef, 0, n - 1);
+        const s64 t2 = utils::timeNowUS();
+
+        for (u32 i = 0; i < n; ++i)
+        {
+            assert(aKeys[i] == aRef[i]);
+            if (i > 0 && aKeys[i] == aKeys[i - 1]) assert(aIdxs[i] > aIdxs[i - 1]);
+        }
+
+        LOG_GOOD("render queue: {} keys: radix: {} us, quick: {} us\n", n, t1 - t0, t2 - t1);
+    }
+
+    Shader aShaders[6] {};
+    for (u32 i = 0; i < utils::size(aShaders); ++i) aShaders[i].m_id = i + 1;
+
+    render::Queue q(&arena);
+
+    /* scene order is random, nothing shares state with its neighbour */
+    constexpr u32 nItems = 4096;
+    for (u32 i = 0; i < nItems; ++i)
+    {
+        render::DrawItem it {};
+        it.eFlags = DRAW::DIFF | DRAW::NORM;
+        it.depth = f32(next() % 1000) / 1000.0f;
+        it.pShader = &aShaders[next() % utils::size(aShaders)];
+        it.vao = 1 + next() % 8;
+        it.diffuse = 1 + next() % 12;
+        it.normal = 100 + next() % 4;
+        it.count = 6;
+        q.submit(it);
+    }
+
+    const render::QueueStats unsorted = q.replay(false);
+    const render::QueueStats sorted = q.replay(true);
+
+    assert(unsorted.nDraws == nItems && sorted.nDraws == nItems);
+    assert(sorted.nPrograms == utils::size(aShaders));
+    assert(sorted.nPrograms < unsorted.nPrograms);
+    assert(sorted.nTextures < unsorted.nTextures);
+    assert(sorted.nVaos < unsorted.nVaos);
+    /* every (shader, diffuse, normal, vao) group is contiguous */
+    assert(sorted.nVaos <= utils::size(aShaders) * 12 * 4 * 8);
+
+    LOG_GOOD("render queue: {} items: programs: {} -> {}, textures: {} -> {}, vaos: {} -> {}, sort: {} us\n",
+        nItems, unsorted.nPrograms, sorted.nPrograms, unsorted.nTextures, sorted.nTextures,
+        unsorted.nVaos, sorted.nVaos, sorted.sortUS
+    );
+
+    /* flags that don't bind a texture keep it out of the key */
+    {
+        render::DrawItem a {};
+        a.eFlags = DRAW::DIFF;
+        a.diffuse = 5;
+        a.normal = 6;
+        render::DrawItem b = a;
+        b.normal = 7;
+        assert(render::makeKey(a) == render::makeKey(b));
+        b.eFlags |= DRAW::NORM;
+        assert(render::makeKey(a) != render::makeKey(b));
+    }
+
+    /* passes in order, opaque front to back, translucent back to front */
+    q.reset();
+    const f32 aDepths[] {0.2f, 0.9f, 0.5f};
+    for (f32 d : aDepths)
+    {
+        render::DrawItem it {};
+        it.pShader = &aShaders[0];
+        it.depth = d;
+        it.ePass = render::PASS::TRANSLUCENT;
+        q.submit(it);
+        it.ePass = render::PASS::OPAQUE;
+        q.submit(it);
+        it.ePass = render::PASS::UI;
+        q.submit(it);
+    }
+    q.sort();
+
+    const render::PASS aPasses[] {render::PASS::OPAQUE, render::PASS::TRANSLUCENT, render::PASS::UI};
+    const f32 aWant[][3] {{0.2f, 0.5f, 0.9f}, {0.9f, 0.5f, 0.2f}, {0.2f, 0.5f, 0.9f}};
+    for (u32 i = 0; i < q.getSize(); ++i)
+    {
+        const render::DrawItem& it = q.m_aItems[q.m_aOrder[i]];
+        assert(it.ePass == aPasses[i / 3]);
+        assert(it.depth == aWant[i / 3][i % 3]);
+    }
+
+    LOG_GOOD("'renderQueue' passed\n");
+}
+
+struct GltfLoadArg
+{
+    Model* pModel {};
+    bool bLoaded {};
+    std::atomic<bool> bDone {};
+};
+
+static THREAD_STATUS
+gltfLoader(void* pArg)
+{
+    auto* a = (GltfLoadArg*)pArg;
+    a->bLoaded = a->pModel->loadGLTF("test-assets/models/texturedCubes/texturedCubes.gltf", GL_STATIC_DRAW, GL_CLAMP_TO_EDGE);
+    a->bDone.store(true, std::memory_order_release);
+
+    return {};
+}
+
+void
+gltfTextures()
+{
+    Arena arena(SIZE_1M);
+    defer( arena.freeAll() );
+
+    /* 6 images, more than the slots, the workers have to wait for flushes from this thread */
+    const bool bOwnQueue = !texture::g_uploadQueue;
+    if (bOwnQueue) texture::g_uploadQueue.createBuffer(2, SIZE_1K * 256);
+    defer( if (bOwnQueue) texture::g_uploadQueue.destroy() );
+
+    Model model(&arena);
+    GltfLoadArg arg {.pModel = &model};
+
+    /* the loader still binds the context for its buffers and vaos, so this thread lends it out between flushes */
+    app::g_pWindow->unbindGlContext();
+    Thread loader(gltfLoader, &arg);
+    while (!arg.bDone.load(std::memory_order_acquire))
+    {
+        {
+            gl::g_mtxGlContext.lock();
+            app::g_pWindow->bindGlContext();
+            defer(
+                app::g_pWindow->unbindGlContext();
+                gl::g_mtxGlContext.unlock();
+            );
+
+            texture::g_uploadQueue.flush();
+        }
+        utils::sleepMS(0.5);
+    }
+    loader.join();
+    app::g_pWindow->bindGlContext();
+
+    assert(arg.bLoaded);
+    assert(texture::g_uploadQueue.idle());
+
+    /* paths are in the model's arena, the pool can't keep them */
+    defer(
+        for (auto& img : model.m_modelData.m_aImages)
+        {
+            const String path = file::replacePathEnding(&arena, "test-assets/models/texturedCubes/texturedCubes.gltf", img.uri);
+            auto f = texture::g_mAllTexturesIdxs.search(path);
+            if (!f) continue;
+
+            texture::g_aAllTextures[f.data().val].destroy();
+            texture::g_aAllTextures.giveBack(f.data().val);
+            texture::g_mAllTexturesIdxs.remove(path);
+        }
+    );
+
+    assert(model.m_aaMeshes.getSize() == 3);
+
+    GLuint aIds[6] {};
+    for (u32 i = 0; i < 3; ++i)
+    {
+        const auto& mats = model.m_aaMeshes[i][0].meshData.materials;
+        aIds[i*2] = mats.diffuse.m_id;
+        aIds[i*2 + 1] = mats.normal.m_id;
+
+        /* material i: diffuse is image 2i, normal is 2i + 1 */
+        for (u32 k = 0; k < 2; ++k)
+        {
+            const String path = file::replacePathEnding(&arena, "test-assets/models/texturedCubes/texturedCubes.gltf",
+                model.m_modelData.m_aImages[i*2 + k].uri
+            );
+            auto f = texture::g_mAllTexturesIdxs.search(path);
+            assert(f);
+            assert(texture::g_aAllTextures[f.data().val].m_id == aIds[i*2 + k]);
+        }
+    }
+
+    for (u32 i = 0; i < 6; ++i)
+    {
+        assert(aIds[i] != 0 && glIsTexture(aIds[i]));
+        for (u32 j = 0; j < i; ++j) assert(aIds[i] != aIds[j]);
+    }
+
+    /* box3.bmp, uploaded whole */
+    GLint width = 0;
+    gl::bindTexture(GL_TEXTURE_2D, aIds[0]);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    gl::bindTexture(GL_TEXTURE_2D, 0);
+    assert(width == 64);
+
+    LOG_GOOD("'gltfTextures' passed\n");
+}
+
+void
+indirect()
+{
+    Arena arena(SIZE_1M * 4);
+    defer( arena.freeAll() );
+
+    /* the gl half of Model::loadGLTF() can't run here, it binds and unbinds the context */
+    Model model(&arena);
+    assert(model.m_modelData.load("test-assets/models/cube/gltf/cube.gltf"));
+
+    auto& aNodes = model.m_modelData.m_aNodes;
+    for (auto& mesh : model.m_modelData.m_aMeshes)
+    {
+        VecBase<Mesh> aMeshes(&arena);
+        for (u32 i = 0; i < mesh.aPrimitives.getSize(); ++i) aMeshes.push(&arena, Mesh {});
+        model.m_aaMeshes.push(&arena, aMeshes);
+    }
+
+    /* tile the cube over the viewport, like a level of blocks */
+    constexpr int side = 32;
+    const gltf::Node cube = aNodes[0];
+    aNodes.setSize(&arena, 0);
+    for (int y = 0; y < side; ++y)
+    {
+        for (int x = 0; x < side; ++x)
+        {
+            gltf::Node n = cube;
+            /* scale goes in the matrix, it is applied after the translation */
+            n.matrix = M4Scale(math::M4Iden(), 0.4f / side);
+            n.translation = {(x + 0.5f) * 2.0f / side - 1.0f, (y + 0.5f) * 2.0f / side - 1.0f, 0.0f};
+            aNodes.push(&arena, n);
+        }
+    }
+    for (ssize i = 0; i < aNodes.getSize(); ++i) model.m_aTmCounters.push(&arena, 0);
+
+    model.mergeMeshes(app::g_pThreadPool);
+
+    const auto& ind = model.m_indirect;
+    assert(ind.aLayouts.getSize() == 1 && ind.aBatches.getSize() == 1);
+    assert(ind.aCommands.getSize() == side * side);
+    assert(model.m_aaMeshes[0][0].bIndirect);
+
+    const IndirectLayout& lay = ind.aLayouts[0];
+    assert(lay.bNormals && !lay.bTangents && lay.indType == GL_UNSIGNED_SHORT);
+    /* u16x4 position, f32x2 uv, f32x3 normal */
+    assert(lay.stride == 28 && lay.nVertices == 24 && lay.nIndices == 36);
+
+    for (u32 c = 0; c < ind.aCommands.getSize(); ++c)
+    {
+        const DrawElementsIndirectCommand& cmd = ind.aCommands[c];
+        assert(cmd.count == 36 && cmd.instanceCount == 1 && cmd.firstIndex == 0 && cmd.baseVertex == 0);
+        assert(cmd.baseInstance == c);
+    }
+
+    /* vertices are reordered and quantized, each one still decodes to one of the accessor's */
+    {
+        const auto& a = model.m_modelData;
+        const auto& acc = a.m_aAccessors[a.m_aMeshes[0].aPrimitives[0].attributes.POSITION];
+        const auto& bv = a.m_aBufferViews[acc.bufferView];
+        const f32* pPos = (const f32*)&a.m_aBuffers[bv.buffer].aBin[bv.byteOffset + acc.byteOffset];
+        const IndirectDraw& d = ind.aDraws[0];
+        for (u32 v = 0; v < lay.nVertices; ++v)
+        {
+            const u16* pQ = (const u16*)&lay.aVertices[v * lay.stride];
+            bool bFound = false;
+            for (u32 s = 0; s < acc.count && !bFound; ++s)
+            {
+                bool bMatch = true;
+                for (int k = 0; k < 3; ++k)
+                {
+                    const f32 dq = (pQ[k] / 65535.0f) * d.posScale.e[k] + d.posOffset.e[k];
+                    bMatch &= std::abs(dq - pPos[s*3 + k]) <= d.posScale.e[k] / 65535.0f;
+                }
+                bFound = bMatch;
+            }
+            assert(bFound);
+        }
+    }
+
+    model.uploadIndirect(GL_STATIC_DRAW);
+    defer( model.destroyIndirect() );
+
+    Shader sh {};
+    sh.load("shaders/indirectUB.vert", "shaders/indirect.frag");
+    defer( sh.destroy() );
+    sh.use();
+    sh.setI("uTex0", 0);
+
+    const u32 white = 0xffffffff;
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    gl::bindTextureUnit(GL_TEXTURE0, GL_TEXTURE_2D, tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    defer( gl::deleteTexture(tex) );
+
+    Ubo ubo {};
+    ubo.createBuffer(sizeof(math::M4) * 2, GL_STATIC_DRAW);
+    defer( ubo.destroy() );
+    const math::M4 aProjView[2] {math::M4Iden(), math::M4Iden()};
+    ubo.bufferData((void*)aProjView, 0, sizeof(aProjView));
+    ubo.bindShader(&sh, "ubProjView", 0);
+
+    constexpr int size = 128;
+    GLuint fbo = 0, aRbo[2] {};
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(2, aRbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, aRbo[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+    glBindRenderbuffer(GL_RENDERBUFFER, aRbo[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, aRbo[0]);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, aRbo[1]);
+    assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    defer(
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(2, aRbo);
+        glDeleteFramebuffers(1, &fbo);
+    );
+
+    GLint aViewport[4] {};
+    glGetIntegerv(GL_VIEWPORT, aViewport);
+    glViewport(0, 0, size, size);
+    defer( glViewport(aViewport[0], aViewport[1], aViewport[2], aViewport[3]) );
+    glEnable(GL_DEPTH_TEST);
+
+    u32* aIndirect = (u32*)arena.zalloc(size * size, sizeof(u32));
+    u32* aSeparate = (u32*)arena.zalloc(size * size, sizeof(u32));
+
+    constexpr int nFrames = 20;
+
+    /* one call */
+    s64 t0 = utils::timeNowUS();
+    for (int f = 0; f < nFrames; ++f)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        model.drawIndirect(DRAW::NONE, &sh, "uModel", math::M4Iden());
+    }
+    glFinish();
+    const s64 indirectUS = utils::timeNowUS() - t0;
+    glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, aIndirect);
+
+    /* same commands, one draw call each */
+    t0 = utils::timeNowUS();
+    for (int f = 0; f < nFrames; ++f)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        sh.setM4("uModel", math::M4Iden());
+        gl::bindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_TM_BINDING, ind.tmSsbo);
+        gl::bindVertexArray(lay.vao);
+        for (auto& cmd : ind.aCommands)
+        {
+            glDrawElementsInstancedBaseVertexBaseInstance(
+                GL_TRIANGLES, cmd.count, lay.indType, reinterpret_cast<void*>(usize(cmd.firstIndex) * 2),
+                cmd.instanceCount, cmd.baseVertex, cmd.baseInstance
+            );
+        }
+    }
+    glFinish();
+    const s64 separateUS = utils::timeNowUS() - t0;
+    glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, aSeparate);
+
+    assert(glGetError() == GL_NO_ERROR);
+    assert(memcmp(aIndirect, aSeparate, size * size * sizeof(u32)) == 0);
+
+    /* every tile got its cube */
+    int nLit = 0;
+    for (int i = 0; i < size * size; ++i) nLit += aIndirect[i] != 0;
+    assert(nLit > size * size / 8);
+    for (int y = 0; y < side; ++y)
+    {
+        for (int x = 0; x < side; ++x)
+        {
+            const int px = (x * size + size / 2) / side, py = (y * size + size / 2) / side;
+            assert(aIndirect[py * size + px] != 0);
+        }
+    }
+
+    LOG_GOOD("indirect: {} cubes, {} frames: multi draw: {} us, separate draws: {} us\n",
+        side * side, nFrames, indirectUS, separateUS
+    );
+    LOG_GOOD("'indirect' passed\n");
+}
+
+void
+meshopt()
+{
+    Arena arena(SIZE_1M * 4);
+    defer( arena.freeAll() );
+
+    /* n x n quad grid with the triangles shuffled, about as cache hostile as it gets, the bigger one for the report */
+    const u32 n = g_bBench ? 64 : 16;
+    const u32 nVerts = (n + 1) * (n + 1);
+    const u32 nIdxs = n * n * 6;
+
+    u32* aIdxs = (u32*)arena.malloc(nIdxs, sizeof(u32));
+    {
+        u32 i = 0;
+        for (u32 y = 0; y < n; ++y)
+        {
+            for (u32 x = 0; x < n; ++x)
+            {
+                const u32 v = y * (n + 1) + x;
+                const u32 aQuad[6] {v, v + 1, v + n + 1, v + 1, v + n + 2, v + n + 1};
+                for (u32 q : aQuad) aIdxs[i++] = q;
+            }
+        }
+
+        u64 seed = 0x9e3779b97f4a7c15;
+        for (u32 t = nIdxs / 3 - 1; t > 0; --t)
+        {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            const u32 r = u32(seed >> 33) % (t + 1);
+            for (u32 c = 0; c < 3; ++c) utils::swap(&aIdxs[t*3 + c], &aIdxs[r*3 + c]);
+        }
+    }
+
+    u32* aOpt = (u32*)arena.malloc(nIdxs, sizeof(u32));
+    meshopt::tipsify(&arena, aOpt, aIdxs, nIdxs, nVerts);
+
+    const meshopt::CacheStats before = meshopt::analyzeCache(aIdxs, nIdxs, nVerts);
+    const meshopt::CacheStats after = meshopt::analyzeCache(aOpt, nIdxs, nVerts);
+    assert(after.acmr < before.acmr * 0.5f);
+    assert(after.acmr < 1.0f && after.atvr < 2.0f);
+
+    /* same triangles, only reordered, winding kept */
+    {
+        auto triKey = [&](const u32* p) {
+            /* rotate the smallest index first, that keeps the winding */
+            u32 m = 0;
+            if (p[1] < p[m]) m = 1;
+            if (p[2] < p[m]) m = 2;
+            return (u64(p[m]) << 42) | (u64(p[(m + 1) % 3]) << 21) | u64(p[(m + 2) % 3]);
+        };
+
+        u64* aA = (u64*)arena.malloc(nIdxs / 3, sizeof(u64));
+        u64* aB = (u64*)arena.malloc(nIdxs / 3, sizeof(u64));
+        for (u32 t = 0; t < nIdxs / 3; ++t)
+        {
+            aA[t] = triKey(aIdxs + t*3);
+            aB[t] = triKey(aOpt + t*3);
+        }
+        sort::quick(aA, 0, nIdxs / 3 - 1);
+        sort::quick(aB, 0, nIdxs / 3 - 1);
+        assert(memcmp(aA, aB, nIdxs / 3 * sizeof(u64)) == 0);
+    }
+
+    /* fetch reorder: every index still reaches the same vertex data, in first use order */
+    {
+        u32* aSrcVerts = (u32*)arena.malloc(nVerts, sizeof(u32));
+        for (u32 v = 0; v < nVerts; ++v) aSrcVerts[v] = v * 7 + 3;
+
+        u32* aRemapped = (u32*)arena.malloc(nIdxs, sizeof(u32));
+        memcpy(aRemapped, aOpt, nIdxs * sizeof(u32));
+        u32* aDstVerts = (u32*)arena.malloc(nVerts, sizeof(u32));
+
+        const u32 nKept = meshopt::reorderFetch(
+            &arena, (u8*)aDstVerts, aRemapped, nIdxs, (const u8*)aSrcVerts, nVerts, sizeof(u32)
+        );
+        assert(nKept == nVerts);
+
+        u32 next = 0;
+        for (u32 i = 0; i < nIdxs; ++i)
+        {
+            assert(aDstVerts[aRemapped[i]] == aSrcVerts[aOpt[i]]);
+            assert(aRemapped[i] <= next);
+            if (aRemapped[i] == next) ++next;
+        }
+    }
+
+    /* the cube: serial and pooled builds agree, quantization stays within half a step, cooked round trip */
+    {
+        gltf::Model m(&arena);
+        const String sPath = "test-assets/models/cube/gltf/cube.gltf";
+        assert(m.load(sPath));
+
+        meshopt::Packed serial = meshopt::build(OsAllocatorGet(), nullptr, m);
+        defer( serial.destroy() );
+        meshopt::Packed pooled = meshopt::build(OsAllocatorGet(), app::g_pThreadPool, m);
+        defer( pooled.destroy() );
+
+        assert(serial.header().nPrims == 1);
+        assert(serial.m_size == pooled.m_size && memcmp(serial.m_pData, pooled.m_pData, serial.m_size) == 0);
+
+        const meshopt::Primitive& prim = serial.prim(0);
+        assert(prim.indexSize == 2 && prim.nVerts == 24 && prim.nIdxs == 36);
+        assert(prim.after.acmr <= prim.before.acmr);
+
+        const auto& acc = m.m_aAccessors[m.m_aMeshes[0].aPrimitives[0].attributes.POSITION];
+        const auto& bv = m.m_aBufferViews[acc.bufferView];
+        const f32* pPos = (const f32*)&m.m_aBuffers[bv.buffer].aBin[bv.byteOffset + acc.byteOffset];
+        for (u32 v = 0; v < prim.nVerts; ++v)
+        {
+            const u16* pQ = (const u16*)(serial.verts(0) + usize(v) * prim.stride);
+            f32 minErr = 1e9f;
+            for (u32 s = 0; s < acc.count; ++s)
+            {
+                f32 err = 0.0f;
+                for (int k = 0; k < 3; ++k)
+                {
+                    const f32 dq = (pQ[k] / 65535.0f) * prim.aPosScale[k] + prim.aPosOffset[k];
+                    err = utils::max(err, std::abs(dq - pPos[s*3 + k]) / (prim.aPosScale[k] > 0.0f ? prim.aPosScale[k] : 1.0f));
+                }
+                minErr = utils::min(minErr, err);
+            }
+            assert(minErr <= 0.5f / 65535.0f + math::EPS32);
+        }
+
+        /* writes into cooked/, not on every launch */
+        if (g_bBench)
+        {
+            assert(meshopt::writeCooked(serial, sPath));
+            meshopt::Packed cooked = meshopt::mapCooked(sPath, meshopt::hashSource(m));
+            assert(cooked);
+            assert(cooked.m_size == serial.m_size && memcmp(cooked.m_pData, serial.m_pData, serial.m_size) == 0);
+            cooked.destroy();
+
+            /* different source, stale file */
+            assert(!meshopt::mapCooked(sPath, meshopt::hashSource(m) + 1));
+        }
+    }
+
+    LOG_GOOD("meshopt: {}x{} shuffled grid, acmr: {:.3} -> {:.3}, atvr: {:.3} -> {:.3}\n",
+        n, n, before.acmr, after.acmr, before.atvr, after.atvr
+    );
+    LOG_GOOD("'meshopt' passed\n");
+}
+
+static THREAD_STATUS
+profNested(void*)
+{
+    prof::Scope outer("test outer");
+    {
+        prof::Scope inner("test inner");
+        utils::sleepMS(0.1);
+    }
+
+    return {};
+}
+
+void
+prof()
+{
+    Arena arena(SIZE_1M * 4);
+    defer( arena.freeAll() );
+
+    /* more than the ring holds, the oldest ones have to go */
+    constexpr u32 nWrap = prof::RING_SIZE * 4;
+    const s64 t0 = utils::timeNowUS();
+    for (u32 i = 0; i < nWrap; ++i)
+        prof::Scope scope("test wrap");
+    const s64 wrapUS = utils::timeNowUS() - t0;
+
+    constexpr u32 nTasks = 16;
+    for (u32 i = 0; i < nTasks; ++i) profNested(nullptr);
+    for (u32 i = 0; i < nTasks; ++i) app::g_pThreadPool->submit(profNested, nullptr);
+    app::g_pThreadPool->wait();
+
+    const char* ntsPath = "prof_test.json";
+    const ssize nWritten = prof::writeChromeTrace(ntsPath);
+    assert(nWritten >= nTasks * 4);
+    defer( remove(ntsPath) );
+
+    auto o_sFile = file::load(&arena, ntsPath);
+    assert(o_sFile);
+
+    json::Parser parser {};
+    assert(parser.parse(&arena, o_sFile.value()) == json::STATUS::OK);
+
+    json::Object* pEvents = json::searchObject(parser.getRoot(), "traceEvents");
+    assert(pEvents);
+
+    struct Ev { s64 tid, ts, dur; };
+    Vec<Ev> aOuter(&arena), aInner(&arena);
+    u32 nWrapped = 0;
+    s64 mainTid = -1;
+
+    for (auto& e : json::getArray(pEvents))
+    {
+        auto& o = json::getObject(&e);
+        const String sPh = json::getString(json::searchObject(o, "ph"));
+        if (sPh != "X") continue;
+
+        const String sName = json::getString(json::searchObject(o, "name"));
+        const Ev ev {
+            json::getLong(json::searchObject(o, "tid")),
+            json::getLong(json::searchObject(o, "ts")),
+            json::getLong(json::searchObject(o, "dur")),
+        };
+        assert(ev.dur >= 0);
+
+        if (sName == "test wrap")
+        {
+            ++nWrapped;
+            mainTid = ev.tid;
+        }
+        else if (sName == "test outer") aOuter.push(ev);
+        else if (sName == "test inner") aInner.push(ev);
+    }
+
+    /* the main thread's ring is full of the wrap zones minus what came after them,
+     * the oldest slot is the one the owner writes next, it's never exported */
+    assert(nWrapped == prof::RING_SIZE - nTasks * 2 - 1);
+    assert(aOuter.getSize() == nTasks * 2 && aInner.getSize() == nTasks * 2);
+
+    /* every inner zone sits inside an outer one of its thread */
+    u32 nOnMain = 0;
+    for (const Ev& in : aInner)
+    {
+        bool bNested = false;
+        for (const Ev& out : aOuter)
+            bNested |= out.tid == in.tid && out.ts <= in.ts && in.ts + in.dur <= out.ts + out.dur;
+        assert(bNested);
+        nOnMain += in.tid == mainTid;
+    }
+    assert(nOnMain == nTasks);
+
+    LOG_GOOD("prof: {} zones written, {:.3} ns per zone\n", nWritten, f64(wrapUS) * 1000.0 / nWrap);
+    LOG_GOOD("'prof' passed\n");
+}
+
+void
+frameStats()
+{
+    /* nearest rank over 1..100, shuffled */
+    {
+        f32 aSamples[100];
+        for (u32 i = 0; i < 100; ++i) aSamples[i] = f32((i * 37) % 100 + 1);
+
+        const frame::Percentiles p = frame::computePercentiles(aSamples, 100);
+        assert(p.p50 == 50.0f && p.p95 == 95.0f && p.p99 == 99.0f && p.max == 100.0f);
+        assert(math::eq(p.mean, 50.5f));
+    }
+
+    /* the ring keeps the last RING_SIZE frames, the history every one of them */
+    {
+        frame::FrameStats st {};
+        st.keepHistory(OsAllocatorGet());
+        defer( st.destroy() );
+
+        const u32 nFrames = frame::FrameStats::RING_SIZE + 100;
+        for (u32 i = 0; i < nFrames; ++i)
+        {
+            /* one 50 ms hitch every 50 frames, 2% of them */
+            const f32 wall = i % 50 == 49 ? 50.0f : 16.0f;
+            st.push({.wallMS = wall, .simMS = 1.0f, .drawMS = 2.0f, .swapMS = 13.0f, .nTicks = 4});
+        }
+
+        assert(st.getSize() == frame::FrameStats::RING_SIZE);
+        assert(st.m_aHistory.getSize() == nFrames);
+        /* frames 100, 149 and 1123 */
+        assert(st.at(0).wallMS == 16.0f && st.at(49).wallMS == 50.0f && st.at(st.getSize() - 1).wallMS == 16.0f);
+
+        const frame::Percentiles p = st.percentiles(&frame::FrameRecord::wallMS);
+        assert(p.p50 == 16.0f && p.p95 == 16.0f && p.p99 == 50.0f && p.max == 50.0f);
+        assert(st.percentilesAll(&frame::FrameRecord::swapMS).p99 == 13.0f);
+
+        const char* ntsPath = "frame_stats_test.csv";
+        assert(st.writeFramesCSV(ntsPath));
+        defer( remove(ntsPath) );
+
+        FILE* pf = fopen(ntsPath, "rb");
+        assert(pf);
+        u32 nLines = 0;
+        for (int c; (c = fgetc(pf)) != EOF; ) nLines += c == '\n';
+        fclose(pf);
+        assert(nLines == nFrames + 1);
+    }
+
+    LOG_GOOD("'frameStats' passed\n");
+}
+
+void
+allocStats()
+{
+#ifdef ADT_ALLOC_STATS
+    /* arena: blocks are the reservation, aligned allocations are the live bytes */
+    {
+        Arena arena(SIZE_1K);
+        AllocStats* s = allocStatsGet("test:arena");
+        assert(s && allocStatsGet("test:arena") == s);
+        arena.setStats(s);
+        assert(s->nBytesReserved == SIZE_1K && s->nBytesLive == 0);
+
+        [[maybe_unused]] void* p0 = arena.malloc(1, 100);
+        [[maybe_unused]] void* p1 = arena.malloc(1, 100);
+        void* p2 = arena.malloc(1, 100);
+        assert(s->nBytesLive == 104 * 3 && s->nAllocs == 3);
+
+        /* bump in place */
+        [[maybe_unused]] void* p2b = arena.realloc(p2, 100, 200, 1);
+        assert(p2b == p2);
+        assert(s->nBytesLive == 104 * 2 + 200 && s->nAllocs == 3);
+
+        /* doesn't fit, new block of 2x */
+        [[maybe_unused]] void* pBig = arena.malloc(1, 4000);
+        assert(s->nBytesReserved == SIZE_1K + 8000);
+        assert(s->nBytesLive == 104 * 2 + 200 + 4000 && s->nBytesPeak == s->nBytesLive);
+        assert(s->aSizeHist[allocStatsBucket(104)] == 3 && s->aSizeHist[allocStatsBucket(4000)] == 1);
+        assert(allocStatsBucket(16) == 0 && allocStatsBucket(17) == 1 && allocStatsBucket(SIZE_1G) == ALLOC_STATS_N_BUCKETS - 1);
+
+        arena.reset();
+        assert(s->nBytesLive == 0 && s->nResets == 1);
+
+        [[maybe_unused]] void* pSmall = arena.malloc(1, 16);
+        arena.freeAll();
+        assert(s->nBytesLive == 0 && s->nBytesReserved == 0);
+        assert(s->nBytesPeak == 104 * 2 + 200 + 4000 && s->nBytesReservedPeak == SIZE_1K + 8000);
+    }
+
+    /* same name, one record */
+    {
+        Arena a0(SIZE_1K), a1(SIZE_1K);
+        a0.setStats(allocStatsGet("test:shared"));
+        a1.setStats(allocStatsGet("test:shared"));
+        [[maybe_unused]] void* p0 = a0.malloc(1, 8);
+        [[maybe_unused]] void* p1 = a1.malloc(1, 8);
+
+        AllocStats* s = allocStatsGet("test:shared");
+        assert(s->nBytesReserved == SIZE_1K * 2 && s->nBytesLive == 16 && s->nAllocs == 2);
+
+        a0.freeAll();
+        a1.freeAll();
+        assert(s->nBytesReserved == 0 && s->nBytesLive == 0);
+    }
+
+    /* free() gives the bytes back */
+    {
+        FreeList fl(SIZE_8K);
+        AllocStats* s = allocStatsGet("test:freeList");
+        fl.setStats(s);
+
+        void* p0 = fl.malloc(1, 100);
+        void* p1 = fl.malloc(1, 500);
+        assert(s->nBytesLive == ssize(fl.nBytesAllocated()) && s->nAllocs == 2);
+
+        p0 = fl.realloc(p0, 100, 1000, 1);
+        assert(s->nBytesLive == ssize(fl.nBytesAllocated()));
+
+        fl.free(p0);
+        fl.free(p1);
+        assert(s->nBytesLive == 0);
+
+        fl.freeAll();
+        assert(s->nBytesReserved == 0);
+    }
+
+    {
+        ChunkAllocator ca(sizeof(u64), SIZE_1K);
+        AllocStats* s = allocStatsGet("test:chunk");
+        ca.setStats(s);
+
+        void* aP[10] {};
+        for (auto& p : aP) p = ca.malloc(1, sizeof(u64));
+        assert(s->nAllocs == 10 && s->nBytesLive == ssize(10 * (sizeof(u64) + sizeof(ChunkAllocatorNode))));
+
+        for (auto* p : aP) ca.free(p);
+        assert(s->nBytesLive == 0 && s->nFrees == 10);
+
+        ca.freeAll();
+        assert(s->nBytesReserved == 0);
+    }
+
+    /* the report has a line per record */
+    {
+        FILE* pf = tmpfile();
+        assert(pf);
+        allocStatsReport(pf);
+
+        const long size = ftell(pf);
+        rewind(pf);
+        char* pBuff = (char*)OsAllocatorGet()->zalloc(1, size + 1);
+        defer( OsAllocatorGet()->free(pBuff) );
+        [[maybe_unused]] const usize nRead = fread(pBuff, 1, size, pf);
+        fclose(pf);
+
+        assert(strstr(pBuff, "test:arena") && strstr(pBuff, "test:shared") && strstr(pBuff, "test:chunk"));
+    }
+
+    LOG_GOOD("'allocStats' passed\n");
+#endif
+}
+
+struct PipelineFrame
+{
+    u64 seq {};
+    u64 aPayload[64] {}; /* all == seq, torn reads would show */
+};
+
+static TripleBuffer<PipelineFrame> s_pipeline;
+static std::atomic<bool> s_bPipelineRunning {};
+static frame::SampleRing s_pipelineTicks;
+
+/* publishes at the tick rate, like the sim thread */
+static THREAD_STATUS
+pipelineWriter(void*)
+{
+    const s64 dtUS = 1'000'000 / game::TICK_RATE;
+    s64 nextUS = utils::timeNowUS();
+    s64 prevUS = 0;
+    u64 seq = 0;
+
+    while (s_bPipelineRunning.load(std::memory_order_acquire))
+    {
+        const s64 nowUS = utils::timeNowUS();
+        if (nowUS < nextUS)
+        {
+            utils::sleepMS(f64(nextUS - nowUS) / 1000.0);
+            continue;
+        }
+        nextUS += dtUS;
+
+        if (prevUS > 0) s_pipelineTicks.push(f32(nowUS - prevUS) / 1000.0f);
+        prevUS = nowUS;
+
+        auto& f = s_pipeline.getBack();
+        f.seq = ++seq;
+        for (auto& x : f.aPayload) x = seq;
+        s_pipeline.publish();
+    }
+
+    return {};
+}
+
+void
+pipeline()
+{
+    {
+        TripleBuffer<u32> tb {};
+        assert(!tb.acquire());
+
+        tb.getBack() = 1;
+        tb.publish();
+        tb.getBack() = 2;
+        tb.publish();
+        assert(tb.acquire() && tb.getFront() == 2);
+        assert(!tb.acquire() && tb.getFront() == 2);
+
+        tb.getBack() = 3;
+        tb.publish();
+        assert(tb.acquire() && tb.getFront() == 3);
+    }
+
+    {
+        frame::SampleRing ring {};
+        for (u32 i = 0; i < frame::SampleRing::RING_SIZE + 100; ++i) ring.push(i < 100 ? 1000.0f : 1.0f);
+        assert(ring.getSize() == frame::SampleRing::RING_SIZE);
+        /* the first 100 got overwritten */
+        assert(ring.percentiles().max == 1.0f);
+    }
+
+    /* 40 fps reader: the writer keeps its pace, the reader only sees whole and newer frames */
+    s_bPipelineRunning.store(true, std::memory_order_release);
+    Thread writer(pipelineWriter, nullptr);
+
+    /* a few frames are enough to see torn or stale reads, the interval percentiles want more */
+    const u32 nFrames = g_bBench ? 12 : 3;
+    u64 lastSeq = 0;
+    u32 nRead = 0;
+    for (u32 i = 0; i < nFrames; ++i)
+    {
+        utils::sleepMS(25.0);
+        if (!s_pipeline.acquire()) continue;
+
+        const auto& f = s_pipeline.getFront();
+        assert(f.seq > lastSeq);
+        for (auto x : f.aPayload) assert(x == f.seq);
+
+        lastSeq = f.seq;
+        ++nRead;
+    }
+
+    s_bPipelineRunning.store(false, std::memory_order_release);
+    writer.join();
+
+    assert(nRead > 0);
+    assert(s_pipelineTicks.getSize() > nFrames * 2);
+
+    const f32 dtMS = 1000.0f / game::TICK_RATE;
+    const frame::Percentiles p = s_pipelineTicks.percentiles();
+    assert(p.p50 < dtMS * 3.0f);
+
+    LOG_GOOD("pipeline: 25 ms frames, {} ticks, interval p50/p99/max: {:.3}/{:.3}/{:.3} ms (dt: {:.3} ms)\n",
+        s_pipelineTicks.getSize(), p.p50, p.p99, p.max, dtMS
+    );
+    LOG_GOOD("'pipeline' passed\n");
+}
+
+void
+replay()
+{
+    Arena arena(SIZE_1K * 64);
+    defer( arena.freeAll() );
+
+    const char* ntsPath = "/tmp/breakout-test.rply";
+
+    replay::Recorder rec {};
+    rec.start(&arena, 0xc0ffee);
+
+    /* 10 ticks, holding A for 3 of them, then A+SPACE for one */
+    for (u32 t = 0; t < 10; ++t)
+    {
+        u16 mask = 0;
+        if (t >= 2 && t < 5) mask = 1 << 0;
+        if (t == 5) mask = (1 << 0) | (1 << 2);
+        rec.keys(mask);
+        rec.keys(mask); /* the same state twice logs once */
+        rec.tick(t * 7919);
+    }
+
+    assert(rec.m_aKeys.getSize() == 3);
+    assert(rec.m_aKeys[0].tick == 2 && rec.m_aKeys[0].mask == 1);
+    assert(rec.m_aKeys[1].tick == 5 && rec.m_aKeys[1].mask == 5);
+    assert(rec.m_aKeys[2].tick == 6 && rec.m_aKeys[2].mask == 0);
+    assert(rec.write(ntsPath));
+
+    replay::Log log {};
+    assert(replay::load(&arena, ntsPath, &log));
+    assert(log.header.nTicks == 10 && log.header.nKeyEvents == 3);
+    assert(log.header.tickRate == game::TICK_RATE && log.header.seed == 0xc0ffee);
+    for (u32 i = 0; i < 3; ++i)
+        assert(log.pKeys[i].tick == rec.m_aKeys[i].tick && log.pKeys[i].mask == rec.m_aKeys[i].mask);
+    for (u32 t = 0; t < 10; ++t)
+        assert(log.pHashes[t] == t * 7919);
+
+    /* wrong magic */
+    FILE* pf = fopen(ntsPath, "r+b");
+    assert(pf);
+    const u32 bad = 0;
+    fwrite(&bad, sizeof(bad), 1, pf);
+    fclose(pf);
+    assert(!replay::load(&arena, ntsPath, &log));
+
+    remove(ntsPath);
+
+    LOG_GOOD("'replay' passed\n");
+}
+
+void
+level()
+{
+    Arena arena(SIZE_1M * 4);
+    defer( arena.freeAll() );
+
+    /* two layers, the second one draws over the first, '#' redefined */
+    const char* ntsText =
+        "# test\n"
+        "size 4 3\n"
+        "tile # 9\n"
+        "layer\n"
+        "1111\n"
+        "..2.\n"
+        "####\n"
+        "layer\n"
+        "4...\n"
+        "....\n"
+        ".3..\n";
+
+    level::Layers layers {};
+    assert(level::parseText(&arena, ntsText, &layers));
+    assert(layers.width == 4 && layers.height == 3 && layers.aLayers.getSize() == 2);
+
+    const game::Level lvl = level::composite(&arena, layers);
+    const s8 aExpected[] {4, 1, 1, 1, 0, 0, 2, 0, 9, 3, 9, 9};
+    assert(memcmp(lvl.aTiles, aExpected, sizeof(aExpected)) == 0);
+
+    assert(!level::parseText(&arena, "size 4 3\nlayer\n1111\n", &layers)); /* short layer */
+    assert(!level::parseText(&arena, "size 2 1\nlayer\n1x\n", &layers)); /* unknown tile */
+
+    const char* ntsPath = "/tmp/breakout-test.blvl";
+    auto roundTrip = [&](const level::Layers& l, const game::Level& ref, level::Stats* pSt) {
+        VecBase<u8> aBin = level::encode(&arena, l);
+        FILE* pf = fopen(ntsPath, "wb");
+        assert(pf);
+        fwrite(aBin.data(), 1, aBin.getSize(), pf);
+        fclose(pf);
+
+        game::Level got {};
+        assert(level::load(&arena, ntsPath, &got, pSt));
+        assert(got.width == ref.width && got.height == ref.height);
+        assert(memcmp(got.aTiles, ref.aTiles, usize(ref.width) * ref.height) == 0);
+
+        return aBin;
+    };
+
+    level::Stats st {};
+    roundTrip(layers, lvl, &st);
+    assert(st.nLayers == 2 && st.nBlocks == 9);
+
+    /* the shipped level reads as the old LEVEL1 array did */
+    game::Level lvl1 {};
+    assert(level::load(&arena, game::DEFAULT_LEVEL_PATH, &lvl1));
+    assert(lvl1.width == 15 && lvl1.height == 10);
+    assert(lvl1.aTiles[0] == 3 && lvl1.aTiles[4] == 4 && lvl1.aTiles[9] == 1 && lvl1.aTiles[8*15 + 11] == 7);
+
+    /* 1024x1024, rows of runs with some noise */
+    constexpr u32 W = 1024, H = 1024;
+    level::Layers big {.width = W, .height = H};
+    s8* pBig = (s8*)arena.malloc(W*H, 1);
+    u32 seed = 1;
+    for (u32 i = 0; i < W*H; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        pBig[i] = (seed >> 28) == 0 ? s8((seed >> 20) % 9 + 1) : s8(((i / 37) % 3) * 2);
+    }
+    big.aLayers.push(&arena, pBig);
+
+    const game::Level bigLvl {.width = W, .height = H, .aTiles = pBig};
+    VecBase<u8> aBin = roundTrip(big, bigLvl, &st);
+    assert(st.nBlocks > 0 && st.nLayers == 1);
+
+    /* truncated file */
+    FILE* pf = fopen(ntsPath, "wb");
+    assert(pf);
+    fwrite(aBin.data(), 1, aBin.getSize() / 2, pf);
+    fclose(pf);
+    game::Level broken {};
+    assert(!level::load(&arena, ntsPath, &broken));
+
+    remove(ntsPath);
+
+    LOG_GOOD("level: {}x{}, {} blocks, {} runs, {} -> {} bytes, map: {} us, decode: {} us\n",
+        W, H, st.nBlocks, st.nRuns, W*H, aBin.getSize(), st.mapUS, st.decodeUS
+    );
+    LOG_GOOD("'level' passed\n");
+}
+
+void
+collision()
+{
+    using namespace collision;
+
+    auto near = [](f32 a, f32 b) { return std::abs(a - b) < 1e-4f; };
+
+    /* box, head on, through a corner, missing, moving out of an overlap */
+    {
+        Hit h {};
+        assert(sweepCircleAABB({0, -3}, {0, 4}, 0.25f, {0, 0}, {0.5f, 0.5f}, &h));
+        assert(near(h.t, (3.0f - 0.75f) / 4.0f) && near(h.normal.x, 0) && near(h.normal.y, -1));
+
+        assert(sweepCircleAABB({-2, -2}, {2, 2}, 0.25f, {0, 0}, {0.5f, 0.5f}, &h));
+        assert(near(h.normal.x, -0.70710678f) && near(h.normal.y, -0.70710678f));
+        const f32 dCorner = (1.5f*std::sqrt(2.0f) - 0.25f) / (2.0f*std::sqrt(2.0f));
+        assert(near(h.t, dCorner));
+
+        assert(!sweepCircleAABB({-2, 0.8f}, {4, 0}, 0.25f, {0, 0}, {0.5f, 0.5f}, &h)); /* above */
+        assert(!sweepCircleAABB({-0.7f, 0.7f}, {0.3f, 0.3f}, 0.15f, {0, 0}, {0.5f, 0.5f}, &h)); /* past the corner */
+        assert(!sweepCircleAABB({0, -3}, {0, 1}, 0.25f, {0, 0}, {0.5f, 0.5f}, &h)); /* short */
+
+        assert(!sweepCircleAABB({0, 0.6f}, {0, 1}, 0.25f, {0, 0}, {0.5f, 0.5f}, &h)); /* overlapping, leaving */
+        assert(sweepCircleAABB({0, 0.6f}, {0, -1}, 0.25f, {0, 0}, {0.5f, 0.5f}, &h));
+        assert(h.t == 0.0f && near(h.normal.y, 1));
+    }
+
+    /* grid: the earliest of several, ignoring cells behind */
+    {
+        auto bSolid = [](s32 x, s32 y) { return y == 5 && (x == 3 || x == 4); };
+        GridHit h {};
+        assert(sweepGrid({3.0f, 0.0f}, {0.0f, 100.0f}, 0.1f, 8, 8, bSolid, &h));
+        assert(h.x == 3 && h.y == 5 && near(h.t, (5.0f - 0.6f) / 100.0f));
+        assert(!sweepGrid({6.0f, 0.0f}, {0.0f, 100.0f}, 0.1f, 8, 8, bSolid, &h));
+        assert(!sweepGrid({-20.0f, 5.0f}, {-5.0f, 0.0f}, 0.1f, 8, 8, bSolid, &h)); /* outside, going away */
+    }
+
+    /* Tunneling. A one cell thick diagonal staircase (x, x), (x + 1, x) splits the grid, y - x < -1 is below it,
+     * > 1 above. Balls start below and are thrown at it at up to 300 cells per tick. The swept move must never end
+     * up above, a single sample at the end of the step (what blockHit() did) is checked against it for comparison. */
+    {
+        constexpr s32 W = 128, H = 128;
+        auto bSolid = [](s32 x, s32 y) { return x == y || x == y + 1; };
+
+        u32 seed = 7;
+        auto rand01 = [&] {
+            seed = seed * 1664525u + 1013904223u;
+            return f32(seed >> 8) / f32(1 << 24);
+        };
+
+        const u32 N_TRIALS = g_bBench ? 20000 : 2000;
+        u32 nSweptTunneled = 0, nSampledTunneled = 0, nHits = 0;
+        f32 maxSpeed = 0.0f;
+
+        for (u32 i = 0; i < N_TRIALS; ++i)
+        {
+            const math::V2 start {40.0f + rand01()*40.0f, 0.0f};
+            const f32 gap = 2.0f + rand01()*10.0f;
+            const math::V2 p {start.x, start.x - gap - 1.0f - rand01()};
+
+            const f32 ang = math::toRad(100.0f + rand01()*70.0f); /* up and to the left, into the stairs */
+            const math::V2 dir {std::cos(ang), std::sin(ang)};
+            const f32 speed = rand01() < 0.5f ? 0.01f + rand01()*2.0f : 2.0f + rand01()*300.0f;
+            maxSpeed = utils::max(maxSpeed, speed);
+
+            Move m {.pos = p, .dir = dir, .dist = speed};
+            nHits += moveCircle(&m, 0.1f, W, H, 8, bSolid, [](const GridHit&, Move*) {});
+            if (m.pos.y - m.pos.x > -1.0f) ++nSweptTunneled;
+
+            /* discrete: move, if the end overlaps anything stay put */
+            const math::V2 q = p + dir*speed;
+            bool bOverlap = false;
+            for (s32 y = s32(std::floor(q.y + 0.5f)) - 1; y <= s32(std::floor(q.y + 0.5f)) + 1; ++y)
+                for (s32 x = s32(std::floor(q.x + 0.5f)) - 1; x <= s32(std::floor(q.x + 0.5f)) + 1; ++x)
+                    if (x >= 0 && x < W && y >= 0 && y < H && bSolid(x, y) &&
+                        std::abs(q.x - x) < 0.5f + 0.05f && std::abs(q.y - y) < 0.5f + 0.05f)
+                        bOverlap = true;
+            if (!bOverlap && q.y - q.x > 1.0f && q.x >= 0 && q.y < H) ++nSampledTunneled;
+        }
+
+        assert(nSweptTunneled == 0);
+        assert(nHits > 0);
+        LOG_GOOD("collision: {} throws up to {:.1} cells/tick, {} bounces, tunneled: swept: {}, sampled: {}\n",
+            N_TRIALS, maxSpeed, nHits, nSweptTunneled, nSampledTunneled
+        );
+    }
+
+    /* a closed box, bounce around for a while at 5 cells per tick, must stay inside */
+    {
+        constexpr s32 W = 32, H = 32;
+        auto bSolid = [](s32 x, s32 y) { return x == 0 || y == 0 || x == W - 1 || y == H - 1; };
+
+        Move m {.pos = {16.0f, 16.0f}, .dir = math::V2Norm({0.3f, 1.0f}), .dist = 0.0f};
+        u32 nHits = 0;
+        for (u32 tick = 0; tick < 10000; ++tick)
+        {
+            m.dist = 5.0f;
+            nHits += moveCircle(&m, 0.1f, W, H, 8, bSolid, [](const GridHit&, Move*) {});
+            assert(m.pos.x > 0.5f && m.pos.x < W - 1.5f && m.pos.y > 0.5f && m.pos.y < H - 1.5f);
+        }
+        assert(nHits > 1000);
+    }
+
+    /* throughput, random rays over a 30% filled grid */
+    if (g_bBench)
+    {
+        constexpr s32 W = 256, H = 256;
+        Arena arena(SIZE_1K * 128);
+        defer( arena.freeAll() );
+
+        u8* aCells = (u8*)arena.zalloc(W*H, 1);
+        u32 seed = 3;
+        auto rnd = [&] {
+            seed = seed * 1664525u + 1013904223u;
+            return seed >> 8;
+        };
+        for (s32 i = 0; i < W*H; ++i) aCells[i] = rnd() % 10 < 3;
+        auto bSolid = [&](s32 x, s32 y) { return aCells[y*W + x] != 0; };
+
+        constexpr u32 N = 200000;
+        u32 nHit = 0;
+        f32 sumT = 0.0f;
+
+        const s64 t0 = utils::timeNowUS();
+        for (u32 i = 0; i < N; ++i)
+        {
+            const math::V2 p {f32(rnd() % (W*16)) / 16.0f, f32(rnd() % (H*16)) / 16.0f};
+            const f32 ang = f32(rnd() % 3600) * math::PI32 / 1800.0f;
+            const f32 len = 0.05f + f32(rnd() % 64) / 16.0f;
+
+            GridHit h;
+            if (sweepGrid(p, math::V2 {std::cos(ang), std::sin(ang)} * len, 0.1f, W, H, bSolid, &h))
+            {
+                ++nHit;
+                sumT += h.t;
+            }
+        }
+        const s64 t1 = utils::timeNowUS();
+
+        LOG_GOOD("collision: {} grid sweeps (up to 4 cells) in {} us, {:.1} ns each, {} hit (avg t: {:.3})\n",
+            N, t1 - t0, f64(t1 - t0) * 1000.0 / N, nHit, nHit ? sumT / nHit : 0.0f
+        );
+    }
+
+    LOG_GOOD("'collision' passed\n");
+}
+
+
+void
+balls()
+{
+    using namespace balls;
+
+    Arena arena(SIZE_1M);
+    defer( arena.freeAll() );
+
+    u32 seed = 11;
+    auto rand01 = [&] {
+        seed = seed * 1664525u + 1013904223u;
+        return f32(seed >> 8) / f32(1 << 24);
+    };
+
+    constexpr s32 W = 256, H = 128;
+    const Paddle pad {.left = 100.0f, .right = 140.0f, .lineY = 0.25f, .dir = {0.5f, 0.0f}};
+    const Bounds bounds {.left = -0.5f, .right = W - 0.5f, .bottom = -0.5f, .top = H - 0.5f, .bBounceBottom = false};
+
+    auto fill = [&](Balls* pB, u32 n, f32 minSpeed, f32 maxSpeed) {
+        for (u32 i = 0; i < n; ++i)
+        {
+            /* some of them out of bounds or under the paddle already */
+            const math::V2 pos {-2.0f + rand01()*(W + 3.0f), -2.0f + rand01()*(H + 3.0f)};
+            const f32 ang = rand01() * 2.0f * math::PI32;
+            pB->push(pos, {std::cos(ang), std::sin(ang)}, minSpeed + rand01()*(maxSpeed - minSpeed));
+        }
+    };
+
+    /* kernels against the scalar versions, 1003 so every tail runs */
+    {
+        Balls a(&arena), b(&arena);
+        fill(&a, 1003, 1.0f, 20.0f);
+        for (u32 i = 0; i < a.m_size; ++i) b.push(a.pos(i), a.dir(i), a.m_aSpeed[i]);
+        for (u32 i = 0; i < a.m_size; ++i) a.m_aStep[i] = b.m_aStep[i] = a.m_aSpeed[i] / 240.0f;
+
+        VecBase<u32> aLostA {}, aLostB {};
+        const u32 nPadA = paddle(&a, 3, pad);
+        const u32 nPadB = paddleScalar(&b, 3, b.m_size, pad);
+        const u32 nWallA = walls(&a, 3, bounds, &arena, &aLostA);
+        const u32 nWallB = wallsScalar(&b, 3, b.m_size, bounds, &arena, &aLostB);
+        integrate(&a, 3);
+        integrateScalar(&b, 3, b.m_size);
+
+        assert(nPadA == nPadB && nPadA > 0);
+        assert(nWallA == nWallB && nWallA > 0);
+        assert(aLostA.getSize() == aLostB.getSize() && aLostA.getSize() > 0);
+        for (ssize i = 0; i < aLostA.getSize(); ++i) assert(aLostA[i] == aLostB[i]);
+
+        for (u32 i = 0; i < a.m_size; ++i)
+        {
+            assert(math::V2Length(a.pos(i) - b.pos(i)) < 1e-5f);
+            assert(math::V2Length(a.dir(i) - b.dir(i)) < 1e-5f);
+        }
+
+        /* the first 3 weren't touched */
+        for (u32 i = 0; i < 3; ++i) assert(a.m_aPosX[i] == b.m_aPosX[i] && a.m_aPosY[i] == b.m_aPosY[i]);
+    }
+
+    /* a level's worth of blocks in the top half, indestructible so every run sees the same grid */
+    u8* aCells = (u8*)arena.zalloc(W*H, 1);
+    Grid grid {};
+    grid.init(&arena, W, H);
+    for (s32 y = H/2; y < H - 8; ++y)
+    {
+        for (s32 x = 0; x < W; ++x)
+        {
+            if (rand01() < 0.6f)
+            {
+                aCells[y*W + x] = 1;
+                grid.add(x, y);
+            }
+        }
+    }
+    auto bSolid = [&](s32 x, s32 y) { return aCells[y*W + x] != 0; };
+    auto onHit = [](const collision::GridHit&, collision::Move*) {};
+
+    /* the headless sim at 1, 100, 10k and 100k balls (1k without g_bBench), at the game's speed, nothing is lost */
+    {
+        const Bounds closed {.left = -0.5f, .right = W - 0.5f, .bottom = -0.5f, .top = H - 0.5f, .bBounceBottom = true};
+        constexpr f32 DT = 1.0f / 240.0f;
+        const u32 aCounts[] {1, 100, 1000, 10000, 100000};
+
+        for (u32 n : aCounts)
+        {
+            if (!g_bBench && n > 1000) break;
+
+            Balls b(&arena, n);
+            for (u32 i = 0; i < n; ++i)
+            {
+                const f32 ang = rand01() * 2.0f * math::PI32;
+                b.push({rand01()*(W - 1.0f), rand01()*(H/2 - 2.0f)}, {std::cos(ang), std::sin(ang)}, 9.0f);
+            }
+
+            Arena scratch(SIZE_1K * 64);
+            defer( scratch.freeAll() );
+
+            const u32 nTicks = n >= 100000 ? 60 : 240;
+            u64 nSwept = 0, nBlockHits = 0;
+
+            const s64 t0 = utils::timeNowUS();
+            for (u32 tick = 0; tick < nTicks; ++tick)
+            {
+                scratch.reset();
+                const StepStats st = step(&b, 0, DT, 0.1f, 8, pad, closed, grid, &scratch, bSolid, onHit);
+                assert(st.nLost == 0 && !st.bLost0);
+                nSwept += st.nSwept;
+                nBlockHits += st.nBlockHits;
+            }
+            const s64 t1 = utils::timeNowUS();
+
+            for (u32 i = 0; i < b.m_size; ++i)
+            {
+                assert(b.m_aPosX[i] >= -0.6f && b.m_aPosX[i] <= W - 0.4f);
+                assert(b.m_aPosY[i] >= -0.6f && b.m_aPosY[i] <= H - 0.4f);
+            }
+
+            LOG_GOOD("balls: {}: {:.1} us/tick, {:.1} ns/ball, swept: {:.1}%, block hits: {}\n",
+                n, f64(t1 - t0) / nTicks, f64(t1 - t0) * 1000.0 / (f64(nTicks) * n),
+                100.0 * f64(nSwept) / (f64(nTicks) * n), nBlockHits
+            );
+        }
+    }
+
+    /* kernels alone at 100k, vectors against one ball at a time */
+    if (g_bBench)
+    {
+        Balls b(&arena, 100000);
+        fill(&b, 100000, 1.0f, 20.0f);
+        for (u32 i = 0; i < b.m_size; ++i) b.m_aStep[i] = 0.0f; /* stays put, every pass sees the same input */
+
+        const Bounds closed {.left = -0.5f, .right = W - 0.5f, .bottom = -0.5f, .top = H - 0.5f, .bBounceBottom = true};
+        constexpr u32 N_PASSES = 50;
+        u32 nSink = 0;
+
+        auto time = [&](auto fn) {
+            const s64 t0 = utils::timeNowUS();
+            for (u32 i = 0; i < N_PASSES; ++i) fn();
+            return f64(utils::timeNowUS() - t0) * 1000.0 / (f64(N_PASSES) * b.m_size);
+        };
+
+        const f64 simdNS = time([&] {
+            nSink += paddle(&b, 0, pad);
+            nSink += walls(&b, 0, closed, &arena, nullptr);
+            integrate(&b, 0);
+        });
+        const f64 scalarNS = time([&] {
+            nSink += paddleScalar(&b, 0, b.m_size, pad);
+            nSink += wallsScalar(&b, 0, b.m_size, closed, &arena, nullptr);
+            integrateScalar(&b, 0, b.m_size);
+        });
+
+        LOG_GOOD("balls: paddle + walls + integrate: {:.2} ns/ball, scalar: {:.2} ns/ball ({} bounces)\n", simdNS, scalarNS, nSink);
+    }
+
+    LOG_GOOD("'balls' passed\n");
+}
+
+
+void
+explosion()
+{
+    Arena arena(SIZE_1M);
+    defer( arena.freeAll() );
+
+    /* 0 empty, 1 block, 2 chains */
+    auto neighbors = [](s32 w, s32 h, s32 x, s32 y, auto fn) {
+        for (s32 ny = y - 1; ny <= y + 1; ++ny)
+            for (s32 nx = x - 1; nx <= x + 1; ++nx)
+                if (nx >= 0 && nx < w && ny >= 0 && ny < h && (nx != x || ny != y)) fn(nx, ny);
+    };
+
+    /* small random grids against a brute force fixed point */
+    {
+        constexpr s32 W = 24, H = 16;
+        u8 aCells[W*H];
+        u8 aHits[W*H];
+        u8 aRef[W*H];
+        u8 aExploding[W*H];
+
+        u32 seed = 5;
+        auto rnd = [&] {
+            seed = seed * 1664525u + 1013904223u;
+            return seed >> 8;
+        };
+
+        explosion::Chain chain {};
+        u32 nTotalHits = 0;
+        for (u32 trial = 0; trial < 500; ++trial)
+        {
+            for (u8& c : aCells) c = rnd() % 10 < 3 ? 0 : rnd() % 10 < 5 ? 2 : 1;
+            const s32 sx = rnd() % W, sy = rnd() % H;
+
+            /* reused for half of them, the other half starts over */
+            if (trial % 2 == 0) chain.init(&arena, W, H);
+            else memset(chain.m_aLive, 0, chain.m_rowWords * H * sizeof(u64));
+            for (s32 y = 0; y < H; ++y)
+                for (s32 x = 0; x < W; ++x)
+                    if (aCells[y*W + x]) chain.add(x, y, aCells[y*W + x] == 2);
+
+            /* removing while it runs, like killBlock() */
+            memset(aHits, 0, sizeof(aHits));
+            const u32 nHits = chain.run(sx, sy, [&](u32 x, u32 y) {
+                ++aHits[y*W + x];
+                chain.remove(x, y);
+            });
+
+            memset(aRef, 0, sizeof(aRef));
+            memset(aExploding, 0, sizeof(aExploding));
+            aRef[sy*W + sx] = aCells[sy*W + sx] != 0;
+            aExploding[sy*W + sx] = 1;
+            for (bool bChanged = true; bChanged;)
+            {
+                bChanged = false;
+                for (s32 y = 0; y < H; ++y)
+                {
+                    for (s32 x = 0; x < W; ++x)
+                    {
+                        if (!aExploding[y*W + x]) continue;
+
+                        neighbors(W, H, x, y, [&](s32 nx, s32 ny) {
+                            const s32 i = ny*W + nx;
+                            if (aCells[i] == 0 || aRef[i]) return;
+                            aRef[i] = 1;
+                            aExploding[i] = aCells[i] == 2;
+                            bChanged = true;
+                        });
+                    }
+                }
+            }
+
+            u32 nRef = 0;
+            for (s32 i = 0; i < W*H; ++i)
+            {
+                assert(aHits[i] == aRef[i]); /* each once */
+                nRef += aRef[i];
+            }
+            assert(nHits == nRef);
+            nTotalHits += nHits;
+        }
+
+        /* nothing left behind between runs */
+        for (u32 i = 0; i < chain.m_rowWords * H; ++i) assert(chain.m_aVisited[i] == 0);
+        assert(nTotalHits > 500);
+    }
+
+    /* 100k+ chains, a one cell wide snake (as deep as it gets) and a solid field (as wide as it gets) */
+    if (g_bBench)
+    {
+        constexpr u32 W = 512, H = 400;
+        constexpr f64 budgetUS = 1000000.0 / 240.0;
+
+        u8* aSnake = (u8*)arena.zalloc(W*H, 1);
+        u32 nSnake = 0;
+        for (u32 y = 0; y < H; ++y)
+        {
+            if (y % 2 == 0)
+            {
+                memset(aSnake + y*W, 1, W);
+                nSnake += W;
+            }
+            else
+            {
+                /* connector at alternating ends, the rows only touch through it */
+                aSnake[y*W + ((y / 2) % 2 == 0 ? W - 1 : 0)] = 1;
+                ++nSnake;
+            }
+        }
+
+        u8* aField = (u8*)arena.zalloc(W*H, 1);
+        memset(aField, 1, W*(H/2));
+        const u32 nField = W*(H/2);
+
+        explosion::Chain chain {};
+        auto bench = [&](const char* ntsName, const u8* aCells, u32 nExpected) {
+            chain.init(&arena, W, H);
+            for (u32 y = 0; y < H; ++y)
+                for (u32 x = 0; x < W; ++x)
+                    if (aCells[y*W + x]) chain.add(x, y, true);
+
+            /* nothing is removed, the first run grows the queue, the second one is what a tick sees */
+            u32 nHits = 0;
+            auto onHit = [&](u32, u32) { ++nHits; };
+            (void)chain.run(0, 0, onHit);
+            nHits = 0;
+
+            const s64 t0 = utils::timeNowUS();
+            const u32 nRet = chain.run(0, 0, onHit);
+            const s64 t1 = utils::timeNowUS();
+
+            assert(nRet == nExpected && nHits == nExpected);
+            LOG_GOOD("explosion: {}: {} blocks in {} us ({:.1}% of a {} hz tick)\n",
+                ntsName, nRet, t1 - t0, 100.0 * f64(t1 - t0) / budgetUS, game::TICK_RATE
+            );
+        };
+
+        bench("snake", aSnake, nSnake);
+        bench("field", aField, nField);
+    }
+
+    LOG_GOOD("'explosion' passed\n");
+}
+
+void
+staticSprites()
+{
+    Arena arena(SIZE_8M);
+    defer( arena.freeAll() );
+
+    Plain plain(GL_STATIC_DRAW);
+    defer( plain.destroy() );
+
+    Shader sh {};
+    sh.load("shaders/2d/spriteInstanced.vert", "shaders/2d/spriteInstanced.frag");
+    defer( sh.destroy() );
+
+    auto readBack = [&](const render::StaticSprites& ss, u32 i) {
+        render::SpriteInstance inst {};
+        gl::bindBuffer(GL_ARRAY_BUFFER, ss.m_vbo);
+        glGetBufferSubData(GL_ARRAY_BUFFER, i * sizeof(inst), sizeof(inst), &inst);
+        return inst;
+    };
+    auto same = [](const render::SpriteInstance& a, const render::SpriteInstance& b) {
+        return memcmp(&a, &b, sizeof(a)) == 0;
+    };
+
+    /* only the changed range goes up */
+    {
+        render::StaticSprites ss(&arena);
+        ss.init(plain.m_vbo);
+        defer( ss.destroy() );
+
+        ss.reset(8);
+        ss.flush();
+        assert(ss.m_lastFlush.bRealloc && ss.m_lastFlush.nFlushed == 8);
+        for (u32 i = 0; i < 8; ++i) assert(readBack(ss, i).scale.x == 0.0f);
+
+        const render::SpriteInstance a {.pos = {1, 2, 0}, .layer = 1, .scale = {0.5f, 0.5f}, .uvRect = {0, 0, 0.5f, 0.5f}, .color = {1, 0, 0}};
+        const render::SpriteInstance b {.pos = {3, 4, 10}, .layer = 2, .scale = {1, 1}, .uvRect = {0, 0, 1, 1}, .color = {0, 1, 0}};
+        ss.set(2, a);
+        ss.set(5, b);
+        ss.flush();
+        assert(!ss.m_lastFlush.bRealloc && ss.m_lastFlush.nFlushed == 4);
+        assert(same(readBack(ss, 2), a) && same(readBack(ss, 5), b));
+
+        ss.hide(5);
+        ss.flush();
+        assert(ss.m_lastFlush.nFlushed == 1);
+        assert(readBack(ss, 5).scale.x == 0.0f && readBack(ss, 5).scale.y == 0.0f && same(readBack(ss, 2), a));
+
+        /* nothing changed, nothing uploaded */
+        ss.flush();
+        assert(ss.m_lastFlush.nFlushed == 0);
+
+    }
+
+    /* the same pixels as one sprite.vert draw per block */
+    {
+        const String aPaths[] {"test-assets/box3.bmp", "test-assets/ball.bmp"};
+        texture::ImgArray arr(&arena);
+        arr.build(aPaths, utils::size(aPaths), false, GL_NEAREST, GL_NEAREST);
+        defer( arr.destroy() );
+
+        Shader shSprite {};
+        shSprite.load("shaders/2d/sprite.vert", "shaders/2d/sprite.frag");
+        defer( shSprite.destroy() );
+
+        Ubo ubo {};
+        ubo.createBuffer(sizeof(math::M4) * 2, GL_STATIC_DRAW);
+        defer( ubo.destroy() );
+        const math::M4 aProjView[2] {math::M4Iden(), math::M4Iden()};
+        ubo.bufferData((void*)aProjView, 0, sizeof(aProjView));
+        ubo.bindShader(&sh, "ubProjView", 0);
+        ubo.bindShader(&shSprite, "ubProjView", 0);
+
+        constexpr int size = 64;
+        GLuint fbo = 0, rbo = 0;
+        glGenFramebuffers(1, &fbo);
+        glGenRenderbuffers(1, &rbo);
+        glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size, size);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo);
+        assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+        defer(
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDeleteRenderbuffers(1, &rbo);
+            glDeleteFramebuffers(1, &fbo);
+        );
+
+        GLint aViewport[4] {};
+        glGetIntegerv(GL_VIEWPORT, aViewport);
+        glViewport(0, 0, size, size);
+        defer( glViewport(aViewport[0], aViewport[1], aViewport[2], aViewport[3]) );
+        glDisable(GL_DEPTH_TEST);
+
+        /* a 4x4 grid of blocks in ndc, every other one hidden, two layers and colors */
+        render::StaticSprites ss(&arena);
+        ss.init(plain.m_vbo);
+        defer( ss.destroy() );
+        ss.reset(16);
+        for (u32 i = 0; i < 16; ++i)
+        {
+            if (i % 3 == 1) continue;
+
+            const u32 l = i % 2;
+            ss.set(i, {
+                .pos = {-1.0f + 0.5f*f32(i % 4), -1.0f + 0.5f*f32(i / 4), 0.0f}, .layer = f32(arr.m_aSlots[l].layer),
+                .scale = {0.25f, 0.2f}, .uvRect = arr.m_aSlots[l].uvRect, .color = l ? math::V3{1, 0.5f, 0} : math::V3{0, 1, 1}
+            });
+        }
+        ss.flush();
+
+        u32* aInstanced = (u32*)arena.zalloc(size * size, sizeof(u32));
+        u32* aSeparate = (u32*)arena.zalloc(size * size, sizeof(u32));
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        sh.use();
+        sh.setI("uSprites", 0);
+        arr.bind(GL_TEXTURE0);
+        ss.draw();
+        glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, aInstanced);
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        shSprite.use();
+        shSprite.setI("uSprites", 0);
+        for (u32 i = 0; i < 16; ++i)
+        {
+            const render::SpriteInstance& inst = ss.m_aInstances[i];
+            if (inst.scale.x == 0.0f) continue;
+
+            math::M4 tm = math::M4Iden();
+            tm = M4Translate(tm, inst.pos);
+            tm = M4Scale(tm, {inst.scale.x, inst.scale.y, 1.0f});
+            shSprite.setM4("uModel", tm);
+            shSprite.setI("uLayer", s32(inst.layer));
+            shSprite.setV4("uUvRect", inst.uvRect);
+            shSprite.setV3("uColor", inst.color);
+            plain.draw();
+        }
+        glReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, aSeparate);
+
+        assert(glGetError() == GL_NO_ERROR);
+        assert(memcmp(aInstanced, aSeparate, size * size * sizeof(u32)) == 0);
+
+        int nLit = 0;
+        for (int i = 0; i < size * size; ++i) nLit += aInstanced[i] != 0;
+        assert(nLit > size * size / 16);
+    }
+
+    /* per frame cpu time against block count: a matrix and a queued draw per block (how drawEntities() did blocks)
+     * against only the blocks that changed going into the persistent buffer */
+    if (g_bBench)
+    {
+        constexpr u32 nFrames = 16;
+        Shader fake {};
+        fake.m_id = 1;
+
+        for (const u32 nBlocks : {256u, 4096u, 65536u})
+        {
+            render::Queue q(&arena);
+            s64 oldUS = 0;
+            for (u32 f = 0; f < nFrames; ++f)
+            {
+                const s64 t0 = utils::timeNowUS();
+                for (u32 i = 0; i < nBlocks; ++i)
+                {
+                    math::M4 tm = math::M4Iden();
+                    tm = M4Translate(tm, {f32(i % 256), f32(i / 256), 0.0f});
+                    tm = M4Scale(tm, {0.5f, 0.5f, 1.0f});
+
+                    render::DrawItem it {};
+                    it.eFlags = DRAW::DIFF | DRAW::SPRITE;
+                    it.depth = 0.5f;
+                    it.pShader = &fake;
+                    it.vao = 1;
+                    it.texTarget = GL_TEXTURE_2D_ARRAY;
+                    it.diffuse = 1;
+                    it.count = 6;
+                    it.tm = tm;
+                    it.svUniform = "uModel";
+                    it.color = {1, 0, 0};
+                    q.submit(it);
+                }
+                q.sort();
+                (void)q.replay(true);
+                q.reset();
+                oldUS += utils::timeNowUS() - t0;
+            }
+
+            render::StaticSprites ss(&arena);
+            ss.init(plain.m_vbo);
+            defer( ss.destroy() );
+            ss.reset(nBlocks);
+            ss.flush();
+
+            /* 1% of the blocks change every frame, more than a game ever sees */
+            const u32 nChanged = utils::max(nBlocks / 100, 1u);
+            s64 newUS = 0, idleUS = 0;
+            u32 next = 0;
+            for (u32 f = 0; f < nFrames; ++f)
+            {
+                const s64 t0 = utils::timeNowUS();
+                for (u32 i = 0; i < nChanged; ++i, next = (next + 97) % nBlocks)
+                {
+                    ss.set(next, {
+                        .pos = {f32(next % 256), f32(next / 256), 0.0f}, .layer = 0, .scale = {0.5f, 0.5f},
+                        .uvRect = {0, 0, 1, 1}, .color = {1, 0, 0}
+                    });
+                }
+                ss.flush();
+                const s64 t1 = utils::timeNowUS();
+                ss.flush();
+                const s64 t2 = utils::timeNowUS();
+
+                newUS += t1 - t0;
+                idleUS += t2 - t1;
+            }
+
+            LOG_GOOD("static sprites: {} blocks: per block: {:.3} ms/frame, {} changed: {:.4} ms/frame, none changed: {:.4} ms/frame\n",
+                nBlocks, f64(oldUS) / 1000.0 / nFrames, nChanged, f64(newUS) / 1000.0 / nFrames, f64(idleUS) / 1000.0 / nFrames
+            );
+
+            q.destroy();
+        }
+    }
+
+    LOG_GOOD("'staticSprites' passed\n");
+}
+
 } /* namespace test */
@@ -3,7 +3,31 @@
 namespace test
 {
 
+extern bool g_bBench; /* --bench-tests: the timings and the big sizes too, not only the asserts */
+
 void math();
 void locks();
+void ttf();
+void cook();
+void convert();
+void images();
+void upload();
+void sprites();
+void shaders();
+void glState();
+void renderQueue();
+void gltfTextures();
+void indirect();
+void meshopt();
+void prof();
+void frameStats();
+void allocStats();
+void pipeline();
+void replay();
+void level();
+void collision();
+void balls();
+void explosion();
+void staticSprites();
 
 } /* namespace test */
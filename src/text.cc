@@ -2,10 +2,16 @@
 
 #include "adt/Arena.hh"
 #include "adt/Arr.hh"
+#include "adt/OsAllocator.hh"
 #include "adt/Vec.hh"
+#include "adt/prof.hh"
 #include "adt/defer.hh"
 #include "app.hh"
 #include "frame.hh"
+#include "gl/state.hh"
+
+#include <cstring>
+#include <immintrin.h>
 
 using namespace adt;
 
@@ -53,10 +59,10 @@ genMesh(Bitmap* s, int xOrigin, int yOrigin, GLint drawMode)
     auto aQuads = updateBuffer(s, &arena, s->m_str, s->m_maxSize, xOrigin, yOrigin);
 
     glGenVertexArrays(1, &s->m_vao);
-    glBindVertexArray(s->m_vao);
+    gl::bindVertexArray(s->m_vao);
 
     glGenBuffers(1, &s->m_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, s->m_vbo);
+    gl::bindBuffer(GL_ARRAY_BUFFER, s->m_vbo);
     glBufferData(GL_ARRAY_BUFFER, s->m_maxSize * sizeof(CharQuad), aQuads.data(), drawMode);
 
     /* positions */
@@ -66,7 +72,7 @@ genMesh(Bitmap* s, int xOrigin, int yOrigin, GLint drawMode)
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(math::V2), (void*)(sizeof(math::V2)));
 
-    glBindVertexArray(0);
+    gl::bindVertexArray(0);
 }
 
 static VecBase<CharQuad>
@@ -133,15 +139,15 @@ Bitmap::update(IAllocator* pAlloc, String str, int x, int y)
     this->m_str = str;
     VecBase<CharQuad> aQuads = updateBuffer(this, pAlloc, str, m_maxSize, x, y);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    gl::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
     glBufferSubData(GL_ARRAY_BUFFER, 0, m_maxSize * sizeof(f32)*4*6, aQuads.data());
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void
 Bitmap::draw()
 {
-    glBindVertexArray(m_vao);
+    gl::bindVertexArray(m_vao);
     glDrawArrays(GL_TRIANGLES, 0, m_vboSize);
 }
 
@@ -248,8 +254,8 @@ makeItCurvy(IAllocator* pAlloc, const VecBase<PointOnCurve>& aNonCurvyPoints, Cu
                 .bEndOfCurve = true,
             });
 
-            if (endIdx < 8) pEndIdxs->aIdxs[endIdx++] = aNew.lastI();
-            else assert(false && "8 curves max");
+            /* only the first few are recorded, nothing reads them past that */
+            if (endIdx < utils::size(pEndIdxs->aIdxs)) pEndIdxs->aIdxs[endIdx++] = aNew.lastI();
 
             firstInCurveIdx = idx + 1;
             bPrevOnCurve = true;
@@ -482,43 +488,192 @@ polygonWindingOrder(const VecBase<PointOnCurve>& aPoints, u32 startIdx)
     return polygonArea(aPoints, startIdx);
 }
 
-/* https://sharo.dev/post/reading-ttf-files-and-rasterizing-them-using-a-handmade- */
-void
-TTF::rasterizeGlyph(IAllocator* pAlloc, reader::ttf::Glyph* pGlyph, Span2D<u8> spBitmap)
+VecBase<OutlineEdge>
+glyphEdges(IAllocator* pAlloc, reader::ttf::Glyph* pGlyph, const f32 scale, const math::V2 off)
 {
-    const auto& aGlyphPoints = pGlyph->uGlyph.simple.aPoints;
+    if (pGlyph->numberOfContours <= 0) return {};
 
     CurveEndIdx endIdxs;
     auto aCurvyPoints = makeItCurvy(
         pAlloc, getPointsWithMissingOnCurve(pAlloc, pGlyph), &endIdxs, 6
     );
 
-    f32 xMax = m_pFont->m_head.xMax;
-    f32 xMin = m_pFont->m_head.xMin;
-    f32 yMax = m_pFont->m_head.yMax;
-    f32 yMin = m_pFont->m_head.yMin;
+    VecBase<OutlineEdge> aEdges(pAlloc, aCurvyPoints.getSize());
+
+    for (u32 pointIdx = 1; pointIdx < aCurvyPoints.getSize(); ++pointIdx)
+    {
+        aEdges.push(pAlloc, {
+            aCurvyPoints[pointIdx - 1].pos*scale + off,
+            aCurvyPoints[pointIdx - 0].pos*scale + off
+        });
+
+        /* don't connect the end of one contour to the start of the next */
+        if (aCurvyPoints[pointIdx].bEndOfCurve)
+            ++pointIdx;
+    }
+
+    return aEdges;
+}
+
+/* Adds the signed area the edge covers to every cell it crosses (font-rs style).
+ * The area right of the edge inside a cell goes to the next cell, so the running sum along a row is the coverage. */
+static void
+accumulateEdge(f32* pAcc, const ssize width, const ssize height, math::V2 p0, math::V2 p1)
+{
+    if (p0.y == p1.y) return;
+
+    f32 dir = 1.0f;
+    if (p0.y > p1.y)
+    {
+        utils::swap(&p0, &p1);
+        dir = -1.0f;
+    }
+
+    const f32 dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+    f32 x = p0.x;
+    if (p0.y < 0.0f) x -= p0.y * dxdy;
+
+    const ssize yStart = utils::max(ssize(p0.y), ssize(0));
+    const ssize yEnd = utils::min(ssize(std::ceil(p1.y)), height);
+
+    for (ssize y = yStart; y < yEnd; ++y)
+    {
+        f32* pRow = pAcc + y*width;
+        const f32 dy = utils::min(f32(y + 1), p1.y) - utils::max(f32(y), p0.y);
+        const f32 xNext = x + dxdy*dy;
+        const f32 d = dy * dir;
+
+        const f32 x0 = utils::min(x, xNext);
+        const f32 x1 = utils::max(x, xNext);
+        const f32 x0Floor = std::floor(x0);
+        const f32 x1Ceil = std::ceil(x1);
+        const ssize x0i = ssize(x0Floor);
+        const ssize x1i = ssize(x1Ceil);
+
+        if (x1i <= x0i + 1)
+        {
+            /* stays in one cell, trapezoid split at the mid point */
+            const f32 xmf = 0.5f*(x + xNext) - x0Floor;
+            pRow[x0i] += d - d*xmf;
+            pRow[x0i + 1] += d*xmf;
+        }
+        else
+        {
+            const f32 s = 1.0f / (x1 - x0);
+            const f32 x0f = x0 - x0Floor;
+            const f32 a0 = 0.5f*s*(1.0f - x0f)*(1.0f - x0f);
+            const f32 x1f = x1 - x1Ceil + 1.0f;
+            const f32 am = 0.5f*s*x1f*x1f;
+
+            pRow[x0i] += d*a0;
+
+            if (x1i == x0i + 2)
+            {
+                pRow[x0i + 1] += d*(1.0f - a0 - am);
+            }
+            else
+            {
+                const f32 a1 = s*(1.5f - x0f);
+                pRow[x0i + 1] += d*(a1 - a0);
+
+                for (ssize xi = x0i + 2; xi < x1i - 1; ++xi)
+                    pRow[xi] += d*s;
+
+                const f32 a2 = a1 + f32(x1i - x0i - 3)*s;
+                pRow[x1i - 1] += d*(1.0f - a2 - am);
+            }
+
+            pRow[x1i] += d*am;
+        }
+
+        x = xNext;
+    }
+}
+
+/* prefix sum of the whole buffer, rows sum up to zero so there is no need to restart per row */
+static void
+accumulateCoverage(u8* pDst, const f32* pAcc, const ssize size)
+{
+    ssize i = 0;
+    f32 sum = 0.0f;
+
+#ifdef ADT_SSE4_2
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 max = _mm_set1_ps(255.0f);
+    __m128 carry = _mm_setzero_ps();
+
+    for (; i + 4 <= size; i += 4)
+    {
+        /* inclusive scan of 4 lanes: shift by one lane and add, then by two */
+        __m128 x = _mm_loadu_ps(pAcc + i);
+        x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+        x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+        x = _mm_add_ps(x, carry);
+        carry = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+
+        /* nonzero winding: |sum| clamped to 1 */
+        __m128 cov = _mm_min_ps(_mm_andnot_ps(signMask, x), one);
+        __m128i c32 = _mm_cvtps_epi32(_mm_mul_ps(cov, max));
+        __m128i c16 = _mm_packs_epi32(c32, c32);
+        __m128i c8 = _mm_packus_epi16(c16, c16);
+
+        const int packed = _mm_cvtsi128_si32(c8);
+        memcpy(pDst + i, &packed, 4);
+    }
+
+    sum = _mm_cvtss_f32(carry);
+#endif
+
+    for (; i < size; ++i)
+    {
+        sum += pAcc[i];
+        pDst[i] = u8(std::nearbyint(utils::min(std::abs(sum), 1.0f) * 255.0f));
+    }
+}
+
+void
+rasterizeGlyph(Span2D<u8> spBitmap, const VecBase<OutlineEdge>& aEdges)
+{
+    const ssize width = spBitmap.getWidth();
+    const ssize height = spBitmap.getHeight();
+    const ssize size = width * height;
+
+    /* edges on the right border spill a couple of cells past the last row */
+    auto* pAcc = (f32*)OsAllocatorGet()->zalloc(size + 4, sizeof(f32));
+    defer( OsAllocatorGet()->free(pAcc) );
+
+    const f32 xMax = f32(width);
+    for (const auto& e : aEdges)
+    {
+        accumulateEdge(pAcc, width, height,
+            {utils::clamp(e.p0.x, 0.0f, xMax), e.p0.y},
+            {utils::clamp(e.p1.x, 0.0f, xMax), e.p1.y}
+        );
+    }
+
+    accumulateCoverage(spBitmap.data(), pAcc, size);
+}
 
+/* https://sharo.dev/post/reading-ttf-files-and-rasterizing-them-using-a-handmade- */
+void
+rasterizeGlyphScanline(Span2D<u8> spBitmap, const VecBase<OutlineEdge>& aEdges)
+{
     Arr<f32, 32> aIntersections {};
     auto& spBM = spBitmap;
 
-    f32 vScale = f32(spBM.getHeight()) / f32(yMax - yMin);
-    f32 hScale = f32(spBM.getWidth()) / f32(xMax - xMin);
-
     for (u32 row = 0; row < spBM.getHeight(); ++row)
     {
         aIntersections.setSize(0);
         const f32 scanline = f32(row);
 
-        for (u32 pointIdx = 1; pointIdx < aCurvyPoints.getSize(); ++pointIdx)
+        for (const auto& e : aEdges)
         {
-            f32 x0 = (aCurvyPoints[pointIdx - 1].pos.x) * hScale;
-            f32 x1 = (aCurvyPoints[pointIdx - 0].pos.x) * hScale;
-
-            f32 y0 = (aCurvyPoints[pointIdx - 1].pos.y - yMin) * vScale;
-            f32 y1 = (aCurvyPoints[pointIdx - 0].pos.y - yMin) * vScale;
+            f32 x0 = e.p0.x;
+            f32 x1 = e.p1.x;
 
-            if (aCurvyPoints[pointIdx].bEndOfCurve)
-                ++pointIdx;
+            f32 y0 = e.p0.y;
+            f32 y1 = e.p1.y;
 
             /* for the intersection all we need is to find what X is when our y = scanline or when y is equal to i of the loop
              *
@@ -575,128 +730,276 @@ TTF::rasterizeGlyph(IAllocator* pAlloc, reader::ttf::Glyph* pGlyph, Span2D<u8> s
     }
 }
 
-[[nodiscard]]
-static VecBase<CharQuad3Pos2UV>
-ttfGenStringMesh(
-    TTF* s,
-    IAllocator* pAlloc,
-    const String str,
-    const int xOrigin,
-    const int yOrigin,
-    const f32 zOff
-)
+/* Brute force distance to every edge, fine at TTF_SDF_SIZE.
+ * Inside test is the nonzero winding rule, same as truetype fill. */
+void
+genGlyphSDF(Span2D<u8> spBitmap, const VecBase<OutlineEdge>& aEdges, const f32 spread)
 {
-    auto getUV = [&](int c) -> f32
+    const f32 invSpread = 1.0f / (2.0f * spread);
+
+    for (ssize y = 0; y < spBitmap.getHeight(); ++y)
     {
-        return (c*s->m_scale) / (128.0f * s->m_scale);
-    };
+        const f32 py = f32(y) + 0.5f;
 
-    const auto& head = s->m_pFont->m_head;
+        for (ssize x = 0; x < spBitmap.getWidth(); ++x)
+        {
+            const f32 px = f32(x) + 0.5f;
 
-    VecBase<CharQuad3Pos2UV> aQuads(pAlloc, s->m_maxSize);
+            f32 minDistSq = std::numeric_limits<f32>::max();
+            int winding = 0;
 
-    f32 xOff = 0.0f;
-    f32 yOff = 0.0f;
+            for (const auto& e : aEdges)
+            {
+                const f32 dx = e.p1.x - e.p0.x;
+                const f32 dy = e.p1.y - e.p0.y;
+                const f32 lenSq = dx*dx + dy*dy;
 
-    for (char ch : str)
-    {
-        /* FIXME: uv ordering is messed up (but works correctly) */
+                f32 t = 0.0f;
+                if (lenSq > 0.0f)
+                    t = utils::clamp(((px - e.p0.x)*dx + (py - e.p0.y)*dy) / lenSq, 0.0f, 1.0f);
 
-        /* tr */
-        f32 x0 = 0.0f;
-        f32 y0 = getUV(ch + 1);
+                const f32 qx = e.p0.x + dx*t - px;
+                const f32 qy = e.p0.y + dy*t - py;
+                minDistSq = utils::min(minDistSq, qx*qx + qy*qy);
 
-        /* br */
-        f32 x3 = 1.0f;
-        f32 y3 = getUV(ch + 1);
+                /* which side of the edge the pixel is on */
+                const f32 side = dx*(py - e.p0.y) - (px - e.p0.x)*dy;
 
-        /* tl */
-        f32 x1 = 0.0f;
-        f32 y1 = getUV(ch + 0);
+                if (e.p0.y <= py)
+                {
+                    if (e.p1.y > py && side > 0.0f) ++winding;
+                }
+                else if (e.p1.y <= py && side < 0.0f)
+                {
+                    --winding;
+                }
+            }
 
-        /* bl */
-        f32 x2 = 1.0f;
-        f32 y2 = getUV(ch + 0);
+            f32 dist = std::sqrt(minDistSq);
+            if (winding == 0) dist = -dist;
 
-        if (ch == '\n')
-        {
-            xOff = 0.0f;
-            yOff -= 2.0f;
-            continue;
+            const f32 v = utils::clamp(0.5f + dist*invSpread, 0.0f, 1.0f);
+            spBitmap(x, y) = u8(std::round(v * 255.0f));
         }
+    }
+}
 
-        aQuads.push(pAlloc, {
-             0.0f + xOff + xOrigin,  2.0f + yOff + yOrigin,  zOff,     x0, y0,
-             0.0f + xOff + xOrigin,  0.0f + yOff + yOrigin,  zOff,     x1, y1,
-             2.0f + xOff + xOrigin,  0.0f + yOff + yOrigin,  zOff,     x2, y2,
+struct GlyphJob
+{
+    GlyphKey key {};
+    GlyphMetrics metrics {};
+    Span2D<u8> spBitmap {};
+    VecBase<OutlineEdge> aEdges {};
+};
 
-             0.0f + xOff + xOrigin,  2.0f + yOff + yOrigin,  zOff,     x0, y0,
-             2.0f + xOff + xOrigin,  0.0f + yOff + yOrigin,  zOff,     x2, y2,
-             2.0f + xOff + xOrigin,  2.0f + yOff + yOrigin,  zOff,     x3, y3,
-        });
+/* read the outline and size the bitmap, not thread safe (font reader state) */
+static GlyphJob
+prepareGlyphJob(TTF* s, IAllocator* pAlloc, const GlyphKey& key)
+{
+    const auto& head = s->m_pFont->m_head;
+    const f32 scale = f32(s->m_pxSize) / f32(head.yMax - head.yMin);
 
-        /* TODO: account for aspect ratio */
-        xOff += 1.0f;
+    /* edge pixels need room for partial coverage, distance fields for the whole spread */
+    const f32 border = s->m_eMode == TTF_MODE::SDF ? std::ceil(TTF_SDF_SPREAD) + 1.0f : 1.0f;
+
+    auto g = s->m_pFont->readGlyphIdx(key.glyphIdx);
+    auto hMetric = s->m_pFont->getHorMetric(key.glyphIdx);
+
+    GlyphJob job {
+        .key = key,
+        .metrics {
+            .xBearing = g.xMin*scale - border,
+            .yBearing = g.yMin*scale - border,
+            .advance = hMetric.advanceWidth*scale,
+        },
+    };
+
+    if (g.numberOfContours > 0 && g.xMax > g.xMin && g.yMax > g.yMin)
+    {
+        const u32 width = u32(std::ceil((g.xMax - g.xMin)*scale + 2.0f*border));
+        const u32 height = u32(std::ceil((g.yMax - g.yMin)*scale + 2.0f*border));
+
+        job.spBitmap = {(u8*)pAlloc->zalloc(width*height, 1), width, height};
+        job.aEdges = glyphEdges(pAlloc, &g, scale, {-g.xMin*scale + border, -g.yMin*scale + border});
     }
 
-    return aQuads;
+    return job;
 }
 
-void
-TTF::rasterizeAscii(reader::ttf::Font* pFont)
+u32
+TTF::pixelSize() const
 {
-    const f32 scale = 128.0f;
-    const int iScale = std::round(scale);
-    m_scale = scale;
-    m_maxSize = 100;
+    if (m_eMode == TTF_MODE::SDF) return TTF_SDF_SIZE;
 
-    m_pFont = pFont;
+    /* rasterize at the size the text ends up on screen */
+    const f32 pxPerUnit = f32(app::g_pWindow->m_wHeight) / frame::g_uiHeight;
+    return utils::clamp(u32(std::round(pxPerUnit * TTF_LINE_HEIGHT)), 4u, 256u);
+}
+
+bool
+TTF::getGlyph(IAllocator* pAlloc, u32 code, GlyphEntry* pEntry)
+{
+    const u32 glyphIdx = m_pFont->getGlyphIdx(code);
+    const u32 keySize = m_eMode == TTF_MODE::SDF ? (m_pxSize | GLYPH_KEY_SDF) : m_pxSize;
+    const GlyphKey key {m_pFont, glyphIdx, keySize};
+
+    if (const GlyphEntry* pFound = m_atlas.find(key))
+    {
+        *pEntry = *pFound;
+        return true;
+    }
 
-    /* width*height*128 */
-    m_pBitmap = (u8*)m_pAlloc->zalloc(1, math::sq(iScale) * 128);
+    GlyphJob job = prepareGlyphJob(this, pAlloc, key);
 
-    Arena arena(SIZE_8M);
+    GlyphRasterArg arg {job.spBitmap, &job.aEdges, m_eMode};
+    if (job.spBitmap) GlyphRasterSubmit(&arg);
+
+    const GlyphEntry* pNew = m_atlas.insert(key, job.spBitmap, job.metrics);
+    if (!pNew) return false;
+
+    *pEntry = *pNew;
+    return true;
+}
+
+void
+TTF::cacheParallel(const String str)
+{
+    PROFILE_SCOPE("TTF::cacheParallel");
+
+    Arena arena(SIZE_1M);
     defer( arena.freeAll() );
 
-    for (int ch = '!'; ch <= '~'; ++ch)
+    m_pxSize = pixelSize();
+    const u32 keySize = m_eMode == TTF_MODE::SDF ? (m_pxSize | GLYPH_KEY_SDF) : m_pxSize;
+
+    VecBase<GlyphJob> aJobs(&arena, str.getSize());
+
+    for (wchar_t wc : StringGlyphIt(str))
     {
-        u8* pTmp = (u8*)arena.zalloc(1, math::sq(iScale));
+        const u32 code = u32(wc);
+        const u32 glyphIdx = m_pFont->getGlyphIdx(code);
+        const GlyphKey key {m_pFont, glyphIdx, keySize};
+
+        if (m_atlas.find(key)) continue;
 
-        auto g = pFont->readGlyph(ch);
-        rasterizeGlyph(&arena, &g, Span2D{pTmp, u32(iScale), u32(iScale)});
-        memcpy(m_pBitmap + ch*math::sq(iScale), pTmp, iScale * 128);
+        bool bQueued = false;
+        for (const auto& j : aJobs)
+            if (j.key == key) bQueued = true;
 
-        arena.reset();
+        if (!bQueued) aJobs.push(&arena, prepareGlyphJob(this, &arena, key));
     }
 
-    texture::Img img {};
-    img.setMonochrome(m_pBitmap, iScale, iScale * 128);
-    m_texId = img.m_id;
+    VecBase<GlyphRasterArg> aArgs(&arena, aJobs.getSize());
 
-    char test[100] {};
-    for (int c = '!', i = 0; c <= '~'; ++c, ++i)
+    for (auto& j : aJobs)
     {
-        if (i == 40) test[i++] = '\n';
-        test[i] = c;
+        if (!j.spBitmap) continue;
+
+        aArgs.push(&arena, {j.spBitmap, &j.aEdges, m_eMode});
+        app::g_pThreadPool->submit(GlyphRasterSubmit, &aArgs.last());
     }
 
-    auto aQuads = ttfGenStringMesh(this, &arena, test, 0, 0, 1.0f);
-    m_vboSize = aQuads.getSize() * 6; /* 6 vertices for 1 quad */
+    app::g_pThreadPool->wait();
 
-    gl::g_mtxGlContext.lock();
-    app::g_pWindow->bindGlContext();
-    defer(
-        app::g_pWindow->unbindGlContext();
-        gl::g_mtxGlContext.unlock();
-    );
+    for (auto& j : aJobs)
+        m_atlas.insert(j.key, j.spBitmap, j.metrics);
+
+    LOG_GOOD("cached {} glyphs ({} rasterized) at {} px\n", aJobs.getSize(), aArgs.getSize(), m_pxSize);
+}
+
+[[nodiscard]]
+static VecBase<CharQuad3Pos2UV>
+ttfGenStringMesh(
+    TTF* s,
+    IAllocator* pAlloc,
+    const String str,
+    const f32 xOrigin,
+    const f32 yOrigin,
+    const f32 zOff
+)
+{
+    const auto& head = s->m_pFont->m_head;
+    const f32 pxPerUnit = f32(s->m_pxSize) / TTF_LINE_HEIGHT;
+    const f32 baseline = f32(-head.yMin) * (TTF_LINE_HEIGHT / f32(head.yMax - head.yMin));
+
+    /* resolve every glyph first, inserts may grow the atlas and invalidate earlier uvs */
+    struct Placed { GlyphEntry e; f32 x; f32 y; };
+    VecBase<Placed> aPlaced(pAlloc, utils::min(str.getSize(), ssize(s->m_maxSize)));
+
+    f32 xOff = 0.0f;
+    f32 yOff = 0.0f;
+
+    for (wchar_t wc : StringGlyphIt(str))
+    {
+        if (wc == L'\n')
+        {
+            xOff = 0.0f;
+            yOff -= TTF_LINE_HEIGHT;
+            continue;
+        }
+
+        if (aPlaced.getSize() >= s->m_maxSize) break;
+
+        GlyphEntry e {};
+        if (!s->getGlyph(pAlloc, u32(wc), &e)) continue;
+
+        if (e.width > 0 && e.height > 0)
+            aPlaced.push(pAlloc, {e, xOrigin + xOff, yOrigin + yOff + baseline});
+
+        xOff += e.metrics.advance / pxPerUnit;
+    }
+
+    const f32 atlasWidth = s->m_atlas.m_width;
+    const f32 atlasHeight = s->m_atlas.m_height;
+
+    VecBase<CharQuad3Pos2UV> aQuads(pAlloc, aPlaced.getSize());
+
+    for (const auto& p : aPlaced)
+    {
+        const auto& e = p.e;
+
+        f32 x0 = p.x + e.metrics.xBearing / pxPerUnit;
+        f32 y0 = p.y + e.metrics.yBearing / pxPerUnit;
+        f32 x1 = x0 + e.width / pxPerUnit;
+        f32 y1 = y0 + e.height / pxPerUnit;
+
+        /* bitmap row 0 is the bottom of the glyph */
+        f32 u0 = e.x / atlasWidth;
+        f32 v0 = e.y / atlasHeight;
+        f32 u1 = (e.x + e.width) / atlasWidth;
+        f32 v1 = (e.y + e.height) / atlasHeight;
+
+        aQuads.push(pAlloc, {
+            x0, y1, zOff,     u0, v1,
+            x0, y0, zOff,     u0, v0,
+            x1, y0, zOff,     u1, v0,
+
+            x0, y1, zOff,     u0, v1,
+            x1, y0, zOff,     u1, v0,
+            x1, y1, zOff,     u1, v1,
+        });
+    }
+
+    return aQuads;
+}
+
+void
+TTF::init(reader::ttf::Font* pFont, TTF_MODE eMode)
+{
+    m_pFont = pFont;
+    m_maxSize = 320; /* the debug overlay is the longest one */
+    m_eMode = eMode;
+
+    /* grows with the glyphs actually used, 512x64 is enough for ascii at ui sizes */
+    m_atlas = GlyphAtlas(OsAllocatorGet(), 512, 64, 1024);
 
     glGenVertexArrays(1, &m_vao);
-    glBindVertexArray(m_vao);
-    defer( glBindVertexArray(0) );
+    gl::bindVertexArray(m_vao);
+    defer( gl::bindVertexArray(0) );
 
     glGenBuffers(1, &m_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-    glBufferData(GL_ARRAY_BUFFER, m_maxSize * sizeof(CharQuad3Pos2UV), aQuads.data(), GL_DYNAMIC_DRAW);
+    gl::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, m_maxSize * sizeof(CharQuad3Pos2UV), nullptr, GL_DYNAMIC_DRAW);
 
     /* positions */
     glEnableVertexAttribArray(0);
@@ -710,22 +1013,40 @@ void
 TTF::updateText(IAllocator* pAlloc, const String str, f32 x, f32 y, f32 z)
 {
     assert(str.getSize() <= m_maxSize);
-    if (m_str == str) return;
+
+    const u32 pxSize = pixelSize();
+
+    if (m_str == str && m_pxSize == pxSize && m_meshGeneration == m_atlas.m_generation) return;
 
     m_str = str;
+    m_pxSize = pxSize;
+    m_atlas.nextFrame();
+
     auto aQuads = ttfGenStringMesh(this, pAlloc, str, x, y, z);
     m_vboSize = aQuads.getSize() * 6; /* 6 vertices for 1 quad */
+    m_meshGeneration = m_atlas.m_generation;
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    gl::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
     glBufferSubData(GL_ARRAY_BUFFER, 0, aQuads.getSize() * sizeof(aQuads[0]), aQuads.data());
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl::bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void
 TTF::draw()
 {
-    glBindVertexArray(m_vao);
+    m_atlas.flush();
+    texture::ImgBind(m_atlas.m_texId, GL_TEXTURE0);
+
+    gl::bindVertexArray(m_vao);
     glDrawArrays(GL_TRIANGLES, 0, m_vboSize);
 }
 
+void
+TTF::destroy()
+{
+    m_atlas.destroy();
+    gl::deleteBuffer(m_vbo);
+    gl::deleteVertexArray(m_vao);
+}
+
 } /* namespace text */
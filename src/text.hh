@@ -1,5 +1,6 @@
 #pragma once
 
+#include "GlyphAtlas.hh"
 #include "adt/Span2D.hh"
 #include "adt/String.hh"
 #include "adt/Thread.hh"
@@ -38,18 +39,66 @@ struct CharToUV
     math::V2 texCoords {};
 };
 
+/* ui units per line, glyph quads are sized so that font's yMin..yMax covers this */
+constexpr f32 TTF_LINE_HEIGHT = 2.0f;
+
+enum class TTF_MODE : u8 { COVERAGE, SDF };
+
+/* distance fields are generated once at this line height and scaled by the shader */
+constexpr u32 TTF_SDF_SIZE = 32;
+constexpr f32 TTF_SDF_SPREAD = 4.0f; /* pixels from the outline to 0 or 255 */
+constexpr u32 GLYPH_KEY_SDF = 1u << 31; /* or'd into GlyphKey::size */
+
+/* segment of a flattened glyph outline in bitmap pixel space */
+struct OutlineEdge
+{
+    math::V2 p0 {};
+    math::V2 p1 {};
+};
+
+/* tessellate glyph contours, mapping font units to pixels as p*scale + off */
+[[nodiscard]] VecBase<OutlineEdge> glyphEdges(IAllocator* pAlloc, reader::ttf::Glyph* pGlyph, const f32 scale, const math::V2 off);
+
+/* 128 is on the outline, > 128 inside */
+void genGlyphSDF(Span2D<u8> spBitmap, const VecBase<OutlineEdge>& aEdges, const f32 spread);
+
+/* exact area coverage, nonzero winding, any number of crossings per row */
+void rasterizeGlyph(Span2D<u8> spBitmap, const VecBase<OutlineEdge>& aEdges);
+
+/* old intersection path (32 crossings per row max), only kept to compare against */
+void rasterizeGlyphScanline(Span2D<u8> spBitmap, const VecBase<OutlineEdge>& aEdges);
+
+struct GlyphRasterArg
+{
+    Span2D<u8> spBitmap {};
+    const VecBase<OutlineEdge>* pEdges {};
+    TTF_MODE eMode {};
+};
+
+inline THREAD_STATUS
+GlyphRasterSubmit(void* pArg)
+{
+    auto arg = *(GlyphRasterArg*)pArg;
+
+    if (arg.eMode == TTF_MODE::SDF) genGlyphSDF(arg.spBitmap, *arg.pEdges, TTF_SDF_SPREAD);
+    else rasterizeGlyph(arg.spBitmap, *arg.pEdges);
+
+    return {};
+}
+
 struct TTF
 {
     IAllocator* m_pAlloc {};
     reader::ttf::Font* m_pFont {};
     String m_str {};
-    u8* m_pBitmap {};
     u32 m_maxSize {};
-    f32 m_scale {};
+    u32 m_pxSize {}; /* rasterization size of one line in pixels */
+    TTF_MODE m_eMode {};
+    u64 m_meshGeneration {}; /* atlas generation the current mesh was built with */
+    GlyphAtlas m_atlas {};
     GLuint m_vao {};
     GLuint m_vbo {};
     GLuint m_vboSize {};
-    GLuint m_texId {};
 
     /* */
 
@@ -58,32 +107,24 @@ struct TTF
 
     /* */
 
-    void rasterizeAscii(reader::ttf::Font* pFont);
+    /* requires gl context, glyphs are rasterized lazily by updateText() */
+    void init(reader::ttf::Font* pFont, TTF_MODE eMode = TTF_MODE::COVERAGE);
+
+    /* rasterize every missing glyph of str on the thread pool */
+    void cacheParallel(const String str);
 
     /* xy [0, 0] is bottom left */
     void updateText(IAllocator* pAlloc, const String str, f32 x, f32 y, f32 z);
 
+    /* binds atlas texture to GL_TEXTURE0 */
     void draw();
 
-    /* */
+    void destroy();
 
-private:
-    void rasterizeGlyph(IAllocator* pAlloc, reader::ttf::Glyph* pGlyph, Span2D<u8> spBitmap);
-};
+    /* atlas lookup, rasterizes on miss */
+    bool getGlyph(IAllocator* pAlloc, u32 code, GlyphEntry* pEntry);
 
-struct TTFRasterizeArg
-{
-    TTF* self {};
-    reader::ttf::Font* pFont {};
+    [[nodiscard]] u32 pixelSize() const;
 };
 
-inline THREAD_STATUS
-TTFRasterizeSubmit(void* pArg)
-{
-    auto arg = *(TTFRasterizeArg*)pArg;
-    arg.self->rasterizeAscii(arg.pFont);
-
-    return {};
-}
-
 } /* namespace text */
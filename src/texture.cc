@@ -4,31 +4,8 @@
 #include "adt/Arena.hh"
 #include "adt/logs.hh"
 #include "app.hh"
-#include "reader/Bin.hh"
-
-#include <immintrin.h>
-
-/* Bitmap file format
- *
- * SECTION
- * Address:Bytes	Name
- *
- * HEADER:
- *	  0:	2		"BM" magic number
- *	  2:	4		file size
- *	  6:	4		junk
- *	 10:	4		Starting address of image data
- * BITMAP HEADER:
- *	 14:	4		header size
- *	 18:	4		width  (signed)
- *	 22:	4		height (signed)
- *	 26:	2		Number of color planes
- *	 28:	2		Bits per pixel
- *	[...]
- * [OPTIONAL COLOR PALETTE, NOT PRESENT IN 32 BIT BITMAPS]
- * BITMAP DATA:
- *	DATA:	X	Pixels
- */
+
+#include <cstring>
 
 namespace texture
 {
@@ -36,6 +13,9 @@ namespace texture
 Pool<Img, texture::MAX_COUNT> g_aAllTextures(INIT);
 Map<String, PoolHnd> g_mAllTexturesIdxs(OsAllocatorGet(), texture::MAX_COUNT);
 
+UploadQueue g_uploadQueue(OsAllocatorGet());
+BindStats g_bindStats {};
+
 static Mutex s_mtxAllTextures(MUTEX_TYPE::PLAIN);
 
 void
@@ -63,27 +43,68 @@ Img::load(String path, bool bFlip, TYPE type, GLint texMode, GLint magFilter, GL
 
     if (m_id != 0) LOG_FATAL("id != 0: '{}'\n", m_id);
 
-    Arena al(SIZE_1M * 5);
-    defer( al.freeAll() );
-    Data img = loadBMP(&al, path, bFlip);
-
     m_texPath = path;
     this->m_eType = type;
 
-    Vec<u8> pixels = img.aData;
+    /* warm start: mmap the cooked file, first run cooks it */
+    cook::Mapping cooked = cook::mapCooked(path, bFlip);
+    if (!cooked)
+    {
+        Arena al(SIZE_1M);
+        defer( al.freeAll() );
 
-    set(pixels.data(), texMode, img.format, img.width, img.height, magFilter, minFilter);
+        if (cook::cookImage(&al, path, bFlip))
+            cooked = cook::mapCooked(path, bFlip);
+    }
 
-    m_width = img.width;
-    m_height = img.height;
-    
-    auto found = g_mAllTexturesIdxs.search(path);
-    if (found)
+    if (cooked)
     {
-        u32 idx = found.pData->val;
+        defer( cooked.unmap() );
+
+        const cook::Header& h = cooked.header();
+        m_width = h.width;
+        m_height = h.height;
+
+        UploadLevel aLevels[cook::MAX_MIPS] {};
+        for (u32 i = 0; i < h.nMips; ++i)
+            aLevels[i] = {cooked.level(i), h.aMips[i].width, h.aMips[i].height};
+
+        /* the pool copy is written first, the context thread fills in m_id of both */
         g_aAllTextures[idx] = *this;
+
+        if (!g_uploadQueue || !g_uploadQueue.upload(this, idx, aLevels, h.nMips, h.nMips, false, texMode, magFilter, minFilter))
+        {
+            setCooked(cooked, texMode, magFilter, minFilter);
+            g_aAllTextures[idx] = *this;
+        }
+    }
+    else
+    {
+        LOG_WARN("no cooked texture for '{}', loading directly\n", path);
+
+        Arena al(SIZE_1M * 5);
+        defer( al.freeAll() );
+        Data img = loadImage(&al, path, bFlip);
+        if (img.width == 0)
+        {
+            LOG_WARN("failed to load '{}'\n", path);
+            return;
+        }
+
+        m_width = img.width;
+        m_height = img.height;
+        g_aAllTextures[idx] = *this;
+
+        u32 nStorageLevels = 1;
+        while ((utils::max(img.width, img.height) >> nStorageLevels) > 0) ++nStorageLevels;
+
+        const UploadLevel level {img.aData.data(), img.width, img.height};
+        if (!g_uploadQueue || !g_uploadQueue.upload(this, idx, &level, 1, nStorageLevels, true, texMode, magFilter, minFilter))
+        {
+            set(img.aData.data(), texMode, img.format, img.width, img.height, magFilter, minFilter);
+            g_aAllTextures[idx] = *this;
+        }
     }
-    else LOG_FATAL("Why didn't find?\n");
 }
 
 void
@@ -91,7 +112,7 @@ Img::destroy()
 {
     if (m_id != 0)
     {
-        glDeleteTextures(1, &m_id);
+        gl::deleteTexture(m_id);
         LOG_OK("Texture '{}' destroyed\n", m_id);
         m_id = 0;
     }
@@ -100,8 +121,8 @@ Img::destroy()
 void
 Img::bind(GLint glTex)
 {
-    glActiveTexture(glTex);
-    glBindTexture(GL_TEXTURE_2D, m_id);
+    g_bindStats.add();
+    gl::bindTextureUnit(glTex, GL_TEXTURE_2D, m_id);
 }
 
 void
@@ -115,7 +136,7 @@ Img::set(u8* pData, GLint texMode, GLint format, GLsizei width, GLsizei height,
     );
 
     glGenTextures(1, &m_id);
-    glBindTexture(GL_TEXTURE_2D, m_id);
+    gl::bindTexture(GL_TEXTURE_2D, m_id);
     /* set the texture wrapping parameters */
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texMode);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texMode);
@@ -132,6 +153,36 @@ Img::set(u8* pData, GLint texMode, GLint format, GLsizei width, GLsizei height,
     glGenerateMipmap(GL_TEXTURE_2D);
 }
 
+void
+Img::setCooked(const cook::Mapping& cooked, GLint texMode, GLint magFilter, GLint minFilter)
+{
+    gl::g_mtxGlContext.lock();
+    app::g_pWindow->bindGlContext();
+    defer(
+        app::g_pWindow->unbindGlContext();
+        gl::g_mtxGlContext.unlock();
+    );
+
+    const cook::Header& h = cooked.header();
+    m_width = h.width;
+    m_height = h.height;
+
+    glGenTextures(1, &m_id);
+    gl::bindTexture(GL_TEXTURE_2D, m_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, texMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, texMode);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, h.nMips - 1);
+
+    /* mips are precomputed, no glGenerateMipmap() */
+    for (u32 i = 0; i < h.nMips; ++i)
+    {
+        const auto& mip = h.aMips[i];
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, cooked.level(i));
+    }
+}
+
 void
 Img::setMonochrome(u8* pData, u32 width, u32 height)
 {
@@ -147,10 +198,10 @@ Img::setMonochrome(u8* pData, u32 width, u32 height)
 
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     glGenTextures(1, &m_id);
-    glBindTexture(GL_TEXTURE_2D, m_id);
+    gl::bindTexture(GL_TEXTURE_2D, m_id);
     defer(
         glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        gl::bindTexture(GL_TEXTURE_2D, 0);
     );
 
     /*glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);*/
@@ -182,7 +233,7 @@ ShadowMapCreate(const int width, const int height)
     res.t.height = height;
 
     glGenTextures(1, &res.t.tex);
-    glBindTexture(GL_TEXTURE_2D, res.t.tex);
+    gl::bindTexture(GL_TEXTURE_2D, res.t.tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -192,7 +243,7 @@ ShadowMapCreate(const int width, const int height)
 	f32 borderColor[] {1.0, 1.0, 1.0, 1.0};
 	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, nullptr);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl::bindTexture(GL_TEXTURE_2D, 0);
 
     GLint defFramebuffer = 0;
     glGetIntegerv(GL_FRAMEBUFFER_BINDING, &defFramebuffer);
@@ -205,8 +256,8 @@ ShadowMapCreate(const int width, const int height)
 
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, res.t.tex, 0);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, res.t.tex);
+    gl::activeTexture(GL_TEXTURE0);
+    gl::bindTexture(GL_TEXTURE_2D, res.t.tex);
 
     if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
         LOG_FATAL("glCheckFramebufferStatus != GL_FRAMEBUFFER_COMPLETE\n"); 
@@ -221,7 +272,7 @@ CubeMapShadowMapCreate(const int width, const int height)
 {
     GLuint depthCubeMap;
     glGenTextures(1, &depthCubeMap);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
+    gl::bindTexture(GL_TEXTURE_CUBE_MAP, depthCubeMap);
 
     for (GLuint i = 0; i < 6; i++)
         glTexImage2D(
@@ -263,11 +314,11 @@ skyBoxCreate(String aFaces[6])
     CubeMap cmNew {};
 
     glGenTextures(1, &cmNew.t.tex);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cmNew.t.tex);
+    gl::bindTexture(GL_TEXTURE_CUBE_MAP, cmNew.t.tex);
 
     for (u32 i = 0; i < 6; i++)
     {
-        Data tex = loadBMP(&al, aFaces[i], true);
+        Data tex = loadImage(&al, aFaces[i], true);
         glTexImage2D(
             GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
             0, tex.format, tex.width, tex.height,
@@ -284,93 +335,134 @@ skyBoxCreate(String aFaces[6])
     return cmNew;
 }
 
-Data
-loadBMP(IAllocator* pAlloc, String path, bool flip)
+void
+ImgArray::build(const String* aPaths, u32 nPaths, bool bFlip, GLint magFilter, GLint minFilter)
 {
-    u32 imageDataAddress;
-    u32 width;
-    u32 height;
-    u32 nPixels;
-    u16 bitDepth;
-    u8 byteDepth;
+    Arena al(SIZE_1M);
+    defer( al.freeAll() );
 
-    reader::Bin p(pAlloc);
-    p.load(path);
-    auto BM = p.readString(2);
+    struct Src
+    {
+        const u8* pData;
+        u32 width;
+        u32 height;
+    };
 
-    if (BM != "BM")
-        LOG_FATAL("BM: '{}', bmp file should have 'BM' as first 2 bytes\n", BM);
+    Src* aSrcs = (Src*)al.zalloc(nPaths, sizeof(Src));
+    cook::Mapping* aMaps = (cook::Mapping*)al.zalloc(nPaths, sizeof(cook::Mapping));
+    defer( for (u32 i = 0; i < nPaths; ++i) aMaps[i].unmap() );
 
-    p.skipBytes(8);
-    imageDataAddress = p.read32();
+    /* level 0 straight from the mapping, first run cooks it */
+    for (u32 i = 0; i < nPaths; ++i)
+    {
+        aMaps[i] = cook::mapCooked(aPaths[i], bFlip);
+        if (!aMaps[i] && cook::cookImage(&al, aPaths[i], bFlip))
+            aMaps[i] = cook::mapCooked(aPaths[i], bFlip);
 
-#ifdef D_TEXTURE
-    LOG_OK("imageDataAddress: {}\n", imageDataAddress);
-#endif
+        if (aMaps[i])
+        {
+            const cook::Header& h = aMaps[i].header();
+            aSrcs[i] = {aMaps[i].level(0), h.width, h.height};
+        }
+        else
+        {
+            Data img = loadImage(&al, aPaths[i], bFlip);
+            if (img.width > 0)
+            {
+                aSrcs[i] = {img.aData.data(), img.width, img.height};
+            }
+            else
+            {
+                LOG_WARN("failed to load '{}', using a white pixel\n", aPaths[i]);
+                static const u32 s_white = 0xffffffff;
+                aSrcs[i] = {(const u8*)&s_white, 1, 1};
+            }
+        }
 
-    p.skipBytes(4);
-    width = p.read32();
-    height = p.read32();
-#ifdef D_TEXTURE
-    LOG_OK("width: {}, height: {}\n", width, height);
-#endif
+        m_layerWidth = utils::max(m_layerWidth, aSrcs[i].width);
+        m_layerHeight = utils::max(m_layerHeight, aSrcs[i].height);
+    }
 
-    [[maybe_unused]] auto colorPlane = p.read16();
-#ifdef D_TEXTURE
-    LOG_OK("colorPlane: {}\n", colorPlane);
-#endif
+    m_nLayers = nPaths;
+    m_aSlots.setSize(m_pAlloc, nPaths);
 
-    GLint format = GL_RGB;
-    bitDepth = p.read16();
-#ifdef D_TEXTURE
-    LOG_OK("bitDepth: {}\n", bitDepth);
-#endif
+    const usize layerSize = usize(m_layerWidth) * m_layerHeight * 4;
+    u8* pLayers = (u8*)al.malloc(layerSize * nPaths, 1);
 
-    switch (bitDepth)
+    for (u32 i = 0; i < nPaths; ++i)
     {
-        case 24:
-            format = GL_RGB;
-            break;
+        const Src& src = aSrcs[i];
+        u8* pLayer = pLayers + layerSize*i;
 
-        case 32:
-            format = GL_RGBA;
-            break;
+        for (u32 y = 0; y < m_layerHeight; ++y)
+        {
+            const u32* pSrcRow = (const u32*)(src.pData + usize(utils::min(y, src.height - 1))*src.width*4);
+            u32* pDstRow = (u32*)(pLayer + usize(y)*m_layerWidth*4);
 
-        default:
-            LOG_WARN("support only for 32 and 24 bit bmp's, read '{}', setting to GL_RGB\n", bitDepth);
-            break;
-    }
+            memcpy(pDstRow, pSrcRow, usize(src.width) * 4);
+            for (u32 x = src.width; x < m_layerWidth; ++x)
+                pDstRow[x] = pSrcRow[src.width - 1];
+        }
 
-    bitDepth = 32; /* use RGBA anyway */
-    nPixels = width * height;
-    byteDepth = bitDepth / 8;
-#ifdef D_TEXTURE
-    LOG_OK("nPixels: {}, byteDepth: {}, format: {}\n", nPixels, byteDepth, format);
-#endif
-    Vec<u8> pixels(pAlloc, nPixels * byteDepth);
+        m_aSlots[i] = {
+            .layer = i,
+            .uvRect = {0.0f, 0.0f, f32(src.width) / m_layerWidth, f32(src.height) / m_layerHeight},
+        };
 
-    p.m_pos = imageDataAddress;
+        /* no texture of its own, the entry is only there to find the layer by path */
+        guard::Mtx lock(&s_mtxAllTextures);
 
-    switch (format)
-    {
-        default:
-        case GL_RGB:
-            flipCpyBGRtoRGBA(pixels.data(), (u8*)(&p[p.m_pos]), width, height, flip);
-            format = GL_RGBA;
-            break;
-
-        case GL_RGBA:
-            flipCpyBGRAtoRGBA(pixels.data(), (u8*)(&p[p.m_pos]), width, height, flip);
-            break;
+        auto found = g_mAllTexturesIdxs.search(aPaths[i]);
+        u32 idx;
+        if (found)
+        {
+            idx = found.data().val;
+        }
+        else
+        {
+            Img img(m_pAlloc);
+            img.m_texPath = aPaths[i];
+            img.m_width = src.width;
+            img.m_height = src.height;
+
+            idx = g_aAllTextures.push(img);
+            g_mAllTexturesIdxs.insert(aPaths[i], idx);
+        }
+
+        auto& img = g_aAllTextures[idx];
+        img.m_layer = i;
+        img.m_uvRect = m_aSlots[i].uvRect;
     }
 
-    return {
-        .aData = pixels,
-        .width = width,
-        .height = height,
-        .bitDepth = bitDepth,
-        .format = format
-    };
+    glGenTextures(1, &m_id);
+    gl::bindTexture(GL_TEXTURE_2D_ARRAY, m_id);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, magFilter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, minFilter);
+    glTexImage3D(
+        GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, m_layerWidth, m_layerHeight, nPaths, 0, GL_RGBA, GL_UNSIGNED_BYTE, pLayers
+    );
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    gl::bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    LOG_OK("sprite array: {} layers of {}x{}\n", m_nLayers, m_layerWidth, m_layerHeight);
+}
+
+void
+ImgArray::bind(GLint glTex)
+{
+    g_bindStats.add();
+    gl::bindTextureUnit(glTex, GL_TEXTURE_2D_ARRAY, m_id);
+}
+
+void
+ImgArray::destroy()
+{
+    if (m_id != 0) gl::deleteTexture(m_id);
+    m_aSlots.destroy(m_pAlloc);
+
+    *this = ImgArray(m_pAlloc);
 }
 
 Framebuffer
@@ -383,7 +475,7 @@ FramebufferCreate(const GLsizei width, const GLsizei height)
     /* generate texture */
     GLuint tex;
     glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
+    gl::bindTexture(GL_TEXTURE_2D, tex);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -406,104 +498,4 @@ FramebufferCreate(const GLsizei width, const GLsizei height)
     };
 }
 
-#ifndef NDEBUG
-[[maybe_unused]] static void
-printPack(String s, __m128i m)
-{
-    u32 f[4];
-    memcpy(f, &m, sizeof(f));
-    fprintf(stderr, "'%.*s': %08x, %08x, %08x, %08x\n", (int)s.getSize(), s.data(), f[0], f[1], f[2], f[3]);
-};
-#endif
-
-[[maybe_unused]] static u32
-swapRedBlueBits(u32 col)
-{
-    u32 r = col & 0x00'ff'00'00;
-    u32 b = col & 0x00'00'00'ff;
-    return (col & 0xff'00'ff'00) | (r >> (4*4)) | (b << (4*4));
-};
-
-void
-flipCpyBGRAtoRGBA(u8* dest, u8* src, int width, int height, bool vertFlip)
-{
-    int f = vertFlip ? -(height - 1) : 0;
-    int inc = vertFlip ? 2 : 0;
-
-    u32* d = (u32*)(dest);
-    u32* s = (u32*)(src);
-
-    for (int y = 0; y < height; y++, f += inc)
-    {
-        for (int x = 0; x < width; x += 4)
-        {
-            __m128i pack = _mm_loadu_si128((__m128i*)(&s[y*width + x]));
-            __m128i redBits = _mm_and_si128(pack, _mm_set1_epi32(0x00'ff'00'00));
-            __m128i blueBits = _mm_and_si128(pack, _mm_set1_epi32(0x00'00'00'ff));
-            pack = _mm_and_si128(pack, _mm_set1_epi32(0xff'00'ff'00));
-
-            /* https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html#techs=SSE_ALL&ig_expand=3975,627,305,2929,627&cats=Shift */
-            redBits = _mm_bsrli_si128(redBits, 2); /* simd bitshifts are in bytes: 'dst[127:0] := a[127:0] << (tmp*8)' */
-            blueBits = _mm_bslli_si128(blueBits, 2);
-
-            pack = _mm_or_si128(_mm_or_si128(pack, redBits), blueBits);
-            _mm_storeu_si128((__m128i*)(&d[(y-f)*width + x]), pack);
-        }
-    }
-};
-
-void
-flipCpyBGRtoRGB(u8* dest, u8* src, int width, int height, bool vertFlip)
-{
-    int f = vertFlip ? -(height - 1) : 0;
-    int inc = vertFlip ? 2 : 0;
-
-    constexpr int nComponents = 3;
-    width = width * nComponents;
-
-    auto at = [=](int x, int y, int z) -> int {
-        return y*width + x + z;
-    };
-
-    for (int y = 0; y < height; y++)
-    {
-        for (int x = 0; x < width; x += nComponents)
-        {
-            dest[at(x, y-f, 0)] = src[at(x, y, 2)];
-            dest[at(x, y-f, 1)] = src[at(x, y, 1)];
-            dest[at(x, y-f, 2)] = src[at(x, y, 0)];
-        }
-        f += inc;
-    }
-};
-
-void
-flipCpyBGRtoRGBA(u8* dest, u8* src, int width, int height, bool vertFlip)
-{
-    int f = vertFlip ? -(height - 1) : 0;
-    int inc = vertFlip ? 2 : 0;
-
-    constexpr int rgbComp = 3;
-    constexpr int rgbaComp = 4;
-
-    int rgbWidth = width * rgbComp;
-    int rgbaWidth = width * rgbaComp;
-
-    auto at = [](int width, int x, int y, int z) -> int {
-        return y*width + x + z;
-    };
-
-    for (int y = 0; y < height; y++)
-    {
-        for (int xSrc = 0, xDest = 0; xSrc < rgbWidth; xSrc += rgbComp, xDest += rgbaComp)
-        {
-            dest[at(rgbaWidth, xDest, y-f, 0)] = src[at(rgbWidth, xSrc, y, 2)];
-            dest[at(rgbaWidth, xDest, y-f, 1)] = src[at(rgbWidth, xSrc, y, 1)];
-            dest[at(rgbaWidth, xDest, y-f, 2)] = src[at(rgbWidth, xSrc, y, 0)];
-            dest[at(rgbaWidth, xDest, y-f, 3)] = 0xff;
-        }
-        f += inc;
-    }
-};
-
 } /* namespace texture */
@@ -3,10 +3,15 @@
 #include "adt/IAllocator.hh"
 #include "adt/Map.hh"
 #include "adt/Pool.hh"
+#include "adt/prof.hh"
 #include "adt/Vec.hh"
 #include "adt/String.hh"
 #include "gl/gl.hh" /* IWYU pragma: keep */
+#include "gl/state.hh"
 #include "adt/math.hh"
+#include "cook.hh"
+#include "image.hh"
+#include "UploadQueue.hh"
 
 namespace texture
 {
@@ -20,6 +25,7 @@ struct Hash;
 
 extern Pool<Img, MAX_COUNT> g_aAllTextures;
 extern Map<String, PoolHnd> g_mAllTexturesIdxs;
+extern UploadQueue g_uploadQueue; /* Img::load() goes through it once createBuffer() was called */
 
 enum TYPE : s8
 {
@@ -27,15 +33,6 @@ enum TYPE : s8
     NORMAL
 };
 
-struct Data
-{
-    Vec<u8> aData;
-    u32 width;
-    u32 height;
-    u16 bitDepth;
-    GLint format;
-};
-
 struct Img
 {
     IAllocator* m_pAlloc;
@@ -44,6 +41,8 @@ struct Img
     u32 m_height = 0;
     GLuint m_id = 0;
     enum TYPE m_eType = TYPE::DIFFUSE;
+    u32 m_layer = NPOS32; /* ImgArray layer, if it was packed into one */
+    math::V4 m_uvRect {}; /* x0, y0, x1, y1 of the image inside its layer */
 
     /* */
 
@@ -58,18 +57,65 @@ struct Img
 
     void set(u8* pData, GLint texMode, GLint format, GLsizei width, GLsizei height, GLint magFilter, GLint minFilter);
 
+    /* upload every level of a cooked file */
+    void setCooked(const cook::Mapping& cooked, GLint texMode, GLint magFilter, GLint minFilter);
+
     void setMonochrome(u8* pData, u32 width, u32 height);
 
     void destroy();
 };
 
+struct BindStats
+{
+    u32 nFrame {};
+    u32 nLastFrame {};
+    u64 nTotal {};
+
+    void add() { ++nFrame; ++nTotal; }
+    void nextFrame() { nLastFrame = nFrame; nFrame = 0; }
+};
+
+extern BindStats g_bindStats;
+
 inline void
 ImgBind(GLuint id, GLint glTex)
 {
-    glActiveTexture(glTex);
-    glBindTexture(GL_TEXTURE_2D, id);
+    g_bindStats.add();
+    gl::bindTextureUnit(glTex, GL_TEXTURE_2D, id);
 }
 
+struct ArraySlot
+{
+    u32 layer {};
+    math::V4 uvRect {};
+};
+
+/* Sprites as layers of one GL_TEXTURE_2D_ARRAY, so they can be drawn with a single bind.
+ * Layers are as big as the largest image, smaller ones sit in the corner and their edges are
+ * repeated over the rest of the layer, so mips don't pull in black. */
+struct ImgArray
+{
+    IAllocator* m_pAlloc {};
+    GLuint m_id {};
+    u32 m_layerWidth {};
+    u32 m_layerHeight {};
+    u32 m_nLayers {};
+    VecBase<ArraySlot> m_aSlots {}; /* same order as the paths */
+
+    /* */
+
+    ImgArray() = default;
+    ImgArray(IAllocator* p) : m_pAlloc(p) {}
+
+    /* */
+
+    /* one layer per path. Paths go into g_aAllTextures (without a texture of their own, unless Img::load() had
+     * loaded them) with m_layer/m_uvRect set, that's how sprites find their layer. Paths have to outlive the pool */
+    void build(const String* aPaths, u32 nPaths, bool bFlip, GLint magFilter, GLint minFilter);
+    void bind(GLint glTex);
+    void destroy();
+};
+
 struct ImgLoadArg
 {
     Img* self;
@@ -115,14 +161,11 @@ ShadowMap ShadowMapCreate(const int width, const int height);
 CubeMap CubeMapShadowMapCreate(const int width, const int height);
 CubeMap skyBoxCreate(String sFaces[6]);
 
-Data loadBMP(IAllocator* pAlloc, String path, bool flip);
-void flipCpyBGRAtoRGBA(u8* dest, u8* src, int width, int height, bool vertFlip);
-void flipCpyBGRtoRGB(u8* dest, u8* src, int width, int height, bool vertFlip);
-void flipCpyBGRtoRGBA(u8* dest, u8* src, int width, int height, bool vertFlip);
-
 inline THREAD_STATUS
 ImgSubmit(void* p)
 {
+    PROFILE_SCOPE("ImgSubmit");
+
     auto a = *(ImgLoadArg*)p;
     a.self->load(a.path, a.flip, a.type, a.texMode, a.magFilter, a.minFilter);
     return {};
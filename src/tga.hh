@@ -1,6 +1,6 @@
 #pragma once
 
-#include "adt/TwoDSpan.hh"
+#include "adt/Span2D.hh"
 
 #include <cstdio>
 
@@ -11,6 +11,21 @@ namespace tga
 
 enum class PIXEL_TYPE : u8 { RGB, RGBA };
 
+/* Header::dataTypeCode */
+enum DATA_TYPE : u8
+{
+    COLOR_MAPPED = 1,
+    TRUE_COLOR = 2,
+    GRAY = 3,
+    RLE_COLOR_MAPPED = 9,
+    RLE_TRUE_COLOR = 10,
+    RLE_GRAY = 11,
+};
+
+/* Header::imageDescriptor, low 4 bits are the number of alpha bits */
+constexpr u8 DESCRIPTOR_RIGHT_TO_LEFT = 0x10;
+constexpr u8 DESCRIPTOR_TOP_TO_BOTTOM = 0x20;
+
 struct PixelRGB
 {
     u8 r {};
@@ -26,24 +41,26 @@ struct PixelRGBA : PixelRGB
 #pragma pack(1)
 struct Header
 {
-    s8 idLen {};
-    s8 colorMapType {};
-    s8 dataTypeCode {}; /* 2 (RGB) */
-    s16 colorMapOrigin {};
-    s16 colorMapLenght {};
-    s8 colorMapDepth {};
-    s16 xOrigin {};
-    s16 yOrigin {};
-    s16 width {};
-    s16 height {};
-    s8 bitsPerPixel {};
-    s8 imageDescriptor {};
+    u8 idLen {};
+    u8 colorMapType {};
+    u8 dataTypeCode {}; /* DATA_TYPE */
+    u16 colorMapOrigin {};
+    u16 colorMapLenght {};
+    u8 colorMapDepth {};
+    u16 xOrigin {};
+    u16 yOrigin {};
+    u16 width {};
+    u16 height {};
+    u8 bitsPerPixel {};
+    u8 imageDescriptor {};
 };
 #pragma pack()
 
+static_assert(sizeof(Header) == 18);
+
 struct Image
 {
-    TwoDSpan<PixelRGBA> m_spBuff {};
+    Span2D<PixelRGBA> m_spBuff {};
 
     /* */
 
@@ -55,12 +72,12 @@ struct Image
     const PixelRGBA& operator()(ssize x, ssize y) const { return m_spBuff(x, y); }
     auto data() { return m_spBuff.data(); }
 
-    bool read(TwoDSpan<PixelRGBA> spData);
+    bool read(Span2D<PixelRGBA> spData);
     void writeToFile(FILE* fp);
 };
 
 inline bool
-Image::read(TwoDSpan<PixelRGBA> spData)
+Image::read(Span2D<PixelRGBA> spData)
 {
     m_spBuff = {spData.data(), spData.getWidth(), spData.getHeight()};
 
@@ -79,10 +96,10 @@ Image::writeToFile(FILE* fp)
         .colorMapDepth = 0,
         .xOrigin = 0,
         .yOrigin = 0,
-        .width = m_spBuff.getWidth(),
-        .height = m_spBuff.getHeight(),
-        .bitsPerPixel = 24,
-        .imageDescriptor = 0,
+        .width = u16(m_spBuff.getWidth()),
+        .height = u16(m_spBuff.getHeight()),
+        .bitsPerPixel = 32,
+        .imageDescriptor = 8,
     };
 
     fwrite(&header, sizeof(Header), 1, fp);
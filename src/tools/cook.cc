@@ -0,0 +1,179 @@
+/* Batch texture, mesh and level cooker, run from the directory the game runs from:
+ *     cook [--flip] [--force] [dir ...] (default: test-assets)
+ * Writes cook::COOKED_DIR/ the same way the first run of the game would. */
+
+#include "cook.hh"
+#include "level.hh"
+#include "meshopt.hh"
+
+#include "adt/Arena.hh"
+#include "adt/ThreadPool.hh"
+#include "adt/Vec.hh"
+#include "adt/defer.hh"
+#include "adt/logs.hh"
+#include "adt/utils.hh"
+
+#include <filesystem>
+
+using namespace adt;
+
+int
+main(int argc, char** argv)
+{
+    Arena arena(SIZE_1M);
+    defer( arena.freeAll() );
+
+    bool bFlip = false;
+    bool bForce = false;
+    VecBase<String> aDirs(&arena, 4);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (String(argv[i]) == "--flip") bFlip = true;
+        else if (String(argv[i]) == "--force") bForce = true;
+        else aDirs.push(&arena, String(argv[i]));
+    }
+
+    if (aDirs.empty()) aDirs.push(&arena, String("test-assets"));
+
+    VecBase<cook::CookArg> aArgs(&arena, 64);
+    VecBase<String> aMeshes(&arena, 8);
+    VecBase<String> aLevels(&arena, 8);
+
+    for (const String sDir : aDirs)
+    {
+        std::error_code ec {};
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(sDir.data(), ec))
+        {
+            if (!entry.is_regular_file()) continue;
+
+            const auto ext = entry.path().extension();
+            /* same '/' separated relative path the game passes to Img::load() and gltf::Model::load() */
+            const std::string sPath = entry.path().generic_string();
+
+            if (ext == ".gltf")
+            {
+                aMeshes.push(&arena, StringAlloc(&arena, sPath.data(), sPath.size()));
+                continue;
+            }
+
+            if (ext == ".lvl")
+            {
+                aLevels.push(&arena, StringAlloc(&arena, sPath.data(), sPath.size()));
+                continue;
+            }
+
+            if (ext != ".bmp" && ext != ".png" && ext != ".tga") continue;
+
+            aArgs.push(&arena, {.sPath = StringAlloc(&arena, sPath.data(), sPath.size()), .bFlip = bFlip, .bForce = bForce});
+        }
+
+        if (ec) CERR("'{}': {}\n", sDir, ec.message().data());
+    }
+
+    ThreadPool tp(&arena, utils::max(ADT_GET_NCORES(), 1));
+    tp.start();
+
+    s64 t0 = utils::timeNowUS();
+
+    for (auto& a : aArgs)
+        tp.submit(cook::CookSubmit, &a);
+
+    tp.wait();
+
+    s64 t1 = utils::timeNowUS();
+
+    /* one model at a time, its primitives go wide */
+    int nMeshesFailed = 0;
+    for (const String sPath : aMeshes)
+    {
+        gltf::Model m(&arena);
+        if (!m.load(sPath))
+        {
+            CERR("failed: '{}'\n", sPath);
+            ++nMeshesFailed;
+            continue;
+        }
+
+        if (!bForce)
+        {
+            meshopt::Packed cooked = meshopt::mapCooked(sPath, meshopt::hashSource(m));
+            const bool bUpToDate = bool(cooked);
+            cooked.destroy();
+            if (bUpToDate) continue;
+        }
+
+        const s64 tm0 = utils::timeNowUS();
+        meshopt::Packed p = meshopt::build(&arena, &tp, m);
+        const s64 tm1 = utils::timeNowUS();
+
+        if (p.header().nPrims == 0) continue;
+        if (!meshopt::writeCooked(p, sPath))
+        {
+            CERR("failed to write: '{}'\n", sPath);
+            ++nMeshesFailed;
+            continue;
+        }
+
+        for (u32 i = 0; i < p.header().nPrims; ++i)
+        {
+            const meshopt::Primitive& prim = p.prim(i);
+            CERR("'{}' [{}][{}]: {} verts, {} indices ({} bit), acmr: {:.3} -> {:.3}, atvr: {:.3} -> {:.3}\n",
+                sPath, prim.meshIdx, prim.primIdx, prim.nVerts, prim.nIdxs, prim.indexSize * 8,
+                prim.before.acmr, prim.after.acmr, prim.before.atvr, prim.after.atvr
+            );
+        }
+        CERR("'{}': {} bytes in {} us\n", sPath, p.m_size, tm1 - tm0);
+    }
+
+    tp.destroy();
+
+    /* text levels are small, always recooked */
+    int nLevelsFailed = 0;
+    for (const String sPath : aLevels)
+    {
+        Arena scratch(SIZE_1M);
+        defer( scratch.freeAll() );
+
+        const s64 tl0 = utils::timeNowUS();
+        if (!level::cookText(&scratch, sPath))
+        {
+            CERR("failed: '{}'\n", sPath);
+            ++nLevelsFailed;
+            continue;
+        }
+        CERR("'{}': cooked in {} us\n", sPath, utils::timeNowUS() - tl0);
+    }
+
+    u64 srcBytes = 0, cookedBytes = 0;
+    int nFailed = 0, nSkipped = 0;
+
+    for (const auto& a : aArgs)
+    {
+        if (!a.bOk)
+        {
+            CERR("failed: '{}'\n", a.sPath);
+            ++nFailed;
+            continue;
+        }
+
+        if (a.bSkipped)
+        {
+            ++nSkipped;
+            continue;
+        }
+
+        srcBytes += a.stats.srcBytes;
+        cookedBytes += a.stats.cookedBytes;
+
+        CERR("'{}': {} -> {} bytes, decode: {} us, mips: {} us, write: {} us\n",
+            a.sPath, a.stats.srcBytes, a.stats.cookedBytes, a.stats.decodeUS, a.stats.mipsUS, a.stats.writeUS
+        );
+    }
+
+    CERR("cooked {}/{} images, {} up to date ({} -> {} bytes) in {:.3} ms\n",
+        aArgs.getSize() - nFailed - nSkipped, aArgs.getSize(), nSkipped, srcBytes, cookedBytes, f64(t1 - t0) / 1000.0
+    );
+
+    return nFailed == 0 && nMeshesFailed == 0 && nLevelsFailed == 0 ? 0 : 1;
+}